@@ -0,0 +1,556 @@
+// Micro benchmarks of engine primitives, run by MicroBenchmark.cpp.
+//
+// The arguments are data sizes: number of matrices, vectors or quaternions for the math, grid side
+// of the generated mesh for the loaders and number of bodies, or bodies spawned per second, for the
+// physics world and number of objects for the scene graph. Nothing needs a window or a gl context,
+// meshes are never uploaded.
+
+#include "MicroBenchmark.h"
+
+#include "../Game/GameObject.h"
+#include "../Game/ModelLoaders/ObjLoader.h"
+#include "../Game/PhysicsWorld.h"
+#include "../Game/Profiling/Profiler.h"
+#include "../Game/SceneGraph.h"
+#include "../Game/Math/matrix4.h"
+#include "../Game/Math/quaternion.h"
+#include "../Game/Math/vector3.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+static unsigned int random_state = 12345;
+
+static float RandomFloat(float min, float max)
+{
+	random_state = random_state * 1664525u + 1013904223u;
+	return min + (max - min) * float(random_state >> 8) / float(1 << 24);
+}
+
+static Matrix4 RandomMatrix()
+{
+	Matrix4 matrix;
+	for (float &value : matrix.values) {
+		value = RandomFloat(-1.0f, 1.0f);
+	}
+	return matrix;
+}
+
+static Quaternion RandomRotation()
+{
+	Vector3 axis(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f) + 2.0f);
+	return Quaternion(axis.Normalize(), RandomFloat(-3.0f, 3.0f));
+}
+
+// a wavy side x side vertex grid, two triangles per cell
+static void MakeGrid(int side, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+	vertices.resize(side * side);
+	for (int z = 0; z < side; z++) {
+		for (int x = 0; x < side; x++) {
+			Vertex &vertex = vertices[z * side + x];
+			vertex.x = float(x);
+			vertex.y = std::sin(float(x) * 0.3f) * std::cos(float(z) * 0.2f);
+			vertex.z = float(z);
+			vertex.ny = 1.0f;
+			vertex.s = float(x) / float(side - 1);
+			vertex.t = float(z) / float(side - 1);
+		}
+	}
+
+	indices.clear();
+	for (int z = 0; z + 1 < side; z++) {
+		for (int x = 0; x + 1 < side; x++) {
+			const unsigned int corner = z * side + x;
+			indices.insert(indices.end(), { corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1 });
+		}
+	}
+}
+
+static long GetFileSize(const std::string &path)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		return 0;
+	}
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+// math
+
+static void BM_Matrix4Multiply(BenchmarkState &state)
+{
+	const size_t count = size_t(state.GetArg());
+	std::vector<Matrix4> a(count), b(count), result(count);
+	for (size_t i = 0; i < count; i++) {
+		a[i] = RandomMatrix();
+		b[i] = RandomMatrix();
+	}
+
+	while (state.KeepRunning()) {
+		for (size_t i = 0; i < count; i++) {
+			result[i] = a[i] * b[i];
+		}
+		DoNotOptimize(result.data());
+		ClobberMemory();
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations() * count));
+}
+BENCHMARK(BM_Matrix4Multiply)->Arg(16)->Arg(1024)->Arg(65536);
+
+static void BM_Matrix4Invert(BenchmarkState &state)
+{
+	const size_t count = size_t(state.GetArg());
+	std::vector<Matrix4> matrices(count), result(count);
+	for (Matrix4 &matrix : matrices) {
+		matrix = RandomMatrix();
+	}
+
+	while (state.KeepRunning()) {
+		for (size_t i = 0; i < count; i++) {
+			result[i] = matrices[i];
+			result[i].Invert();
+		}
+		DoNotOptimize(result.data());
+		ClobberMemory();
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations() * count));
+}
+BENCHMARK(BM_Matrix4Invert)->Arg(16)->Arg(1024)->Arg(65536);
+
+static void BM_QuaternionMultiply(BenchmarkState &state)
+{
+	const size_t count = size_t(state.GetArg());
+	std::vector<Quaternion> a(count), b(count), result(count);
+	for (size_t i = 0; i < count; i++) {
+		a[i] = RandomRotation();
+		b[i] = RandomRotation();
+	}
+
+	while (state.KeepRunning()) {
+		for (size_t i = 0; i < count; i++) {
+			result[i] = a[i] * b[i];
+		}
+		DoNotOptimize(result.data());
+		ClobberMemory();
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations() * count));
+}
+BENCHMARK(BM_QuaternionMultiply)->Arg(16)->Arg(1024)->Arg(65536);
+
+static void BM_Vector3Normalize(BenchmarkState &state)
+{
+	const size_t count = size_t(state.GetArg());
+	std::vector<Vector3> vectors(count), result(count);
+	for (Vector3 &vector : vectors) {
+		vector = Vector3(RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f));
+	}
+
+	while (state.KeepRunning()) {
+		for (size_t i = 0; i < count; i++) {
+			result[i] = vectors[i];
+			result[i].Normalize();
+		}
+		DoNotOptimize(result.data());
+		ClobberMemory();
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations() * count));
+}
+BENCHMARK(BM_Vector3Normalize)->Arg(16)->Arg(1024)->Arg(65536);
+
+// loaders
+
+static void BM_ObjLoaderLoadMesh(BenchmarkState &state)
+{
+	const int side = int(state.GetArg());
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(side, vertices, indices);
+
+	const std::string path = "microbenchmark_" + std::to_string(side) + ".obj";
+	FILE *file = fopen(path.c_str(), "w");
+	if (file == nullptr) {
+		state.SkipWithError("could not write " + path);
+		return;
+	}
+	for (const Vertex &vertex : vertices) {
+		fprintf(file, "v %f %f %f\n", vertex.x, vertex.y, vertex.z);
+	}
+	for (const Vertex &vertex : vertices) {
+		fprintf(file, "vt %f %f\n", vertex.s, vertex.t);
+	}
+	for (const Vertex &vertex : vertices) {
+		fprintf(file, "vn %f %f %f\n", vertex.nx, vertex.ny, vertex.nz);
+	}
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", indices[i] + 1, indices[i] + 1, indices[i] + 1,
+			indices[i + 1] + 1, indices[i + 1] + 1, indices[i + 1] + 1, indices[i + 2] + 1, indices[i + 2] + 1, indices[i + 2] + 1);
+	}
+	fclose(file);
+
+	ObjLoader loader;
+	while (state.KeepRunning()) {
+		MeshHandle mesh = loader.LoadMesh(path);
+		DoNotOptimize(Mesh::pool.Get(mesh));
+		Mesh::pool.Destroy(mesh);
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations() * vertices.size()));
+	state.SetBytesProcessed(int64_t(state.GetIterations()) * GetFileSize(path));
+
+	remove(path.c_str());
+}
+BENCHMARK(BM_ObjLoaderLoadMesh)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_GameObjectSave(BenchmarkState &state)
+{
+	const int side = int(state.GetArg());
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(side, vertices, indices);
+
+	GameObject object;
+	object.SetMesh(Mesh::pool.Create(vertices, indices));
+
+	const std::string path = "microbenchmark_" + std::to_string(side) + ".m5m";
+	while (state.KeepRunning()) {
+		object.Save(path);
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations() * vertices.size()));
+	state.SetBytesProcessed(int64_t(state.GetIterations()) * GetFileSize(path));
+
+	Mesh::pool.Destroy(object.GetMeshHandle());
+	remove(path.c_str());
+}
+BENCHMARK(BM_GameObjectSave)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_GameObjectLoad(BenchmarkState &state)
+{
+	const int side = int(state.GetArg());
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(side, vertices, indices);
+
+	const std::string path = "microbenchmark_" + std::to_string(side) + ".m5m";
+	{
+		GameObject object;
+		object.SetMesh(Mesh::pool.Create(vertices, indices));
+		object.Save(path);
+		Mesh::pool.Destroy(object.GetMeshHandle());
+	}
+
+	while (state.KeepRunning()) {
+		GameObjectHandle handle = GameObject::Load(path);
+		GameObject *object = GameObject::pool.Get(handle);
+		DoNotOptimize(object);
+		Mesh::pool.Destroy(object->GetMeshHandle());
+		GameObject::pool.Destroy(handle);
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations() * vertices.size()));
+	state.SetBytesProcessed(int64_t(state.GetIterations()) * GetFileSize(path));
+
+	remove(path.c_str());
+}
+BENCHMARK(BM_GameObjectLoad)->Arg(16)->Arg(64)->Arg(256);
+
+// scene graph
+
+// objects of each prop: a root with two children that have two children each
+static const int PROP_SIZE = 7;
+// one in this many props moves every frame
+static const int PROP_MOVE_INTERVAL = 10;
+
+// props of a few attached objects, of which a tenth move every iteration like bodies synced by the
+// physics world. the rest keep their matrices.
+static void BM_SceneGraphUpdate(BenchmarkState &state)
+{
+	const int props = int(state.GetArg()) / PROP_SIZE;
+
+	std::unique_ptr<SceneGraph> graph(new SceneGraph());
+	std::vector<GameObject*> roots;
+	for (int i = 0; i < props; i++) {
+		GameObject *nodes[PROP_SIZE];
+		for (int j = 0; j < PROP_SIZE; j++) {
+			nodes[j] = GameObject::pool.Get(GameObject::pool.Create());
+			nodes[j]->translation = Vector3(RandomFloat(-1.0f, 1.0f), 1.0f, RandomFloat(-1.0f, 1.0f));
+			nodes[j]->rotation = RandomRotation();
+		}
+		graph->Add(*nodes[0]);
+		for (int j = 1; j < PROP_SIZE; j++) {
+			graph->Attach(*nodes[j], *nodes[(j - 1) / 2]);
+		}
+		roots.push_back(nodes[0]);
+	}
+	graph->Update();
+
+	int frame = 0;
+	while (state.KeepRunning()) {
+		for (size_t i = frame % PROP_MOVE_INTERVAL; i < roots.size(); i += PROP_MOVE_INTERVAL) {
+			roots[i]->translation.y += 0.01f;
+			roots[i]->UpdateMatrix();
+		}
+		graph->Update();
+		DoNotOptimize(&roots[0]->GetMatrix());
+		frame++;
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations()) * props * PROP_SIZE);
+
+	graph.reset();
+	GameObject::pool.Clear();
+}
+BENCHMARK(BM_SceneGraphUpdate)->Arg(1024)->Arg(16384)->Arg(131072);
+
+// physics
+
+// frames simulated per iteration, from the moment the bodies are dropped
+static const int PHYSICS_FRAMES = 120;
+
+// bullet's thread pool, shared by every world. a world made without one starts a pool of its own,
+// and bullet hands out thread indices that are never given back, so a pool per world runs out of
+// them after a few iterations. starting the threads would be timed as well.
+static btITaskScheduler *GetPhysicsScheduler()
+{
+	static btITaskScheduler *scheduler = btCreateDefaultTaskScheduler();
+	return scheduler;
+}
+
+// a unit cube, the vertices aren't shared between faces
+static MeshHandle MakeBoxMesh()
+{
+	std::vector<Vertex> box_vertices(8);
+	for (int i = 0; i < 8; i++) {
+		box_vertices[i].x = (i & 1) ? 0.5f : -0.5f;
+		box_vertices[i].y = (i & 2) ? 0.5f : -0.5f;
+		box_vertices[i].z = (i & 4) ? 0.5f : -0.5f;
+	}
+	return Mesh::pool.Create(box_vertices, std::vector<unsigned int> {
+		0, 1, 2, 1, 3, 2, 4, 6, 5, 5, 6, 7, 0, 4, 1, 1, 4, 5, 2, 3, 6, 3, 7, 6, 0, 2, 4, 2, 6, 4, 1, 5, 3, 3, 5, 7 });
+}
+
+// a pile of boxes dropped onto a grid, every iteration starts over with a new world so the bodies
+// always fall, collide and settle the same way
+static void BM_PhysicsWorldUpdate(BenchmarkState &state)
+{
+	const int count = int(state.GetArg());
+
+	std::vector<Vertex> ground_vertices;
+	std::vector<unsigned int> ground_indices;
+	MakeGrid(64, ground_vertices, ground_indices);
+	MeshHandle ground_mesh = Mesh::pool.Create(ground_vertices, ground_indices);
+	MeshHandle box_mesh = MakeBoxMesh();
+
+	// layers of 16 x 16 boxes over the middle of the grid
+	const int row = 16;
+	std::vector<Vector3> positions(count);
+	for (int i = 0; i < count; i++) {
+		const int layer = i / (row * row);
+		positions[i] = Vector3(24.0f + 1.5f * float(i % row), 3.0f + 1.5f * float(layer), 24.0f + 1.5f * float(i / row % row));
+	}
+
+	while (state.KeepRunning()) {
+		state.PauseTiming();
+		std::unique_ptr<PhysicsWorld> world(new PhysicsWorld(false, GetPhysicsScheduler()));
+		world->SetFixedTimeStep(60.0, 1);
+
+		GameObjectHandle ground = GameObject::pool.Create();
+		GameObject::pool.Get(ground)->SetMesh(ground_mesh);
+		world->RegisterObject(ground, 0.0);
+
+		for (int i = 0; i < count; i++) {
+			GameObjectHandle box = GameObject::pool.Create();
+			GameObject::pool.Get(box)->SetMesh(box_mesh);
+			GameObject::pool.Get(box)->translation = positions[i];
+			world->RegisterObject(box, 1.0);
+		}
+		state.ResumeTiming();
+
+		for (int frame = 0; frame < PHYSICS_FRAMES; frame++) {
+			world->Update(1.0 / 60.0);
+		}
+
+		state.PauseTiming();
+		world.reset();
+		GameObject::pool.Clear();
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations()) * PHYSICS_FRAMES);
+
+	Mesh::pool.Destroy(ground_mesh);
+	Mesh::pool.Destroy(box_mesh);
+}
+BENCHMARK(BM_PhysicsWorldUpdate)->Arg(64)->Arg(256)->Arg(1024);
+
+// bodies kicked up per frame in a SleepingWorld
+static const int SLEEPING_KICKS = 10;
+
+// a large world at rest: boxes sitting apart on flat ground have gone to sleep once it is made, and
+// every frame kicks a few of them up so a small share is always awake
+struct SleepingWorld
+{
+	explicit SleepingWorld(int count)
+	{
+		const int side = int(std::ceil(std::sqrt(double(count))));
+		const float spacing = 3.0f;
+
+		// flat, one cell per box. bullet copes badly with a few huge triangles
+		std::vector<Vertex> ground_vertices;
+		std::vector<unsigned int> ground_indices;
+		MakeGrid(side + 1, ground_vertices, ground_indices);
+		for (Vertex &vertex : ground_vertices) {
+			vertex.x = spacing * vertex.x - 0.5f * spacing;
+			vertex.y = 0.0f;
+			vertex.z = spacing * vertex.z - 0.5f * spacing;
+		}
+		groundMesh = Mesh::pool.Create(ground_vertices, ground_indices);
+		boxMesh = MakeBoxMesh();
+
+		world.reset(new PhysicsWorld(false, GetPhysicsScheduler()));
+		world->SetFixedTimeStep(60.0, 1);
+
+		GameObjectHandle ground = GameObject::pool.Create();
+		GameObject::pool.Get(ground)->SetMesh(groundMesh);
+		world->RegisterObject(ground, 0.0);
+
+		bodies.reserve(count);
+		for (int i = 0; i < count; i++) {
+			const GameObjectHandle handle = GameObject::pool.Create();
+			GameObject *box = GameObject::pool.Get(handle);
+			box->SetMesh(boxMesh);
+			// where they come to rest, collision margins included
+			box->translation = Vector3(spacing * float(i % side), 0.54f, spacing * float(i / side));
+			box->UpdateMatrix();
+			bodies.push_back(world->RegisterObject(handle, 1.0));
+		}
+
+		// bullet puts a body to sleep after it has rested for two seconds. with 100k boxes, this is
+		// most of the benchmark's run time
+		for (int frame = 0; frame < 150; frame++) {
+			world->Update(1.0 / 60.0);
+		}
+	}
+
+	~SleepingWorld()
+	{
+		world.reset();
+		GameObject::pool.Clear();
+		Mesh::pool.Destroy(groundMesh);
+		Mesh::pool.Destroy(boxMesh);
+	}
+
+	void Frame()
+	{
+		for (int i = 0; i < SLEEPING_KICKS; i++) {
+			// a prime stride spreads the kicks over the whole field
+			nextKick = (nextKick + 7919) % int(bodies.size());
+			world->ApplyImpulse(bodies[nextKick], Vector3(0.0f, 5.0f, 0.0f));
+		}
+		world->Update(1.0 / 60.0);
+	}
+
+	MeshHandle groundMesh;
+	MeshHandle boxMesh;
+	std::unique_ptr<PhysicsWorld> world;
+	std::vector<PhysicsBodyHandle> bodies;
+	int nextKick = 0;
+};
+
+// a whole frame of a SleepingWorld. bullet still walks every body for the aabb update and the
+// islands each step, so a frame takes about ten times as long with ten times the boxes even
+// though only the kicked ones are awake. BM_PhysicsSleepingSync times the engine's share alone.
+static void BM_PhysicsSleepingBodies(BenchmarkState &state)
+{
+	SleepingWorld sleeping(int(state.GetArg()));
+
+	while (state.KeepRunning()) {
+		sleeping.Frame();
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations()));
+}
+BENCHMARK(BM_PhysicsSleepingBodies)->Arg(10000)->Arg(100000);
+
+// only the copy of the moved bodies into their objects at the end of a SleepingWorld frame, taken
+// from its profiler zone. it visits the bodies bullet moved, a few hundred with either count, and
+// stays well under a millisecond. it still grows a little with the boxes, the moved ones are
+// spread over more memory.
+static void BM_PhysicsSleepingSync(BenchmarkState &state)
+{
+	SleepingWorld sleeping(int(state.GetArg()));
+	Profiler::Init(1);
+
+	while (state.KeepRunning()) {
+		sleeping.Frame();
+		Profiler::EndFrame();
+
+		uint64_t ticks = 0;
+		for (size_t thread = 0; thread < Profiler::GetThreadCount(); thread++) {
+			for (const ProfileEvent &event : Profiler::GetThreadEvents(thread)) {
+				if (strcmp(event.name, "PhysicsWorld::SyncMovedBodies") == 0) {
+					ticks += event.end - event.start;
+				}
+			}
+		}
+		state.SetIterationTime(Profiler::TicksToMilliseconds(ticks) * 1.0e-3);
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations()));
+
+	Profiler::Shutdown();
+}
+BENCHMARK(BM_PhysicsSleepingSync)->Arg(10000)->Arg(100000)->Iterations(60);
+
+// frames a spawned box lives for
+static const int SPAWN_LIFETIME = 10;
+
+// debris churn: every iteration is a 60 Hz frame that spawns boxes with bodies, despawns the ones
+// spawned SPAWN_LIFETIME frames earlier and steps the world. the argument is the spawn rate per
+// second, the engine keeps up with it while the items per second stay above it.
+static void BM_SpawnDespawn(BenchmarkState &state)
+{
+	const int per_frame = int((state.GetArg() + 59) / 60);
+
+	MeshHandle box_mesh = MakeBoxMesh();
+	std::unique_ptr<PhysicsWorld> world(new PhysicsWorld(false, GetPhysicsScheduler()));
+	world->SetFixedTimeStep(60.0, 1);
+
+	// the boxes spawned by each of the last frames, reused so the bookkeeping doesn't allocate
+	std::vector<std::pair<GameObjectHandle, PhysicsBodyHandle>> spawned[SPAWN_LIFETIME];
+	// spread out so they fall without touching each other
+	const int side = int(std::ceil(std::sqrt(double(per_frame) * SPAWN_LIFETIME)));
+	int next_position = 0;
+	int frame = 0;
+
+	while (state.KeepRunning()) {
+		std::vector<std::pair<GameObjectHandle, PhysicsBodyHandle>> &expired = spawned[frame % SPAWN_LIFETIME];
+		for (auto &&it : expired) {
+			world->RemoveObject(it.second);
+			GameObject::pool.Destroy(it.first);
+		}
+		expired.clear();
+
+		for (int i = 0; i < per_frame; i++) {
+			const int position = next_position++ % (side * side);
+
+			const GameObjectHandle handle = GameObject::pool.Create();
+			GameObject *box = GameObject::pool.Get(handle);
+			box->SetMesh(box_mesh);
+			box->translation = Vector3(2.0f * float(position % side), 100.0f, 2.0f * float(position / side));
+			box->UpdateMatrix();
+			expired.push_back(std::make_pair(handle, world->RegisterObject(handle, 1.0)));
+		}
+
+		world->Update(1.0 / 60.0);
+		frame++;
+	}
+	state.SetItemsProcessed(int64_t(state.GetIterations()) * per_frame);
+
+	world.reset();
+	GameObject::pool.Clear();
+	Mesh::pool.Destroy(box_mesh);
+}
+BENCHMARK(BM_SpawnDespawn)->Arg(10000)->Arg(100000);
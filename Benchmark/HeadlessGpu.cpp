@@ -0,0 +1,51 @@
+#include "../Game/Mesh.h"
+#include "../Game/Texture.h"
+
+// stands in for MeshGpu.cpp and TextureGpu.cpp in the micro benchmarks, which run without a
+// window or gpu and don't link gl. meshes are never uploaded there, drawing is an error.
+
+void Mesh::Upload()
+{
+	throw "no gpu in the micro benchmarks";
+}
+
+void Mesh::ReleaseBuffers()
+{
+}
+
+void Mesh::Bind()
+{
+	throw "no gpu in the micro benchmarks";
+}
+
+void Mesh::DrawBound()
+{
+	throw "no gpu in the micro benchmarks";
+}
+
+void Mesh::Draw()
+{
+	throw "no gpu in the micro benchmarks";
+}
+
+Texture::Texture(const std::string &path)
+	: Texture(TextureImage(path))
+{
+}
+
+Texture::Texture(const TextureImage &)
+{
+	throw "no gpu in the micro benchmarks";
+}
+
+Texture::~Texture()
+{
+}
+
+void Texture::Bind()
+{
+}
+
+void Texture::Unbind()
+{
+}
@@ -0,0 +1,323 @@
+// Micro benchmark runner.
+//
+// Runs every benchmark registered with BENCHMARK() (see EngineBenchmarks.cpp) once per argument. Each
+// run grows its iteration count until it takes at least the minimum time, is then repeated, and the
+// median time per iteration is reported along with the spread of the repetitions.
+//
+// With --baseline the results are compared with an earlier --out file. A benchmark whose median got
+// slower by more than the threshold is flagged as a regression, unless its fastest repetition is still
+// within the baseline's spread, then it is only reported as noisy. The exit code is 1 if anything
+// regressed, so a script can refuse a change that makes anything slower:
+//
+//	MicroBenchmark --out=baseline.json
+//	... change the engine, rebuild ...
+//	MicroBenchmark --baseline=baseline.json --threshold=5
+//
+// usage: MicroBenchmark [--filter=text] [--min-time=seconds] [--repetitions=n] [--out=results.json]
+//                       [--baseline=baseline.json] [--threshold=percent]
+
+#include "MicroBenchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+static std::vector<std::unique_ptr<Benchmark>> &GetBenchmarks()
+{
+	static std::vector<std::unique_ptr<Benchmark>> benchmarks;
+	return benchmarks;
+}
+
+Benchmark *RegisterBenchmark(const char *name, BenchmarkFunc func)
+{
+	Benchmark *benchmark = new Benchmark();
+	benchmark->name = name;
+	benchmark->func = func;
+	GetBenchmarks().emplace_back(benchmark);
+	return benchmark;
+}
+
+struct BenchmarkResult
+{
+	std::string name;
+	std::string error;
+	uint64_t iterations = 0;
+	// median, fastest and slowest repetition
+	double nanoseconds = 0.0;
+	double minNanoseconds = 0.0;
+	double maxNanoseconds = 0.0;
+	// standard deviation over the mean of the repetitions
+	double variation = 0.0;
+	double itemsPerSecond = 0.0;
+	double bytesPerSecond = 0.0;
+};
+
+static BenchmarkResult Run(const Benchmark &benchmark, int64_t arg, double min_time, int repetitions)
+{
+	BenchmarkResult result;
+	result.name = benchmark.args.empty() ? benchmark.name : benchmark.name + "/" + std::to_string(arg);
+
+	// find an iteration count that takes long enough to measure, this also warms up the caches
+	uint64_t iterations = benchmark.iterations > 0 ? benchmark.iterations : 1;
+	while (benchmark.iterations == 0) {
+		BenchmarkState state(arg, iterations);
+		benchmark.func(state);
+		if (!state.GetError().empty()) {
+			result.error = state.GetError();
+			return result;
+		}
+
+		const double seconds = state.GetSeconds();
+		if (seconds >= min_time || iterations >= 1000000000) {
+			break;
+		}
+		const double multiplier = seconds > 0.0 ? min_time * 1.4 / seconds : 10.0;
+		iterations = uint64_t(double(iterations) * std::min(std::max(multiplier, 2.0), 10.0));
+	}
+
+	std::vector<double> times;
+	double items = 0.0, bytes = 0.0, seconds = 0.0;
+	for (int i = 0; i < repetitions; i++) {
+		BenchmarkState state(arg, iterations);
+		benchmark.func(state);
+		times.push_back(state.GetSeconds() * 1.0e9 / double(iterations));
+		items += double(state.GetItemsProcessed());
+		bytes += double(state.GetBytesProcessed());
+		seconds += state.GetSeconds();
+	}
+
+	double mean = 0.0;
+	for (double time : times) {
+		mean += time;
+	}
+	mean /= double(times.size());
+	double variance = 0.0;
+	for (double time : times) {
+		variance += (time - mean) * (time - mean);
+	}
+	variance /= double(times.size());
+
+	std::sort(times.begin(), times.end());
+	const size_t middle = times.size() / 2;
+	result.iterations = iterations;
+	result.nanoseconds = times.size() % 2 == 1 ? times[middle] : 0.5 * (times[middle - 1] + times[middle]);
+	result.minNanoseconds = times.front();
+	result.maxNanoseconds = times.back();
+	result.variation = mean > 0.0 ? std::sqrt(variance) / mean : 0.0;
+	result.itemsPerSecond = seconds > 0.0 ? items / seconds : 0.0;
+	result.bytesPerSecond = seconds > 0.0 ? bytes / seconds : 0.0;
+	return result;
+}
+
+static std::string FormatTime(double nanoseconds)
+{
+	char text[32];
+	if (nanoseconds < 1.0e3) {
+		snprintf(text, sizeof(text), "%.1f ns", nanoseconds);
+	} else if (nanoseconds < 1.0e6) {
+		snprintf(text, sizeof(text), "%.2f us", nanoseconds * 1.0e-3);
+	} else if (nanoseconds < 1.0e9) {
+		snprintf(text, sizeof(text), "%.2f ms", nanoseconds * 1.0e-6);
+	} else {
+		snprintf(text, sizeof(text), "%.2f s", nanoseconds * 1.0e-9);
+	}
+	return text;
+}
+
+static std::string FormatRate(double rate, const char *unit)
+{
+	const char *prefixes[] = { "", "k", "M", "G", "T" };
+	int prefix = 0;
+	while (rate >= 1000.0 && prefix < 4) {
+		rate /= 1000.0;
+		prefix++;
+	}
+	char text[32];
+	snprintf(text, sizeof(text), "%.2f %s%s/s", rate, prefixes[prefix], unit);
+	return text;
+}
+
+// one benchmark per line, which is what ReadResults() relies on
+static bool WriteResults(const char *path, const std::vector<BenchmarkResult> &results, double min_time, int repetitions)
+{
+	FILE *file = fopen(path, "w");
+	if (file == nullptr) {
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"min_time\": %g,\n", min_time);
+	fprintf(file, "\t\"repetitions\": %d,\n", repetitions);
+	fprintf(file, "\t\"benchmarks\": [\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult &result = results[i];
+		fprintf(file, "\t\t{ \"name\": \"%s\", ", result.name.c_str());
+		if (!result.error.empty()) {
+			fprintf(file, "\"error\": \"%s\" }", result.error.c_str());
+		} else {
+			fprintf(file, "\"iterations\": %llu, \"ns_per_iteration\": %.3f, \"min_ns\": %.3f, \"max_ns\": %.3f, "
+				"\"variation\": %.4f, \"items_per_second\": %.1f, \"bytes_per_second\": %.1f }",
+				(unsigned long long)result.iterations, result.nanoseconds, result.minNanoseconds, result.maxNanoseconds,
+				result.variation, result.itemsPerSecond, result.bytesPerSecond);
+		}
+		fprintf(file, "%s\n", i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "\t]\n}\n");
+
+	fclose(file);
+	return true;
+}
+
+static double ReadNumber(const std::string &line, const char *key)
+{
+	const std::string pattern = std::string("\"") + key + "\": ";
+	const size_t position = line.find(pattern);
+	return position != std::string::npos ? atof(line.c_str() + position + pattern.size()) : 0.0;
+}
+
+// reads the times per iteration of every benchmark in a file written by WriteResults()
+static bool ReadResults(const char *path, std::map<std::string, BenchmarkResult> &results)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		const size_t name = line.find("\"name\": \"");
+		if (name == std::string::npos || line.find("\"ns_per_iteration\": ") == std::string::npos) {
+			continue;
+		}
+
+		BenchmarkResult result;
+		const size_t name_start = name + strlen("\"name\": \"");
+		result.name = line.substr(name_start, line.find('"', name_start) - name_start);
+		result.nanoseconds = ReadNumber(line, "ns_per_iteration");
+		result.minNanoseconds = ReadNumber(line, "min_ns");
+		result.maxNanoseconds = ReadNumber(line, "max_ns");
+		results[result.name] = result;
+	}
+	return true;
+}
+
+static const char *GetOption(const char *arg, const char *option)
+{
+	const size_t length = strlen(option);
+	return strncmp(arg, option, length) == 0 && arg[length] == '=' ? arg + length + 1 : nullptr;
+}
+
+int main(int argc, char **argv)
+{
+	std::string filter;
+	double min_time = 0.2;
+	int repetitions = 5;
+	const char *out_path = nullptr;
+	const char *baseline_path = nullptr;
+	double threshold = 5.0;
+
+	for (int i = 1; i < argc; i++) {
+		const char *value;
+		if ((value = GetOption(argv[i], "--filter")) != nullptr) {
+			filter = value;
+		} else if ((value = GetOption(argv[i], "--min-time")) != nullptr) {
+			min_time = atof(value);
+		} else if ((value = GetOption(argv[i], "--repetitions")) != nullptr) {
+			repetitions = std::max(atoi(value), 1);
+		} else if ((value = GetOption(argv[i], "--out")) != nullptr) {
+			out_path = value;
+		} else if ((value = GetOption(argv[i], "--baseline")) != nullptr) {
+			baseline_path = value;
+		} else if ((value = GetOption(argv[i], "--threshold")) != nullptr) {
+			threshold = atof(value);
+		} else {
+			printf("usage: %s [--filter=text] [--min-time=seconds] [--repetitions=n] [--out=results.json] "
+				"[--baseline=baseline.json] [--threshold=percent]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::map<std::string, BenchmarkResult> baseline;
+	if (baseline_path != nullptr && !ReadResults(baseline_path, baseline)) {
+		printf("could not read %s\n", baseline_path);
+		return 1;
+	}
+
+	if (baseline.empty()) {
+		printf("%-40s %12s %12s %8s %12s\n", "benchmark", "time", "iterations", "spread", "rate");
+	} else {
+		printf("%-40s %12s %12s %8s %9s\n", "benchmark", "time", "baseline", "spread", "change");
+	}
+
+	std::vector<BenchmarkResult> results;
+	int regressions = 0;
+
+	for (const std::unique_ptr<Benchmark> &benchmark : GetBenchmarks()) {
+		if (!filter.empty() && benchmark->name.find(filter) == std::string::npos) {
+			continue;
+		}
+
+		std::vector<int64_t> args = benchmark->args;
+		if (args.empty()) {
+			args.push_back(0);
+		}
+
+		for (int64_t arg : args) {
+			const BenchmarkResult result = Run(*benchmark, arg, min_time, repetitions);
+			results.push_back(result);
+
+			if (!result.error.empty()) {
+				printf("%-40s error: %s\n", result.name.c_str(), result.error.c_str());
+				continue;
+			}
+
+			char spread[16];
+			snprintf(spread, sizeof(spread), "%.1f%%", result.variation * 100.0);
+
+			if (baseline.empty()) {
+				const std::string rate = result.bytesPerSecond > 0.0 ? FormatRate(result.bytesPerSecond, "B")
+					: result.itemsPerSecond > 0.0 ? FormatRate(result.itemsPerSecond, "items") : "";
+				printf("%-40s %12s %12llu %8s %12s\n", result.name.c_str(), FormatTime(result.nanoseconds).c_str(),
+					(unsigned long long)result.iterations, spread, rate.c_str());
+				continue;
+			}
+
+			const auto previous = baseline.find(result.name);
+			if (previous == baseline.end() || previous->second.nanoseconds <= 0.0) {
+				printf("%-40s %12s %12s %8s %9s\n", result.name.c_str(), FormatTime(result.nanoseconds).c_str(), "-", spread, "new");
+				continue;
+			}
+
+			const BenchmarkResult &old = previous->second;
+			const double change = (result.nanoseconds / old.nanoseconds - 1.0) * 100.0;
+			const char *verdict = "";
+			if (change > threshold) {
+				// even the fastest run being slower than the slowest baseline run rules out noise
+				const bool regressed = result.minNanoseconds > old.maxNanoseconds;
+				regressions += regressed ? 1 : 0;
+				verdict = regressed ? "  REGRESSION" : "  noisy";
+			} else if (change < -threshold) {
+				verdict = result.maxNanoseconds < old.minNanoseconds ? "  faster" : "  noisy";
+			}
+			printf("%-40s %12s %12s %8s %+8.1f%%%s\n", result.name.c_str(), FormatTime(result.nanoseconds).c_str(),
+				FormatTime(old.nanoseconds).c_str(), spread, change, verdict);
+		}
+	}
+
+	if (out_path != nullptr && !WriteResults(out_path, results, min_time, repetitions)) {
+		printf("could not write %s\n", out_path);
+		return 1;
+	}
+
+	if (!baseline.empty()) {
+		printf("%d of %zu benchmarks regressed by more than %.1f%%\n", regressions, results.size(), threshold);
+	}
+	return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,158 @@
+#pragma once
+// A small Google Benchmark style harness, so the suite builds anywhere the engine does.
+//
+//	static void BM_Something(BenchmarkState &state)
+//	{
+//		// setup, not timed
+//		while (state.KeepRunning()) {
+//			// timed
+//		}
+//		state.SetItemsProcessed(state.GetIterations() * state.GetArg());
+//	}
+//	BENCHMARK(BM_Something)->Arg(64)->Arg(4096);
+//
+// The runner in MicroBenchmark.cpp grows the iteration count until a run takes long enough, repeats
+// it, and reports the median time per iteration.
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+class BenchmarkState
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	BenchmarkState(int64_t arg, uint64_t iterations) : arg(arg), iterations(iterations), remaining(iterations) {}
+
+	// runs the timed loop, true until the requested number of iterations is done
+	inline bool KeepRunning()
+	{
+		if (!started) {
+			started = true;
+			start = Clock::now();
+		}
+		if (remaining > 0) {
+			remaining--;
+			return true;
+		}
+		if (!paused) {
+			elapsed += Clock::now() - start;
+		}
+		return false;
+	}
+
+	// excludes the work between the two from the time, e.g. rebuilding state every iteration
+	inline void PauseTiming()
+	{
+		elapsed += Clock::now() - start;
+		paused = true;
+	}
+
+	inline void ResumeTiming()
+	{
+		paused = false;
+		start = Clock::now();
+	}
+
+	// reports the given time for the iteration instead of the loop's, for work that can't be
+	// timed from outside, e.g. one zone of a frame. has to be called every iteration.
+	inline void SetIterationTime(double seconds)
+	{
+		manualTime = true;
+		manualSeconds += seconds;
+	}
+
+	inline int64_t GetArg() const { return arg; }
+	inline uint64_t GetIterations() const { return iterations; }
+
+	// per second rates are reported when set
+	inline void SetItemsProcessed(int64_t items) { itemsProcessed = items; }
+	inline void SetBytesProcessed(int64_t bytes) { bytesProcessed = bytes; }
+
+	// ends the benchmark, the message is shown instead of a result
+	inline void SkipWithError(const std::string &message) { error = message; remaining = 0; }
+
+	inline double GetSeconds() const { return manualTime ? manualSeconds : std::chrono::duration<double>(elapsed).count(); }
+	inline int64_t GetItemsProcessed() const { return itemsProcessed; }
+	inline int64_t GetBytesProcessed() const { return bytesProcessed; }
+	inline const std::string &GetError() const { return error; }
+
+private:
+	int64_t arg;
+	uint64_t iterations;
+	uint64_t remaining;
+	bool started = false;
+	bool paused = false;
+
+	Clock::time_point start;
+	Clock::duration elapsed = Clock::duration::zero();
+	bool manualTime = false;
+	double manualSeconds = 0.0;
+
+	int64_t itemsProcessed = 0;
+	int64_t bytesProcessed = 0;
+	std::string error;
+};
+
+typedef void (*BenchmarkFunc)(BenchmarkState &state);
+
+struct Benchmark
+{
+	std::string name;
+	BenchmarkFunc func;
+	// one run per argument, none means a single run with 0
+	std::vector<int64_t> args;
+	// zero grows the count until a run takes the minimum time
+	uint64_t iterations = 0;
+
+	inline Benchmark *Arg(int64_t arg) { args.push_back(arg); return this; }
+	// runs exactly this many iterations, e.g. when SetIterationTime() reports only a small part
+	// of each and growing the count to the minimum time would take far too long
+	inline Benchmark *Iterations(uint64_t count) { iterations = count; return this; }
+
+	// lo, lo * multiplier, ... up to and including hi
+	inline Benchmark *Range(int64_t lo, int64_t hi, int64_t multiplier=8)
+	{
+		for (int64_t arg = lo; arg < hi; arg *= multiplier) {
+			args.push_back(arg);
+		}
+		args.push_back(hi);
+		return this;
+	}
+};
+
+// adds a benchmark to the suite, used through BENCHMARK()
+Benchmark *RegisterBenchmark(const char *name, BenchmarkFunc func);
+
+#define BENCHMARK(func) BENCHMARK_NAME(__LINE__) = RegisterBenchmark(#func, func)
+#define BENCHMARK_NAME(line) BENCHMARK_NAME_2(line)
+#define BENCHMARK_NAME_2(line) static Benchmark *benchmark_##line
+
+// keeps the compiler from optimizing away a result that is otherwise unused
+template <class T>
+inline void DoNotOptimize(const T &value)
+{
+#if defined(_MSC_VER)
+	static volatile const void *sink;
+	sink = &value;
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+// forces pending writes to memory to happen
+inline void ClobberMemory()
+{
+#if defined(_MSC_VER)
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : : "memory");
+#endif
+}
@@ -0,0 +1,207 @@
+// Ray cast benchmark.
+//
+// Loads the landscape mesh into a collision world with a few hundred boxes and spheres standing on it,
+// then casts the same random rays (mostly straight down, some sideways across the terrain) by calling
+// btCollisionWorld::rayTest once per ray and with btRayTestBatch, and reports rays per second for both.
+// The batch results are compared with the rayTest ones; a few rays that graze an edge may differ.
+//
+// usage: RayCastBenchmark [threads] [rays] [repeats] [landscape.m5m]
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btRayTestBatch.h"
+#include "../Game/BinaryModel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+// reads the positions and indices of an engine model, the scale is applied to the positions
+static bool LoadModel(const char *path, std::vector<float> &positions, std::vector<int> &indices)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	float scale[3] = { 1, 1, 1 };
+	int marker = 0;
+	do {
+		if (!file.read((char*)&marker, sizeof(marker))) {
+			return false;
+		}
+
+		if (marker == BinaryModelFlags::MODEL_TRANSLATION) {
+			float translation[3];
+			file.read((char*)translation, sizeof(translation));
+		} else if (marker == BinaryModelFlags::MODEL_ROTATION) {
+			float rotation[4];
+			file.read((char*)rotation, sizeof(rotation));
+		} else if (marker == BinaryModelFlags::MODEL_SCALE) {
+			file.read((char*)scale, sizeof(scale));
+		} else if (marker == BinaryModelFlags::MODEL_VERTICES) {
+			int num_vertices;
+			file.read((char*)&num_vertices, sizeof(num_vertices));
+			positions.resize(num_vertices * 3);
+			for (int i = 0; i < num_vertices; i++) {
+				// position, normal and texture coordinates
+				float vertex[8];
+				file.read((char*)vertex, sizeof(vertex));
+				positions[i * 3 + 0] = vertex[0];
+				positions[i * 3 + 1] = vertex[1];
+				positions[i * 3 + 2] = vertex[2];
+			}
+		} else if (marker == BinaryModelFlags::MODEL_INDICES) {
+			int num_indices;
+			file.read((char*)&num_indices, sizeof(num_indices));
+			indices.resize(num_indices);
+			file.read((char*)indices.data(), num_indices * sizeof(int));
+		}
+	} while (marker != BinaryModelFlags::MODEL_END_FILE);
+
+	for (size_t i = 0; i < positions.size(); i++) {
+		positions[i] *= scale[i % 3];
+	}
+	return !indices.empty();
+}
+
+static unsigned int random_state = 12345;
+
+static float RandomFloat(float min, float max)
+{
+	random_state = random_state * 1664525u + 1013904223u;
+	return min + (max - min) * float(random_state >> 8) / float(1 << 24);
+}
+
+int main(int argc, char **argv)
+{
+	const int num_threads = argc > 1 ? atoi(argv[1]) : 1;
+	const int num_rays = argc > 2 ? atoi(argv[2]) : 100000;
+	const int num_repeats = argc > 3 ? atoi(argv[3]) : 5;
+	const char *path = argc > 4 ? argv[4] : "../Game/landscape.m5m";
+
+	btITaskScheduler *task_scheduler = btCreateDefaultTaskScheduler();
+	if (task_scheduler != nullptr) {
+		btSetTaskScheduler(task_scheduler);
+		task_scheduler->setNumThreads(num_threads);
+	}
+	else {
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+	}
+
+	std::vector<float> positions;
+	std::vector<int> indices;
+	if (!LoadModel(path, positions, indices)) {
+		printf("could not load %s\n", path);
+		return 1;
+	}
+
+	btTriangleIndexVertexArray *mesh = new btTriangleIndexVertexArray(int(indices.size() / 3), indices.data(), 3 * sizeof(int),
+		int(positions.size() / 3), positions.data(), 3 * sizeof(float));
+	btBvhTriangleMeshShape *landscape_shape = new btBvhTriangleMeshShape(mesh, true);
+	btVector3 aabb_min, aabb_max;
+	landscape_shape->getAabb(btTransform::getIdentity(), aabb_min, aabb_max);
+
+	btDbvtBroadphase *broadphase = new btDbvtBroadphase();
+	btDefaultCollisionConfiguration *collision_configuration = new btDefaultCollisionConfiguration();
+	btCollisionDispatcher *dispatcher = new btCollisionDispatcher(collision_configuration);
+	btCollisionWorld *world = new btCollisionWorld(dispatcher, broadphase, collision_configuration);
+
+	btCollisionObject *landscape = new btCollisionObject();
+	landscape->setCollisionShape(landscape_shape);
+	world->addCollisionObject(landscape, btBroadphaseProxy::StaticFilter, btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter);
+
+	// props scattered over the terrain, these go through rayTestSingle
+	const btVector3 extent = aabb_max - aabb_min;
+	const btScalar prop_size = 0.01f * btMax(extent.x(), extent.z());
+	btBoxShape *box_shape = new btBoxShape(btVector3(prop_size, prop_size, prop_size));
+	btSphereShape *sphere_shape = new btSphereShape(prop_size);
+	std::vector<btCollisionObject*> props;
+	for (int i = 0; i < 400; i++) {
+		btTransform transform;
+		transform.setIdentity();
+		transform.setOrigin(btVector3(RandomFloat(aabb_min.x(), aabb_max.x()), RandomFloat(aabb_min.y(), aabb_max.y()), RandomFloat(aabb_min.z(), aabb_max.z())));
+		btCollisionObject *prop = new btCollisionObject();
+		prop->setCollisionShape(i % 2 ? (btCollisionShape*)box_shape : (btCollisionShape*)sphere_shape);
+		prop->setWorldTransform(transform);
+		world->addCollisionObject(prop);
+		props.push_back(prop);
+	}
+	world->updateAabbs();
+
+	std::vector<btBatchedRay> rays(num_rays);
+	for (int i = 0; i < num_rays; i++) {
+		btVector3 from, to;
+		if (i % 4) {
+			from.setValue(RandomFloat(aabb_min.x(), aabb_max.x()), aabb_max.y() + 1, RandomFloat(aabb_min.z(), aabb_max.z()));
+			to = from + btVector3(RandomFloat(-0.05f, 0.05f) * extent.x(), -(extent.y() + 2), RandomFloat(-0.05f, 0.05f) * extent.z());
+		}
+		else {
+			from.setValue(RandomFloat(aabb_min.x(), aabb_max.x()), RandomFloat(aabb_min.y(), aabb_max.y()), RandomFloat(aabb_min.z(), aabb_max.z()));
+			to = from + btVector3(RandomFloat(-0.5f, 0.5f) * extent.x(), RandomFloat(-0.1f, 0.1f) * extent.y(), RandomFloat(-0.5f, 0.5f) * extent.z());
+		}
+		rays[i] = btBatchedRay(from, to);
+	}
+
+	// one rayTest per ray, on this thread
+	std::vector<btCollisionWorld::ClosestRayResultCallback> expected;
+	auto start = std::chrono::steady_clock::now();
+	for (int repeat = 0; repeat < num_repeats; repeat++) {
+		expected.clear();
+		for (int i = 0; i < num_rays; i++) {
+			btCollisionWorld::ClosestRayResultCallback callback(rays[i].m_rayFromWorld, rays[i].m_rayToWorld);
+			world->rayTest(rays[i].m_rayFromWorld, rays[i].m_rayToWorld, callback);
+			expected.push_back(callback);
+		}
+	}
+	double loop_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	btRayTestBatch batch(world, broadphase);
+	std::vector<btBatchedRayHit> hits(num_rays);
+	start = std::chrono::steady_clock::now();
+	for (int repeat = 0; repeat < num_repeats; repeat++) {
+		batch.rayTest(rays.data(), num_rays, hits.data());
+	}
+	double batch_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int num_hits = 0;
+	int num_mismatches = 0;
+	for (int i = 0; i < num_rays; i++) {
+		const btCollisionWorld::ClosestRayResultCallback &reference = expected[i];
+		if (hits[i].hasHit()) {
+			num_hits++;
+		}
+		if (hits[i].hasHit() != reference.hasHit() ||
+			(reference.hasHit() && (hits[i].m_collisionObject != reference.m_collisionObject ||
+				btFabs(hits[i].m_hitFraction - reference.m_closestHitFraction) > 1e-4f ||
+				hits[i].m_hitNormalWorld.dot(reference.m_hitNormalWorld) < 0.999f))) {
+			num_mismatches++;
+		}
+	}
+
+	const int num_triangles = int(indices.size() / 3);
+	printf("threads=%d triangles=%d rays=%d hits=%d mismatches=%d\n",
+		btGetTaskScheduler()->getNumThreads(), num_triangles, num_rays, num_hits, num_mismatches);
+	printf("rayTest loop %.3f ms %.0f rays/s\n", 1000.0 * loop_seconds / num_repeats, num_rays * num_repeats / loop_seconds);
+	printf("batch        %.3f ms %.0f rays/s\n", 1000.0 * batch_seconds / num_repeats, num_rays * num_repeats / batch_seconds);
+
+	for (btCollisionObject *prop : props) {
+		world->removeCollisionObject(prop);
+		delete prop;
+	}
+	world->removeCollisionObject(landscape);
+	delete landscape;
+	delete sphere_shape;
+	delete box_shape;
+	delete landscape_shape;
+	delete mesh;
+	delete world;
+	delete dispatcher;
+	delete collision_configuration;
+	delete broadphase;
+
+	btSetTaskScheduler(nullptr);
+	delete task_scheduler;
+	return 0;
+}
@@ -0,0 +1,662 @@
+// Scene benchmark.
+//
+// Builds a scene from a description file, runs it for a fixed number of frames with a fixed timestep and
+// writes the time spent per subsystem and per profiler zone, frame time percentiles, allocation counts and
+// the memory used per MemoryTracker tag as JSON, so runs can be compared between builds. Nothing depends on the wall clock, so two runs of the
+// same scene simulate exactly the same frames.
+//
+// Runs headless unless the scene turns rendering on. Frames are then drawn into an offscreen framebuffer
+// of a hidden GLFW window, or, when built with BENCHMARK_USE_EGL, of a surfaceless EGL context, which
+// also works on machines without a display or gpu (e.g. mesa's llvmpipe).
+//
+// Scene files have one setting per line, '#' starts a comment:
+//
+//   frames 600                            measured frames
+//   warmup 30                             frames run before measuring
+//   timestep 60                           physics steps per second, one step per frame
+//   threads 4                             physics worker threads and threads recording draws, 0 leaves
+//                                         the default of one per core
+//   physics on                            step the physics world
+//   render off                            draw every frame
+//   resolution 1280 720                   of the offscreen framebuffer
+//   lights 4                              point lights, the shader uses up to 4
+//   camera 0 20 -40                       looks at the origin
+//   data ../Game                          directory mesh paths are relative to
+//   object landscape.m5m 1 0              mesh, count, mass and optionally a scale. objects with mass are
+//   object models/monkow.obj 100 1 0.25   dropped in a grid above the origin, one layer per line.
+//   budget Physics 64                     megabytes a memory tag may use at most. a tag going over it is
+//                                         marked in the results, and the run exits with 2
+//
+// usage: SceneBenchmark <scene file> [results.json] [trace.json]
+
+#ifdef BENCHMARK_USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/glew.h>
+#else
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#endif
+
+#include "../Game/PhysicsWorld.h"
+#include "../Game/Renderer.h"
+#include "../Game/ModelLoaders/ObjLoader.h"
+#include "../Game/Math/matrix_util.h"
+#include "../Game/Profiling/Profiler.h"
+#include "../Game/Profiling/GpuProfiler.h"
+#include "../Game/Threading/JobSystem.h"
+#include "../Game/Memory/FrameAllocator.h"
+#include "../Game/Memory/HeapStats.h"
+#include "../Game/Memory/MemoryTracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct SceneObject
+{
+	std::string path;
+	int count;
+	float mass;
+	float scale;
+};
+
+struct SceneDescription
+{
+	std::string name;
+	int frames = 600;
+	int warmup = 30;
+	double stepRate = 60.0;
+	int threads = 0;
+	bool physics = true;
+	bool render = false;
+	int width = 1280;
+	int height = 720;
+	int lights = 4;
+	Vector3 camera = Vector3(0, 20, -40);
+	std::string dataPath = "../Game";
+	std::vector<SceneObject> objects;
+	std::vector<std::pair<MemoryTag, size_t>> budgets;
+};
+
+static bool ParseSwitch(std::istringstream &line, bool &value)
+{
+	std::string word;
+	line >> word;
+	value = word == "on" || word == "true" || word == "1";
+	return word == "on" || word == "off" || word == "true" || word == "false" || word == "1" || word == "0";
+}
+
+static bool LoadScene(const std::string &path, SceneDescription &scene)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		printf("could not open %s\n", path.c_str());
+		return false;
+	}
+
+	// the file name without directories and extension
+	scene.name = path.substr(path.find_last_of("/\\") + 1);
+	scene.name = scene.name.substr(0, scene.name.find('.'));
+
+	std::string text;
+	int line_number = 0;
+	while (std::getline(file, text)) {
+		line_number++;
+		text = text.substr(0, text.find('#'));
+
+		std::istringstream line(text);
+		std::string key;
+		if (!(line >> key)) {
+			continue;
+		}
+
+		bool ok = true;
+		if (key == "frames") {
+			ok = bool(line >> scene.frames) && scene.frames > 0;
+		} else if (key == "warmup") {
+			ok = bool(line >> scene.warmup) && scene.warmup >= 0;
+		} else if (key == "timestep") {
+			ok = bool(line >> scene.stepRate) && scene.stepRate > 0.0;
+		} else if (key == "threads") {
+			ok = bool(line >> scene.threads) && scene.threads >= 0;
+		} else if (key == "physics") {
+			ok = ParseSwitch(line, scene.physics);
+		} else if (key == "render") {
+			ok = ParseSwitch(line, scene.render);
+		} else if (key == "resolution") {
+			ok = bool(line >> scene.width >> scene.height) && scene.width > 0 && scene.height > 0;
+		} else if (key == "lights") {
+			ok = bool(line >> scene.lights) && scene.lights >= 0;
+		} else if (key == "camera") {
+			ok = bool(line >> scene.camera.x >> scene.camera.y >> scene.camera.z);
+		} else if (key == "data") {
+			ok = bool(line >> scene.dataPath);
+		} else if (key == "object") {
+			SceneObject object;
+			object.scale = 1.0f;
+			ok = bool(line >> object.path >> object.count >> object.mass) && object.count > 0;
+			line >> object.scale;
+			scene.objects.push_back(object);
+		} else if (key == "budget") {
+			std::string tag;
+			double megabytes = 0.0;
+			ok = bool(line >> tag >> megabytes) && MemoryTracker::FindTag(tag.c_str()) != MemoryTag::Count && megabytes > 0.0;
+			scene.budgets.push_back({ MemoryTracker::FindTag(tag.c_str()), size_t(megabytes * 1024.0 * 1024.0) });
+		} else {
+			ok = false;
+		}
+
+		if (!ok) {
+			printf("%s:%d: could not read '%s'\n", path.c_str(), line_number, text.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+static MeshHandle LoadMesh(const std::string &path, Vector3 &scale)
+{
+	if (path.size() > 4 && path.substr(path.size() - 4) == ".obj") {
+		ObjLoader loader;
+		scale = Vector3(1.0f);
+		return loader.LoadMesh(path);
+	}
+
+	const GameObjectHandle handle = GameObject::Load(path);
+	const GameObject *object = GameObject::pool.Get(handle);
+	if (object == nullptr) {
+		return MeshHandle();
+	}
+	scale = object->scale;
+	// only the mesh is kept, the scene places objects of its own
+	const MeshHandle mesh = object->GetMeshHandle();
+	GameObject::pool.Destroy(handle);
+	return mesh;
+}
+
+// largest extent of the mesh along any axis
+static float GetMeshSize(const Mesh &mesh, const Vector3 &scale)
+{
+	Vector3 min(1e30f), max(-1e30f);
+	for (const Vertex &vertex : mesh.GetVertices()) {
+		min = Vector3(std::min(min.x, vertex.x), std::min(min.y, vertex.y), std::min(min.z, vertex.z));
+		max = Vector3(std::max(max.x, vertex.x), std::max(max.y, vertex.y), std::max(max.z, vertex.z));
+	}
+	return std::max(std::max((max.x - min.x) * scale.x, (max.y - min.y) * scale.y), (max.z - min.z) * scale.z);
+}
+
+#ifdef BENCHMARK_USE_EGL
+
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+static EGLContext egl_context = EGL_NO_CONTEXT;
+
+static bool CreateContext()
+{
+	auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	egl_display = get_platform_display != nullptr
+		? get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+		: eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API)) {
+		return false;
+	}
+
+	// a compatibility context like the game's window gets, core contexts can't draw without a vertex array bound
+	const EGLint attributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE };
+	egl_context = eglCreateContext(egl_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+	if (egl_context == EGL_NO_CONTEXT) {
+		return false;
+	}
+	return eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context) == EGL_TRUE;
+}
+
+static void DestroyContext()
+{
+	eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(egl_display, egl_context);
+	eglTerminate(egl_display);
+}
+
+#else
+
+static GLFWwindow *window = nullptr;
+
+static bool CreateContext()
+{
+	if (!glfwInit()) {
+		return false;
+	}
+
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	window = glfwCreateWindow(64, 64, "SceneBenchmark", nullptr, nullptr);
+	if (window == nullptr) {
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+	// never wait for vsync
+	glfwSwapInterval(0);
+	return true;
+}
+
+static void DestroyContext()
+{
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
+
+#endif
+
+static std::string ReadFile(const std::string &path)
+{
+	std::ifstream file(path);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+// per frame values of one measurement
+struct Series
+{
+	const char *name;
+	std::vector<double> values;
+};
+
+static void WriteSeries(std::ostream &out, const Series &series)
+{
+	std::vector<double> sorted = series.values;
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0.0;
+	for (double value : sorted) {
+		total += value;
+	}
+
+	// nearest rank
+	auto percentile = [&sorted](double p) {
+		const size_t rank = size_t(std::ceil(p * 0.01 * double(sorted.size())));
+		return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+	};
+
+	out << "\"" << series.name << "\": {\"mean_ms\": " << total / double(sorted.size())
+		<< ", \"min_ms\": " << sorted.front() << ", \"p50_ms\": " << percentile(50) << ", \"p90_ms\": " << percentile(90)
+		<< ", \"p95_ms\": " << percentile(95) << ", \"p99_ms\": " << percentile(99) << ", \"max_ms\": " << sorted.back()
+		<< ", \"total_ms\": " << total << "}";
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		printf("usage: SceneBenchmark <scene file> [results.json] [trace.json]\n");
+		return 1;
+	}
+
+	// before bullet allocates anything
+	MemoryTracker::Init();
+
+	SceneDescription scene;
+	if (!LoadScene(argv[1], scene)) {
+		return 1;
+	}
+	for (const auto &budget : scene.budgets) {
+		MemoryTracker::SetBudget(budget.first, budget.second);
+	}
+
+	// keep every frame so the zones of the whole run can be summed up
+	Profiler::Init(scene.warmup + scene.frames + 1);
+	Profiler::SetThreadName("Main");
+	FrameAllocator::Init();
+
+	Shader *shader = nullptr;
+	Renderer *renderer = nullptr;
+	JobSystem *jobs = nullptr;
+	GpuProfiler *gpu_profiler = nullptr;
+	GLuint framebuffer = 0, color_buffer = 0, depth_buffer = 0;
+
+	if (scene.render) {
+		if (!CreateContext()) {
+			printf("could not create an offscreen gl context\n");
+			return 1;
+		}
+
+		glewExperimental = GL_TRUE;
+		const GLenum glew_error = glewInit();
+#ifdef BENCHMARK_USE_EGL
+		// a glx built glew fails without a glx display even though it loaded the gl functions,
+		// so only check for the ones needed here
+		(void)glew_error;
+		if (glGenFramebuffers == nullptr || glGenBuffers == nullptr) {
+#else
+		if (glew_error != GLEW_OK) {
+#endif
+			printf("could not initialize glew\n");
+			return 1;
+		}
+
+		glGenRenderbuffers(1, &color_buffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, scene.width, scene.height);
+		glGenRenderbuffers(1, &depth_buffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, scene.width, scene.height);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("could not create a %dx%d framebuffer\n", scene.width, scene.height);
+			return 1;
+		}
+
+		glViewport(0, 0, scene.width, scene.height);
+		glDisable(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		glClearColor(0.2f, 0.5f, 0.8f, 1.0f);
+
+		shader = new Shader(ReadFile(scene.dataPath + "/shaders/shader.vert"), ReadFile(scene.dataPath + "/shaders/shader.frag"));
+		// the calling thread records draws too
+		jobs = new JobSystem(scene.threads > 0 ? scene.threads - 1 : -1);
+		renderer = new Renderer(shader, jobs);
+		gpu_profiler = new GpuProfiler();
+	}
+
+	PhysicsWorld *physics_world = new PhysicsWorld();
+	physics_world->SetFixedTimeStep(scene.stepRate, 1);
+	if (scene.threads > 0 && btGetTaskScheduler() != nullptr) {
+		btGetTaskScheduler()->setNumThreads(scene.threads);
+	}
+
+	// build the scene
+	const uint64_t load_allocations = HeapStats::GetAllocationCount();
+	const uint64_t load_start = Profiler::Now();
+
+	std::vector<GameObject*> objects;
+	std::vector<GameObject*> dynamic_objects;
+	float layer_height = 10.0f;
+	{
+		PROFILE("Load");
+
+		for (const SceneObject &description : scene.objects) {
+			Vector3 scale;
+			const MeshHandle mesh = LoadMesh(scene.dataPath + "/" + description.path, scale);
+			if (mesh.IsNull()) {
+				printf("could not load %s\n", description.path.c_str());
+				return 1;
+			}
+			scale *= description.scale;
+
+			// a square grid with a gap of half an object between neighbours
+			const float spacing = GetMeshSize(*Mesh::pool.Get(mesh), scale) * 1.5f;
+			const int side = int(std::ceil(std::sqrt(double(description.count))));
+
+			for (int i = 0; i < description.count; i++) {
+				const GameObjectHandle handle = GameObject::pool.Create();
+				GameObject *object = GameObject::pool.Get(handle);
+				object->SetMesh(mesh);
+				object->scale = scale;
+				if (description.mass > 0.0f) {
+					object->translation = Vector3((i % side - 0.5f * (side - 1)) * spacing, layer_height, (i / side - 0.5f * (side - 1)) * spacing);
+				}
+				object->UpdateMatrix();
+
+				objects.push_back(object);
+				if (scene.physics) {
+					physics_world->RegisterObject(handle, description.mass);
+				}
+				if (description.mass > 0.0f) {
+					dynamic_objects.push_back(object);
+				}
+			}
+
+			if (description.mass > 0.0f) {
+				layer_height += spacing;
+			}
+		}
+	}
+
+	const double load_ms = Profiler::TicksToMilliseconds(Profiler::Now() - load_start);
+	const uint64_t loaded_allocations = HeapStats::GetAllocationCount() - load_allocations;
+
+	// lights in a ring above the scene
+	std::vector<PointLight> point_lights;
+	for (int i = 0; i < scene.lights; i++) {
+		const float angle = 6.2831853f * float(i) / float(scene.lights);
+		PointLight light;
+		light.position = Vector3(20.0f * std::cos(angle), 15.0f, 20.0f * std::sin(angle));
+		light.color = Color(1.0f, 0.9f, 0.8f, 1.0f);
+		point_lights.push_back(light);
+	}
+
+	if (renderer != nullptr) {
+		Matrix4 view_matrix, proj_matrix;
+		MatrixUtil::ToLookAt(view_matrix, scene.camera, Vector3::Zero(), Vector3::UnitY());
+		MatrixUtil::ToPerspective(proj_matrix, 45, scene.width, scene.height, 0.1f, 500.0f);
+		renderer->SetCamera(view_matrix, proj_matrix, scene.camera);
+		renderer->SetAmbience(Color(0.1f, 0.25f, 0.4f, 1.0f));
+	}
+
+	Series frame_times = { "frame", {} };
+	Series physics_times = { "physics", {} };
+	Series render_times = { "render", {} };
+	Series present_times = { "present", {} };
+	Series gpu_times = { "gpu_scene", {} };
+	std::vector<unsigned long long> frame_allocations;
+	// so that recording the results doesn't show up in the allocation counts
+	for (Series *series : { &frame_times, &physics_times, &render_times, &present_times, &gpu_times }) {
+		series->values.reserve(scene.frames);
+	}
+	frame_allocations.reserve(scene.frames);
+
+	// per tag, over the measured frames
+	uint64_t tag_allocations[size_t(MemoryTag::Count)] = {};
+	uint64_t tag_bytes[size_t(MemoryTag::Count)] = {};
+
+	const double time_step = 1.0 / scene.stepRate;
+	uint64_t measure_start = 0;
+
+	for (int frame = 0; frame < scene.warmup + scene.frames; frame++) {
+		if (frame == scene.warmup) {
+			measure_start = Profiler::Now();
+		}
+
+		const uint64_t allocations_before = HeapStats::GetAllocationCount();
+		const uint64_t frame_start = Profiler::Now();
+		Profiler::BeginZone("Frame");
+
+		uint64_t physics_ticks = 0, render_ticks = 0, present_ticks = 0;
+
+		if (scene.physics) {
+			PROFILE("Physics");
+			const uint64_t start = Profiler::Now();
+			physics_world->Update(time_step);
+			physics_ticks = Profiler::Now() - start;
+		}
+
+		if (renderer != nullptr) {
+			{
+				PROFILE("Render");
+				GPU_PROFILE(*gpu_profiler, "Scene");
+				const uint64_t start = Profiler::Now();
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				renderer->Render(objects, point_lights);
+				render_ticks = Profiler::Now() - start;
+			}
+
+			{
+				// there is no swap to wait on, so wait for the gpu to finish the frame instead
+				PROFILE("Present");
+				const uint64_t start = Profiler::Now();
+				glFinish();
+				present_ticks = Profiler::Now() - start;
+			}
+			gpu_profiler->EndFrame();
+		}
+
+		Profiler::EndZone();
+		const uint64_t frame_ticks = Profiler::Now() - frame_start;
+		Profiler::EndFrame();
+		FrameAllocator::EndFrame();
+		MemoryTracker::EndFrame();
+
+		if (frame < scene.warmup) {
+			continue;
+		}
+
+		for (size_t tag = 0; tag < size_t(MemoryTag::Count); tag++) {
+			const MemoryTagStats stats = MemoryTracker::GetStats(MemoryTag(tag));
+			tag_allocations[tag] += stats.frameAllocations;
+			tag_bytes[tag] += stats.frameAllocatedBytes;
+		}
+
+		frame_times.values.push_back(Profiler::TicksToMilliseconds(frame_ticks));
+		physics_times.values.push_back(Profiler::TicksToMilliseconds(physics_ticks));
+		render_times.values.push_back(Profiler::TicksToMilliseconds(render_ticks));
+		present_times.values.push_back(Profiler::TicksToMilliseconds(present_ticks));
+		if (gpu_profiler != nullptr && gpu_profiler->GetZoneMilliseconds("Scene") >= 0.0) {
+			gpu_times.values.push_back(gpu_profiler->GetZoneMilliseconds("Scene"));
+		}
+		frame_allocations.push_back(HeapStats::GetAllocationCount() - allocations_before);
+	}
+
+	// time per frame and calls per frame of every zone on any thread, bullet's included
+	struct ZoneTotal
+	{
+		uint64_t ticks = 0;
+		unsigned long long calls = 0;
+	};
+	std::map<std::string, ZoneTotal> zones;
+	for (size_t thread = 0; thread < Profiler::GetThreadCount(); thread++) {
+		for (const ProfileEvent &event : Profiler::GetThreadEvents(thread)) {
+			if (event.start >= measure_start) {
+				ZoneTotal &total = zones[event.name];
+				total.ticks += event.end - event.start;
+				total.calls++;
+			}
+		}
+	}
+	std::vector<std::pair<std::string, ZoneTotal>> sorted_zones(zones.begin(), zones.end());
+	std::sort(sorted_zones.begin(), sorted_zones.end(), [](const std::pair<std::string, ZoneTotal> &a, const std::pair<std::string, ZoneTotal> &b) {
+		return a.second.ticks > b.second.ticks;
+	});
+
+	unsigned long long total_allocations = 0;
+	unsigned long long max_allocations = 0;
+	for (unsigned long long count : frame_allocations) {
+		total_allocations += count;
+		max_allocations = std::max(max_allocations, count);
+	}
+
+	// where the dynamic objects came to rest, to tell a changed simulation from a slower one
+	Vector3 checksum(0.0f);
+	for (const GameObject *object : dynamic_objects) {
+		checksum += object->translation;
+	}
+
+	std::ostringstream out;
+	out.precision(4);
+	out << std::fixed;
+	out << "{\n";
+	out << "  \"scene\": \"" << scene.name << "\",\n";
+	out << "  \"frames\": " << scene.frames << ", \"warmup\": " << scene.warmup << ", \"timestep\": " << time_step << ",\n";
+	out << "  \"objects\": " << objects.size() << ", \"physics\": " << (scene.physics ? "true" : "false")
+		<< ", \"render\": " << (scene.render ? "true" : "false") << ", \"lights\": " << scene.lights << ",\n";
+	out << "  \"threads\": " << (btGetTaskScheduler() != nullptr ? btGetTaskScheduler()->getNumThreads() : 1) << ",\n";
+	out << "  \"load_ms\": " << load_ms << ", \"load_allocations\": " << loaded_allocations << ",\n";
+	out << "  \"subsystems\": {\n    ";
+	WriteSeries(out, frame_times);
+	out << ",\n    ";
+	WriteSeries(out, physics_times);
+	if (scene.render) {
+		out << ",\n    ";
+		WriteSeries(out, render_times);
+		out << ",\n    ";
+		WriteSeries(out, present_times);
+		if (!gpu_times.values.empty()) {
+			out << ",\n    ";
+			WriteSeries(out, gpu_times);
+		}
+	}
+	out << "\n  },\n";
+	out << "  \"allocations\": {\"per_frame\": " << double(total_allocations) / double(scene.frames) << ", \"max_per_frame\": " << max_allocations
+		<< ", \"physics_per_frame\": " << double(tag_allocations[size_t(MemoryTag::Physics)]) / double(scene.frames) << "},\n";
+	// live bytes are what is left at the end of the run, the peak is since the program started
+	std::vector<MemoryTag> over_budget;
+	out << "  \"memory\": {";
+	for (size_t tag = 0; tag < size_t(MemoryTag::Count); tag++) {
+		const MemoryTagStats stats = MemoryTracker::GetStats(MemoryTag(tag));
+		const bool over = stats.budget > 0 && stats.peakBytes > stats.budget;
+		if (over) {
+			over_budget.push_back(MemoryTag(tag));
+		}
+		out << (tag > 0 ? ",\n" : "\n") << "    \"" << MemoryTracker::GetTagName(MemoryTag(tag)) << "\": {\"live_bytes\": " << stats.liveBytes
+			<< ", \"peak_bytes\": " << stats.peakBytes << ", \"live_allocations\": " << stats.liveAllocations
+			<< ", \"allocations_per_frame\": " << double(tag_allocations[tag]) / double(scene.frames)
+			<< ", \"bytes_per_frame\": " << double(tag_bytes[tag]) / double(scene.frames)
+			<< ", \"fragmentation\": " << stats.GetFragmentation()
+			<< ", \"budget_bytes\": " << stats.budget << ", \"over_budget\": " << (over ? "true" : "false") << "}";
+	}
+	out << "\n  },\n";
+	out << "  \"zones\": {";
+	for (size_t i = 0; i < sorted_zones.size(); i++) {
+		out << (i > 0 ? ",\n" : "\n") << "    \"" << sorted_zones[i].first << "\": {\"ms_per_frame\": "
+			<< Profiler::TicksToMilliseconds(sorted_zones[i].second.ticks) / double(scene.frames)
+			<< ", \"calls_per_frame\": " << double(sorted_zones[i].second.calls) / double(scene.frames) << "}";
+	}
+	out << "\n  },\n";
+	out << "  \"checksum\": [" << checksum.x << ", " << checksum.y << ", " << checksum.z << "]\n";
+	out << "}\n";
+
+	if (argc > 2) {
+		std::ofstream file(argv[2]);
+		file << out.str();
+		if (!file) {
+			printf("could not write %s\n", argv[2]);
+			return 1;
+		}
+	} else {
+		std::cout << out.str();
+	}
+
+	if (argc > 3 && !Profiler::SaveChromeTrace(argv[3])) {
+		printf("could not write %s\n", argv[3]);
+	}
+
+	for (MemoryTag tag : over_budget) {
+		const MemoryTagStats stats = MemoryTracker::GetStats(tag);
+		fprintf(stderr, "%s went over its budget: peak of %.2f MB, %.2f MB allowed\n", MemoryTracker::GetTagName(tag),
+			stats.peakBytes / (1024.0 * 1024.0), stats.budget / (1024.0 * 1024.0));
+	}
+
+	// the bodies read the meshes' triangles, and the meshes' buffers go with the context
+	delete physics_world;
+	objects.clear();
+	dynamic_objects.clear();
+	GameObject::pool.Clear();
+	Mesh::pool.Clear();
+
+	if (scene.render) {
+		delete gpu_profiler;
+		delete renderer;
+		delete jobs;
+		delete shader;
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &color_buffer);
+		glDeleteRenderbuffers(1, &depth_buffer);
+		DestroyContext();
+	}
+
+	FrameAllocator::Shutdown();
+	Profiler::Shutdown();
+	return over_budget.empty() ? 0 : 2;
+}
@@ -0,0 +1,165 @@
+// Contact solver benchmark.
+//
+// Settles a stepped pyramid of boxes (the same pile as StackingBenchmark, about 11000 contacts with the
+// default 13 layers), then solves the resting contacts over and over with the selected solver and
+// reports solver iterations per second.
+//
+// usage: SolverBenchmark [seq|rows|soa|avx2] [threads] [layers] [solves] [iterations]
+//   seq   btSequentialImpulseConstraintSolver, one row at a time
+//   rows  btSequentialImpulseConstraintSolverMt, batched rows solved one at a time
+//   soa   btSequentialImpulseConstraintSolverMt, batched rows solved 8 at a time lane by lane
+//   avx2  btSequentialImpulseConstraintSolverMt, batched rows solved 8 at a time with AVX2
+//
+// The batched modes run in deterministic mode so they batch even on one thread. soa and avx2 print
+// the same velocity checksum.
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "LinearMath/btCpuFeatureUtility.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+	const char *mode = argc > 1 ? argv[1] : "avx2";
+	const int num_threads = argc > 2 ? atoi(argv[2]) : 1;
+	const int num_layers = argc > 3 ? atoi(argv[3]) : 13;
+	const int num_solves = argc > 4 ? atoi(argv[4]) : 50;
+	const int num_iterations = argc > 5 ? atoi(argv[5]) : 10;
+
+	btITaskScheduler *task_scheduler = btCreateDefaultTaskScheduler();
+	if (task_scheduler != nullptr) {
+		btSetTaskScheduler(task_scheduler);
+		task_scheduler->setNumThreads(num_threads);
+	}
+	else {
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+	}
+
+	btConstraintSolver *solver = nullptr;
+	if (strcmp(mode, "seq") == 0) {
+		solver = new btSequentialImpulseConstraintSolver();
+	}
+	else {
+		btSequentialImpulseConstraintSolverMt *solver_mt = new btSequentialImpulseConstraintSolverMt();
+		solver_mt->setDeterministic(true);
+		if (strcmp(mode, "rows") == 0) {
+			solver_mt->setUseSoaRows(false);
+		}
+		else if (strcmp(mode, "soa") == 0) {
+			solver_mt->setSoaRowSolvers(btSolveSoaContactRows_scalar, btSolveSoaFrictionRows_scalar);
+		}
+		else if (strcmp(mode, "avx2") == 0) {
+#ifdef BT_ALLOW_AVX2
+			if (!(btCpuFeatureUtility::getCpuFeatures() & btCpuFeatureUtility::CPU_FEATURE_AVX2)) {
+				printf("this CPU has no AVX2\n");
+				return 1;
+			}
+			solver_mt->setSoaRowSolvers(btSolveSoaContactRows_avx2, btSolveSoaFrictionRows_avx2);
+#else
+			printf("bullet was built without AVX2 support\n");
+			return 1;
+#endif
+		}
+		else {
+			printf("unknown mode %s\n", mode);
+			return 1;
+		}
+		solver = solver_mt;
+	}
+
+	// the pile is settled with the sequential solver, so every mode starts from the same contacts
+	btDbvtBroadphase *broadphase = new btDbvtBroadphase();
+	btDefaultCollisionConfiguration *collision_configuration = new btDefaultCollisionConfiguration();
+	btCollisionDispatcher *dispatcher = new btCollisionDispatcher(collision_configuration);
+	btSequentialImpulseConstraintSolver *settle_solver = new btSequentialImpulseConstraintSolver();
+	btDiscreteDynamicsWorld *world = new btDiscreteDynamicsWorld(dispatcher, broadphase, settle_solver, collision_configuration);
+	world->setGravity(btVector3(0, -10, 0));
+
+	btBoxShape *ground_shape = new btBoxShape(btVector3(100, 1, 100));
+	btTransform ground_transform;
+	ground_transform.setIdentity();
+	ground_transform.setOrigin(btVector3(0, -1, 0));
+	btRigidBody *ground = new btRigidBody(btRigidBody::btRigidBodyConstructionInfo(0, nullptr, ground_shape));
+	ground->setWorldTransform(ground_transform);
+	world->addRigidBody(ground);
+
+	const btScalar half_size = 0.5;
+	const btScalar spacing = 1.02;
+	btBoxShape *box_shape = new btBoxShape(btVector3(half_size, half_size, half_size));
+	btVector3 local_inertia;
+	box_shape->calculateLocalInertia(1, local_inertia);
+
+	std::vector<btCollisionObject *> boxes;
+	for (int layer = 0; layer < num_layers; layer++) {
+		const int count = num_layers - layer;
+		const btScalar offset = -0.5 * spacing * (count - 1);
+		for (int x = 0; x < count; x++) {
+			for (int z = 0; z < count; z++) {
+				btTransform transform;
+				transform.setIdentity();
+				transform.setOrigin(btVector3(offset + x * spacing, half_size + layer * 2 * half_size, offset + z * spacing));
+				btRigidBody::btRigidBodyConstructionInfo info(1, new btDefaultMotionState(transform), box_shape, local_inertia);
+				btRigidBody *box = new btRigidBody(info);
+				box->setActivationState(DISABLE_DEACTIVATION);
+				world->addRigidBody(box);
+				boxes.push_back(box);
+			}
+		}
+	}
+	for (int i = 0; i < 30; i++)
+		world->stepSimulation(1.0 / 60.0, 0);
+
+	std::vector<btPersistentManifold *> manifolds;
+	int num_contacts = 0;
+	for (int i = 0; i < dispatcher->getNumManifolds(); i++) {
+		btPersistentManifold *manifold = dispatcher->getManifoldByIndexInternal(i);
+		if (manifold->getNumContacts() > 0) {
+			manifolds.push_back(manifold);
+			num_contacts += manifold->getNumContacts();
+		}
+	}
+
+	btContactSolverInfo solver_info = world->getSolverInfo();
+	solver_info.m_numIterations = num_iterations;
+	solver->prepareSolve(int(boxes.size()), int(manifolds.size()));
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < num_solves; i++) {
+		solver->solveGroup(&boxes[0], int(boxes.size()), &manifolds[0], int(manifolds.size()), nullptr, 0, solver_info, nullptr, dispatcher);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	solver->allSolved(solver_info, nullptr);
+
+	double checksum = 0;
+	for (size_t i = 0; i < boxes.size(); i++) {
+		btRigidBody *body = btRigidBody::upcast(boxes[i]);
+		checksum += body->getLinearVelocity().dot(btVector3(1.3, 0.7, 0.1)) + body->getAngularVelocity().dot(btVector3(0.3, 1.1, 0.9));
+	}
+
+	printf("%s threads=%d boxes=%d manifolds=%d contacts=%d %.3f ms/solve %.0f iterations/s checksum=%.9g\n",
+		mode, btGetTaskScheduler()->getNumThreads(), int(boxes.size()), int(manifolds.size()), num_contacts,
+		1000.0 * seconds / num_solves, num_solves * solver_info.m_numIterations / seconds, checksum);
+
+	for (int i = world->getNumCollisionObjects() - 1; i >= 0; i--) {
+		btRigidBody *body = btRigidBody::upcast(world->getCollisionObjectArray()[i]);
+		world->removeRigidBody(body);
+		delete body->getMotionState();
+		delete body;
+	}
+	delete box_shape;
+	delete ground_shape;
+	delete world;
+	delete settle_solver;
+	delete solver;
+	delete dispatcher;
+	delete collision_configuration;
+	delete broadphase;
+
+	btSetTaskScheduler(nullptr);
+	delete task_scheduler;
+	return 0;
+}
@@ -0,0 +1,136 @@
+// Stacking benchmark for the large island solver.
+//
+// Builds a stepped pyramid of boxes on a static ground box. Every box rests on the ones below it,
+// so the whole pyramid is a single simulation island, which the island pool alone can only solve
+// on one thread.
+//
+// usage: StackingBenchmark [st|mt|det] [threads] [layers] [steps]
+//   st   btDiscreteDynamicsWorld with btSequentialImpulseConstraintSolver
+//   mt   btDiscreteDynamicsWorldMt with btSequentialImpulseConstraintSolverMt for large islands
+//   det  as mt, with the large island solver in deterministic mode
+//
+// Prints the average step time and a checksum of the final box positions. In det mode the checksum
+// is the same for any thread count.
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+	const char *mode = argc > 1 ? argv[1] : "mt";
+	const bool threaded = strcmp(mode, "st") != 0;
+	const bool deterministic = strcmp(mode, "det") == 0;
+	const int num_threads = argc > 2 ? atoi(argv[2]) : 0;
+	const int num_layers = argc > 3 ? atoi(argv[3]) : 14;
+	const int num_steps = argc > 4 ? atoi(argv[4]) : 200;
+
+	btITaskScheduler *task_scheduler = nullptr;
+	if (threaded) {
+		task_scheduler = btCreateDefaultTaskScheduler();
+		if (task_scheduler == nullptr) {
+			printf("bullet was built without BT_THREADSAFE\n");
+			return 1;
+		}
+		btSetTaskScheduler(task_scheduler);
+		if (num_threads > 0)
+			task_scheduler->setNumThreads(num_threads);
+	}
+
+	btDbvtBroadphase *broadphase = new btDbvtBroadphase();
+	btDefaultCollisionConfiguration *collision_configuration = new btDefaultCollisionConfiguration();
+	btCollisionDispatcher *dispatcher = new btCollisionDispatcher(collision_configuration);
+
+	btConstraintSolver *solver = nullptr;
+	btSequentialImpulseConstraintSolverMt *large_island_solver = nullptr;
+	btDiscreteDynamicsWorld *world = nullptr;
+	if (threaded) {
+		solver = new btConstraintSolverPoolMt(task_scheduler->getMaxNumThreads());
+		large_island_solver = new btSequentialImpulseConstraintSolverMt();
+		large_island_solver->setDeterministic(deterministic);
+		world = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, static_cast<btConstraintSolverPoolMt *>(solver), collision_configuration, large_island_solver);
+	}
+	else {
+		solver = new btSequentialImpulseConstraintSolver();
+		world = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collision_configuration);
+	}
+	world->setGravity(btVector3(0, -10, 0));
+
+	// ground, top face at y = 0
+	btBoxShape *ground_shape = new btBoxShape(btVector3(100, 1, 100));
+	btTransform ground_transform;
+	ground_transform.setIdentity();
+	ground_transform.setOrigin(btVector3(0, -1, 0));
+	btRigidBody *ground = new btRigidBody(btRigidBody::btRigidBodyConstructionInfo(0, nullptr, ground_shape));
+	ground->setWorldTransform(ground_transform);
+	world->addRigidBody(ground);
+
+	// layer k is (layers - k)^2 boxes, shifted by half a box so each box sits on four below it
+	const btScalar half_size = 0.5;
+	const btScalar spacing = 1.02;
+	btBoxShape *box_shape = new btBoxShape(btVector3(half_size, half_size, half_size));
+	btVector3 local_inertia;
+	box_shape->calculateLocalInertia(1, local_inertia);
+
+	std::vector<btRigidBody *> boxes;
+	for (int layer = 0; layer < num_layers; layer++) {
+		const int count = num_layers - layer;
+		const btScalar offset = -0.5 * spacing * (count - 1);
+		for (int x = 0; x < count; x++) {
+			for (int z = 0; z < count; z++) {
+				btTransform transform;
+				transform.setIdentity();
+				transform.setOrigin(btVector3(offset + x * spacing, half_size + layer * 2 * half_size, offset + z * spacing));
+				btRigidBody::btRigidBodyConstructionInfo info(1, new btDefaultMotionState(transform), box_shape, local_inertia);
+				btRigidBody *box = new btRigidBody(info);
+				box->setActivationState(DISABLE_DEACTIVATION);
+				world->addRigidBody(box);
+				boxes.push_back(box);
+			}
+		}
+	}
+
+	// let the contacts settle before timing
+	for (int i = 0; i < 10; i++)
+		world->stepSimulation(1.0 / 60.0, 0);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < num_steps; i++)
+		world->stepSimulation(1.0 / 60.0, 0);
+	double ms_per_step = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / num_steps;
+
+	double checksum = 0;
+	for (size_t i = 0; i < boxes.size(); i++) {
+		const btVector3 &origin = boxes[i]->getWorldTransform().getOrigin();
+		checksum += origin.x() * 1.3 + origin.y() * 0.7 + origin.z() * 0.1 * (i % 100);
+	}
+
+	printf("%s threads=%d boxes=%d manifolds=%d %.3f ms/step checksum=%.9g\n",
+		mode, threaded ? task_scheduler->getNumThreads() : 1, int(boxes.size()),
+		dispatcher->getNumManifolds(), ms_per_step, checksum);
+
+	for (int i = world->getNumCollisionObjects() - 1; i >= 0; i--) {
+		btRigidBody *body = btRigidBody::upcast(world->getCollisionObjectArray()[i]);
+		world->removeRigidBody(body);
+		delete body->getMotionState();
+		delete body;
+	}
+	delete box_shape;
+	delete ground_shape;
+	delete world;
+	delete large_island_solver;
+	delete solver;
+	delete dispatcher;
+	delete collision_configuration;
+	delete broadphase;
+
+	btSetTaskScheduler(nullptr);
+	delete task_scheduler;
+	return 0;
+}
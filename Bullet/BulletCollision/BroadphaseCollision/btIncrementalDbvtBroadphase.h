@@ -0,0 +1,109 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_INCREMENTAL_DBVT_BROADPHASE_H
+#define BT_INCREMENTAL_DBVT_BROADPHASE_H
+
+#include "btDbvtBroadphase.h"
+
+///what the last calculateOverlappingPairs call did
+struct btIncrementalBroadphaseStats
+{
+	int m_staticProxies;	// leaves of the static tree
+	int m_dynamicProxies;	// leaves of the dynamic tree
+	int m_movedProxies;		// proxies whose leaf moved or that were added, only these looked for new pairs
+	int m_staticToDynamic;	// static proxies that moved and went into the dynamic tree
+	int m_fixedUpdates;		// optimization passes over the static tree, see m_fupdates
+	int m_dynamicUpdates;	// optimization passes over the dynamic tree, see m_dupdates
+	int m_pairsAdded;
+	int m_pairsRemoved;
+	int m_numPairs;
+};
+
+///a btDbvtProxy that knows its pairs, so pairs can be checked for removal without walking the whole pair cache
+struct btIncrementalDbvtProxy : btDbvtProxy
+{
+	///the other proxy of each of its pairs. kept for proxies in the dynamic tree only, a static proxy can have
+	///a pair with every dynamic one and is never checked for removal itself.
+	btAlignedObjectArray<btIncrementalDbvtProxy*> m_partners;
+
+	btIncrementalDbvtProxy( const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, short int collisionFilterGroup, short int collisionFilterMask )
+		: btDbvtProxy( aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask )
+	{
+	}
+};
+
+///
+/// btIncrementalDbvtBroadphase -- a btDbvtBroadphase for worlds that are mostly static.
+///
+///  Proxies created with the StaticFilter group go into the fixed tree (m_sets[FIXED_SET]) and stay
+///  there, all others go into the dynamic tree. Unlike btDbvtBroadphase, resting dynamic proxies are
+///  never moved to the fixed tree, so the fixed tree only changes when static proxies are added or
+///  removed, and is optimized incrementally (m_fupdates percent of its leaves per call) until it has
+///  been gone over once.
+///
+///  setAabb updates the leaf right away (rayTest and aabbTest see it), and queues the proxy if its
+///  leaf had to move. calculateOverlappingPairs then tests only the queued proxies against both trees,
+///  and only checks the pairs of the queued proxies for removal, found through their partner lists
+///  (btIncrementalDbvtProxy::m_partners), so the cost follows the number of moving proxies rather than
+///  the size of the world. A pair cache with deferred removal drops pairs itself, the partner lists are
+///  not kept then. A static proxy whose box changes (e.g. a kinematic
+///  body) is moved to the dynamic tree for good.
+///
+///  Use btCollisionWorld::setForceUpdateAllAabbs( false ) with it, so static objects don't call
+///  setAabb every step.
+///
+class btIncrementalDbvtBroadphase : public btDbvtBroadphase
+{
+public:
+	btIncrementalDbvtBroadphase( btOverlappingPairCache* paircache = 0 );
+
+	virtual btBroadphaseProxy* createProxy( const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, short int collisionFilterGroup, short int collisionFilterMask, btDispatcher* dispatcher, void* multiSapProxy ) BT_OVERRIDE;
+	virtual void destroyProxy( btBroadphaseProxy* proxy, btDispatcher* dispatcher ) BT_OVERRIDE;
+	virtual void setAabb( btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher ) BT_OVERRIDE;
+	virtual void calculateOverlappingPairs( btDispatcher* dispatcher ) BT_OVERRIDE;
+	virtual void resetPool( btDispatcher* dispatcher ) BT_OVERRIDE;
+	virtual void printStats() BT_OVERRIDE;
+
+	const btIncrementalBroadphaseStats& getStats() const
+	{
+		return m_stats;
+	}
+
+protected:
+	///values of btDbvtProxy::stage
+	enum ProxyState
+	{
+		PROXY_DYNAMIC = 0,
+		PROXY_MOVED = 1,		// in the dynamic tree and in m_movedProxies
+		PROXY_STATIC = STAGECOUNT
+	};
+
+	btAlignedObjectArray<btDbvtProxy*> m_movedProxies;
+	btIncrementalBroadphaseStats m_stats;
+	int m_staticToDynamic;		// since the last calculateOverlappingPairs
+	bool m_trackPartners;		// the pair cache has no deferred removal
+
+	void queueMovedProxy( btDbvtProxy* proxy );
+	void collideMovedProxies( btDispatcher* dispatcher );
+	void findPartners( btIncrementalDbvtProxy* proxy );
+	void forgetPartners( btIncrementalDbvtProxy* proxy );
+	static void linkPartners( btIncrementalDbvtProxy* a, btIncrementalDbvtProxy* b );
+	static void unlinkPartner( btIncrementalDbvtProxy* proxy, btIncrementalDbvtProxy* partner );
+
+	friend struct btIncrementalDbvtCollider;
+};
+
+#endif //BT_INCREMENTAL_DBVT_BROADPHASE_H
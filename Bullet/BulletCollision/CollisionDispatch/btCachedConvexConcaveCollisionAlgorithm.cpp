@@ -0,0 +1,281 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btCachedConvexConcaveCollisionAlgorithm.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "BulletCollision/CollisionDispatch/btManifoldResult.h"
+#include "BulletCollision/CollisionShapes/btConcaveShape.h"
+#include "BulletCollision/CollisionShapes/btTriangleShape.h"
+#include "BulletCollision/CollisionShapes/btTriangleCallback.h"
+#include "BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h"
+#include "BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h"
+#include "BulletCollision/NarrowPhaseCollision/btPolyhedralContactClipping.h"
+#include "LinearMath/btTransformUtil.h"
+#include "LinearMath/btQuickprof.h"
+
+
+btScalar btCachedConvexConcaveCollisionAlgorithm::s_motionThreshold = btScalar( 0.1 );
+
+
+// runs GJK between the convex and each triangle, starting from the axis that triangle had last time
+struct btCachedConvexTriangleCallback : public btTriangleCallback
+{
+	const btCollisionObjectWrapper* m_convexBodyWrap;
+	const btCollisionObjectWrapper* m_triBodyWrap;
+	const btDispatcherInfo* m_dispatchInfoPtr;
+	btManifoldResult* m_resultOut;
+	btConvexPenetrationDepthSolver* m_pdSolver;
+	btScalar m_collisionMarginTriangle;
+	btScalar m_contactBreakingThreshold;
+	btVector3 m_aabbMin;
+	btVector3 m_aabbMax;
+	const btAlignedObjectArray<btCachedTriangleAxis>* m_axes;
+	btAlignedObjectArray<btCachedTriangleAxis>* m_newAxes;
+	int m_nextAxis;
+	btVertexArray m_worldVertsB2;
+
+	// the bvh hands out the triangles in the same order every step, so the next entry is usually the one
+	const btCachedTriangleAxis* findAxis( int partId, int triangleIndex )
+	{
+		const btAlignedObjectArray<btCachedTriangleAxis>& axes = *m_axes;
+		for ( int i = 0; i < axes.size(); ++i )
+		{
+			int index = m_nextAxis + i;
+			if ( index >= axes.size() )
+			{
+				index -= axes.size();
+			}
+			if ( axes[ index ].m_partId == partId && axes[ index ].m_triangleIndex == triangleIndex )
+			{
+				m_nextAxis = index + 1;
+				return &axes[ index ];
+			}
+		}
+		return 0;
+	}
+
+	void collideTriangle( btTriangleShape& triangle, int partId, int triangleIndex )
+	{
+		const btConvexShape* convexShape = static_cast<const btConvexShape*>( m_convexBodyWrap->getCollisionShape() );
+		const btTransform& convexTrans = m_convexBodyWrap->getWorldTransform();
+		const btTransform& meshTrans = m_triBodyWrap->getWorldTransform();
+
+		// btConvexConvexAlgorithm keeps one simplex solver per create func, which threads would share
+		btVoronoiSimplexSolver simplexSolver;
+		btGjkPairDetector gjkPairDetector( convexShape, &triangle, &simplexSolver, m_pdSolver );
+		gjkPairDetector.setMinkowskiA( convexShape );
+		gjkPairDetector.setMinkowskiB( &triangle );
+
+		const btCachedTriangleAxis* cached = findAxis( partId, triangleIndex );
+		if ( cached )
+		{
+			gjkPairDetector.setCachedSeperatingAxis( meshTrans.getBasis() * cached->m_axis );
+		}
+
+		btGjkPairDetector::ClosestPointInput input;
+		input.m_maximumDistanceSquared = convexShape->getMargin() + triangle.getMargin() + m_contactBreakingThreshold;
+		input.m_maximumDistanceSquared *= input.m_maximumDistanceSquared;
+		input.m_transformA = convexTrans;
+		input.m_transformB = meshTrans;
+
+		const btPolyhedralConvexShape* polyhedron = convexShape->isPolyhedral() ? static_cast<const btPolyhedralConvexShape*>( convexShape ) : 0;
+		if ( polyhedron && polyhedron->getConvexPolyhedron() )
+		{
+			// same as btConvexConvexAlgorithm for a hull against a triangle: GJK only finds the axis,
+			// the points come from clipping the triangle against the hull
+			struct btDummyResult : public btDiscreteCollisionDetectorInterface::Result
+			{
+				virtual void setShapeIdentifiersA( int, int ) {}
+				virtual void setShapeIdentifiersB( int, int ) {}
+				virtual void addContactPoint( const btVector3&, const btVector3&, btScalar ) {}
+			};
+			btDummyResult dummy;
+			gjkPairDetector.getClosestPoints( input, dummy, m_dispatchInfoPtr->m_debugDraw );
+
+			btScalar l2 = gjkPairDetector.getCachedSeparatingAxis().length2();
+			if ( l2 > SIMD_EPSILON )
+			{
+				btVertexArray vertices;
+				vertices.push_back( meshTrans * triangle.m_vertices1[ 0 ] );
+				vertices.push_back( meshTrans * triangle.m_vertices1[ 1 ] );
+				vertices.push_back( meshTrans * triangle.m_vertices1[ 2 ] );
+				btVector3 sepNormalWorldSpace = gjkPairDetector.getCachedSeparatingAxis() * ( 1.f / l2 );
+				btScalar minDist = gjkPairDetector.getCachedSeparatingDistance() - convexShape->getMargin() - triangle.getMargin();
+				m_worldVertsB2.resize( 0 );
+				btPolyhedralContactClipping::clipFaceAgainstHull( sepNormalWorldSpace, *polyhedron->getConvexPolyhedron(),
+					convexTrans, vertices, m_worldVertsB2, minDist - m_contactBreakingThreshold, m_contactBreakingThreshold, *m_resultOut );
+			}
+			else
+			{
+				// no usable axis (deep or degenerate overlap), take the points from GJK instead
+				gjkPairDetector.getClosestPoints( input, *m_resultOut, m_dispatchInfoPtr->m_debugDraw );
+			}
+		}
+		else
+		{
+			gjkPairDetector.getClosestPoints( input, *m_resultOut, m_dispatchInfoPtr->m_debugDraw );
+		}
+
+		const btVector3& axis = gjkPairDetector.getCachedSeparatingAxis();
+		if ( axis.length2() > SIMD_EPSILON )
+		{
+			btCachedTriangleAxis entry;
+			entry.m_partId = partId;
+			entry.m_triangleIndex = triangleIndex;
+			entry.m_axis = meshTrans.getBasis().transpose() * axis;
+			m_newAxes->push_back( entry );
+		}
+	}
+
+	virtual void processTriangle( btVector3* triangle, int partId, int triangleIndex )
+	{
+		if ( !TestTriangleAgainstAabb2( triangle, m_aabbMin, m_aabbMax ) )
+		{
+			return;
+		}
+
+		btTriangleShape tm( triangle[ 0 ], triangle[ 1 ], triangle[ 2 ] );
+		tm.setMargin( m_collisionMarginTriangle );
+
+		// the result reports the triangle as the shape the convex touched, contact added callbacks
+		// (e.g. btAdjustInternalEdgeContacts) rely on that
+		btCollisionObjectWrapper triObWrap( m_triBodyWrap, &tm, m_triBodyWrap->getCollisionObject(), m_triBodyWrap->getWorldTransform(), partId, triangleIndex );
+		const btCollisionObjectWrapper* tmpWrap = 0;
+		const bool triIsBody0 = m_resultOut->getBody0Internal() == m_triBodyWrap->getCollisionObject();
+		if ( triIsBody0 )
+		{
+			tmpWrap = m_resultOut->getBody0Wrap();
+			m_resultOut->setBody0Wrap( &triObWrap );
+			m_resultOut->setShapeIdentifiersA( partId, triangleIndex );
+		}
+		else
+		{
+			tmpWrap = m_resultOut->getBody1Wrap();
+			m_resultOut->setBody1Wrap( &triObWrap );
+			m_resultOut->setShapeIdentifiersB( partId, triangleIndex );
+		}
+
+		collideTriangle( tm, partId, triangleIndex );
+
+		if ( triIsBody0 )
+		{
+			m_resultOut->setBody0Wrap( tmpWrap );
+		}
+		else
+		{
+			m_resultOut->setBody1Wrap( tmpWrap );
+		}
+	}
+};
+
+
+btCachedConvexConcaveCollisionAlgorithm::btCachedConvexConcaveCollisionAlgorithm( const btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, btConvexPenetrationDepthSolver* pdSolver, bool isSwapped )
+	: btActivatingCollisionAlgorithm( ci, body0Wrap, body1Wrap ),
+	m_pdSolver( pdSolver ),
+	m_isSwapped( isSwapped ),
+	m_hasLastTransform( false )
+{
+	const btCollisionObjectWrapper* convexBodyWrap = isSwapped ? body1Wrap : body0Wrap;
+	const btCollisionObjectWrapper* triBodyWrap = isSwapped ? body0Wrap : body1Wrap;
+	m_manifoldPtr = m_dispatcher->getNewManifold( convexBodyWrap->getCollisionObject(), triBodyWrap->getCollisionObject() );
+}
+
+
+btCachedConvexConcaveCollisionAlgorithm::~btCachedConvexConcaveCollisionAlgorithm()
+{
+	m_dispatcher->releaseManifold( m_manifoldPtr );
+}
+
+
+void btCachedConvexConcaveCollisionAlgorithm::clearCache()
+{
+	m_dispatcher->clearManifold( m_manifoldPtr );
+	m_axes.resize( 0 );
+	m_hasLastTransform = false;
+}
+
+
+void btCachedConvexConcaveCollisionAlgorithm::processCollision( const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, const btDispatcherInfo& dispatchInfo, btManifoldResult* resultOut )
+{
+	const btCollisionObjectWrapper* convexBodyWrap = m_isSwapped ? body1Wrap : body0Wrap;
+	const btCollisionObjectWrapper* triBodyWrap = m_isSwapped ? body0Wrap : body1Wrap;
+	if ( !triBodyWrap->getCollisionShape()->isConcave() || !convexBodyWrap->getCollisionShape()->isConvex() )
+	{
+		return;
+	}
+
+	resultOut->setPersistentManifold( m_manifoldPtr );
+	m_manifoldPtr->setBodies( convexBodyWrap->getCollisionObject(), triBodyWrap->getCollisionObject() );
+
+	const btConcaveShape* concaveShape = static_cast<const btConcaveShape*>( triBodyWrap->getCollisionShape() );
+	const btConvexShape* convexShape = static_cast<const btConvexShape*>( convexBodyWrap->getCollisionShape() );
+	const btTransform convexInMesh = triBodyWrap->getWorldTransform().inverseTimes( convexBodyWrap->getWorldTransform() );
+	const btScalar threshold = m_manifoldPtr->getContactBreakingThreshold();
+
+	if ( m_hasLastTransform )
+	{
+		// how far a point on the convex can have moved since the last full pass
+		btVector3 axis;
+		btScalar angle;
+		btTransformUtil::calculateDiffAxisAngle( m_lastConvexInMesh, convexInMesh, axis, angle );
+		btScalar motion = ( convexInMesh.getOrigin() - m_lastConvexInMesh.getOrigin() ).length() + btFabs( angle ) * convexShape->getAngularMotionDisc();
+		if ( motion < s_motionThreshold * threshold )
+		{
+			resultOut->refreshContactPoints();
+			return;
+		}
+	}
+
+	BT_PROFILE( "btCachedConvexConcaveCollisionAlgorithm::processCollision" );
+	btCachedConvexTriangleCallback callback;
+	callback.m_convexBodyWrap = convexBodyWrap;
+	callback.m_triBodyWrap = triBodyWrap;
+	callback.m_dispatchInfoPtr = &dispatchInfo;
+	callback.m_resultOut = resultOut;
+	callback.m_pdSolver = m_pdSolver;
+	callback.m_collisionMarginTriangle = concaveShape->getMargin();
+	callback.m_contactBreakingThreshold = threshold;
+	callback.m_axes = &m_axes;
+	callback.m_newAxes = &m_newAxes;
+	callback.m_nextAxis = 0;
+	m_newAxes.resize( 0 );
+
+	convexShape->getAabb( convexInMesh, callback.m_aabbMin, callback.m_aabbMax );
+	const btVector3 extra( callback.m_collisionMarginTriangle, callback.m_collisionMarginTriangle, callback.m_collisionMarginTriangle );
+	callback.m_aabbMin -= extra;
+	callback.m_aabbMax += extra;
+
+	concaveShape->processAllTriangles( &callback, callback.m_aabbMin, callback.m_aabbMax );
+
+	resultOut->refreshContactPoints();
+
+	// triangles that weren't visited this time drop out of the cache
+	m_axes.copyFromArray( m_newAxes );
+	m_lastConvexInMesh = convexInMesh;
+	m_hasLastTransform = true;
+}
+
+
+btScalar btCachedConvexConcaveCollisionAlgorithm::calculateTimeOfImpact( btCollisionObject* body0, btCollisionObject* body1, const btDispatcherInfo& dispatchInfo, btManifoldResult* resultOut )
+{
+	(void)body0;
+	(void)body1;
+	(void)dispatchInfo;
+	(void)resultOut;
+	//not yet, btDiscreteDynamicsWorld does its own swept sphere test for ccd
+	return btScalar( 1. );
+}
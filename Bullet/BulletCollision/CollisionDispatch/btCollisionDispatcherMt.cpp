@@ -0,0 +1,387 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btCollisionDispatcherMt.h"
+
+#include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
+#include "BulletCollision/CollisionShapes/btCollisionShape.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "LinearMath/btPoolAllocator.h"
+#include "LinearMath/btQuickprof.h"
+#include "BulletCollision/CollisionDispatch/btCollisionConfiguration.h"
+
+#include <new>
+
+extern int gNumManifold;
+
+
+/// function object that orders manifold events by pair, then by the order they happened in within the pair
+class btManifoldEventSortPredicate
+{
+public:
+	SIMD_FORCE_INLINE bool operator() ( const btCollisionDispatcherMt::ManifoldEvent& lhs, const btCollisionDispatcherMt::ManifoldEvent& rhs ) const
+	{
+		if ( lhs.m_pairIndex != rhs.m_pairIndex )
+		{
+			return lhs.m_pairIndex < rhs.m_pairIndex;
+		}
+		return lhs.m_sequence < rhs.m_sequence;
+	}
+};
+
+
+btCollisionDispatcherMt::btCollisionDispatcherMt( btCollisionConfiguration* config, int grainSize )
+	: btCollisionDispatcher( config )
+{
+	m_grainSize = grainSize;
+	m_batchUpdating = false;
+	// the configuration pools are sized for the whole world, each thread gets a share of that
+	m_threadAlgorithmPoolSize = btMax( m_collisionAlgorithmPoolAllocator->getMaxCount() / 4, 256 );
+	m_threadManifoldPoolSize = btMax( m_persistentManifoldPoolAllocator->getMaxCount() / 4, 256 );
+	for ( int i = 0; i < int( BT_MAX_THREAD_COUNT ); ++i )
+	{
+		ThreadState& state = m_threadStates[ i ];
+		state.m_algorithmPool = NULL;
+		state.m_manifoldPool = NULL;
+		state.m_pairIndex = 0;
+		state.m_sequence = 0;
+	}
+}
+
+
+btCollisionDispatcherMt::~btCollisionDispatcherMt()
+{
+	for ( int i = 0; i < int( BT_MAX_THREAD_COUNT ); ++i )
+	{
+		ThreadState& state = m_threadStates[ i ];
+		if ( state.m_algorithmPool )
+		{
+			state.m_algorithmPool->~btPoolAllocator();
+			btAlignedFree( state.m_algorithmPool );
+		}
+		if ( state.m_manifoldPool )
+		{
+			state.m_manifoldPool->~btPoolAllocator();
+			btAlignedFree( state.m_manifoldPool );
+		}
+	}
+}
+
+
+btCollisionDispatcherMt::ThreadState& btCollisionDispatcherMt::getThreadState()
+{
+	unsigned int threadIndex = btGetCurrentThreadIndex();
+	btAssert( threadIndex < BT_MAX_THREAD_COUNT );
+	return m_threadStates[ threadIndex ];
+}
+
+
+void* btCollisionDispatcherMt::allocateFromThreadPool( bool manifold, int size )
+{
+	ThreadState& state = getThreadState();
+	void* mem = NULL;
+	btMutexLock( &state.m_poolMutex );
+	btPoolAllocator*& pool = manifold ? state.m_manifoldPool : state.m_algorithmPool;
+	if ( pool == NULL )
+	{
+		int elemSize = manifold ? m_persistentManifoldPoolAllocator->getElementSize() : m_collisionAlgorithmPoolAllocator->getElementSize();
+		int maxElements = manifold ? m_threadManifoldPoolSize : m_threadAlgorithmPoolSize;
+		void* poolMem = btAlignedAlloc( sizeof( btPoolAllocator ), 16 );
+		pool = new ( poolMem ) btPoolAllocator( elemSize, maxElements );
+	}
+	if ( pool->getFreeCount() && size <= pool->getElementSize() )
+	{
+		mem = pool->allocate( size );
+	}
+	btMutexUnlock( &state.m_poolMutex );
+	return mem;
+}
+
+
+void btCollisionDispatcherMt::freeToOwningPool( bool manifold, void* ptr )
+{
+	// most memory is freed by the thread that allocated it, so look there first
+	ThreadState* ownState = &getThreadState();
+	btMutexLock( &ownState->m_poolMutex );
+	btPoolAllocator* ownPool = manifold ? ownState->m_manifoldPool : ownState->m_algorithmPool;
+	if ( ownPool && ownPool->validPtr( ptr ) )
+	{
+		ownPool->freeMemory( ptr );
+		btMutexUnlock( &ownState->m_poolMutex );
+		return;
+	}
+	btMutexUnlock( &ownState->m_poolMutex );
+
+	for ( int i = 0; i < int( BT_MAX_THREAD_COUNT ); ++i )
+	{
+		ThreadState& state = m_threadStates[ i ];
+		if ( &state == ownState )
+		{
+			continue;
+		}
+		btMutexLock( &state.m_poolMutex );
+		btPoolAllocator* pool = manifold ? state.m_manifoldPool : state.m_algorithmPool;
+		if ( pool && pool->validPtr( ptr ) )
+		{
+			pool->freeMemory( ptr );
+			btMutexUnlock( &state.m_poolMutex );
+			return;
+		}
+		btMutexUnlock( &state.m_poolMutex );
+	}
+
+	// allocated before the pools existed, or dynamically when they ran dry
+	btPoolAllocator* sharedPool = manifold ? m_persistentManifoldPoolAllocator : m_collisionAlgorithmPoolAllocator;
+	btMutexLock( &m_sharedPoolMutex );
+	if ( sharedPool->validPtr( ptr ) )
+	{
+		sharedPool->freeMemory( ptr );
+		btMutexUnlock( &m_sharedPoolMutex );
+		return;
+	}
+	btMutexUnlock( &m_sharedPoolMutex );
+	btAlignedFree( ptr );
+}
+
+
+void* btCollisionDispatcherMt::allocateCollisionAlgorithm( int size )
+{
+	void* mem = allocateFromThreadPool( false, size );
+	if ( mem == NULL )
+	{
+		//warn user for overflow?
+		mem = btAlignedAlloc( static_cast<size_t>( size ), 16 );
+	}
+	return mem;
+}
+
+
+void btCollisionDispatcherMt::freeCollisionAlgorithm( void* ptr )
+{
+	if ( ptr )
+	{
+		freeToOwningPool( false, ptr );
+	}
+}
+
+
+void btCollisionDispatcherMt::beginPair( int pairIndex )
+{
+	ThreadState& state = getThreadState();
+	state.m_pairIndex = pairIndex;
+	state.m_sequence = 0;
+}
+
+
+btPersistentManifold* btCollisionDispatcherMt::getNewManifold( const btCollisionObject* body0, const btCollisionObject* body1 )
+{
+	//optional relative contact breaking threshold, turned on by default (use setDispatcherFlags to switch off feature for improved performance)
+
+	btScalar contactBreakingThreshold = ( m_dispatcherFlags & btCollisionDispatcher::CD_USE_RELATIVE_CONTACT_BREAKING_THRESHOLD ) ?
+		btMin( body0->getCollisionShape()->getContactBreakingThreshold( gContactBreakingThreshold ), body1->getCollisionShape()->getContactBreakingThreshold( gContactBreakingThreshold ) )
+		: gContactBreakingThreshold;
+
+	btScalar contactProcessingThreshold = btMin( body0->getContactProcessingThreshold(), body1->getContactProcessingThreshold() );
+
+	void* mem = allocateFromThreadPool( true, sizeof( btPersistentManifold ) );
+	if ( mem == NULL )
+	{
+		//we got a pool memory overflow, by default we fallback to dynamically allocate memory. If we require a contiguous contact pool then assert.
+		if ( ( m_dispatcherFlags&CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION ) == 0 )
+		{
+			mem = btAlignedAlloc( sizeof( btPersistentManifold ), 16 );
+		}
+		else
+		{
+			btAssert( 0 );
+			//make sure to increase the m_defaultMaxPersistentManifoldPoolSize in the btDefaultCollisionConstructionInfo/btDefaultCollisionConfiguration
+			return 0;
+		}
+	}
+	btPersistentManifold* manifold = new( mem ) btPersistentManifold( body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold );
+	if ( m_batchUpdating )
+	{
+		// added to the manifold array once all pairs are processed
+		manifold->m_index1a = -1;
+		ThreadState& state = getThreadState();
+		ManifoldEvent event;
+		event.m_pairIndex = state.m_pairIndex;
+		event.m_sequence = state.m_sequence++;
+		event.m_manifold = manifold;
+		event.m_release = false;
+		state.m_manifoldEvents.push_back( event );
+	}
+	else
+	{
+		addManifoldToArray( manifold );
+	}
+	return manifold;
+}
+
+
+void btCollisionDispatcherMt::releaseManifold( btPersistentManifold* manifold )
+{
+	clearManifold( manifold );
+	if ( m_batchUpdating )
+	{
+		// the manifold array can't change while other threads are working, so removing
+		// the manifold and freeing its memory waits until all pairs are processed
+		ThreadState& state = getThreadState();
+		ManifoldEvent event;
+		event.m_pairIndex = state.m_pairIndex;
+		event.m_sequence = state.m_sequence++;
+		event.m_manifold = manifold;
+		event.m_release = true;
+		state.m_manifoldEvents.push_back( event );
+	}
+	else
+	{
+		removeManifoldFromArray( manifold );
+	}
+}
+
+
+void btCollisionDispatcherMt::addManifoldToArray( btPersistentManifold* manifold )
+{
+	gNumManifold++;
+	manifold->m_index1a = m_manifoldsPtr.size();
+	m_manifoldsPtr.push_back( manifold );
+}
+
+
+void btCollisionDispatcherMt::removeManifoldFromArray( btPersistentManifold* manifold )
+{
+	gNumManifold--;
+	int findIndex = manifold->m_index1a;
+	btAssert( findIndex < m_manifoldsPtr.size() );
+	m_manifoldsPtr.swap( findIndex, m_manifoldsPtr.size() - 1 );
+	m_manifoldsPtr[ findIndex ]->m_index1a = findIndex;
+	m_manifoldsPtr.pop_back();
+
+	manifold->~btPersistentManifold();
+	freeToOwningPool( true, manifold );
+}
+
+
+void btCollisionDispatcherMt::mergeManifoldEvents()
+{
+	m_mergedEvents.resize( 0 );
+	for ( int i = 0; i < int( BT_MAX_THREAD_COUNT ); ++i )
+	{
+		btAlignedObjectArray<ManifoldEvent>& events = m_threadStates[ i ].m_manifoldEvents;
+		for ( int j = 0; j < events.size(); ++j )
+		{
+			m_mergedEvents.push_back( events[ j ] );
+		}
+		events.resize( 0 );
+	}
+	if ( m_mergedEvents.size() == 0 )
+	{
+		return;
+	}
+	// apply in pair order so the manifold array doesn't depend on which thread got which pair
+	m_mergedEvents.quickSort( btManifoldEventSortPredicate() );
+	for ( int i = 0; i < m_mergedEvents.size(); ++i )
+	{
+		const ManifoldEvent& event = m_mergedEvents[ i ];
+		if ( event.m_release )
+		{
+			removeManifoldFromArray( event.m_manifold );
+		}
+		else
+		{
+			addManifoldToArray( event.m_manifold );
+		}
+	}
+}
+
+
+// soft bodies collect their contacts in arrays on the body and share the sparse SDF of the world,
+// so pairs with a soft body in them are processed on the calling thread after the others
+static SIMD_FORCE_INLINE bool btIsSoftBodyPair( const btBroadphasePair& pair )
+{
+	const btCollisionObject* obj0 = static_cast<const btCollisionObject*>( pair.m_pProxy0->m_clientObject );
+	const btCollisionObject* obj1 = static_cast<const btCollisionObject*>( pair.m_pProxy1->m_clientObject );
+	return ( ( obj0->getInternalType() | obj1->getInternalType() ) & btCollisionObject::CO_SOFT_BODY ) != 0;
+}
+
+
+struct CollisionDispatcherUpdater : public btIParallelForBody
+{
+	btBroadphasePair* mPairArray;
+	btNearCallback mCallback;
+	btCollisionDispatcherMt* mDispatcher;
+	const btDispatcherInfo* mInfo;
+
+	CollisionDispatcherUpdater()
+	{
+		mPairArray = NULL;
+		mCallback = NULL;
+		mDispatcher = NULL;
+		mInfo = NULL;
+	}
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btBroadphasePair* pair = &mPairArray[ i ];
+			if ( btIsSoftBodyPair( *pair ) )
+			{
+				continue;
+			}
+			mDispatcher->beginPair( i );
+			mCallback( *pair, *mDispatcher, *mInfo );
+		}
+	}
+};
+
+
+void btCollisionDispatcherMt::dispatchAllCollisionPairs( btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btDispatcher* dispatcher )
+{
+	// time of impact queries reduce into a single value, keep those on one thread
+	if ( info.m_dispatchFunc != btDispatcherInfo::DISPATCH_DISCRETE )
+	{
+		btCollisionDispatcher::dispatchAllCollisionPairs( pairCache, info, dispatcher );
+		return;
+	}
+
+	int pairCount = pairCache->getNumOverlappingPairs();
+	if ( pairCount == 0 )
+	{
+		return;
+	}
+	BT_PROFILE( "dispatchAllCollisionPairsMt" );
+	CollisionDispatcherUpdater updater;
+	updater.mCallback = getNearCallback();
+	updater.mPairArray = pairCache->getOverlappingPairArrayPtr();
+	updater.mDispatcher = this;
+	updater.mInfo = &info;
+
+	m_batchUpdating = true;
+	btParallelFor( 0, pairCount, m_grainSize, updater );
+	for ( int i = 0; i < pairCount; ++i )
+	{
+		btBroadphasePair* pair = &updater.mPairArray[ i ];
+		if ( btIsSoftBodyPair( *pair ) )
+		{
+			beginPair( i );
+			updater.mCallback( *pair, *this, info );
+		}
+	}
+	m_batchUpdating = false;
+
+	mergeManifoldEvents();
+}
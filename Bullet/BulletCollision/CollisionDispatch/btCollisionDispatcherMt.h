@@ -0,0 +1,96 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_COLLISION_DISPATCHER_MT_H
+#define BT_COLLISION_DISPATCHER_MT_H
+
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include "LinearMath/btThreads.h"
+
+
+///btCollisionDispatcherMt runs the narrowphase of all overlapping pairs on the task scheduler.
+///The pair array is split into ranges handed to btParallelFor. Collision algorithms and persistent
+///manifolds come from per-thread pools, so workers don't fight over a single allocator. Manifolds
+///created or released while the pairs are processed are recorded per thread and applied to the
+///manifold array afterwards in pair order, which keeps the manifold order (and therefore the solver
+///order) the same no matter how the pairs were spread over the threads.
+///Pairs involving a soft body are processed on the calling thread once the parallel loop is done.
+class btCollisionDispatcherMt : public btCollisionDispatcher
+{
+public:
+	btCollisionDispatcherMt( btCollisionConfiguration* config, int grainSize = 40 );
+	virtual ~btCollisionDispatcherMt();
+
+	virtual btPersistentManifold* getNewManifold( const btCollisionObject* body0, const btCollisionObject* body1 ) BT_OVERRIDE;
+	virtual void releaseManifold( btPersistentManifold* manifold ) BT_OVERRIDE;
+
+	virtual void dispatchAllCollisionPairs( btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btDispatcher* dispatcher ) BT_OVERRIDE;
+
+	virtual void* allocateCollisionAlgorithm( int size ) BT_OVERRIDE;
+	virtual void freeCollisionAlgorithm( void* ptr ) BT_OVERRIDE;
+
+	int getGrainSize() const
+	{
+		return m_grainSize;
+	}
+	///number of pairs a worker processes per task
+	void setGrainSize( int grainSize )
+	{
+		m_grainSize = grainSize;
+	}
+
+	// internal use only: called by the parallel loop before each pair is processed
+	void beginPair( int pairIndex );
+
+	// internal use only: a manifold created or released while the pairs were being processed
+	struct ManifoldEvent
+	{
+		int m_pairIndex;
+		int m_sequence;  // order of the event within its pair
+		btPersistentManifold* m_manifold;
+		bool m_release;
+	};
+
+protected:
+	struct ThreadState
+	{
+		// pools can be freed into from any thread, so they are guarded by the mutex
+		btSpinMutex m_poolMutex;
+		btPoolAllocator* m_algorithmPool;
+		btPoolAllocator* m_manifoldPool;
+		// manifolds created and released by this thread during dispatchAllCollisionPairs
+		btAlignedObjectArray<ManifoldEvent> m_manifoldEvents;
+		int m_pairIndex;
+		int m_sequence;
+		char m_padding[ 64 ];  // keep neighbouring threads off each other's cache line
+	};
+
+	ThreadState m_threadStates[ BT_MAX_THREAD_COUNT ];
+	btSpinMutex m_sharedPoolMutex;  // for the collision configuration pools, which still own old allocations
+	btAlignedObjectArray<ManifoldEvent> m_mergedEvents;
+	int m_threadAlgorithmPoolSize;
+	int m_threadManifoldPoolSize;
+	int m_grainSize;
+	bool m_batchUpdating;
+
+	ThreadState& getThreadState();
+	void* allocateFromThreadPool( bool manifold, int size );
+	void freeToOwningPool( bool manifold, void* ptr );
+	void addManifoldToArray( btPersistentManifold* manifold );
+	void removeManifoldFromArray( btPersistentManifold* manifold );
+	void mergeManifoldEvents();
+};
+
+#endif //BT_COLLISION_DISPATCHER_MT_H
@@ -107,6 +107,12 @@ protected:
 
 	void	serializeCollisionObjects(btSerializer* serializer);
 
+	///computes the aabb updateSingleAabb would give the broadphase. doesn't touch the broadphase, so it can run on any thread
+	void	computeBroadphaseAabb(const btCollisionObject* colObj, btVector3& aabbMin, btVector3& aabbMax) const;
+
+	///hands an aabb from computeBroadphaseAabb to the broadphase, or takes the object out of the simulation if it is too large
+	void	setBroadphaseAabb(btCollisionObject* colObj, const btVector3& aabbMin, const btVector3& aabbMax);
+
 public:
 
 	//this constructor doesn't own the dispatcher and paircache/broadphase
@@ -0,0 +1,318 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btMipHeightfieldTerrainShape.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include "LinearMath/btAabbUtil2.h"
+
+#include <limits.h> //SHRT_MAX
+
+
+// a hierarchy over a grid of up to 2^31 cells per side is at most this deep, each entry pushes 4 children
+#define MIP_STACK_SIZE 128
+
+
+btMipHeightfieldTerrainShape::btMipHeightfieldTerrainShape( int heightStickWidth, int heightStickLength, const short* heightfieldData, const btVector3& gridOrigin, const btVector3& gridSpacing, bool flipQuadEdges )
+	: btHeightfieldTerrainShape( heightStickWidth, heightStickLength, heightfieldData, gridSpacing.getY(), 0, 0, 1, PHY_SHORT, flipQuadEdges ),
+	m_gridOrigin( gridOrigin ),
+	m_gridSpacing( gridSpacing )
+{
+	updateMips();
+}
+
+
+btMipHeightfieldTerrainShape::~btMipHeightfieldTerrainShape()
+{
+}
+
+
+void btMipHeightfieldTerrainShape::updateMips()
+{
+	m_levels.resize( 0 );
+	m_mips.resize( 0 );
+
+	// level 0, the range of the four corners of each cell
+	MipLevel level;
+	level.m_width = m_heightStickWidth - 1;
+	level.m_length = m_heightStickLength - 1;
+	level.m_offset = 0;
+	m_levels.push_back( level );
+	m_mips.resize( 2 * level.m_width * level.m_length );
+	for ( int j = 0; j < level.m_length; ++j )
+	{
+		const short* row0 = m_heightfieldDataShort + j * m_heightStickWidth;
+		const short* row1 = row0 + m_heightStickWidth;
+		for ( int x = 0; x < level.m_width; ++x )
+		{
+			short* entry = &m_mips[ 2 * ( j * level.m_width + x ) ];
+			entry[ 0 ] = btMin( btMin( row0[ x ], row0[ x + 1 ] ), btMin( row1[ x ], row1[ x + 1 ] ) );
+			entry[ 1 ] = btMax( btMax( row0[ x ], row0[ x + 1 ] ), btMax( row1[ x ], row1[ x + 1 ] ) );
+		}
+	}
+
+	while ( level.m_width > 1 || level.m_length > 1 )
+	{
+		MipLevel next;
+		next.m_width = ( level.m_width + 1 ) / 2;
+		next.m_length = ( level.m_length + 1 ) / 2;
+		next.m_offset = m_mips.size();
+		m_mips.resize( next.m_offset + 2 * next.m_width * next.m_length );
+		for ( int j = 0; j < next.m_length; ++j )
+		{
+			for ( int x = 0; x < next.m_width; ++x )
+			{
+				short lo = SHRT_MAX;
+				short hi = SHRT_MIN;
+				for ( int cj = 2 * j; cj < btMin( 2 * j + 2, level.m_length ); ++cj )
+				{
+					for ( int cx = 2 * x; cx < btMin( 2 * x + 2, level.m_width ); ++cx )
+					{
+						const short* child = &m_mips[ level.m_offset + 2 * ( cj * level.m_width + cx ) ];
+						lo = btMin( lo, child[ 0 ] );
+						hi = btMax( hi, child[ 1 ] );
+					}
+				}
+				m_mips[ next.m_offset + 2 * ( j * next.m_width + x ) ] = lo;
+				m_mips[ next.m_offset + 2 * ( j * next.m_width + x ) + 1 ] = hi;
+			}
+		}
+		m_levels.push_back( next );
+		level = next;
+	}
+
+	// the top entry bounds the whole grid
+	const short* top = &m_mips[ level.m_offset ];
+	m_minHeight = top[ 0 ] * m_heightScale;
+	m_maxHeight = top[ 1 ] * m_heightScale;
+	btVector3 corner0 = m_gridOrigin + btVector3( 0, top[ 0 ], 0 ) * m_gridSpacing;
+	btVector3 corner1 = m_gridOrigin + btVector3( btScalar( m_heightStickWidth - 1 ), top[ 1 ], btScalar( m_heightStickLength - 1 ) ) * m_gridSpacing;
+	m_localAabbMin = corner0;
+	m_localAabbMin.setMin( corner1 );
+	m_localAabbMax = corner0;
+	m_localAabbMax.setMax( corner1 );
+	m_localOrigin = btScalar( 0.5 ) * ( m_localAabbMin + m_localAabbMax );
+}
+
+
+void btMipHeightfieldTerrainShape::getAabb( const btTransform& t, btVector3& aabbMin, btVector3& aabbMax ) const
+{
+	btVector3 corner0 = m_localAabbMin * m_localScaling;
+	btVector3 corner1 = m_localAabbMax * m_localScaling;
+	btVector3 localAabbMin = corner0;
+	localAabbMin.setMin( corner1 );
+	btVector3 localAabbMax = corner0;
+	localAabbMax.setMax( corner1 );
+	btTransformAabb( localAabbMin, localAabbMax, getMargin(), t, aabbMin, aabbMax );
+}
+
+
+void btMipHeightfieldTerrainShape::processCell( btTriangleCallback* callback, int x, int j ) const
+{
+	const int triangleIndex = 2 * ( j * ( m_heightStickWidth - 1 ) + x );
+	btVector3 vertices[ 3 ];
+	if ( m_flipQuadEdges || ( m_useDiamondSubdivision && !( ( j + x ) & 1 ) ) || ( m_useZigzagSubdivision && !( j & 1 ) ) )
+	{
+		getGridVertex( x, j, vertices[ 0 ] );
+		getGridVertex( x, j + 1, vertices[ 1 ] );
+		getGridVertex( x + 1, j + 1, vertices[ 2 ] );
+		callback->processTriangle( vertices, 0, triangleIndex );
+		getGridVertex( x + 1, j + 1, vertices[ 1 ] );
+		getGridVertex( x + 1, j, vertices[ 2 ] );
+		callback->processTriangle( vertices, 0, triangleIndex + 1 );
+	}
+	else
+	{
+		getGridVertex( x, j, vertices[ 0 ] );
+		getGridVertex( x, j + 1, vertices[ 1 ] );
+		getGridVertex( x + 1, j, vertices[ 2 ] );
+		callback->processTriangle( vertices, 0, triangleIndex );
+		getGridVertex( x + 1, j, vertices[ 0 ] );
+		getGridVertex( x + 1, j + 1, vertices[ 2 ] );
+		callback->processTriangle( vertices, 0, triangleIndex + 1 );
+	}
+}
+
+
+void btMipHeightfieldTerrainShape::processAllTriangles( btTriangleCallback* callback, const btVector3& aabbMin, const btVector3& aabbMax ) const
+{
+	// into grid units, where cell (x,j) spans [x,x+1] and [j,j+1] and heights are the raw shorts
+	btVector3 corner0 = ( aabbMin / m_localScaling - m_gridOrigin ) / m_gridSpacing;
+	btVector3 corner1 = ( aabbMax / m_localScaling - m_gridOrigin ) / m_gridSpacing;
+	btVector3 gridMin = corner0;
+	gridMin.setMin( corner1 );
+	btVector3 gridMax = corner0;
+	gridMax.setMax( corner1 );
+
+	const int cellsX = m_heightStickWidth - 1;
+	const int cellsZ = m_heightStickLength - 1;
+	if ( gridMax.getX() < 0 || gridMax.getZ() < 0 || gridMin.getX() > cellsX || gridMin.getZ() > cellsZ )
+	{
+		return;
+	}
+	const int startX = btMax( 0, int( floor( gridMin.getX() ) ) );
+	const int endX = btMin( cellsX - 1, int( floor( gridMax.getX() ) ) );
+	const int startJ = btMax( 0, int( floor( gridMin.getZ() ) ) );
+	const int endJ = btMin( cellsZ - 1, int( floor( gridMax.getZ() ) ) );
+
+	int stack[ MIP_STACK_SIZE ][ 3 ];
+	int depth = 0;
+	stack[ depth ][ 0 ] = m_levels.size() - 1;
+	stack[ depth ][ 1 ] = 0;
+	stack[ depth ][ 2 ] = 0;
+	++depth;
+	while ( depth > 0 )
+	{
+		--depth;
+		const int l = stack[ depth ][ 0 ];
+		const int x = stack[ depth ][ 1 ];
+		const int j = stack[ depth ][ 2 ];
+		const MipLevel& level = m_levels[ l ];
+		const short* entry = &m_mips[ level.m_offset + 2 * ( j * level.m_width + x ) ];
+		if ( entry[ 0 ] > gridMax.getY() || entry[ 1 ] < gridMin.getY() )
+		{
+			continue;
+		}
+		if ( l == 0 )
+		{
+			processCell( callback, x, j );
+			continue;
+		}
+
+		// children in reverse, so they come off the stack in grid order
+		const MipLevel& below = m_levels[ l - 1 ];
+		const int shift = l - 1;
+		for ( int cj = btMin( 2 * j + 1, below.m_length - 1 ); cj >= 2 * j; --cj )
+		{
+			if ( ( cj << shift ) > endJ || ( ( ( cj + 1 ) << shift ) - 1 ) < startJ )
+			{
+				continue;
+			}
+			for ( int cx = btMin( 2 * x + 1, below.m_width - 1 ); cx >= 2 * x; --cx )
+			{
+				if ( ( cx << shift ) > endX || ( ( ( cx + 1 ) << shift ) - 1 ) < startX )
+				{
+					continue;
+				}
+				btAssert( depth < MIP_STACK_SIZE );
+				stack[ depth ][ 0 ] = l - 1;
+				stack[ depth ][ 1 ] = cx;
+				stack[ depth ][ 2 ] = cj;
+				++depth;
+			}
+		}
+	}
+}
+
+
+void btMipHeightfieldTerrainShape::performRaycast( btTriangleRaycastCallback* callback, const btVector3& raySource, const btVector3& rayTarget ) const
+{
+	// fractions along the ray are the same in grid units
+	const btVector3 from = ( raySource / m_localScaling - m_gridOrigin ) / m_gridSpacing;
+	const btVector3 to = ( rayTarget / m_localScaling - m_gridOrigin ) / m_gridSpacing;
+	const btVector3 dir = to - from;
+	btVector3 invDir;
+	for ( int i = 0; i < 3; ++i )
+	{
+		// a ray parallel to a slab starts either inside it (-inf..inf) or outside (both on one side)
+		invDir[ i ] = dir[ i ] == btScalar( 0 ) ? btScalar( BT_LARGE_FLOAT ) : btScalar( 1 ) / dir[ i ];
+	}
+
+	const int cellsX = m_heightStickWidth - 1;
+	const int cellsZ = m_heightStickLength - 1;
+
+	struct Entry
+	{
+		int m_level;
+		int m_x;
+		int m_j;
+		btScalar m_enter;
+	};
+	Entry stack[ MIP_STACK_SIZE ];
+	int depth = 0;
+	stack[ depth ].m_level = m_levels.size() - 1;
+	stack[ depth ].m_x = 0;
+	stack[ depth ].m_j = 0;
+	stack[ depth ].m_enter = 0;
+	++depth;
+	while ( depth > 0 )
+	{
+		const Entry node = stack[ --depth ];
+		// the nearest entry comes off the stack first, so a hit closer than it ends the walk of its subtree
+		if ( node.m_enter > callback->m_hitFraction )
+		{
+			continue;
+		}
+		if ( node.m_level == 0 )
+		{
+			processCell( callback, node.m_x, node.m_j );
+			continue;
+		}
+
+		const MipLevel& below = m_levels[ node.m_level - 1 ];
+		const int shift = node.m_level - 1;
+		Entry children[ 4 ];
+		int numChildren = 0;
+		for ( int cj = 2 * node.m_j; cj < btMin( 2 * node.m_j + 2, below.m_length ); ++cj )
+		{
+			for ( int cx = 2 * node.m_x; cx < btMin( 2 * node.m_x + 2, below.m_width ); ++cx )
+			{
+				const short* entry = &m_mips[ below.m_offset + 2 * ( cj * below.m_width + cx ) ];
+				// the box of the child's cells, grown a little so rays along a face don't slip past it
+				btVector3 boxMin( btScalar( cx << shift ), entry[ 0 ], btScalar( cj << shift ) );
+				btVector3 boxMax( btScalar( btMin( ( cx + 1 ) << shift, cellsX ) ), entry[ 1 ], btScalar( btMin( ( cj + 1 ) << shift, cellsZ ) ) );
+				boxMin -= btVector3( btScalar( 1e-3 ), btScalar( 0.5 ), btScalar( 1e-3 ) );
+				boxMax += btVector3( btScalar( 1e-3 ), btScalar( 0.5 ), btScalar( 1e-3 ) );
+
+				btScalar enter = 0;
+				btScalar leave = callback->m_hitFraction;
+				for ( int i = 0; i < 3; ++i )
+				{
+					btScalar t0 = ( boxMin[ i ] - from[ i ] ) * invDir[ i ];
+					btScalar t1 = ( boxMax[ i ] - from[ i ] ) * invDir[ i ];
+					if ( t0 > t1 )
+					{
+						btSwap( t0, t1 );
+					}
+					enter = btMax( enter, t0 );
+					leave = btMin( leave, t1 );
+				}
+				if ( enter > leave )
+				{
+					continue;
+				}
+
+				Entry& child = children[ numChildren++ ];
+				child.m_level = node.m_level - 1;
+				child.m_x = cx;
+				child.m_j = cj;
+				child.m_enter = enter;
+			}
+		}
+
+		// farthest first
+		for ( int i = 1; i < numChildren; ++i )
+		{
+			for ( int k = i; k > 0 && children[ k - 1 ].m_enter < children[ k ].m_enter; --k )
+			{
+				btSwap( children[ k - 1 ], children[ k ] );
+			}
+		}
+		for ( int i = 0; i < numChildren; ++i )
+		{
+			btAssert( depth < MIP_STACK_SIZE );
+			stack[ depth++ ] = children[ i ];
+		}
+	}
+}
@@ -0,0 +1,158 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SEQUENTIAL_IMPULSE_CONSTRAINT_SOLVER_MT_H
+#define BT_SEQUENTIAL_IMPULSE_CONSTRAINT_SOLVER_MT_H
+
+#include "btSequentialImpulseConstraintSolver.h"
+#include "btSolverConstraintSoa.h"
+#include "LinearMath/btThreads.h"
+
+
+///
+/// btSequentialImpulseConstraintSolverMt -- a btSequentialImpulseConstraintSolver that spreads a single
+///                                          large island over all threads of the task scheduler.
+///
+///  After the usual setup the constraint rows are split into batches in which no two rows touch the
+///  same dynamic solver body. The batches are solved one after another, the rows within a batch in
+///  parallel, so every row still sees the impulses of all batches before it (Gauss-Seidel across
+///  batches). Rows against static geometry only use the shared fixed solver body, which never
+///  changes, so any number of them can go into the same batch and a scene resting on the terrain
+///  does not end up in one long serial chain.
+///
+///  Only islands with at least s_minimumContactManifoldsForBatching manifolds are batched, smaller
+///  ones are solved exactly like btSequentialImpulseConstraintSolver.
+///
+///  The contact and friction rows of a batch are packed 8 at a time into btSolverConstraintSoa and
+///  solved a whole group at once, with AVX2 when btCpuFeatureUtility reports it and lane by lane
+///  otherwise. Both give the same results, so deterministic mode doesn't depend on the CPU either.
+///
+ATTRIBUTE_ALIGNED16(class) btSequentialImpulseConstraintSolverMt : public btSequentialImpulseConstraintSolver
+{
+public:
+	///islands with fewer contact manifolds than this are not worth batching
+	static int s_minimumContactManifoldsForBatching;
+	///minimum number of rows per parallel-for job
+	static int s_minBatchSize;
+
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btSequentialImpulseConstraintSolverMt();
+	virtual ~btSequentialImpulseConstraintSolverMt();
+
+	///Batching changes the order rows are solved in, so by default an island is only batched when there
+	///is more than one thread to run it on, and a single thread gives the same result as
+	///btSequentialImpulseConstraintSolver. In deterministic mode large islands are always batched, so the
+	///result is the same whatever the number of threads (e.g. for replays or lockstep networking).
+	void setDeterministic( bool deterministic )
+	{
+		m_deterministic = deterministic;
+	}
+	bool getDeterministic() const
+	{
+		return m_deterministic;
+	}
+
+	///solve batched contact and friction rows in groups of 8 (on by default), otherwise one row at a time
+	void setUseSoaRows( bool useSoaRows )
+	{
+		m_useSoaRows = useSoaRows;
+	}
+	bool getUseSoaRows() const
+	{
+		return m_useSoaRows;
+	}
+
+	///the group row solvers are picked in the constructor, based on btCpuFeatureUtility
+	void setSoaRowSolvers( btSoaContactRowSolver contactRowSolver, btSoaFrictionRowSolver frictionRowSolver )
+	{
+		m_solveSoaContactRows = contactRowSolver;
+		m_solveSoaFrictionRows = frictionRowSolver;
+	}
+	btSoaContactRowSolver getActiveSoaContactRowSolver() const
+	{
+		return m_solveSoaContactRows;
+	}
+	btSoaFrictionRowSolver getActiveSoaFrictionRowSolver() const
+	{
+		return m_solveSoaFrictionRows;
+	}
+
+protected:
+	enum RowKind
+	{
+		ROW_JOINT,					// m_tmpSolverNonContactConstraintPool rows
+		ROW_CONTACT,				// contact rows
+		ROW_FRICTION,				// the friction rows of a contact
+		ROW_CONTACT_AND_FRICTION,	// a contact followed by its friction rows (SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS)
+		ROW_ROLLING_FRICTION,		// the rolling friction rows of a contact
+		ROW_SPLIT_PENETRATION		// split impulse pass of a contact
+	};
+
+	///rows of one constraint pool grouped into batches without shared dynamic bodies
+	struct btBatchedRows
+	{
+		btAlignedObjectArray<int> m_rows;			// row indices, by batch, in pool order within a batch
+		btAlignedObjectArray<int> m_batchStarts;	// batch i is m_rows[m_batchStarts[i]] .. m_rows[m_batchStarts[i+1]-1]
+		btAlignedObjectArray<int> m_batchOrder;		// order the batches are solved in
+		int m_serialBatch;							// rows that didn't fit any batch, solved on one thread (-1 if none)
+
+		int getNumBatches() const
+		{
+			return m_batchStarts.size() > 0 ? m_batchStarts.size() - 1 : 0;
+		}
+	};
+
+	struct BatchSolveLoop;
+	struct SoaBatchSolveLoop;
+
+	btBatchedRows m_jointBatches;
+	btBatchedRows m_contactBatches;		// friction and rolling friction rows go with their contact
+	// rolling friction rows of contact c are m_rollingFrictionRows[m_rollingFrictionStarts[c]] ..
+	btAlignedObjectArray<int> m_rollingFrictionStarts;
+	btAlignedObjectArray<int> m_rollingFrictionRows;
+	// per solver body, the batches it is already used in
+	btAlignedObjectArray<unsigned long long> m_bodyBatchMasks;
+	btAlignedObjectArray<int> m_rowBatches;
+	// contact batch i is m_soaContactGroups[m_soaGroupStarts[i]] .. m_soaContactGroups[m_soaGroupStarts[i+1]-1],
+	// friction direction j of contact group g is m_soaFrictionGroups[g * m_soaNumFriction + j]
+	btAlignedObjectArray<btSolverConstraintSoa> m_soaContactGroups;
+	btAlignedObjectArray<btSolverConstraintSoa> m_soaFrictionGroups;
+	btAlignedObjectArray<int> m_soaGroupStarts;
+	int m_soaNumFriction;
+	btSoaContactRowSolver m_solveSoaContactRows;
+	btSoaFrictionRowSolver m_solveSoaFrictionRows;
+	bool m_useBatching;
+	bool m_useSoaGroups;	// m_useSoaRows and the groups are set up for the current island
+	bool m_useSoaRows;
+	bool m_deterministic;
+
+	void buildBatches( btBatchedRows* batches, const btConstraintArray& rows );
+	void buildRollingFrictionLookup();
+	bool buildSoaGroups( const btContactSolverInfo& infoGlobal );
+	void shuffleBatches( btBatchedRows* batches );
+	void solveBatches( btBatchedRows& batches, RowKind kind, int iteration, const btContactSolverInfo& infoGlobal );
+	void solveRows( RowKind kind, const int* rows, int iBegin, int iEnd, int iteration, const btContactSolverInfo& infoGlobal );
+	void solveSoaBatches( RowKind kind, int iteration, const btContactSolverInfo& infoGlobal );
+	void solveSoaGroups( RowKind kind, int iBegin, int iEnd );
+	void writeSoaAppliedImpulses( bool contactsOnly );
+
+	virtual btScalar solveGroupCacheFriendlySetup( btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer ) BT_OVERRIDE;
+	virtual void solveGroupCacheFriendlySplitImpulseIterations( btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer ) BT_OVERRIDE;
+	virtual btScalar solveGroupCacheFriendlyFinish( btCollisionObject** bodies, int numBodies, const btContactSolverInfo& infoGlobal ) BT_OVERRIDE;
+	virtual btScalar solveSingleIteration( int iteration, btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer ) BT_OVERRIDE;
+};
+
+#endif //BT_SEQUENTIAL_IMPULSE_CONSTRAINT_SOLVER_MT_H
@@ -0,0 +1,215 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btSolverConstraintSoa.h"
+
+#ifdef BT_ALLOW_AVX2
+
+#include <immintrin.h>
+
+// only the functions in this file are compiled for AVX2, the rest of the build stays at the default
+// instruction set. FMA is left out on purpose so the results match btSolveSoa*Rows_scalar exactly.
+#if defined(__GNUC__) || defined(__clang__)
+#define BT_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define BT_AVX2_TARGET
+#endif
+
+
+struct btSoaBodyVelocities
+{
+	__m256 m_linear[ 3 ];
+	__m256 m_angular[ 3 ];
+};
+
+
+// loads the x,y,z of 8 btVector3s into one register each, lane l from vectors[l]
+static BT_AVX2_TARGET SIMD_FORCE_INLINE void btSoaLoadTransposed( const float* const* vectors, __m256* xyz )
+{
+	// separate loads and a transpose, hardware gathers are much slower on many CPUs
+	__m256 r0 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( vectors[ 0 ] ) ), _mm_loadu_ps( vectors[ 4 ] ), 1 );
+	__m256 r1 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( vectors[ 1 ] ) ), _mm_loadu_ps( vectors[ 5 ] ), 1 );
+	__m256 r2 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( vectors[ 2 ] ) ), _mm_loadu_ps( vectors[ 6 ] ), 1 );
+	__m256 r3 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( vectors[ 3 ] ) ), _mm_loadu_ps( vectors[ 7 ] ), 1 );
+	__m256 t0 = _mm256_unpacklo_ps( r0, r1 );
+	__m256 t1 = _mm256_unpacklo_ps( r2, r3 );
+	__m256 t2 = _mm256_unpackhi_ps( r0, r1 );
+	__m256 t3 = _mm256_unpackhi_ps( r2, r3 );
+	xyz[ 0 ] = _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+	xyz[ 1 ] = _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+	xyz[ 2 ] = _mm256_shuffle_ps( t2, t3, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+}
+
+
+// inverse of btSoaLoadTransposed for the lanes in writeMask, w is set to 0 like btVector3::setValue does
+static BT_AVX2_TARGET SIMD_FORCE_INLINE void btSoaStoreTransposed( const __m256* xyz, int writeMask, float* const* vectors )
+{
+	__m256 zero = _mm256_setzero_ps();
+	__m256 t0 = _mm256_unpacklo_ps( xyz[ 0 ], xyz[ 1 ] );
+	__m256 t1 = _mm256_unpackhi_ps( xyz[ 0 ], xyz[ 1 ] );
+	__m256 t2 = _mm256_unpacklo_ps( xyz[ 2 ], zero );
+	__m256 t3 = _mm256_unpackhi_ps( xyz[ 2 ], zero );
+	__m256 r[ 4 ];
+	r[ 0 ] = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+	r[ 1 ] = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+	r[ 2 ] = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+	r[ 3 ] = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+	for ( int l = 0; l < 4; ++l )
+	{
+		if ( writeMask & ( 1 << l ) )
+		{
+			_mm_storeu_ps( vectors[ l ], _mm256_castps256_ps128( r[ l ] ) );
+		}
+		if ( writeMask & ( 1 << ( l + 4 ) ) )
+		{
+			_mm_storeu_ps( vectors[ l + 4 ], _mm256_extractf128_ps( r[ l ], 1 ) );
+		}
+	}
+}
+
+
+static BT_AVX2_TARGET SIMD_FORCE_INLINE void btSoaGatherVelocities( btSolverBody* bodies, const int* bodyIds, float** linear, float** angular, btSoaBodyVelocities* velocities )
+{
+	for ( int l = 0; l < BT_SOA_ROW_WIDTH; ++l )
+	{
+		btSolverBody& body = bodies[ bodyIds[ l ] ];
+		linear[ l ] = body.m_deltaLinearVelocity.m_floats;
+		angular[ l ] = body.m_deltaAngularVelocity.m_floats;
+	}
+	btSoaLoadTransposed( linear, velocities->m_linear );
+	btSoaLoadTransposed( angular, velocities->m_angular );
+}
+
+
+static BT_AVX2_TARGET SIMD_FORCE_INLINE void btSoaScatterVelocities( int writeMask, float* const* linear, float* const* angular, const btSoaBodyVelocities& velocities )
+{
+	if ( writeMask != 0 )
+	{
+		btSoaStoreTransposed( velocities.m_linear, writeMask, linear );
+		btSoaStoreTransposed( velocities.m_angular, writeMask, angular );
+	}
+}
+
+
+static BT_AVX2_TARGET SIMD_FORCE_INLINE __m256 btSoaDot( const float ( *axis )[ BT_SOA_ROW_WIDTH ], const __m256* v )
+{
+	__m256 result = _mm256_mul_ps( _mm256_loadu_ps( axis[ 0 ] ), v[ 0 ] );
+	result = _mm256_add_ps( result, _mm256_mul_ps( _mm256_loadu_ps( axis[ 1 ] ), v[ 1 ] ) );
+	result = _mm256_add_ps( result, _mm256_mul_ps( _mm256_loadu_ps( axis[ 2 ] ), v[ 2 ] ) );
+	return result;
+}
+
+
+static BT_AVX2_TARGET SIMD_FORCE_INLINE __m256 btSoaDeltaImpulse( const btSolverConstraintSoa& group, const btSoaBodyVelocities& a, const btSoaBodyVelocities& b )
+{
+	__m256 vel1 = _mm256_add_ps( btSoaDot( group.m_contactNormal1, a.m_linear ), btSoaDot( group.m_relpos1CrossNormal, a.m_angular ) );
+	__m256 vel2 = _mm256_add_ps( btSoaDot( group.m_contactNormal2, b.m_linear ), btSoaDot( group.m_relpos2CrossNormal, b.m_angular ) );
+	__m256 jacDiagABInv = _mm256_loadu_ps( group.m_jacDiagABInv );
+	__m256 deltaImpulse = _mm256_sub_ps( _mm256_loadu_ps( group.m_rhs ), _mm256_mul_ps( _mm256_loadu_ps( group.m_appliedImpulse ), _mm256_loadu_ps( group.m_cfm ) ) );
+	deltaImpulse = _mm256_sub_ps( deltaImpulse, _mm256_mul_ps( vel1, jacDiagABInv ) );
+	deltaImpulse = _mm256_sub_ps( deltaImpulse, _mm256_mul_ps( vel2, jacDiagABInv ) );
+	return deltaImpulse;
+}
+
+
+static BT_AVX2_TARGET SIMD_FORCE_INLINE void btSoaApplyImpulse( const float ( *linearComponent )[ BT_SOA_ROW_WIDTH ], const float ( *angularComponent )[ BT_SOA_ROW_WIDTH ], __m256 deltaImpulse, btSoaBodyVelocities* velocities )
+{
+	for ( int k = 0; k < 3; ++k )
+	{
+		velocities->m_linear[ k ] = _mm256_add_ps( velocities->m_linear[ k ], _mm256_mul_ps( _mm256_loadu_ps( linearComponent[ k ] ), deltaImpulse ) );
+		velocities->m_angular[ k ] = _mm256_add_ps( velocities->m_angular[ k ], _mm256_mul_ps( _mm256_loadu_ps( angularComponent[ k ] ), deltaImpulse ) );
+	}
+}
+
+
+BT_AVX2_TARGET void btSolveSoaContactRows_avx2( btSolverBody* bodies, btSolverConstraintSoa* groups, int iBegin, int iEnd )
+{
+	for ( int i = iBegin; i < iEnd; ++i )
+	{
+		btSolverConstraintSoa& group = groups[ i ];
+		btSoaBodyVelocities a, b;
+		float* linearA[ BT_SOA_ROW_WIDTH ];
+		float* angularA[ BT_SOA_ROW_WIDTH ];
+		float* linearB[ BT_SOA_ROW_WIDTH ];
+		float* angularB[ BT_SOA_ROW_WIDTH ];
+		btSoaGatherVelocities( bodies, group.m_solverBodyIdA, linearA, angularA, &a );
+		btSoaGatherVelocities( bodies, group.m_solverBodyIdB, linearB, angularB, &b );
+
+		__m256 deltaImpulse = btSoaDeltaImpulse( group, a, b );
+		__m256 appliedImpulse = _mm256_loadu_ps( group.m_appliedImpulse );
+		__m256 lowerLimit = _mm256_loadu_ps( group.m_lowerLimit );
+		__m256 sum = _mm256_add_ps( appliedImpulse, deltaImpulse );
+		__m256 belowLower = _mm256_cmp_ps( sum, lowerLimit, _CMP_LT_OQ );
+		deltaImpulse = _mm256_blendv_ps( deltaImpulse, _mm256_sub_ps( lowerLimit, appliedImpulse ), belowLower );
+		_mm256_storeu_ps( group.m_appliedImpulse, _mm256_blendv_ps( sum, lowerLimit, belowLower ) );
+
+		btSoaApplyImpulse( group.m_linearComponentA, group.m_angularComponentA, deltaImpulse, &a );
+		btSoaApplyImpulse( group.m_linearComponentB, group.m_angularComponentB, deltaImpulse, &b );
+		btSoaScatterVelocities( group.m_writeMaskA, linearA, angularA, a );
+		btSoaScatterVelocities( group.m_writeMaskB, linearB, angularB, b );
+	}
+	_mm256_zeroupper();
+}
+
+
+BT_AVX2_TARGET void btSolveSoaFrictionRows_avx2( btSolverBody* bodies, btSolverConstraintSoa* frictionGroups, const btSolverConstraintSoa* contactGroups, int numFriction, int iBegin, int iEnd )
+{
+	const __m256 signMask = _mm256_set1_ps( -0.0f );
+	for ( int i = iBegin; i < iEnd; ++i )
+	{
+		// friction rows of contacts without impulse are skipped, like in the sequential solver
+		__m256 totalImpulse = _mm256_loadu_ps( contactGroups[ i ].m_appliedImpulse );
+		__m256 active = _mm256_cmp_ps( totalImpulse, _mm256_setzero_ps(), _CMP_GT_OQ );
+		int activeMask = _mm256_movemask_ps( active );
+		if ( activeMask == 0 )
+		{
+			continue;
+		}
+		for ( int j = 0; j < numFriction; ++j )
+		{
+			btSolverConstraintSoa& group = frictionGroups[ i * numFriction + j ];
+			btSoaBodyVelocities a, b;
+			float* linearA[ BT_SOA_ROW_WIDTH ];
+			float* angularA[ BT_SOA_ROW_WIDTH ];
+			float* linearB[ BT_SOA_ROW_WIDTH ];
+			float* angularB[ BT_SOA_ROW_WIDTH ];
+			btSoaGatherVelocities( bodies, group.m_solverBodyIdA, linearA, angularA, &a );
+			btSoaGatherVelocities( bodies, group.m_solverBodyIdB, linearB, angularB, &b );
+
+			__m256 upperLimit = _mm256_mul_ps( _mm256_loadu_ps( group.m_friction ), totalImpulse );
+			__m256 lowerLimit = _mm256_xor_ps( upperLimit, signMask );
+			__m256 deltaImpulse = btSoaDeltaImpulse( group, a, b );
+			__m256 appliedImpulse = _mm256_loadu_ps( group.m_appliedImpulse );
+			__m256 sum = _mm256_add_ps( appliedImpulse, deltaImpulse );
+			__m256 belowLower = _mm256_cmp_ps( sum, lowerLimit, _CMP_LT_OQ );
+			__m256 aboveUpper = _mm256_andnot_ps( belowLower, _mm256_cmp_ps( sum, upperLimit, _CMP_GT_OQ ) );
+			deltaImpulse = _mm256_blendv_ps( deltaImpulse, _mm256_sub_ps( upperLimit, appliedImpulse ), aboveUpper );
+			deltaImpulse = _mm256_blendv_ps( deltaImpulse, _mm256_sub_ps( lowerLimit, appliedImpulse ), belowLower );
+			deltaImpulse = _mm256_and_ps( deltaImpulse, active );
+			__m256 newImpulse = _mm256_blendv_ps( sum, upperLimit, aboveUpper );
+			newImpulse = _mm256_blendv_ps( newImpulse, lowerLimit, belowLower );
+			_mm256_storeu_ps( group.m_appliedImpulse, _mm256_blendv_ps( appliedImpulse, newImpulse, active ) );
+
+			btSoaApplyImpulse( group.m_linearComponentA, group.m_angularComponentA, deltaImpulse, &a );
+			btSoaApplyImpulse( group.m_linearComponentB, group.m_angularComponentB, deltaImpulse, &b );
+			btSoaScatterVelocities( group.m_writeMaskA & activeMask, linearA, angularA, a );
+			btSoaScatterVelocities( group.m_writeMaskB & activeMask, linearB, angularB, b );
+		}
+	}
+	_mm256_zeroupper();
+}
+
+#endif //BT_ALLOW_AVX2
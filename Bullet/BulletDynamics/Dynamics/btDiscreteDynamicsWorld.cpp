@@ -974,112 +974,123 @@ void	btDiscreteDynamicsWorld::createPredictiveContacts(btScalar timeStep)
 		}
 	}
 }
-void	btDiscreteDynamicsWorld::integrateTransforms(btScalar timeStep)
+bool	btDiscreteDynamicsWorld::integrateSingleTransform(btRigidBody* body, btScalar timeStep, btTransform& predictedTrans)
 {
-	BT_PROFILE("integrateTransforms");
-	btTransform predictedTrans;
-	for ( int i=0;i<m_nonStaticRigidBodies.size();i++)
+	body->setHitFraction(1.f);
+
+	if (body->isActive() && (!body->isStaticOrKinematicObject()))
 	{
-		btRigidBody* body = m_nonStaticRigidBodies[i];
-		body->setHitFraction(1.f);
 
-		if (body->isActive() && (!body->isStaticOrKinematicObject()))
-		{
+		body->predictIntegratedTransform(timeStep, predictedTrans);
 
-			body->predictIntegratedTransform(timeStep, predictedTrans);
-
-			btScalar squareMotion = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
+		btScalar squareMotion = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
 
 
 
-			if (getDispatchInfo().m_useContinuous && body->getCcdSquareMotionThreshold() && body->getCcdSquareMotionThreshold() < squareMotion)
+		if (getDispatchInfo().m_useContinuous && body->getCcdSquareMotionThreshold() && body->getCcdSquareMotionThreshold() < squareMotion)
+		{
+			BT_PROFILE("CCD motion clamping");
+			if (body->getCollisionShape()->isConvex())
 			{
-				BT_PROFILE("CCD motion clamping");
-				if (body->getCollisionShape()->isConvex())
-				{
-					gNumClampedCcdMotions++;
+				gNumClampedCcdMotions++;
 #ifdef USE_STATIC_ONLY
-					class StaticOnlyCallback : public btClosestNotMeConvexResultCallback
-					{
-					public:
+				class StaticOnlyCallback : public btClosestNotMeConvexResultCallback
+				{
+				public:
 
-						StaticOnlyCallback (btCollisionObject* me,const btVector3& fromA,const btVector3& toA,btOverlappingPairCache* pairCache,btDispatcher* dispatcher) :
-						  btClosestNotMeConvexResultCallback(me,fromA,toA,pairCache,dispatcher)
-						{
-						}
+					StaticOnlyCallback (btCollisionObject* me,const btVector3& fromA,const btVector3& toA,btOverlappingPairCache* pairCache,btDispatcher* dispatcher) :
+					  btClosestNotMeConvexResultCallback(me,fromA,toA,pairCache,dispatcher)
+					{
+					}
 
-					  	virtual bool needsCollision(btBroadphaseProxy* proxy0) const
-						{
-							btCollisionObject* otherObj = (btCollisionObject*) proxy0->m_clientObject;
-							if (!otherObj->isStaticOrKinematicObject())
-								return false;
-							return btClosestNotMeConvexResultCallback::needsCollision(proxy0);
-						}
-					};
+				  	virtual bool needsCollision(btBroadphaseProxy* proxy0) const
+					{
+						btCollisionObject* otherObj = (btCollisionObject*) proxy0->m_clientObject;
+						if (!otherObj->isStaticOrKinematicObject())
+							return false;
+						return btClosestNotMeConvexResultCallback::needsCollision(proxy0);
+					}
+				};
 
-					StaticOnlyCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
+				StaticOnlyCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
 #else
-					btClosestNotMeConvexResultCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
+				btClosestNotMeConvexResultCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
 #endif
-					//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
-					btSphereShape tmpSphere(body->getCcdSweptSphereRadius());//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
-					sweepResults.m_allowedPenetration=getDispatchInfo().m_allowedCcdPenetration;
+				//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
+				btSphereShape tmpSphere(body->getCcdSweptSphereRadius());//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
+				sweepResults.m_allowedPenetration=getDispatchInfo().m_allowedCcdPenetration;
 
-					sweepResults.m_collisionFilterGroup = body->getBroadphaseProxy()->m_collisionFilterGroup;
-					sweepResults.m_collisionFilterMask  = body->getBroadphaseProxy()->m_collisionFilterMask;
-					btTransform modifiedPredictedTrans = predictedTrans;
-					modifiedPredictedTrans.setBasis(body->getWorldTransform().getBasis());
+				sweepResults.m_collisionFilterGroup = body->getBroadphaseProxy()->m_collisionFilterGroup;
+				sweepResults.m_collisionFilterMask  = body->getBroadphaseProxy()->m_collisionFilterMask;
+				btTransform modifiedPredictedTrans = predictedTrans;
+				modifiedPredictedTrans.setBasis(body->getWorldTransform().getBasis());
 
-					convexSweepTest(&tmpSphere,body->getWorldTransform(),modifiedPredictedTrans,sweepResults);
-					if (sweepResults.hasHit() && (sweepResults.m_closestHitFraction < 1.f))
-					{
+				convexSweepTest(&tmpSphere,body->getWorldTransform(),modifiedPredictedTrans,sweepResults);
+				if (sweepResults.hasHit() && (sweepResults.m_closestHitFraction < 1.f))
+				{
 
-						//printf("clamped integration to hit fraction = %f\n",fraction);
-						body->setHitFraction(sweepResults.m_closestHitFraction);
-						body->predictIntegratedTransform(timeStep*body->getHitFraction(), predictedTrans);
-						body->setHitFraction(0.f);
-						body->proceedToTransform( predictedTrans);
+					//printf("clamped integration to hit fraction = %f\n",fraction);
+					body->setHitFraction(sweepResults.m_closestHitFraction);
+					body->predictIntegratedTransform(timeStep*body->getHitFraction(), predictedTrans);
+					body->setHitFraction(0.f);
 
 #if 0
-						btVector3 linVel = body->getLinearVelocity();
+					btVector3 linVel = body->getLinearVelocity();
 
-						btScalar maxSpeed = body->getCcdMotionThreshold()/getSolverInfo().m_timeStep;
-						btScalar maxSpeedSqr = maxSpeed*maxSpeed;
-						if (linVel.length2()>maxSpeedSqr)
-						{
-							linVel.normalize();
-							linVel*= maxSpeed;
-							body->setLinearVelocity(linVel);
-							btScalar ms2 = body->getLinearVelocity().length2();
-							body->predictIntegratedTransform(timeStep, predictedTrans);
-
-							btScalar sm2 = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
-							btScalar smt = body->getCcdSquareMotionThreshold();
-							printf("sm2=%f\n",sm2);
-						}
+					btScalar maxSpeed = body->getCcdMotionThreshold()/getSolverInfo().m_timeStep;
+					btScalar maxSpeedSqr = maxSpeed*maxSpeed;
+					if (linVel.length2()>maxSpeedSqr)
+					{
+						linVel.normalize();
+						linVel*= maxSpeed;
+						body->setLinearVelocity(linVel);
+						btScalar ms2 = body->getLinearVelocity().length2();
+						body->predictIntegratedTransform(timeStep, predictedTrans);
+
+						btScalar sm2 = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
+						btScalar smt = body->getCcdSquareMotionThreshold();
+						printf("sm2=%f\n",sm2);
+					}
 #else
 
-						//don't apply the collision response right now, it will happen next frame
-						//if you really need to, you can uncomment next 3 lines. Note that is uses zero restitution.
-						//btScalar appliedImpulse = 0.f;
-						//btScalar depth = 0.f;
-						//appliedImpulse = resolveSingleCollision(body,(btCollisionObject*)sweepResults.m_hitCollisionObject,sweepResults.m_hitPointWorld,sweepResults.m_hitNormalWorld,getSolverInfo(), depth);
+					//don't apply the collision response right now, it will happen next frame
+					//if you really need to, you can uncomment next 3 lines. Note that is uses zero restitution.
+					//btScalar appliedImpulse = 0.f;
+					//btScalar depth = 0.f;
+					//appliedImpulse = resolveSingleCollision(body,(btCollisionObject*)sweepResults.m_hitCollisionObject,sweepResults.m_hitPointWorld,sweepResults.m_hitNormalWorld,getSolverInfo(), depth);
 
 
 #endif
 
-        				continue;
-					}
+					return true;
 				}
 			}
+		}
 
+		return true;
+	}
 
-			body->proceedToTransform( predictedTrans);
+	return false;
+}
 
+void	btDiscreteDynamicsWorld::integrateTransforms(btScalar timeStep)
+{
+	BT_PROFILE("integrateTransforms");
+	btTransform predictedTrans;
+	for ( int i=0;i<m_nonStaticRigidBodies.size();i++)
+	{
+		btRigidBody* body = m_nonStaticRigidBodies[i];
+		if (integrateSingleTransform(body, timeStep, predictedTrans))
+		{
+			body->proceedToTransform( predictedTrans);
 		}
-
 	}
 
+	applySpeculativeContactRestitution();
+}
+
+void	btDiscreteDynamicsWorld::applySpeculativeContactRestitution()
+{
 	///this should probably be switched on by default, but it is not well tested yet
 	if (m_applySpeculativeContactRestitution)
 	{
@@ -0,0 +1,142 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef BT_DISCRETE_DYNAMICS_WORLD_MT_H
+#define BT_DISCRETE_DYNAMICS_WORLD_MT_H
+
+#include "btDiscreteDynamicsWorld.h"
+#include "btSimulationIslandManagerMt.h"
+#include "BulletDynamics/ConstraintSolver/btConstraintSolver.h"
+#include "LinearMath/btThreads.h"
+
+struct btSolverIslandCallbackMt;
+
+///
+/// btConstraintSolverPoolMt - masquerades as a constraint solver, but really it is a threadsafe pool of them.
+///
+///  Each solver in the pool is protected by a mutex.  When solveGroup is called from a thread,
+///  the pool looks for a solver that isn't being used by another thread, locks it, and dispatches the
+///  call to the solver.
+///  So long as the number of solvers in the pool exceeds the number of threads, this should never
+///  cause a thread to block.
+///
+ATTRIBUTE_ALIGNED16(class) btConstraintSolverPoolMt : public btConstraintSolver
+{
+public:
+	// create the solvers for me
+	explicit btConstraintSolverPoolMt( int numSolvers );
+
+	// pass in fully constructed solvers (destructor will delete them)
+	btConstraintSolverPoolMt( btConstraintSolver** solvers, int numSolvers );
+
+	virtual ~btConstraintSolverPoolMt();
+
+	///solve a group of constraints
+	virtual btScalar solveGroup( btCollisionObject** bodies,
+								 int numBodies,
+								 btPersistentManifold** manifolds,
+								 int numManifolds,
+								 btTypedConstraint** constraints,
+								 int numConstraints,
+								 const btContactSolverInfo& info,
+								 btIDebugDraw* debugDrawer,
+								 btDispatcher* dispatcher
+								 ) BT_OVERRIDE;
+
+	virtual void reset() BT_OVERRIDE;
+	virtual btConstraintSolverType getSolverType() const BT_OVERRIDE { return m_solverType; }
+
+private:
+	const static size_t kCacheLineSize = 128;
+	struct ThreadSolver
+	{
+		btConstraintSolver* solver;
+		btSpinMutex mutex;
+		char _cachelinePadding[ kCacheLineSize - sizeof( btSpinMutex ) - sizeof( void* ) ];  // keep mutexes from sharing a cache line
+	};
+	btAlignedObjectArray<ThreadSolver> m_solvers;
+	btConstraintSolverType m_solverType;
+
+	ThreadSolver* getAndLockThreadSolver();
+	void init( btConstraintSolver** solvers, int numSolvers );
+};
+
+
+
+///
+/// btDiscreteDynamicsWorldMt -- a version of DiscreteDynamicsWorld with some minor changes to support
+///                              solving simulation islands on multiple threads.
+///
+///  Should function exactly like btDiscreteDynamicsWorld.
+///  Constraints are solved per island by btSimulationIslandManagerMt, each island on whichever
+///  solver of the btConstraintSolverPoolMt is free. Set a task scheduler with btSetTaskScheduler()
+///  before stepping the world.
+///
+///  Optionally a second solver (e.g. btSequentialImpulseConstraintSolverMt) can be passed in for
+///  islands too large to balance across threads on their own. Those islands are solved one at a time
+///  on the stepping thread, and that solver spreads each of them over all threads.
+///
+///  The per-body passes (velocity prediction, integration, AABB update, motion state sync) run as
+///  parallel-for loops over the bodies, so motion states must tolerate setWorldTransform being
+///  called from several threads at once for different bodies.
+///
+ATTRIBUTE_ALIGNED16(class) btDiscreteDynamicsWorldMt : public btDiscreteDynamicsWorld
+{
+protected:
+	btSolverIslandCallbackMt* m_solverIslandCallbackMt;
+	btConstraintSolver* m_largeIslandSolver;
+
+	struct AabbUpdate
+	{
+		btVector3 m_aabbMin;
+		btVector3 m_aabbMax;
+		bool m_needsUpdate;
+	};
+	// one entry per collision object, filled in parallel and handed to the broadphase afterwards
+	btAlignedObjectArray<AabbUpdate> m_aabbUpdates;
+	// end of step transforms of m_nonStaticRigidBodies, used when CCD is on
+	btAlignedObjectArray<btTransform> m_integratedTransforms;
+
+	// parallel-for bodies of the per-body passes
+	struct UpdaterUnconstraintMotion;
+	struct UpdaterIntegrateTransforms;
+	struct UpdaterProceedToTransforms;
+	struct UpdaterComputeAabbs;
+	struct UpdaterSynchronizeMotionStates;
+
+	virtual void solveConstraints(btContactSolverInfo& solverInfo) BT_OVERRIDE;
+	virtual void predictUnconstraintMotion(btScalar timeStep) BT_OVERRIDE;
+	virtual void integrateTransforms(btScalar timeStep) BT_OVERRIDE;
+
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btDiscreteDynamicsWorldMt(btDispatcher* dispatcher,
+		btBroadphaseInterface* pairCache,
+		btConstraintSolverPoolMt* constraintSolver, // Note this should be a solver-pool for multi-threading
+		btCollisionConfiguration* collisionConfiguration,
+		btConstraintSolver* largeIslandSolver = NULL // solves islands with many manifolds, not owned by the world
+	);
+	virtual ~btDiscreteDynamicsWorldMt();
+
+	virtual void updateAabbs() BT_OVERRIDE;
+	virtual void synchronizeMotionStates() BT_OVERRIDE;
+
+	///sets the number of worker threads of the current task scheduler
+	virtual void setNumTasks(int numTasks) BT_OVERRIDE;
+};
+
+#endif //BT_DISCRETE_DYNAMICS_WORLD_MT_H
@@ -0,0 +1,525 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btDefaultSoftBodySolverMt.h"
+
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "LinearMath/btQuickprof.h"
+
+
+int btDefaultSoftBodySolverMt::s_minimumLinksForBatching = 4096;
+int btDefaultSoftBodySolverMt::s_minBatchSize = 256;
+
+// a node can be in at most this many batches, links beyond that go to the serial batch
+static const int kMaxBatches = 64;
+
+
+btDefaultSoftBodySolverMt::btDefaultSoftBodySolverMt()
+{
+}
+
+
+btDefaultSoftBodySolverMt::~btDefaultSoftBodySolverMt()
+{
+}
+
+
+void btDefaultSoftBodySolverMt::optimize( btAlignedObjectArray< btSoftBody * > &softBodies, bool forceUpdate )
+{
+	bool changed = forceUpdate || softBodies.size() != m_softBodySet.size();
+	for ( int i = 0; i < softBodies.size() && !changed; ++i )
+	{
+		changed = softBodies[ i ] != m_softBodySet[ i ];
+	}
+	btDefaultSoftBodySolver::optimize( softBodies, forceUpdate );
+	if ( changed )
+	{
+		// rebuilt on demand, see solveConstraints
+		m_linkBatches.resize( m_softBodySet.size() );
+		for ( int i = 0; i < m_linkBatches.size(); ++i )
+		{
+			m_linkBatches[ i ].m_numLinks = -1;
+		}
+	}
+}
+
+
+struct btDefaultSoftBodySolverMt::BodyLoop : public btIParallelForBody
+{
+	enum Step
+	{
+		STEP_PREDICT,
+		STEP_SOLVE,
+		STEP_INTEGRATE
+	};
+
+	btSoftBody* const* m_bodies;
+	Step m_step;
+	btScalar m_timeStep;
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btSoftBody* psb = m_bodies[ i ];
+			switch ( m_step )
+			{
+			case STEP_PREDICT:
+				// the broadphase isn't thread safe, the aabbs are updated afterwards
+				psb->predictMotion( m_timeStep, false );
+				break;
+			case STEP_SOLVE:
+				psb->solveConstraints();
+				break;
+			case STEP_INTEGRATE:
+				psb->integrateMotion();
+				break;
+			}
+		}
+	}
+};
+
+
+void btDefaultSoftBodySolverMt::predictMotion( float timeStep )
+{
+	BT_PROFILE( "predictMotionSoftBodyMt" );
+	m_activeBodies.resize( 0 );
+	for ( int i = 0; i < m_softBodySet.size(); ++i )
+	{
+		if ( m_softBodySet[ i ]->isActive() )
+		{
+			m_activeBodies.push_back( m_softBodySet[ i ] );
+		}
+	}
+	if ( m_activeBodies.size() == 0 )
+	{
+		return;
+	}
+
+	BodyLoop loop;
+	loop.m_bodies = &m_activeBodies[ 0 ];
+	loop.m_step = BodyLoop::STEP_PREDICT;
+	loop.m_timeStep = timeStep;
+	btParallelFor( 0, m_activeBodies.size(), 1, loop );
+	for ( int i = 0; i < m_activeBodies.size(); ++i )
+	{
+		m_activeBodies[ i ]->updateBroadphaseAabb();
+	}
+}
+
+
+void btDefaultSoftBodySolverMt::updateSoftBodies()
+{
+	BT_PROFILE( "updateSoftBodiesMt" );
+	m_activeBodies.resize( 0 );
+	for ( int i = 0; i < m_softBodySet.size(); ++i )
+	{
+		if ( m_softBodySet[ i ]->isActive() )
+		{
+			m_activeBodies.push_back( m_softBodySet[ i ] );
+		}
+	}
+	if ( m_activeBodies.size() == 0 )
+	{
+		return;
+	}
+
+	BodyLoop loop;
+	loop.m_bodies = &m_activeBodies[ 0 ];
+	loop.m_step = BodyLoop::STEP_INTEGRATE;
+	loop.m_timeStep = 0;
+	btParallelFor( 0, m_activeBodies.size(), 1, loop );
+}
+
+
+bool btDefaultSoftBodySolverMt::needsSerialSolve( const btSoftBody* psb ) const
+{
+	// anchors push on their rigid body, soft contacts on the nodes of the other soft body
+	if ( psb->m_anchors.size() > 0 || psb->m_scontacts.size() > 0 )
+	{
+		return true;
+	}
+	// contacts only push on dynamic rigid bodies, static and kinematic ones are just read
+	for ( int i = 0; i < psb->m_rcontacts.size(); ++i )
+	{
+		const btRigidBody* body = btRigidBody::upcast( psb->m_rcontacts[ i ].m_cti.m_colObj );
+		if ( body && body->getInvMass() != btScalar( 0 ) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void btDefaultSoftBodySolverMt::solveConstraints( float solverdt )
+{
+	BT_PROFILE( "solveConstraintsSoftBodyMt" );
+	m_parallelBodies.resize( 0 );
+	m_serialBodies.resize( 0 );
+	m_batchedBodies.resize( 0 );
+	for ( int i = 0; i < m_softBodySet.size(); ++i )
+	{
+		btSoftBody* psb = m_softBodySet[ i ];
+		if ( psb->isActive() )
+		{
+			if ( needsSerialSolve( psb ) )
+			{
+				m_serialBodies.push_back( psb );
+			}
+			else
+			{
+				m_parallelBodies.push_back( psb );
+			}
+		}
+	}
+
+	// with enough bodies to go round, every thread just gets whole bodies
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	const int numThreads = scheduler ? scheduler->getNumThreads() : 1;
+	if ( numThreads > 1 && m_parallelBodies.size() < numThreads && !btThreadsAreRunning() )
+	{
+		int numParallel = 0;
+		for ( int i = 0; i < m_softBodySet.size(); ++i )
+		{
+			btSoftBody* psb = m_softBodySet[ i ];
+			if ( m_parallelBodies.findLinearSearch( psb ) == m_parallelBodies.size() )
+			{
+				continue;
+			}
+			if ( psb->m_links.size() >= s_minimumLinksForBatching )
+			{
+				m_batchedBodies.push_back( i );
+			}
+			else
+			{
+				m_parallelBodies[ numParallel++ ] = psb;
+			}
+		}
+		m_parallelBodies.resize( numParallel );
+	}
+
+	for ( int i = 0; i < m_batchedBodies.size(); ++i )
+	{
+		btSoftBody* psb = m_softBodySet[ m_batchedBodies[ i ] ];
+		btLinkBatches& batches = m_linkBatches[ m_batchedBodies[ i ] ];
+		if ( batches.m_numLinks != psb->m_links.size() )
+		{
+			BT_PROFILE( "buildLinkBatches" );
+			buildLinkBatches( &batches, psb );
+		}
+		solveBatched( psb, batches );
+	}
+
+	if ( m_parallelBodies.size() > 0 )
+	{
+		BodyLoop loop;
+		loop.m_bodies = &m_parallelBodies[ 0 ];
+		loop.m_step = BodyLoop::STEP_SOLVE;
+		loop.m_timeStep = solverdt;
+		btParallelFor( 0, m_parallelBodies.size(), 1, loop );
+	}
+
+	for ( int i = 0; i < m_serialBodies.size(); ++i )
+	{
+		m_serialBodies[ i ]->solveConstraints();
+	}
+}
+
+
+void btDefaultSoftBodySolverMt::buildLinkBatches( btLinkBatches* batches, btSoftBody* psb )
+{
+	const int numLinks = psb->m_links.size();
+	const int numNodes = psb->m_nodes.size();
+	const btSoftBody::Node* nodes = numNodes ? &psb->m_nodes[ 0 ] : NULL;
+
+	m_nodeBatchMasks.resizeNoInitialize( numNodes );
+	for ( int i = 0; i < numNodes; ++i )
+	{
+		m_nodeBatchMasks[ i ] = 0;
+	}
+	m_linkBatchIds.resizeNoInitialize( numLinks );
+
+	// greedy coloring in link order: each link goes into the first batch neither of its nodes is in yet
+	int batchSizes[ kMaxBatches + 1 ];
+	for ( int i = 0; i <= kMaxBatches; ++i )
+	{
+		batchSizes[ i ] = 0;
+	}
+	int numBatches = 0;
+	for ( int i = 0; i < numLinks; ++i )
+	{
+		const btSoftBody::Link& link = psb->m_links[ i ];
+		const int nodeA = int( link.m_n[ 0 ] - nodes );
+		const int nodeB = int( link.m_n[ 1 ] - nodes );
+		const unsigned long long used = m_nodeBatchMasks[ nodeA ] | m_nodeBatchMasks[ nodeB ];
+
+		int batch = 0;
+		while ( batch < kMaxBatches && ( used & ( 1ULL << batch ) ) )
+		{
+			++batch;
+		}
+		if ( batch < kMaxBatches )
+		{
+			m_nodeBatchMasks[ nodeA ] |= 1ULL << batch;
+			m_nodeBatchMasks[ nodeB ] |= 1ULL << batch;
+			numBatches = btMax( numBatches, batch + 1 );
+		}
+		m_linkBatchIds[ i ] = batch;
+		batchSizes[ batch ]++;
+	}
+
+	// counting sort by batch, keeps link order within a batch. the serial batch goes last.
+	batches->m_serialBatch = -1;
+	if ( batchSizes[ kMaxBatches ] > 0 )
+	{
+		batches->m_serialBatch = numBatches;
+		batchSizes[ numBatches ] = batchSizes[ kMaxBatches ];
+		for ( int i = 0; i < numLinks; ++i )
+		{
+			if ( m_linkBatchIds[ i ] == kMaxBatches )
+			{
+				m_linkBatchIds[ i ] = numBatches;
+			}
+		}
+		numBatches++;
+	}
+
+	batches->m_batchStarts.resizeNoInitialize( numBatches + 1 );
+	int start = 0;
+	for ( int i = 0; i < numBatches; ++i )
+	{
+		batches->m_batchStarts[ i ] = start;
+		start += batchSizes[ i ];
+		batchSizes[ i ] = batches->m_batchStarts[ i ];
+	}
+	batches->m_batchStarts[ numBatches ] = start;
+
+	batches->m_links.resizeNoInitialize( numLinks );
+	for ( int i = 0; i < numLinks; ++i )
+	{
+		batches->m_links[ batchSizes[ m_linkBatchIds[ i ] ]++ ] = i;
+	}
+	batches->m_numLinks = numLinks;
+}
+
+
+struct btDefaultSoftBodySolverMt::BatchLoop : public btIParallelForBody
+{
+	const btDefaultSoftBodySolverMt* m_solver;
+	btSoftBody* m_body;
+	const int* m_links;
+	Pass m_pass;
+	btScalar m_param;
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		m_solver->runPassRange( m_pass, m_body, m_links, iBegin, iEnd, m_param );
+	}
+};
+
+
+void btDefaultSoftBodySolverMt::runPassRange( Pass pass, btSoftBody* psb, const int* links, int iBegin, int iEnd, btScalar param ) const
+{
+	// the link passes are btSoftBody::PSolve_Links and VSolve_Links for the links in links[iBegin..iEnd-1],
+	// the node passes are the loops over all nodes in btSoftBody::solveConstraints
+	const btScalar kst = param;
+	switch ( pass )
+	{
+	case PASS_PREPARE_LINKS:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btSoftBody::Link& l = psb->m_links[ i ];
+			l.m_c3 = l.m_n[ 1 ]->m_q - l.m_n[ 0 ]->m_q;
+			l.m_c2 = 1 / ( l.m_c3.length2() * l.m_c0 );
+		}
+		break;
+
+	case PASS_VELOCITY_LINKS:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btSoftBody::Link& l = psb->m_links[ links[ i ] ];
+			btSoftBody::Node** n = l.m_n;
+			const btScalar j = -btDot( l.m_c3, n[ 0 ]->m_v - n[ 1 ]->m_v ) * l.m_c2 * kst;
+			n[ 0 ]->m_v += l.m_c3 * ( j * n[ 0 ]->m_im );
+			n[ 1 ]->m_v -= l.m_c3 * ( j * n[ 1 ]->m_im );
+		}
+		break;
+
+	case PASS_POSITION_LINKS:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btSoftBody::Link& l = psb->m_links[ links[ i ] ];
+			if ( l.m_c0 > 0 )
+			{
+				btSoftBody::Node& a = *l.m_n[ 0 ];
+				btSoftBody::Node& b = *l.m_n[ 1 ];
+				const btVector3 del = b.m_x - a.m_x;
+				const btScalar len = del.length2();
+				if ( l.m_c1 + len > SIMD_EPSILON )
+				{
+					const btScalar k = ( ( l.m_c1 - len ) / ( l.m_c0 * ( l.m_c1 + len ) ) ) * kst;
+					a.m_x -= del * ( k * a.m_im );
+					b.m_x += del * ( k * b.m_im );
+				}
+			}
+		}
+		break;
+
+	case PASS_INTEGRATE:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btSoftBody::Node& n = psb->m_nodes[ i ];
+			n.m_x = n.m_q + n.m_v * psb->m_sst.sdt;
+		}
+		break;
+
+	case PASS_VELOCITIES:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btSoftBody::Node& n = psb->m_nodes[ i ];
+			n.m_v = ( n.m_x - n.m_q ) * param;
+			n.m_f = btVector3( 0, 0, 0 );
+		}
+		break;
+
+	case PASS_STORE_POSITIONS:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btSoftBody::Node& n = psb->m_nodes[ i ];
+			n.m_q = n.m_x;
+		}
+		break;
+
+	case PASS_DRIFT:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btSoftBody::Node& n = psb->m_nodes[ i ];
+			n.m_v += ( n.m_x - n.m_q ) * param;
+		}
+		break;
+	}
+}
+
+
+void btDefaultSoftBodySolverMt::runPass( Pass pass, btSoftBody* psb, const btLinkBatches& batches, btScalar param )
+{
+	BatchLoop loop;
+	loop.m_solver = this;
+	loop.m_body = psb;
+	loop.m_links = batches.m_links.size() ? &batches.m_links[ 0 ] : NULL;
+	loop.m_pass = pass;
+	loop.m_param = param;
+
+	if ( pass == PASS_VELOCITY_LINKS || pass == PASS_POSITION_LINKS )
+	{
+		// each batch has to be finished before the next one starts, the links in a batch are independent
+		for ( int i = 0; i < batches.getNumBatches(); ++i )
+		{
+			const int iBegin = batches.m_batchStarts[ i ];
+			const int iEnd = batches.m_batchStarts[ i + 1 ];
+			if ( i == batches.m_serialBatch )
+			{
+				runPassRange( pass, psb, loop.m_links, iBegin, iEnd, param );
+			}
+			else
+			{
+				btParallelFor( iBegin, iEnd, s_minBatchSize, loop );
+			}
+		}
+	}
+	else if ( pass == PASS_PREPARE_LINKS )
+	{
+		btParallelFor( 0, psb->m_links.size(), s_minBatchSize, loop );
+	}
+	else
+	{
+		btParallelFor( 0, psb->m_nodes.size(), s_minBatchSize, loop );
+	}
+}
+
+
+void btDefaultSoftBodySolverMt::solveBatched( btSoftBody* psb, const btLinkBatches& batches )
+{
+	// same steps as btSoftBody::solveConstraints, with the link solvers and node loops spread over the threads.
+	// bodies with anchors are never batched, see needsSerialSolve.
+	btAssert( psb->m_anchors.size() == 0 );
+	const btSoftBody::Config& cfg = psb->m_cfg;
+
+	psb->applyClusters( false );
+	runPass( PASS_PREPARE_LINKS, psb, batches, 0 );
+
+	if ( cfg.viterations > 0 )
+	{
+		for ( int isolve = 0; isolve < cfg.viterations; ++isolve )
+		{
+			for ( int iseq = 0; iseq < cfg.m_vsequence.size(); ++iseq )
+			{
+				if ( cfg.m_vsequence[ iseq ] == btSoftBody::eVSolver::Linear )
+				{
+					runPass( PASS_VELOCITY_LINKS, psb, batches, 1 );
+				}
+				else
+				{
+					btSoftBody::getSolver( cfg.m_vsequence[ iseq ] )( psb, 1 );
+				}
+			}
+		}
+		runPass( PASS_INTEGRATE, psb, batches, 0 );
+	}
+
+	if ( cfg.piterations > 0 )
+	{
+		for ( int isolve = 0; isolve < cfg.piterations; ++isolve )
+		{
+			const btScalar ti = isolve / (btScalar) cfg.piterations;
+			for ( int iseq = 0; iseq < cfg.m_psequence.size(); ++iseq )
+			{
+				if ( cfg.m_psequence[ iseq ] == btSoftBody::ePSolver::Linear )
+				{
+					runPass( PASS_POSITION_LINKS, psb, batches, 1 );
+				}
+				else
+				{
+					btSoftBody::getSolver( cfg.m_psequence[ iseq ] )( psb, 1, ti );
+				}
+			}
+		}
+		runPass( PASS_VELOCITIES, psb, batches, psb->m_sst.isdt * ( 1 - cfg.kDP ) );
+	}
+
+	if ( cfg.diterations > 0 )
+	{
+		runPass( PASS_STORE_POSITIONS, psb, batches, 0 );
+		for ( int idrift = 0; idrift < cfg.diterations; ++idrift )
+		{
+			for ( int iseq = 0; iseq < cfg.m_dsequence.size(); ++iseq )
+			{
+				if ( cfg.m_dsequence[ iseq ] == btSoftBody::ePSolver::Linear )
+				{
+					runPass( PASS_POSITION_LINKS, psb, batches, 1 );
+				}
+				else
+				{
+					btSoftBody::getSolver( cfg.m_dsequence[ iseq ] )( psb, 1, 0 );
+				}
+			}
+		}
+		runPass( PASS_DRIFT, psb, batches, cfg.kVCF * psb->m_sst.isdt );
+	}
+
+	psb->dampClusters();
+	psb->applyClusters( true );
+}
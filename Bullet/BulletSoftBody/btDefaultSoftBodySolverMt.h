@@ -0,0 +1,101 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SOFT_BODY_DEFAULT_SOLVER_MT_H
+#define BT_SOFT_BODY_DEFAULT_SOLVER_MT_H
+
+#include "btDefaultSoftBodySolver.h"
+#include "btSoftBody.h"
+#include "LinearMath/btThreads.h"
+
+
+///
+/// btDefaultSoftBodySolverMt -- a btDefaultSoftBodySolver that runs on all threads of the task scheduler.
+///
+///  Motion prediction, constraint solving and the normal update run for several soft bodies at once.
+///  Bodies that push on rigid bodies (anchors, or contacts with a dynamic rigid body) or on other soft
+///  bodies are solved on the calling thread afterwards, since two of them could push on the same body.
+///
+///  When there are fewer bodies than threads, a body with at least s_minimumLinksForBatching links is
+///  spread over the threads instead: its links are split into batches in which no two links share a
+///  node, the batches are solved one after another and the links within a batch in parallel. This
+///  changes the order links are solved in, like btSoftBody::randomizeConstraints does.
+///
+///  The batches are built the first time a body is batched and rebuilt when its link count changes.
+///  Call optimize( bodies, true ) after reordering links, e.g. after randomizeConstraints.
+///
+class btDefaultSoftBodySolverMt : public btDefaultSoftBodySolver
+{
+public:
+	///bodies with fewer links are never split over threads
+	static int s_minimumLinksForBatching;
+	///minimum number of links or nodes per parallel-for job
+	static int s_minBatchSize;
+
+	btDefaultSoftBodySolverMt();
+	virtual ~btDefaultSoftBodySolverMt();
+
+	virtual void optimize( btAlignedObjectArray< btSoftBody * > &softBodies, bool forceUpdate = false ) BT_OVERRIDE;
+	virtual void predictMotion( float solverdt ) BT_OVERRIDE;
+	virtual void solveConstraints( float solverdt ) BT_OVERRIDE;
+	virtual void updateSoftBodies() BT_OVERRIDE;
+
+protected:
+	///links of one soft body grouped into batches without shared nodes
+	struct btLinkBatches
+	{
+		btAlignedObjectArray<int> m_links;			// link indices, by batch, in link order within a batch
+		btAlignedObjectArray<int> m_batchStarts;	// batch i is m_links[m_batchStarts[i]] .. m_links[m_batchStarts[i+1]-1]
+		int m_serialBatch;							// links that didn't fit any batch, solved on one thread (-1 if none)
+		int m_numLinks;								// link count the batches were built for, -1 if not built
+
+		int getNumBatches() const
+		{
+			return m_batchStarts.size() > 0 ? m_batchStarts.size() - 1 : 0;
+		}
+	};
+
+	enum Pass
+	{
+		PASS_PREPARE_LINKS,		// link gradients for the velocity solver
+		PASS_VELOCITY_LINKS,	// VSolve_Links
+		PASS_POSITION_LINKS,	// PSolve_Links
+		PASS_INTEGRATE,			// positions from the solved velocities
+		PASS_VELOCITIES,		// velocities from the solved positions
+		PASS_STORE_POSITIONS,	// start of the drift solve
+		PASS_DRIFT				// velocity correction after the drift solve
+	};
+
+	struct BodyLoop;
+	struct BatchLoop;
+
+	// per body of m_softBodySet
+	btAlignedObjectArray<btLinkBatches> m_linkBatches;
+	btAlignedObjectArray<btSoftBody*> m_activeBodies;
+	btAlignedObjectArray<btSoftBody*> m_parallelBodies;
+	btAlignedObjectArray<btSoftBody*> m_serialBodies;
+	btAlignedObjectArray<int> m_batchedBodies;	// indices into m_softBodySet
+	// per node, the batches it is already used in
+	btAlignedObjectArray<unsigned long long> m_nodeBatchMasks;
+	btAlignedObjectArray<int> m_linkBatchIds;
+
+	bool needsSerialSolve( const btSoftBody* psb ) const;
+	void buildLinkBatches( btLinkBatches* batches, btSoftBody* psb );
+	void solveBatched( btSoftBody* psb, const btLinkBatches& batches );
+	void runPass( Pass pass, btSoftBody* psb, const btLinkBatches& batches, btScalar param );
+	void runPassRange( Pass pass, btSoftBody* psb, const int* links, int iBegin, int iEnd, btScalar param ) const;
+};
+
+#endif //BT_SOFT_BODY_DEFAULT_SOLVER_MT_H
@@ -1736,7 +1736,7 @@ void			btSoftBody::setSolver(eSolverPresets::_ preset)
 }
 
 //
-void			btSoftBody::predictMotion(btScalar dt)
+void			btSoftBody::predictMotion(btScalar dt,bool updateBroadphase)
 {
 
 	int i,ni;
@@ -1790,7 +1790,7 @@ void			btSoftBody::predictMotion(btScalar dt)
 	/* Clusters				*/ 
 	updateClusters();
 	/* Bounds				*/ 
-	updateBounds();	
+	updateBounds(updateBroadphase);	
 	/* Nodes				*/ 
 	ATTRIBUTE_ALIGNED16(btDbvtVolume)	vol;
 	for(i=0,ni=m_nodes.size();i<ni;++i)
@@ -2301,7 +2301,7 @@ void					btSoftBody::updateNormals()
 }
 
 //
-void					btSoftBody::updateBounds()
+void					btSoftBody::updateBounds(bool updateBroadphase)
 {
 	/*if( m_acceleratedSoftBody )
 	{
@@ -2325,12 +2325,9 @@ void					btSoftBody::updateBounds()
 				csm)*1; // ??? to investigate...
 			m_bounds[0]=mins-mrg;
 			m_bounds[1]=maxs+mrg;
-			if(0!=getBroadphaseHandle())
-			{					
-				m_worldInfo->m_broadphase->setAabb(	getBroadphaseHandle(),
-					m_bounds[0],
-					m_bounds[1],
-					m_worldInfo->m_dispatcher);
+			if(updateBroadphase)
+			{
+				updateBroadphaseAabb();
 			}
 		}
 		else
@@ -2341,6 +2338,18 @@ void					btSoftBody::updateBounds()
 	//}
 }
 
+//
+void					btSoftBody::updateBroadphaseAabb()
+{
+	if(m_ndbvt.m_root&&(0!=getBroadphaseHandle()))
+	{					
+		m_worldInfo->m_broadphase->setAabb(	getBroadphaseHandle(),
+			m_bounds[0],
+			m_bounds[1],
+			m_worldInfo->m_dispatcher);
+	}
+}
+
 
 //
 void					btSoftBody::updatePose()
@@ -0,0 +1,357 @@
+/*
+Copyright (c) 2003-2014 Erwin Coumans  http://bullet.googlecode.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btThreads.h"
+#include "btQuickprof.h"
+
+//
+// Lightweight spin-mutex based on atomics
+// Using ordinary system-provided mutexes like Windows critical sections was noticeably slower
+// presumably because when it fails to lock at first it would sleep the thread and trigger costly
+// context switching.
+//
+
+#if BT_THREADSAFE
+
+#if defined( _MSC_VER )
+
+#include <intrin.h>
+
+#define THREAD_LOCAL_STATIC __declspec( thread ) static
+
+
+bool btSpinMutex::tryLock()
+{
+	volatile long* aDest = reinterpret_cast<long*>(&mLock);
+	return ( 0 == _InterlockedCompareExchange( aDest, 1, 0) );
+}
+
+void btSpinMutex::lock()
+{
+	// note: this lock does not sleep the thread.
+	while (! tryLock())
+	{
+		// spin
+	}
+}
+
+void btSpinMutex::unlock()
+{
+	volatile long* aDest = reinterpret_cast<long*>( &mLock );
+	_InterlockedExchange( aDest, 0 );
+}
+
+#elif defined( __GNUC__ )
+
+#define THREAD_LOCAL_STATIC static __thread
+
+
+bool btSpinMutex::tryLock()
+{
+	int expected = 0;
+	bool weak = false;
+	const int memOrderSuccess = __ATOMIC_ACQ_REL;
+	const int memOrderFail = __ATOMIC_ACQUIRE;
+	return __atomic_compare_exchange_n(&mLock, &expected, int(1), weak, memOrderSuccess, memOrderFail);
+}
+
+void btSpinMutex::lock()
+{
+	// note: this lock does not sleep the thread
+	while (! tryLock())
+	{
+		// spin
+	}
+}
+
+void btSpinMutex::unlock()
+{
+	__atomic_store_n(&mLock, int(0), __ATOMIC_RELEASE);
+}
+
+#else //#elif USE_MSVC_INTRINSICS
+
+#error "no threading primitives defined -- unknown platform"
+
+#endif  //#else //#elif USE_MSVC_INTRINSICS
+
+#else //#if BT_THREADSAFE
+
+// These should not be called ever
+void btSpinMutex::lock()
+{
+	btAssert( !"unimplemented btSpinMutex::lock() called" );
+}
+
+void btSpinMutex::unlock()
+{
+	btAssert( !"unimplemented btSpinMutex::unlock() called" );
+}
+
+bool btSpinMutex::tryLock()
+{
+	btAssert( !"unimplemented btSpinMutex::tryLock() called" );
+	return true;
+}
+
+#define THREAD_LOCAL_STATIC static
+
+#endif // #else //#if BT_THREADSAFE
+
+
+struct ThreadsafeCounter
+{
+	unsigned int mCounter;
+	btSpinMutex mMutex;
+
+	ThreadsafeCounter()
+	{
+		mCounter = 0;
+		--mCounter; // first count should come back 0
+	}
+
+	unsigned int getNext()
+	{
+		// no need to optimize this with atomics, it is only called ONCE per thread!
+		mMutex.lock();
+		mCounter++;
+		if ( mCounter >= BT_MAX_THREAD_COUNT )
+		{
+			btAssert( !"thread counter exceeded" );
+			// wrap back to the first worker index
+			mCounter = 1;
+		}
+		unsigned int val = mCounter;
+		mMutex.unlock();
+		return val;
+	}
+};
+
+
+static btITaskScheduler* gBtTaskScheduler;
+static int gThreadsRunningCounter = 0;  // useful for detecting if we are trying to do nested parallel-for calls
+static btSpinMutex gThreadsRunningCounterMutex;
+static ThreadsafeCounter gThreadCounter;
+
+
+//
+// BT_DETECT_BAD_THREAD_INDEX tries to detect when there are multiple threads assigned the same thread index.
+//
+// BT_DETECT_BAD_THREAD_INDEX is a developer option to test if
+// certain assumptions about how the task scheduler manages its threads
+// holds true.
+// The main assumption is:
+//   - when the threadpool is resized, the task scheduler either
+//      1. destroys all worker threads and creates all new ones in the correct number, OR
+//      2. never destroys a worker thread
+//
+// We make that assumption because we can't easily enumerate the worker threads of a task scheduler
+// to assign nice sequential thread-indexes. We also do not get notified if a worker thread is destroyed,
+// so we can't tell when a thread-index is no longer being used.
+// We allocate thread-indexes as needed with a sequential global thread counter.
+//
+// Our simple thread-counting scheme falls apart if the task scheduler destroys some threads but
+// continues to re-use other threads and the application repeatedly resizes the thread pool of the
+// task scheduler.
+// In order to prevent the thread-counter from exceeding the global max (BT_MAX_THREAD_COUNT), we
+// wrap the thread counter back to 1. This should only happen if the worker threads have all been
+// destroyed and re-created.
+//
+// BT_DETECT_BAD_THREAD_INDEX only works for Win32 right now,
+// but could be adapted to work with pthreads
+#define BT_DETECT_BAD_THREAD_INDEX 0
+
+#if BT_DETECT_BAD_THREAD_INDEX
+
+typedef DWORD ThreadId_t;
+const static ThreadId_t kInvalidThreadId = 0;
+ThreadId_t gDebugThreadIds[ BT_MAX_THREAD_COUNT ];
+
+static ThreadId_t getDebugThreadId()
+{
+	return GetCurrentThreadId();
+}
+
+#endif // #if BT_DETECT_BAD_THREAD_INDEX
+
+
+// return a unique index per thread, main thread is 0, worker threads are in [1, BT_MAX_THREAD_COUNT)
+unsigned int btGetCurrentThreadIndex()
+{
+	const unsigned int kNullIndex = ~0U;
+	THREAD_LOCAL_STATIC unsigned int sThreadIndex = kNullIndex;
+	if ( sThreadIndex == kNullIndex )
+	{
+		sThreadIndex = gThreadCounter.getNext();
+		btAssert( sThreadIndex < BT_MAX_THREAD_COUNT );
+	}
+#if BT_DETECT_BAD_THREAD_INDEX
+	if ( gBtTaskScheduler && sThreadIndex > 0 )
+	{
+		ThreadId_t tid = getDebugThreadId();
+		// if not set
+		if ( gDebugThreadIds[ sThreadIndex ] == kInvalidThreadId )
+		{
+			// set it
+			gDebugThreadIds[ sThreadIndex ] = tid;
+		}
+		else
+		{
+			if ( gDebugThreadIds[ sThreadIndex ] != tid )
+			{
+				// this could indicate the task scheduler is breaking our assumptions about
+				// how threads are managed when threadpool is resized
+				btAssert( !"there are 2 or more threads with the same thread-index!" );
+				__debugbreak();
+			}
+		}
+	}
+#endif // #if BT_DETECT_BAD_THREAD_INDEX
+	return sThreadIndex;
+}
+
+bool btIsMainThread()
+{
+	return btGetCurrentThreadIndex() == 0;
+}
+
+void btResetThreadIndexCounter()
+{
+	// for when all current worker threads are destroyed
+	btAssert( btIsMainThread() );
+	gThreadCounter.mCounter = 0;
+}
+
+btITaskScheduler::btITaskScheduler( const char* name )
+{
+	m_name = name;
+	m_isActive = false;
+}
+
+void btITaskScheduler::activate()
+{
+	// thread indexes are handed out by gThreadCounter as threads first ask for one and are
+	// never reused, so worker threads keep their index when a scheduler is swapped back in.
+	// the main thread is always thread-index 0.
+	m_isActive = true;
+}
+
+void btITaskScheduler::deactivate()
+{
+	m_isActive = false;
+}
+
+void btPushThreadsAreRunning()
+{
+	gThreadsRunningCounterMutex.lock();
+	gThreadsRunningCounter++;
+	gThreadsRunningCounterMutex.unlock();
+}
+
+void btPopThreadsAreRunning()
+{
+	gThreadsRunningCounterMutex.lock();
+	gThreadsRunningCounter--;
+	gThreadsRunningCounterMutex.unlock();
+}
+
+bool btThreadsAreRunning()
+{
+	return gThreadsRunningCounter != 0;
+}
+
+
+void btSetTaskScheduler( btITaskScheduler* ts )
+{
+	int threadId = btGetCurrentThreadIndex();  // make sure we call this on main thread at least once before any workers run
+	if ( threadId != 0 )
+	{
+		btAssert( !"btSetTaskScheduler must be called from the main thread!" );
+		return;
+	}
+	if ( gBtTaskScheduler )
+	{
+		// deactivate old task scheduler
+		gBtTaskScheduler->deactivate();
+	}
+	gBtTaskScheduler = ts;
+	if ( ts )
+	{
+		// activate new task scheduler
+		ts->activate();
+	}
+}
+
+
+btITaskScheduler* btGetTaskScheduler()
+{
+	return gBtTaskScheduler;
+}
+
+
+void btParallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body )
+{
+#if BT_THREADSAFE
+
+#if BT_DETECT_BAD_THREAD_INDEX
+	if ( !btThreadsAreRunning() )
+	{
+		// clear out thread ids
+		for ( int i = 0; i < BT_MAX_THREAD_COUNT; ++i )
+		{
+			gDebugThreadIds[ i ] = kInvalidThreadId;
+		}
+	}
+#endif // #if BT_DETECT_BAD_THREAD_INDEX
+
+	btAssert( gBtTaskScheduler != NULL );  // call btSetTaskScheduler() with a valid task scheduler first!
+	gBtTaskScheduler->parallelFor( iBegin, iEnd, grainSize, body );
+
+#else // #if BT_THREADSAFE
+
+	// non-parallel version of btParallelFor
+	btAssert( !"called btParallelFor in non-threadsafe build. enable BT_THREADSAFE" );
+	body.forLoop( iBegin, iEnd );
+
+#endif// #if BT_THREADSAFE
+}
+
+
+///
+/// btTaskSchedulerSequential -- non-threaded implementation of task scheduler
+///                              (really just useful for testing performance of single threaded vs multi)
+///
+class btTaskSchedulerSequential : public btITaskScheduler
+{
+public:
+	btTaskSchedulerSequential() : btITaskScheduler( "Sequential" ) {}
+	virtual int getMaxNumThreads() const BT_OVERRIDE { return 1; }
+	virtual int getNumThreads() const BT_OVERRIDE { return 1; }
+	virtual void setNumThreads( int numThreads ) BT_OVERRIDE { (void)numThreads; }
+	virtual void parallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body ) BT_OVERRIDE
+	{
+		(void)grainSize;
+		BT_PROFILE( "parallelFor_sequential" );
+		body.forLoop( iBegin, iEnd );
+	}
+};
+
+
+// create a non-threaded task scheduler (always available)
+btITaskScheduler* btGetSequentialTaskScheduler()
+{
+	static btTaskSchedulerSequential sTaskScheduler;
+	return &sTaskScheduler;
+}
@@ -1,10 +1,14 @@
 #include "GameObject.h"
+#include "SceneGraph.h"
 #include "Math/matrix_util.h"
+#include "Memory/MemoryTracker.h"
+#include "Profiling/Profiler.h"
 #include <fstream>
 
+Pool<GameObject> GameObject::pool;
+
 GameObject::GameObject()
 {
-	mesh = nullptr;
 	translation = Vector3::Zero();
 	scale = Vector3::One();
 	rotation = Quaternion::Identity();
@@ -19,11 +23,38 @@ GameObject::GameObject(const GameObject &other)
 	matrix = other.matrix;
 }
 
+GameObject &GameObject::operator=(const GameObject &other)
+{
+	mesh = other.mesh;
+	translation = other.translation;
+	scale = other.scale;
+	rotation = other.rotation;
+	matrix = other.matrix;
+
+	if (scene != nullptr) {
+		scene->MarkDirty(sceneNode);
+	}
+	return *this;
+}
+
 GameObject::~GameObject()
 {
+	if (scene != nullptr) {
+		scene->Remove(*this);
+	}
 }
 
 void GameObject::UpdateMatrix()
+{
+	if (scene != nullptr) {
+		scene->MarkDirty(sceneNode);
+		return;
+	}
+
+	matrix = GetLocalMatrix();
+}
+
+Matrix4 GameObject::GetLocalMatrix() const
 {
 	// scale, rotation, translation
 	Matrix4 S, R, T;
@@ -32,22 +63,7 @@ void GameObject::UpdateMatrix()
 	MatrixUtil::ToTranslation(T, translation);
 	MatrixUtil::ToScaling(S, scale);
 
-	matrix = S * R * T;
-}
-
-Matrix4 GameObject::GetMatrix()
-{
-	return matrix;
-}
-
-std::shared_ptr<Mesh> GameObject::GetMesh()
-{
-	return mesh;
-}
-
-void GameObject::SetMesh(std::shared_ptr<Mesh> m)
-{
-	mesh = m;
+	return S * R * T;
 }
 
 void GameObject::Save(const std::string &filepath) const
@@ -87,7 +103,8 @@ void GameObject::Save(const std::string &filepath) const
 		file.write((char*)&scale.z, sizeof(scale.z));
 	}
 
-	if (mesh != nullptr) {
+	const Mesh *mesh_data = GetMesh();
+	if (mesh_data != nullptr) {
 		// save the mesh
 		
 		// save vertices. we have to write the MODEL_VERTICES flag along with the number of vertices.
@@ -95,10 +112,10 @@ void GameObject::Save(const std::string &filepath) const
 			int marker = BinaryModelFlags::MODEL_VERTICES;
 			file.write((char*)&marker, sizeof(marker));
 
-			int num_vertices = mesh->GetVertices().size();
+			int num_vertices = mesh_data->GetVertices().size();
 			file.write((char*)&num_vertices, sizeof(num_vertices));
 
-			auto &vertices = mesh->GetVertices();
+			auto &vertices = mesh_data->GetVertices();
 
 			// now, we write the actual vertex data.
 			for (int i = 0; i < num_vertices; i++) {
@@ -122,10 +139,10 @@ void GameObject::Save(const std::string &filepath) const
 			int marker = BinaryModelFlags::MODEL_INDICES;
 			file.write((char*)&marker, sizeof(marker));
 
-			int num_indices = mesh->GetIndices().size();
+			int num_indices = mesh_data->GetIndices().size();
 			file.write((char*)&num_indices, sizeof(num_indices));
 
-			auto &indices = mesh->GetIndices();
+			auto &indices = mesh_data->GetIndices();
 
 			// now, we write index to the file.
 			for (int i = 0; i < num_indices; i++) {
@@ -142,15 +159,19 @@ void GameObject::Save(const std::string &filepath) const
 	file.close();
 }
 
-std::shared_ptr<GameObject> GameObject::Load(const std::string &filepath)
+GameObjectHandle GameObject::Load(const std::string &filepath)
 {
+	PROFILE("GameObject::Load");
+	MemoryTagScope memory_tag(MemoryTag::Meshes);
+
 	std::ifstream file;
 	file.open(filepath, std::ios::in | std::ios::binary);
 	if (!file.is_open()) {
-		return nullptr;
+		return GameObjectHandle();
 	}
 
-	auto object = std::make_shared<GameObject>();
+	const GameObjectHandle handle = pool.Create();
+	GameObject *object = pool.Get(handle);
 
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
@@ -217,11 +238,12 @@ std::shared_ptr<GameObject> GameObject::Load(const std::string &filepath)
 
 	if (!indices.empty()) {
 		// vertices are not empty, add a mesh
-		object->SetMesh(std::make_shared<Mesh>(vertices, indices));
+		object->SetMesh(Mesh::pool.Create(vertices, indices));
+		object->GetMesh()->SetSourcePath(filepath);
 	}
 
 	// update loaded model's matrix
 	object->UpdateMatrix();
 
-	return object;
+	return handle;
 }
\ No newline at end of file
@@ -3,34 +3,64 @@
 #include "Math/quaternion.h"
 #include "Mesh.h"
 #include "BinaryModel.h"
+#include "Memory/Pool.h"
 
-#include <memory>
+#include <cstdint>
 #include <string>
 
+class GameObject;
+class SceneGraph;
+typedef Handle<GameObject> GameObjectHandle;
+
 class GameObject
 {
 public:
+	// every game object lives here
+	static Pool<GameObject> pool;
+
 	GameObject();
+	// the copy is in no scene graph
 	GameObject(const GameObject &other);
+	// copies the mesh and transform, the object stays where it is in its scene graph
+	GameObject &operator=(const GameObject &other);
+	// takes the object out of its scene graph
 	~GameObject();
 
+	// to be called after changing the translation, rotation or scale. recomputes the matrix right
+	// away, unless the object is in a scene graph: then it is only marked, and the graph updates
+	// its matrix and those of its children in SceneGraph::Update().
 	void UpdateMatrix();
-	Matrix4 GetMatrix();
+	// the world matrix
+	inline const Matrix4 &GetMatrix() const { return matrix; }
+	// the matrix relative to the parent, from the translation, rotation and scale
+	Matrix4 GetLocalMatrix() const;
+
+	// nullptr if the object is in no scene graph
+	inline SceneGraph *GetScene() const { return scene; }
 
-	std::shared_ptr<Mesh> GetMesh();
-	void SetMesh(std::shared_ptr<Mesh> mesh);
+	// nullptr without a mesh or once the mesh was destroyed
+	inline Mesh *GetMesh() const { return Mesh::pool.Get(mesh); }
+	inline MeshHandle GetMeshHandle() const { return mesh; }
+	inline void SetMesh(MeshHandle mesh) { this->mesh = mesh; }
 
 	// saves this game object to a binary file
 	void Save(const std::string &filepath) const;
-	// loads a game object from a binary file
-	static std::shared_ptr<GameObject> Load(const std::string &filepath);
+	// loads a game object from a binary file into the pool, along with its mesh. a null handle
+	// if the file can't be opened.
+	static GameObjectHandle Load(const std::string &filepath);
 
+	// relative to the parent in the scene graph, if any
 	Vector3 translation;
 	Vector3 scale;
 	Quaternion rotation;
 
 private:
+	friend class SceneGraph;
+
 	Matrix4 matrix;
-	std::shared_ptr<Mesh> mesh;
+	MeshHandle mesh;
+
+	SceneGraph *scene = nullptr;
+	uint32_t sceneNode = 0;
 };
 
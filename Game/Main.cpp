@@ -5,7 +5,6 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
-#include <chrono>
 
 #include "Mesh.h"
 #include "Shader.h"
@@ -22,92 +21,96 @@
 #include "Math/matrix_util.h"
 
 #include "PhysicsWorld.h"
+#include "PhysicsTaskScheduler.h"
+#include "Renderer.h"
+#include "SceneGraph.h"
+
+#include "Threading/JobSystem.h"
+
+#include "Memory/FrameAllocator.h"
+#include "Memory/HeapStats.h"
+#include "Memory/MemoryTracker.h"
+#include "Memory/MemoryWindow.h"
+
+#include "Profiling/Profiler.h"
+#include "Profiling/ProfilerWindow.h"
+#include "Profiling/GpuProfiler.h"
 
 // imgui
 #include <imgui.h>
 #include "imgui/imgui_impl_glfw_gl3.h"
 
 // holds a list of all objects in the game
-std::vector<std::shared_ptr<GameObject>> objects;
+std::vector<GameObjectHandle> objects;
+// the objects in view this frame, and which of the objects are
+std::vector<GameObject*> visible_objects;
+std::vector<char> visible_flags;
 
 Shader *my_shader = nullptr;
+Renderer *renderer = nullptr;
 InputManager *input_mgr = nullptr;
 Camera *camera = nullptr;
 PhysicsWorld *physics_world = nullptr;
+SceneGraph *scene_graph = nullptr;
+GpuProfiler *gpu_profiler = nullptr;
+JobSystem *job_system = nullptr;
+PhysicsTaskScheduler *physics_scheduler = nullptr;
 
 Color ambience;
 
 std::vector<PointLight> point_lights;
 
-void Update(const double delta_time)
+void Cull()
 {
-	// update physics
-	physics_world->Update(delta_time);
+	PROFILE("Cull");
 
-	// update the camera
-	camera->UpdateMouse(input_mgr, delta_time);
-	camera->UpdateMovement(input_mgr, delta_time);
-	camera->UpdateMatrices();
-}
+	visible_flags.resize(objects.size());
+	job_system->ParallelFor(0, objects.size(), 64, [](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const GameObject *object = GameObject::pool.Get(objects[i]);
+			visible_flags[i] = object != nullptr && renderer->IsVisible(*object);
+		}
+	});
 
-void Render()
-{
-	my_shader->Begin();
-	// set camera parameters
-	my_shader->SetUniformMatrix("u_viewMatrix", camera->GetViewMatrix());
-	my_shader->SetUniformMatrix("u_projMatrix", camera->GetProjectionMatrix());
-
-	// apply scene ambience color
-	my_shader->SetUniformVector4("u_ambientColor", ambience);
-
-	// set point lights
-	my_shader->SetUniformInt("u_numPointLights", point_lights.size());
-	for (int i = 0; i < point_lights.size() && i < 4; i++) {
-		my_shader->SetUniformVector3("u_pointLight[" + std::to_string(i) + "].position", point_lights[i].position);
-		my_shader->SetUniformVector4("u_pointLight[" + std::to_string(i) + "].color", point_lights[i].color);
+	visible_objects.clear();
+	for (size_t i = 0; i < objects.size(); i++) {
+		if (visible_flags[i]) {
+			visible_objects.push_back(GameObject::pool.Get(objects[i]));
+		}
 	}
+}
 
-	// set camera position
-	my_shader->SetUniformVector3("u_cameraPosition", camera->GetPosition());
-
-	// loop through all objects and draw each
-	for (auto &&obj : objects) {
-		if (obj->GetMesh() != nullptr) {
-			my_shader->SetUniformMatrix("u_modelMatrix", obj->GetMatrix());
-
-			// set material parameters
-			my_shader->SetUniformFloat("u_roughness", obj->GetMesh()->GetMaterial().GetRoughness());
-			my_shader->SetUniformFloat("u_shininess", obj->GetMesh()->GetMaterial().GetShininess());
-
-			const bool has_diffuse_map = obj->GetMesh()->GetMaterial().GetDiffuseMap() != nullptr;
+void Update(const double delta_time)
+{
+	PROFILE("Update");
 
-			if (has_diffuse_map) {
-				// this model has a diffuse texture
-				glActiveTexture(GL_TEXTURE0);
-				obj->GetMesh()->GetMaterial().GetDiffuseMap()->Bind();
-				my_shader->SetUniformInt("u_diffuseTexture", 0);
-				my_shader->SetUniformInt("u_hasTexture", true);
-			} else {
-				my_shader->SetUniformInt("u_hasTexture", false);
-			}
+	// the frame up to rendering is a small graph of jobs: the physics sync runs on a worker while
+	// this thread handles the camera (input has to stay on this thread), and culling starts once both are done
+	JobCounter updated, culled;
 
-			obj->GetMesh()->Draw();
+	// update physics, then the world matrices of what it moved and of everything attached to that
+	job_system->Run([delta_time]() {
+		physics_world->Update(delta_time);
+		scene_graph->Update(job_system);
+	}, &updated);
 
-			if (has_diffuse_map) {
-				obj->GetMesh()->GetMaterial().GetDiffuseMap()->Unbind();
-			}
-		}
-	}
+	// update the camera
+	camera->UpdateMouse(input_mgr, delta_time);
+	camera->UpdateMovement(input_mgr, delta_time);
+	camera->UpdateMatrices();
+	renderer->SetCamera(camera->GetViewMatrix(), camera->GetProjectionMatrix(), camera->GetPosition());
 
-	my_shader->End();
+	job_system->Run(&Cull, &culled, &updated);
+	job_system->Wait(culled);
 }
 
-std::shared_ptr<GameObject> LoadLandscape()
+void Render()
 {
-	auto landscape = GameObject::Load("landscape.m5m");
-	auto grass = std::make_shared<Texture>("textures/grass.jpg");
-	landscape->GetMesh()->GetMaterial().SetDiffuseMap(grass);
-	return landscape;
+	PROFILE("Render");
+	GPU_PROFILE(*gpu_profiler, "Scene");
+
+	renderer->SetAmbience(ambience);
+	renderer->Render(visible_objects, point_lights);
 }
 
 Shader *NewShader()
@@ -146,8 +149,27 @@ static void ErrorCallback(int error, const char *description)
 	std::cout << "Error: " << description << "\n";
 }
 
+static void *ImGuiAllocate(size_t size)
+{
+	return MemoryTracker::Allocate(size, alignof(std::max_align_t), MemoryTag::UI);
+}
+
+static void ImGuiFree(void *memory)
+{
+	MemoryTracker::Free(memory);
+}
+
 bool Run()
 {
+	// before anything allocates from bullet or imgui
+	MemoryTracker::Init();
+	ImGui::GetIO().MemAllocFn = ImGuiAllocate;
+	ImGui::GetIO().MemFreeFn = ImGuiFree;
+
+	Profiler::Init();
+	Profiler::SetThreadName("Main");
+	FrameAllocator::Init();
+
 	glfwSetErrorCallback(ErrorCallback);
 
 	if (!glfwInit()) {
@@ -169,11 +191,22 @@ bool Run()
 		throw std::exception("error initializing glew");
 	}
 
+	// times the render passes on the gpu where timer queries are available
+	gpu_profiler = new GpuProfiler();
+
 	// Setup ImGui binding
 	ImGui_ImplGlfwGL3_Init(window, false);
 
 
-	physics_world = new PhysicsWorld();
+	// one pool of worker threads for the whole engine, bullet included
+	job_system = new JobSystem();
+	physics_scheduler = new PhysicsTaskScheduler(job_system);
+
+	physics_world = new PhysicsWorld(false, physics_scheduler);
+	scene_graph = new SceneGraph();
+	physics_world->SetFixedTimeStep(60.0, 4);
+	// step physics on its own thread so it overlaps with rendering
+	physics_world->StartThread();
 
 	// initialize global input manager
 	input_mgr = new InputManager();
@@ -182,6 +215,7 @@ bool Run()
 	camera = new Camera(1080, 720);
 	// initialize main shader
 	my_shader = NewShader();
+	renderer = new Renderer(my_shader, job_system);
 	// initialize test texture
 	// set the scene's ambience color
 	ambience = Color(0.1, 0.25, 0.4, 1.0);
@@ -189,81 +223,102 @@ bool Run()
 	// default OBJ loader
 	ObjLoader loader;
 
+	// models and images are parsed and decoded on the workers all at once. textures and bodies are
+	// made afterwards on this thread, which owns the gl context, in a fixed order so the body ids
+	// don't depend on which load finished first.
+	MeshHandle box_mesh, monkey_mesh;
+	GameObjectHandle box2, monkey2, landscape;
+	std::unique_ptr<TextureImage> grass_image;
 	{
-		auto start = std::chrono::high_resolution_clock::now();
+		PROFILE_LOG("load assets");
+
+		JobCounter loaded;
+		job_system->Run([&]() {
+			PROFILE_LOG("load obj box");
+			// load a test obj model
+			box_mesh = loader.LoadMesh("models/pokestan.obj");
+		}, &loaded);
+		job_system->Run([&]() {
+			PROFILE_LOG("load m5m box");
+			box2 = GameObject::Load("duce.m5m");
+		}, &loaded);
+		job_system->Run([&]() {
+			PROFILE_LOG("load obj monkey");
+			monkey_mesh = loader.LoadMesh("models/monkow.obj");
+		}, &loaded);
+		job_system->Run([&]() {
+			PROFILE_LOG("load m5m monkey");
+			monkey2 = GameObject::Load("monkey.m5m");
+		}, &loaded);
+		job_system->Run([&]() {
+			PROFILE_LOG("load landscape");
+			landscape = GameObject::Load("landscape.m5m");
+		}, &loaded);
+		job_system->Run([&]() {
+			PROFILE_LOG("decode grass");
+			grass_image.reset(new TextureImage("textures/grass.jpg"));
+		}, &loaded);
+		job_system->Wait(loaded);
+	}
 
-		// load a test obj model
-		auto box_mesh = loader.LoadMesh("models/pokestan.obj");
+	{
 		// apply a gravel texture on the mesh
 		/*auto gravel = std::make_shared<Texture>("textures/gravel.jpg");
 		box_mesh->GetMaterial().SetDiffuseMap(gravel);
 		box_mesh->GetMaterial().SetShininess(0.6);
 		box_mesh->GetMaterial().SetRoughness(0.4);*/
 
-		auto box = std::make_shared<GameObject>();
+		GameObjectHandle box_handle = GameObject::pool.Create();
+		GameObject *box = GameObject::pool.Get(box_handle);
 		box->SetMesh(box_mesh);
 		box->scale = Vector3(0.2);
 		box->translation = Vector3(0, 30, 0);
 		box->UpdateMatrix();
 		//box->Save("duce.m5m");
-		objects.push_back(box);
-		physics_world->RegisterObject(box, 1.0);
-
-		auto end = std::chrono::high_resolution_clock::now();
-		auto duration = end - start;
-		std::cout << std::chrono::duration<double, std::milli>(duration).count() << "ms to load obj box.\n";
+		objects.push_back(box_handle);
+		physics_world->RegisterObject(box_handle, 1.0);
 	}
 
 	{
-		auto start = std::chrono::high_resolution_clock::now();
-
-		auto box2 = GameObject::Load("duce.m5m");
-		box2->translation += Vector3(0, 10, 0);
-		box2->UpdateMatrix();
+		GameObject *box = GameObject::pool.Get(box2);
+		box->translation += Vector3(0, 10, 0);
+		box->UpdateMatrix();
 		objects.push_back(box2);
 		physics_world->RegisterObject(box2, 1.0);
-
-		auto end = std::chrono::high_resolution_clock::now();
-		auto duration = end - start;
-		std::cout << std::chrono::duration<double, std::milli>(duration).count() << "ms to load m5m box.\n";
 	}
 	{
-		auto start = std::chrono::high_resolution_clock::now();
-
-		auto monkey_mesh = loader.LoadMesh("models/monkow.obj");
-		monkey_mesh->GetMaterial().SetShininess(0.25);
-		monkey_mesh->GetMaterial().SetRoughness(0.25);
-		auto monkey = std::make_shared<GameObject>();
+		Mesh *mesh = Mesh::pool.Get(monkey_mesh);
+		mesh->GetMaterial().SetShininess(0.25);
+		mesh->GetMaterial().SetRoughness(0.25);
+		GameObjectHandle monkey_handle = GameObject::pool.Create();
+		GameObject *monkey = GameObject::pool.Get(monkey_handle);
 		monkey->SetMesh(monkey_mesh);
 		monkey->translation = Vector3(-6, 30, 0);
 		monkey->scale = Vector3(0.25f);
 		monkey->UpdateMatrix();
-		objects.push_back(monkey);
-		physics_world->RegisterObject(monkey, 1.0);
+		objects.push_back(monkey_handle);
+		physics_world->RegisterObject(monkey_handle, 1.0);
 		//monkey->Save("monkey.m5m");
-		auto end = std::chrono::high_resolution_clock::now();
-		auto duration = end - start;
-		std::cout << std::chrono::duration<double, std::milli>(duration).count() << "ms to load obj monkey.\n";
 	}
 
 	{
-		auto start = std::chrono::high_resolution_clock::now();
-
-		auto monkey = GameObject::Load("monkey.m5m");
+		GameObject *monkey = GameObject::pool.Get(monkey2);
 		monkey->translation += Vector3(0, 10, 0);
 		monkey->UpdateMatrix();
-		objects.push_back(monkey);
-		physics_world->RegisterObject(monkey, 1.0);
-
-		auto end = std::chrono::high_resolution_clock::now();
-		auto duration = end - start;
-		std::cout << std::chrono::duration<double, std::milli>(duration).count() << "ms to load m5m monkey.\n";
+		objects.push_back(monkey2);
+		physics_world->RegisterObject(monkey2, 1.0);
 	}
 
-	auto landscape = LoadLandscape();
+	GameObject::pool.Get(landscape)->GetMesh()->GetMaterial().SetDiffuseMap(std::make_shared<Texture>(*grass_image));
+	grass_image.reset();
 	objects.push_back(landscape);
 	physics_world->RegisterObject(landscape, 0.0);
 
+	// the bodies are all at the root, props can be attached to them with scene_graph->Attach()
+	for (GameObjectHandle handle : objects) {
+		scene_graph->Add(*GameObject::pool.Get(handle));
+	}
+
 	glfwSwapInterval(1);
 	glDisable(GL_CULL_FACE);
 	glEnable(GL_DEPTH_TEST);
@@ -272,10 +327,18 @@ bool Run()
 
 	bool show_test_window = true;
 	bool show_another_window = false;
+	bool show_profiler = false;
+	ProfilerWindow profiler_window;
+	bool show_memory = false;
+	MemoryWindow memory_window;
 	ImVec4 clear_color = ImColor(114, 144, 154);
 
-	double last_time = 0;
+	// start timing from here so the first frame doesn't include asset loading
+	double last_time = glfwGetTime();
+	// asset loading shows up in the profiler as a frame of its own
+	Profiler::EndFrame();
 	while (!glfwWindowShouldClose(window)) {
+		Profiler::BeginZone("Frame");
 
 		ImGui_ImplGlfwGL3_NewFrame();
 
@@ -302,7 +365,24 @@ bool Run()
 			ImGui::ColorEdit3("clear color", (float*)&clear_color);
 			if (ImGui::Button("Test Window")) show_test_window ^= 1;
 			if (ImGui::Button("Another Window")) show_another_window ^= 1;
+			if (ImGui::Button("Profiler")) show_profiler ^= 1;
+			if (ImGui::Button("Memory")) show_memory ^= 1;
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+			if (gpu_profiler->IsAvailable()) {
+				ImGui::Text("GPU: scene %.3f ms, ui %.3f ms", gpu_profiler->GetZoneMilliseconds("Scene"), gpu_profiler->GetZoneMilliseconds("ImGui"));
+			} else {
+				ImGui::Text("GPU: timer queries not available");
+			}
+
+			const btIncrementalBroadphaseStats &broadphase = physics_world->GetBroadphaseStats();
+			ImGui::Text("Broadphase: %d static, %d dynamic, %d moved", broadphase.m_staticProxies, broadphase.m_dynamicProxies, broadphase.m_movedProxies);
+			ImGui::Text("Pairs: %d (+%d -%d), optimize %d/%d", broadphase.m_numPairs, broadphase.m_pairsAdded, broadphase.m_pairsRemoved,
+				broadphase.m_fixedUpdates, broadphase.m_dynamicUpdates);
+			ImGui::Text("Heap: %llu allocations (%llu KB) last frame", (unsigned long long)HeapStats::GetFrameAllocations(),
+				(unsigned long long)HeapStats::GetFrameAllocatedBytes() / 1024);
+			ImGui::Text("Frame memory: %llu KB, peak %llu of %llu KB, %llu overflowed", (unsigned long long)FrameAllocator::GetFrameUsed() / 1024,
+				(unsigned long long)FrameAllocator::GetPeakUsed() / 1024, (unsigned long long)FrameAllocator::GetCapacity() / 1024,
+				(unsigned long long)FrameAllocator::GetOverflowCount());
 		}
 
 		// 2. Show another simple window, this time using an explicit Begin/End pair
@@ -318,17 +398,57 @@ bool Run()
 			ImGui::SetNextWindowPos(ImVec2(650, 20), ImGuiSetCond_FirstUseEver);
 			ImGui::ShowTestWindow(&show_test_window);
 		}
-		ImGui::Render();
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		if (show_profiler) {
+			profiler_window.Draw(&show_profiler);
+		}
+
+		if (show_memory) {
+			memory_window.Draw(&show_memory);
+		}
+
+		{
+			PROFILE("ImGui");
+			GPU_PROFILE(*gpu_profiler, "ImGui");
+			ImGui::Render();
+		}
+
+		{
+			PROFILE("SwapBuffers");
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+		gpu_profiler->EndFrame();
 
 		last_time = current_time;
+
+		Profiler::EndZone();
+		Profiler::EndFrame();
+		// every job of the frame is done by now
+		FrameAllocator::EndFrame();
+		HeapStats::EndFrame();
+		MemoryTracker::EndFrame();
 	}
 
+	// the bodies read the meshes' triangles, and the meshes' buffers go with the context
+	delete physics_world;
+	physics_world = nullptr;
+	delete scene_graph;
+	scene_graph = nullptr;
+	objects.clear();
+	visible_objects.clear();
+	GameObject::pool.Clear();
+	Mesh::pool.Clear();
+
+	// the queries go with the context
+	delete gpu_profiler;
+	gpu_profiler = nullptr;
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
+	delete renderer;
+
 	if (my_shader != nullptr) {
 		delete my_shader;
 		my_shader = nullptr;
@@ -336,11 +456,16 @@ bool Run()
 
 	delete input_mgr;
 	delete camera;
-	delete physics_world;
+	// after the world, which steps on the scheduler until its thread stops
+	delete physics_scheduler;
+	delete job_system;
 
 	// Cleanup
 	ImGui_ImplGlfwGL3_Shutdown();
 
+	FrameAllocator::Shutdown();
+	Profiler::Shutdown();
+
 	return true;
 }
 
@@ -9,7 +9,7 @@ Material::Material(const Material &other)
 {
 }
 
-std::shared_ptr<Texture> Material::GetDiffuseMap() const
+const std::shared_ptr<Texture> &Material::GetDiffuseMap() const
 {
 	return diffuse_map;
 }
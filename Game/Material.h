@@ -7,7 +7,7 @@ public:
 	Material();
 	Material(const Material &other);
 
-	std::shared_ptr<Texture> GetDiffuseMap() const;
+	const std::shared_ptr<Texture> &GetDiffuseMap() const;
 	void SetDiffuseMap(std::shared_ptr<Texture> ptr);
 
 	inline float GetRoughness() const { return roughness; }
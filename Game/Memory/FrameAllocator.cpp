@@ -0,0 +1,137 @@
+#include "FrameAllocator.h"
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+struct FrameBuffer
+{
+	char *memory = nullptr;
+	std::atomic<size_t> offset { 0 };
+
+	// heap allocations that didn't fit, freed with the frame
+	std::mutex overflowMutex;
+	std::vector<void*> overflow;
+	size_t overflowBytes = 0;
+};
+
+FrameBuffer buffers[2];
+std::atomic<int> current { 0 };
+size_t capacity = 0;
+
+// the following are owned by the game thread
+size_t frame_used = 0;
+size_t peak_used = 0;
+
+std::atomic<uint64_t> overflow_count { 0 };
+
+void Release(FrameBuffer &buffer)
+{
+	for (void *memory : buffer.overflow) {
+		MemoryTracker::Free(memory);
+	}
+	buffer.overflow.clear();
+	buffer.overflowBytes = 0;
+	buffer.offset.store(0, std::memory_order_relaxed);
+}
+
+}
+
+void FrameAllocator::Init(size_t frame_capacity)
+{
+	Shutdown();
+
+	MemoryTagScope tag(MemoryTag::Transient);
+	capacity = frame_capacity;
+	for (FrameBuffer &buffer : buffers) {
+		buffer.memory = static_cast<char*>(MemoryTracker::Allocate(capacity, 64, MemoryTag::Transient));
+		if (buffer.memory == nullptr) {
+			throw std::bad_alloc();
+		}
+		buffer.overflow.reserve(64);
+	}
+}
+
+void FrameAllocator::Shutdown()
+{
+	for (FrameBuffer &buffer : buffers) {
+		Release(buffer);
+		MemoryTracker::Free(buffer.memory);
+		buffer.memory = nullptr;
+	}
+	capacity = 0;
+	frame_used = 0;
+	peak_used = 0;
+	overflow_count.store(0);
+}
+
+void *FrameAllocator::Allocate(size_t size, size_t alignment)
+{
+	FrameBuffer &buffer = buffers[current.load(std::memory_order_acquire)];
+
+	if (buffer.memory != nullptr) {
+		const uintptr_t base = uintptr_t(buffer.memory);
+		size_t offset = buffer.offset.load(std::memory_order_relaxed);
+		while (true) {
+			const size_t aligned = size_t(((base + offset + alignment - 1) & ~uintptr_t(alignment - 1)) - base);
+			if (aligned + size > capacity) {
+				break;
+			}
+			if (buffer.offset.compare_exchange_weak(offset, aligned + size, std::memory_order_relaxed)) {
+				return buffer.memory + aligned;
+			}
+		}
+	}
+
+	// full, or not initialized
+	overflow_count.fetch_add(1, std::memory_order_relaxed);
+	void *memory = MemoryTracker::Allocate(size, alignment, MemoryTag::Transient);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	{
+		std::lock_guard<std::mutex> lock(buffer.overflowMutex);
+		MemoryTagScope tag(MemoryTag::Transient);
+		buffer.overflow.push_back(memory);
+		buffer.overflowBytes += size;
+	}
+	return memory;
+}
+
+void FrameAllocator::EndFrame()
+{
+	const int ending = current.load(std::memory_order_relaxed);
+	FrameBuffer &ended = buffers[ending];
+	frame_used = std::min(ended.offset.load(std::memory_order_relaxed), capacity) + ended.overflowBytes;
+	peak_used = std::max(peak_used, frame_used);
+
+	// the other buffer holds the frame before, which nothing reads anymore
+	const int next = 1 - ending;
+	Release(buffers[next]);
+	current.store(next, std::memory_order_release);
+}
+
+size_t FrameAllocator::GetFrameUsed()
+{
+	return frame_used;
+}
+
+size_t FrameAllocator::GetPeakUsed()
+{
+	return peak_used;
+}
+
+size_t FrameAllocator::GetCapacity()
+{
+	return capacity;
+}
+
+uint64_t FrameAllocator::GetOverflowCount()
+{
+	return overflow_count.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// memory for data that only lives for a frame, e.g. lists built while rendering. allocating is
+// a single atomic add into the current frame's buffer and nothing is ever freed on its own: a
+// frame's memory is reclaimed as a whole at the end of the frame after it, so what a frame
+// allocates can still be read while the next one is built.
+//
+// the two buffers are allocated by Init(). allocations that don't fit go to the heap instead,
+// are freed along with the rest of the frame and counted, see GetOverflowCount().
+class FrameAllocator
+{
+public:
+	// `capacity` bytes for each of the two frames
+	static void Init(size_t capacity=4 * 1024 * 1024);
+	static void Shutdown();
+
+	// can be called from any thread. alignment must be a power of two. never returns nullptr.
+	static void *Allocate(size_t size, size_t alignment=alignof(std::max_align_t));
+
+	// constructors and destructors are not run, the memory is just released with the frame
+	template <typename T>
+	static inline T *AllocateArray(size_t count)
+	{
+		return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	// called on the game thread once every frame, when no thread allocates from the frame
+	// allocator anymore. frees the memory of the frame before the one ending.
+	static void EndFrame();
+
+	// bytes allocated by the frame that ended last, padding and overflow included
+	static size_t GetFrameUsed();
+	// most bytes allocated by a frame since Init()
+	static size_t GetPeakUsed();
+	static size_t GetCapacity();
+	// allocations that didn't fit and went to the heap, since Init()
+	static uint64_t GetOverflowCount();
+};
@@ -0,0 +1,111 @@
+#include "HeapStats.h"
+#include "MemoryTracker.h"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+namespace {
+
+// constant initialized, so they can be counted into before any constructor runs
+std::atomic<uint64_t> num_allocations { 0 };
+std::atomic<uint64_t> num_allocated_bytes { 0 };
+
+// the following are owned by the game thread
+uint64_t frame_start_allocations = 0;
+uint64_t frame_start_bytes = 0;
+uint64_t frame_allocations = 0;
+uint64_t frame_bytes = 0;
+
+void *CountedAllocate(size_t size)
+{
+	num_allocations.fetch_add(1, std::memory_order_relaxed);
+	num_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	return MemoryTracker::Allocate(size, alignof(std::max_align_t), MemoryTracker::GetCurrentTag());
+}
+
+}
+
+void *operator new(size_t size)
+{
+	void *memory = CountedAllocate(size);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+uint64_t HeapStats::GetAllocationCount()
+{
+	return num_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t HeapStats::GetAllocatedBytes()
+{
+	return num_allocated_bytes.load(std::memory_order_relaxed);
+}
+
+void HeapStats::EndFrame()
+{
+	const uint64_t allocations = GetAllocationCount();
+	const uint64_t bytes = GetAllocatedBytes();
+	frame_allocations = allocations - frame_start_allocations;
+	frame_bytes = bytes - frame_start_bytes;
+	frame_start_allocations = allocations;
+	frame_start_bytes = bytes;
+}
+
+uint64_t HeapStats::GetFrameAllocations()
+{
+	return frame_allocations;
+}
+
+uint64_t HeapStats::GetFrameAllocatedBytes()
+{
+	return frame_bytes;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+// counts the allocations made through new by every thread, to find and keep heap allocations out
+// of the main loop. HeapStats.cpp replaces the global operator new and delete with ones going
+// through the MemoryTracker, so a program gets the counts by linking it in. allocations of
+// over-aligned types, and memory taken from the tracker directly (bullet's, imgui's) are not
+// counted here.
+class HeapStats
+{
+public:
+	// since the program started
+	static uint64_t GetAllocationCount();
+	static uint64_t GetAllocatedBytes();
+
+	// called on the game thread once every frame
+	static void EndFrame();
+
+	// made during the frame that ended last, by all threads
+	static uint64_t GetFrameAllocations();
+	static uint64_t GetFrameAllocatedBytes();
+};
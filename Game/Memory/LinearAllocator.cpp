@@ -0,0 +1,80 @@
+#include "LinearAllocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+LinearAllocator::LinearAllocator(size_t block_size, MemoryTag tag)
+	: blockSize(block_size), tag(tag)
+{
+}
+
+LinearAllocator::~LinearAllocator()
+{
+	for (Block &block : blocks) {
+		MemoryTracker::Free(block.memory);
+	}
+}
+
+void *LinearAllocator::Allocate(size_t size, size_t alignment)
+{
+	while (current < blocks.size()) {
+		Block &block = blocks[current];
+		const uintptr_t base = uintptr_t(block.memory);
+		const size_t aligned = size_t(((base + offset + alignment - 1) & ~uintptr_t(alignment - 1)) - base);
+		if (aligned + size <= block.size) {
+			offset = aligned + size;
+			return block.memory + aligned;
+		}
+
+		// the rest of this block goes unused until the next rewind
+		if (current + 1 < blocks.size() && blocks[current + 1].size >= size + alignment) {
+			current++;
+			offset = 0;
+			continue;
+		}
+		break;
+	}
+
+	// out of blocks, or the next one is too small for this request. new blocks go right after
+	// the current one, so markers taken earlier still point to the same spots.
+	Block block;
+	block.size = std::max(blockSize, size + alignment);
+	block.memory = static_cast<char*>(MemoryTracker::Allocate(block.size, alignof(std::max_align_t), tag));
+	if (block.memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	const size_t index = blocks.empty() ? 0 : current + 1;
+	{
+		MemoryTagScope scope(tag);
+		blocks.insert(blocks.begin() + index, block);
+	}
+
+	current = index;
+	offset = 0;
+	return Allocate(size, alignment);
+}
+
+void LinearAllocator::Rewind(const Marker &marker)
+{
+	current = marker.block;
+	offset = marker.offset;
+}
+
+size_t LinearAllocator::GetUsed() const
+{
+	size_t used = 0;
+	for (size_t i = 0; i < current && i < blocks.size(); i++) {
+		used += blocks[i].size;
+	}
+	return used + offset;
+}
+
+size_t LinearAllocator::GetCapacity() const
+{
+	size_t capacity = 0;
+	for (const Block &block : blocks) {
+		capacity += block.size;
+	}
+	return capacity;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "MemoryTracker.h"
+
+#include <cstddef>
+#include <vector>
+
+// hands out memory by bumping an offset through large blocks, and frees it all at once. blocks
+// are kept when the allocator is reset, so once it has grown to what its user needs at most
+// (a frame, a model being loaded) it stops allocating. not thread safe.
+class LinearAllocator
+{
+public:
+	// spot to rewind to, see Rewind()
+	struct Marker
+	{
+		size_t block;
+		size_t offset;
+	};
+
+	// requests larger than block_size get a block of their own. the blocks are counted under `tag`.
+	explicit LinearAllocator(size_t block_size=64 * 1024, MemoryTag tag=MemoryTag::Transient);
+	~LinearAllocator();
+
+	LinearAllocator(const LinearAllocator &) = delete;
+	LinearAllocator &operator=(const LinearAllocator &) = delete;
+
+	// alignment must be a power of two. never returns nullptr.
+	void *Allocate(size_t size, size_t alignment=alignof(std::max_align_t));
+
+	inline Marker GetMarker() const { return { current, offset }; }
+	// frees everything allocated since the marker was taken
+	void Rewind(const Marker &marker);
+	// frees everything
+	inline void Reset() { Rewind({ 0, 0 }); }
+
+	// bytes in use, padding included
+	size_t GetUsed() const;
+	// bytes in all blocks
+	size_t GetCapacity() const;
+
+private:
+	struct Block
+	{
+		char *memory;
+		size_t size;
+	};
+
+	size_t blockSize;
+	MemoryTag tag;
+	std::vector<Block> blocks;
+	// block being allocated from and the offset into it
+	size_t current = 0;
+	size_t offset = 0;
+};
@@ -0,0 +1,196 @@
+#include "MemoryTracker.h"
+
+#include "LinearMath/btAlignedAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const size_t TAG_COUNT = size_t(MemoryTag::Count);
+
+const char *TAG_NAMES[TAG_COUNT] = {
+	"General",
+	"Physics",
+	"Meshes",
+	"Textures",
+	"UI",
+	"Transient",
+};
+
+// in front of every block handed out
+struct BlockHeader
+{
+	uint64_t size;
+	// from the start of the malloc'd memory to the block
+	uint32_t offset;
+	// bytes malloc'd on top of the size: the header, and padding for the alignment
+	uint32_t overhead : 24;
+	uint32_t tag : 8;
+};
+static_assert(sizeof(BlockHeader) == 16, "header would misalign the blocks");
+
+// what malloc's memory is always aligned to, no padding needed up to this
+const size_t MALLOC_ALIGNMENT = std::min(alignof(std::max_align_t), sizeof(BlockHeader));
+
+// constant initialized like HeapStats' counters, new is counted into them before main
+struct alignas(64) TagCounters
+{
+	std::atomic<size_t> liveBytes { 0 };
+	std::atomic<size_t> reservedBytes { 0 };
+	std::atomic<size_t> peakBytes { 0 };
+	std::atomic<uint64_t> liveAllocations { 0 };
+	std::atomic<uint64_t> allocations { 0 };
+	std::atomic<uint64_t> allocatedBytes { 0 };
+	std::atomic<size_t> budget { 0 };
+
+	// the following are owned by the game thread
+	uint64_t frameStartAllocations = 0;
+	uint64_t frameStartBytes = 0;
+	uint64_t frameAllocations = 0;
+	uint64_t frameBytes = 0;
+};
+
+TagCounters counters[TAG_COUNT];
+
+thread_local MemoryTag current_tag = MemoryTag::General;
+
+void *BulletAllocate(size_t size, int alignment)
+{
+	return MemoryTracker::Allocate(size, size_t(alignment), MemoryTag::Physics);
+}
+
+void BulletFree(void *memory)
+{
+	MemoryTracker::Free(memory);
+}
+
+}
+
+void MemoryTracker::Init()
+{
+	btAlignedAllocSetCustomAligned(BulletAllocate, BulletFree);
+}
+
+void *MemoryTracker::Allocate(size_t size, size_t alignment, MemoryTag tag)
+{
+	alignment = std::max(alignment, alignof(BlockHeader));
+	const size_t padding = alignment > MALLOC_ALIGNMENT ? alignment - 1 : 0;
+	const size_t total = size + sizeof(BlockHeader) + padding;
+
+	char *memory = static_cast<char*>(malloc(total));
+	if (memory == nullptr) {
+		return nullptr;
+	}
+
+	const uintptr_t block = (uintptr_t(memory) + sizeof(BlockHeader) + alignment - 1) & ~uintptr_t(alignment - 1);
+	BlockHeader *header = reinterpret_cast<BlockHeader*>(block) - 1;
+	header->size = size;
+	header->offset = uint32_t(block - uintptr_t(memory));
+	header->overhead = uint32_t(total - size);
+	header->tag = uint32_t(tag);
+
+	TagCounters &tag_counters = counters[size_t(tag)];
+	const size_t live = tag_counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	tag_counters.reservedBytes.fetch_add(total, std::memory_order_relaxed);
+	tag_counters.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+	tag_counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	tag_counters.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+	size_t peak = tag_counters.peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !tag_counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+	}
+
+	return reinterpret_cast<void*>(block);
+}
+
+void *MemoryTracker::Reallocate(void *memory, size_t size, MemoryTag tag)
+{
+	void *reallocated = Allocate(size, alignof(std::max_align_t), tag);
+	if (reallocated == nullptr || memory == nullptr) {
+		return reallocated;
+	}
+
+	const BlockHeader *header = static_cast<const BlockHeader*>(memory) - 1;
+	memcpy(reallocated, memory, std::min(size, size_t(header->size)));
+	Free(memory);
+	return reallocated;
+}
+
+void MemoryTracker::Free(void *memory)
+{
+	if (memory == nullptr) {
+		return;
+	}
+
+	const BlockHeader *header = static_cast<const BlockHeader*>(memory) - 1;
+	const size_t size = size_t(header->size);
+
+	TagCounters &tag_counters = counters[header->tag];
+	tag_counters.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+	tag_counters.reservedBytes.fetch_sub(size + header->overhead, std::memory_order_relaxed);
+	tag_counters.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+
+	free(static_cast<char*>(memory) - header->offset);
+}
+
+MemoryTag MemoryTracker::GetCurrentTag()
+{
+	return current_tag;
+}
+
+void MemoryTracker::SetCurrentTag(MemoryTag tag)
+{
+	current_tag = tag;
+}
+
+void MemoryTracker::SetBudget(MemoryTag tag, size_t budget)
+{
+	counters[size_t(tag)].budget.store(budget, std::memory_order_relaxed);
+}
+
+MemoryTagStats MemoryTracker::GetStats(MemoryTag tag)
+{
+	const TagCounters &tag_counters = counters[size_t(tag)];
+
+	MemoryTagStats stats;
+	stats.liveBytes = tag_counters.liveBytes.load(std::memory_order_relaxed);
+	stats.reservedBytes = tag_counters.reservedBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = tag_counters.peakBytes.load(std::memory_order_relaxed);
+	stats.liveAllocations = tag_counters.liveAllocations.load(std::memory_order_relaxed);
+	stats.allocations = tag_counters.allocations.load(std::memory_order_relaxed);
+	stats.allocatedBytes = tag_counters.allocatedBytes.load(std::memory_order_relaxed);
+	stats.frameAllocations = tag_counters.frameAllocations;
+	stats.frameAllocatedBytes = tag_counters.frameBytes;
+	stats.budget = tag_counters.budget.load(std::memory_order_relaxed);
+	return stats;
+}
+
+const char *MemoryTracker::GetTagName(MemoryTag tag)
+{
+	return size_t(tag) < TAG_COUNT ? TAG_NAMES[size_t(tag)] : "Unknown";
+}
+
+MemoryTag MemoryTracker::FindTag(const char *name)
+{
+	for (size_t i = 0; i < TAG_COUNT; i++) {
+		if (strcmp(TAG_NAMES[i], name) == 0) {
+			return MemoryTag(i);
+		}
+	}
+	return MemoryTag::Count;
+}
+
+void MemoryTracker::EndFrame()
+{
+	for (TagCounters &tag_counters : counters) {
+		const uint64_t allocations = tag_counters.allocations.load(std::memory_order_relaxed);
+		const uint64_t bytes = tag_counters.allocatedBytes.load(std::memory_order_relaxed);
+		tag_counters.frameAllocations = allocations - tag_counters.frameStartAllocations;
+		tag_counters.frameBytes = bytes - tag_counters.frameStartBytes;
+		tag_counters.frameStartAllocations = allocations;
+		tag_counters.frameStartBytes = bytes;
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// what a block of memory is used for. every allocation made through the tracker is counted
+// under one of these.
+enum class MemoryTag : uint8_t
+{
+	General,
+	Physics,
+	Meshes,
+	Textures,
+	UI,
+	Transient,
+	Count
+};
+
+struct MemoryTagStats
+{
+	// bytes asked for and not yet freed
+	size_t liveBytes;
+	// bytes taken from the system for them, headers and padding included
+	size_t reservedBytes;
+	// most live bytes at any point since the program started
+	size_t peakBytes;
+	uint64_t liveAllocations;
+
+	// since the program started
+	uint64_t allocations;
+	uint64_t allocatedBytes;
+
+	// made during the frame that ended last, see MemoryTracker::EndFrame()
+	uint64_t frameAllocations;
+	uint64_t frameAllocatedBytes;
+
+	// 0 when not set
+	size_t budget;
+
+	// share of the reserved bytes that doesn't hold anything asked for, 0 to 1
+	inline float GetFragmentation() const
+	{
+		return reservedBytes > 0 ? 1.0f - float(liveBytes) / float(reservedBytes) : 0.0f;
+	}
+
+	inline bool IsOverBudget() const
+	{
+		return budget > 0 && liveBytes > budget;
+	}
+};
+
+// the heap every engine allocation goes through, counted per tag. HeapStats.cpp sends new and
+// delete here under the calling thread's current tag (see MemoryTagScope), Init() hooks up
+// bullet's allocator as Physics, and imgui, stb_image and the engine's own allocators pass
+// their tags directly.
+//
+// budgets are not enforced, an allocation over budget still succeeds. they are reported so a
+// subsystem growing past its share shows up in the memory window and the benchmarks.
+class MemoryTracker
+{
+public:
+	// routes bullet's allocations through the tracker. has to be called before bullet allocates
+	// anything, and stays hooked up for the rest of the program: memory bullet took from the
+	// tracker can't be given back to the default allocator.
+	static void Init();
+
+	// can be called from any thread, and before Init(). alignment must be a power of two.
+	// returns nullptr when out of memory.
+	static void *Allocate(size_t size, size_t alignment, MemoryTag tag);
+	// like realloc, the new block has the default alignment and is counted under `tag`.
+	// memory is nullptr or was returned by the tracker.
+	static void *Reallocate(void *memory, size_t size, MemoryTag tag);
+	// memory is nullptr or was returned by the tracker
+	static void Free(void *memory);
+
+	// tag of the allocations made through new on the calling thread
+	static MemoryTag GetCurrentTag();
+	static void SetCurrentTag(MemoryTag tag);
+
+	// bytes, 0 for none
+	static void SetBudget(MemoryTag tag, size_t budget);
+	static MemoryTagStats GetStats(MemoryTag tag);
+	static const char *GetTagName(MemoryTag tag);
+	// tag with the given name, MemoryTag::Count if there is none
+	static MemoryTag FindTag(const char *name);
+
+	// called on the game thread once every frame
+	static void EndFrame();
+};
+
+// makes the calling thread's allocations through new count under `tag` until the end of the
+// scope. scopes nest.
+class MemoryTagScope
+{
+public:
+	inline explicit MemoryTagScope(MemoryTag tag)
+		: previous(MemoryTracker::GetCurrentTag())
+	{
+		MemoryTracker::SetCurrentTag(tag);
+	}
+
+	inline ~MemoryTagScope()
+	{
+		MemoryTracker::SetCurrentTag(previous);
+	}
+
+	MemoryTagScope(const MemoryTagScope &) = delete;
+	MemoryTagScope &operator=(const MemoryTagScope &) = delete;
+
+private:
+	MemoryTag previous;
+};
@@ -0,0 +1,65 @@
+#include "MemoryWindow.h"
+#include "MemoryTracker.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+
+static const float KB = 1024.0f;
+static const float MB = 1024.0f * 1024.0f;
+
+void MemoryWindow::Draw(bool *open)
+{
+	ImGui::SetNextWindowSize(ImVec2(700, 200), ImGuiSetCond_FirstUseEver);
+	if (!ImGui::Begin("Memory", open)) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Columns(7, "##tags");
+	ImGui::Text("tag"); ImGui::NextColumn();
+	ImGui::Text("live"); ImGui::NextColumn();
+	ImGui::Text("peak"); ImGui::NextColumn();
+	ImGui::Text("budget MB"); ImGui::NextColumn();
+	ImGui::Text("allocs/frame"); ImGui::NextColumn();
+	ImGui::Text("KB/frame"); ImGui::NextColumn();
+	ImGui::Text("fragmentation"); ImGui::NextColumn();
+	ImGui::Separator();
+
+	for (int i = 0; i < int(MemoryTag::Count); i++) {
+		const MemoryTag tag = MemoryTag(i);
+		const MemoryTagStats stats = MemoryTracker::GetStats(tag);
+
+		if (stats.IsOverBudget()) {
+			ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", MemoryTracker::GetTagName(tag));
+		} else {
+			ImGui::Text("%s", MemoryTracker::GetTagName(tag));
+		}
+		ImGui::NextColumn();
+		ImGui::Text("%.2f MB, %llu", stats.liveBytes / MB, (unsigned long long)stats.liveAllocations);
+		ImGui::NextColumn();
+		ImGui::Text("%.2f MB", stats.peakBytes / MB);
+		ImGui::NextColumn();
+
+		// 0 for no budget
+		int budget = int(stats.budget / size_t(MB));
+		ImGui::PushID(i);
+		ImGui::PushItemWidth(-1);
+		if (ImGui::InputInt("##budget", &budget)) {
+			MemoryTracker::SetBudget(tag, size_t(std::max(budget, 0)) * size_t(MB));
+		}
+		ImGui::PopItemWidth();
+		ImGui::PopID();
+		ImGui::NextColumn();
+
+		ImGui::Text("%llu", (unsigned long long)stats.frameAllocations);
+		ImGui::NextColumn();
+		ImGui::Text("%.1f", stats.frameAllocatedBytes / KB);
+		ImGui::NextColumn();
+		ImGui::Text("%.1f%%", stats.GetFragmentation() * 100.0f);
+		ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+
+	ImGui::End();
+}
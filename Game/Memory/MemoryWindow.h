@@ -0,0 +1,8 @@
+#pragma once
+
+// imgui window with the memory in use by every tag of the MemoryTracker, and their budgets
+class MemoryWindow
+{
+public:
+	void Draw(bool *open=nullptr);
+};
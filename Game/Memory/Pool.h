@@ -0,0 +1,206 @@
+#pragma once
+#include "MemoryTracker.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+// refers to an object in a Pool. a handle can be kept after its object is destroyed: the slot's
+// generation changes, so looking the handle up gives nullptr from then on, even once the slot
+// holds another object.
+template <typename T>
+struct Handle
+{
+	uint32_t index = 0;
+	// odd while the object is alive, so a default constructed handle never refers to one
+	uint32_t generation = 0;
+
+	inline bool IsNull() const { return generation == 0; }
+
+	inline bool operator==(const Handle &other) const { return index == other.index && generation == other.generation; }
+	inline bool operator!=(const Handle &other) const { return !(*this == other); }
+	inline bool operator<(const Handle &other) const
+	{
+		return index != other.index ? index < other.index : generation < other.generation;
+	}
+};
+
+// objects of one type in chunks of slots that are reused, so creating and destroying them doesn't
+// touch the heap once the pool has grown, and an object never moves while alive.
+//
+// Create() and Destroy() can be called from any thread, if several destroy the same object only
+// one of them does. Get() takes no lock; an object must not be destroyed while another thread
+// still uses it.
+template <typename T>
+class Pool
+{
+public:
+	static const uint32_t CHUNK_SIZE = 1024;
+	// at most CHUNK_SIZE * MAX_CHUNKS objects at once
+	static const uint32_t MAX_CHUNKS = 4096;
+
+	// the chunks are counted under `tag`
+	explicit Pool(MemoryTag tag=MemoryTag::General) : tag(tag) {}
+
+	~Pool()
+	{
+		Clear();
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+			MemoryTracker::Free(chunks[chunk].load(std::memory_order_relaxed));
+		}
+	}
+
+	Pool(const Pool &) = delete;
+	Pool &operator=(const Pool &) = delete;
+
+	template <typename... Args>
+	Handle<T> Create(Args &&...args)
+	{
+		const uint32_t index = AcquireSlot();
+		Slot &slot = GetSlot(index);
+		try {
+			new (slot.storage) T(std::forward<Args>(args)...);
+		} catch (...) {
+			ReleaseSlot(index);
+			throw;
+		}
+
+		// publishes the object to Get() on other threads
+		const uint32_t generation = slot.generation.load(std::memory_order_relaxed) + 1;
+		slot.generation.store(generation, std::memory_order_release);
+		return Handle<T> { index, generation };
+	}
+
+	// false if the handle is null or its object was already destroyed
+	bool Destroy(Handle<T> handle)
+	{
+		T *object = Get(handle);
+		if (object == nullptr) {
+			return false;
+		}
+
+		// stale before the destructor runs, so it can't find the object through the pool. only
+		// the thread that moves the generation on gets to destroy the object.
+		uint32_t generation = handle.generation;
+		if (!GetSlot(handle.index).generation.compare_exchange_strong(generation, generation + 1, std::memory_order_acq_rel)) {
+			return false;
+		}
+		object->~T();
+		ReleaseSlot(handle.index);
+		return true;
+	}
+
+	// nullptr if the handle is null or its object was destroyed
+	inline T *Get(Handle<T> handle) const
+	{
+		if ((handle.generation & 1) == 0 || handle.index / CHUNK_SIZE >= MAX_CHUNKS) {
+			return nullptr;
+		}
+		const Slot *chunk = chunks[handle.index / CHUNK_SIZE].load(std::memory_order_acquire);
+		if (chunk == nullptr) {
+			return nullptr;
+		}
+		const Slot &slot = chunk[handle.index % CHUNK_SIZE];
+		if (slot.generation.load(std::memory_order_acquire) != handle.generation) {
+			return nullptr;
+		}
+		return reinterpret_cast<T*>(const_cast<unsigned char*>(slot.storage));
+	}
+
+	// calls f(handle, object) for every live object. no other thread may create or destroy
+	// objects meanwhile, f itself may destroy the one it is given.
+	template <typename F>
+	void ForEach(F f)
+	{
+		const uint32_t count = slotCount;
+		for (uint32_t index = 0; index < count; index++) {
+			Slot &slot = GetSlot(index);
+			const uint32_t generation = slot.generation.load(std::memory_order_acquire);
+			if ((generation & 1) != 0) {
+				f(Handle<T> { index, generation }, *reinterpret_cast<T*>(slot.storage));
+			}
+		}
+	}
+
+	// destroys every object and keeps the memory
+	void Clear()
+	{
+		ForEach([this](Handle<T> handle, T &) {
+			Destroy(handle);
+		});
+	}
+
+	// live objects
+	inline size_t GetSize() const { return size; }
+	// slots in all chunks
+	inline size_t GetCapacity() const { return size_t(chunkCount) * CHUNK_SIZE; }
+
+private:
+	struct Slot
+	{
+		alignas(T) unsigned char storage[sizeof(T)];
+		std::atomic<uint32_t> generation { 0 };
+		// next slot in the free list
+		uint32_t nextFree = 0;
+	};
+
+	static const uint32_t NO_SLOT = uint32_t(-1);
+
+	inline Slot &GetSlot(uint32_t index) const
+	{
+		return chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE];
+	}
+
+	uint32_t AcquireSlot()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size++;
+
+		if (freeHead != NO_SLOT) {
+			const uint32_t index = freeHead;
+			freeHead = GetSlot(index).nextFree;
+			return index;
+		}
+
+		if (slotCount == chunkCount * CHUNK_SIZE) {
+			if (chunkCount == MAX_CHUNKS) {
+				size--;
+				throw "pool is full";
+			}
+			Slot *chunk = static_cast<Slot*>(MemoryTracker::Allocate(sizeof(Slot) * CHUNK_SIZE, alignof(Slot), tag));
+			if (chunk == nullptr) {
+				size--;
+				throw std::bad_alloc();
+			}
+			for (uint32_t i = 0; i < CHUNK_SIZE; i++) {
+				new (&chunk[i]) Slot();
+			}
+			// the slots are constructed before Get() on another thread can see the chunk
+			chunks[chunkCount].store(chunk, std::memory_order_release);
+			chunkCount++;
+		}
+		return slotCount++;
+	}
+
+	void ReleaseSlot(uint32_t index)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		GetSlot(index).nextFree = freeHead;
+		freeHead = index;
+		size--;
+	}
+
+	MemoryTag tag;
+	std::mutex mutex;
+
+	// the table never moves, so Get() can read it while another thread adds a chunk
+	std::atomic<Slot*> chunks[MAX_CHUNKS] = {};
+	uint32_t chunkCount = 0;
+	// slots handed out at least once, the rest of the last chunk is untouched
+	uint32_t slotCount = 0;
+	uint32_t freeHead = NO_SLOT;
+	size_t size = 0;
+};
@@ -0,0 +1,8 @@
+#include "ScratchAllocator.h"
+
+LinearAllocator &ScratchAllocator::Get()
+{
+	// grows to the biggest thing the thread ever loaded and stays that size
+	static thread_local LinearAllocator allocator(256 * 1024);
+	return allocator;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "LinearAllocator.h"
+
+// every thread's own LinearAllocator, for temporary memory that doesn't leave the function that
+// allocates it, like the intermediate arrays of a loader. nothing is freed until a ScratchScope
+// ends, so take one before allocating:
+//
+//   ScratchScope scope;
+//   ScratchVector<Vector3> positions;
+//
+// scopes nest, and jobs run while a thread waits use the same allocator, which is fine as long
+// as they take a scope of their own.
+class ScratchAllocator
+{
+public:
+	// the calling thread's allocator, made on first use
+	static LinearAllocator &Get();
+
+	static inline void *Allocate(size_t size, size_t alignment=alignof(std::max_align_t))
+	{
+		return Get().Allocate(size, alignment);
+	}
+};
+
+// frees what the calling thread allocated from its scratch allocator since the scope began
+class ScratchScope
+{
+public:
+	inline ScratchScope()
+		: allocator(ScratchAllocator::Get()), marker(allocator.GetMarker())
+	{
+	}
+
+	inline ~ScratchScope()
+	{
+		allocator.Rewind(marker);
+	}
+
+	ScratchScope(const ScratchScope &) = delete;
+	ScratchScope &operator=(const ScratchScope &) = delete;
+
+private:
+	LinearAllocator &allocator;
+	LinearAllocator::Marker marker;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include "FrameAllocator.h"
+#include "LinearAllocator.h"
+#include "ScratchAllocator.h"
+
+#include <cstddef>
+#include <vector>
+
+// adapters for using the engine's allocators with standard containers. deallocating is a no-op
+// for both, the memory is released with the frame or the allocator, so a container that grows
+// leaves its old buffers behind until then. reserve up front where the size is known.
+
+// allocates from the frame allocator, for containers that are thrown away with the frame
+template <typename T>
+class FrameStlAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameStlAllocator() = default;
+	template <typename U>
+	FrameStlAllocator(const FrameStlAllocator<U> &) {}
+
+	inline T *allocate(size_t count)
+	{
+		return FrameAllocator::AllocateArray<T>(count);
+	}
+
+	inline void deallocate(T *, size_t) {}
+
+	template <typename U>
+	inline bool operator==(const FrameStlAllocator<U> &) const { return true; }
+	template <typename U>
+	inline bool operator!=(const FrameStlAllocator<U> &) const { return false; }
+};
+
+// allocates from a linear allocator, by default the scratch allocator of the thread the
+// container is made on. the container must not outlive the allocator's next rewind.
+template <typename T>
+class LinearStlAllocator
+{
+public:
+	typedef T value_type;
+
+	inline LinearStlAllocator() : allocator(&ScratchAllocator::Get()) {}
+	inline explicit LinearStlAllocator(LinearAllocator &allocator) : allocator(&allocator) {}
+	template <typename U>
+	inline LinearStlAllocator(const LinearStlAllocator<U> &other) : allocator(other.allocator) {}
+
+	inline T *allocate(size_t count)
+	{
+		return static_cast<T*>(allocator->Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	inline void deallocate(T *, size_t) {}
+
+	template <typename U>
+	inline bool operator==(const LinearStlAllocator<U> &other) const { return allocator == other.allocator; }
+	template <typename U>
+	inline bool operator!=(const LinearStlAllocator<U> &other) const { return allocator != other.allocator; }
+
+private:
+	template <typename U>
+	friend class LinearStlAllocator;
+
+	LinearAllocator *allocator;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+
+// see ScratchScope
+template <typename T>
+using ScratchVector = std::vector<T, LinearStlAllocator<T>>;
@@ -1,39 +1,42 @@
 #include "Mesh.h"
 #include "Vertex.h"
+#include "Memory/MemoryTracker.h"
 
-#include <GL/glew.h>
-#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 
+Pool<Mesh> Mesh::pool(MemoryTag::Meshes);
+
+static std::atomic<unsigned int> next_mesh_id { 1 };
+
+// the buffers are made on the first draw, so meshes can be loaded on any thread (and without a
+// gl context at all, e.g. in headless benchmarks). the gl side is in MeshGpu.cpp.
 Mesh::Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
-	: vertices(vertices), indices(indices)
+	: id(next_mesh_id++)
 {
-	glGenBuffers(1, &vboID);
-	glBindBuffer(GL_ARRAY_BUFFER, vboID);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), &vertices[0].x, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &iboID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), &indices[0], GL_STATIC_DRAW);
+	MemoryTagScope memory_tag(MemoryTag::Meshes);
+	this->vertices = vertices;
+	this->indices = indices;
+	CalculateBounds();
 }
 
 Mesh::Mesh(const Mesh &other)
+	: id(next_mesh_id++)
 {
+	MemoryTagScope memory_tag(MemoryTag::Meshes);
 	vertices = other.vertices;
 	indices = other.indices;
-
-	glGenBuffers(1, &vboID);
-	glBindBuffer(GL_ARRAY_BUFFER, vboID);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), &vertices[0].x, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &iboID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), &indices[0], GL_STATIC_DRAW);
+	source_path = other.source_path;
+	boundsCenter = other.boundsCenter;
+	boundsRadius = other.boundsRadius;
 }
 
 Mesh::~Mesh()
 {
-	glDeleteBuffers(1, &vboID);
-	glDeleteBuffers(1, &iboID);
+	if (uploaded) {
+		ReleaseBuffers();
+	}
 }
 
 Material &Mesh::GetMaterial()
@@ -41,21 +44,24 @@ Material &Mesh::GetMaterial()
 	return material;
 }
 
-void Mesh::Draw() 
+void Mesh::CalculateBounds()
 {
-	glBindBuffer(GL_ARRAY_BUFFER, vboID);
-	
-	glEnableVertexAttribArray(0); // positions
-	glEnableVertexAttribArray(1); // normals
-	glEnableVertexAttribArray(2); // texcoords
-
-	// set pointer to vertices
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex), BUFFER_OFFSET(0));
-	// set pointer to normals
-	glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(Vertex), BUFFER_OFFSET(12));
-	// set pointer to texcoords
-	glVertexAttribPointer(2, 2, GL_FLOAT, false, sizeof(Vertex), BUFFER_OFFSET(24));
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboID);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, BUFFER_OFFSET(0));
-}
\ No newline at end of file
+	if (vertices.empty()) {
+		return;
+	}
+
+	// a sphere around the bounding box, not the smallest one but close enough for culling
+	Vector3 min(vertices[0].x, vertices[0].y, vertices[0].z);
+	Vector3 max = min;
+	for (const Vertex &vertex : vertices) {
+		min = Vector3::Min(min, Vector3(vertex.x, vertex.y, vertex.z));
+		max = Vector3::Max(max, Vector3(vertex.x, vertex.y, vertex.z));
+	}
+
+	boundsCenter = (min + max) * Vector3(0.5f);
+	boundsRadius = 0.0f;
+	for (const Vertex &vertex : vertices) {
+		boundsRadius = std::max(boundsRadius, boundsCenter.DistanceSquared(Vector3(vertex.x, vertex.y, vertex.z)));
+	}
+	boundsRadius = std::sqrt(boundsRadius);
+}
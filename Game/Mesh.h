@@ -1,12 +1,23 @@
 #pragma once
 #include "Vertex.h"
 #include "Material.h"
+#include "Math/vector3.h"
+#include "Memory/Pool.h"
 #include <vector>
+#include <string>
 #define BUFFER_OFFSET(i) ((void*)(i))
 
+class Mesh;
+typedef Handle<Mesh> MeshHandle;
+
 class Mesh
 {
 public:
+	// every mesh lives here. meshes are shared by the objects drawing them and stay until they
+	// are destroyed through the pool; their gl buffers go with them, so that has to happen
+	// while the context is still current.
+	static Pool<Mesh> pool;
+
 	Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices);
 	Mesh(const Mesh &other);
 	~Mesh();
@@ -16,13 +27,38 @@ public:
 
 	Material &GetMaterial();
 
+	// sphere around all vertices, in model space
+	inline const Vector3 &GetBoundsCenter() const { return boundsCenter; }
+	inline float GetBoundsRadius() const { return boundsRadius; }
+
+	// file the mesh was loaded from, empty for meshes built at runtime
+	inline const std::string &GetSourcePath() const { return source_path; }
+	inline void SetSourcePath(const std::string &path) { source_path = path; }
+
+	// unique per mesh, for sorting draws by mesh
+	inline unsigned int GetId() const { return id; }
+
+	// binds the buffers and sets up the vertex attributes, uploading the mesh on first use
+	void Bind();
+	// draws the mesh, which must be the one bound last
+	void DrawBound();
+	// binds and draws
 	void Draw();
 
 private:
-	unsigned int vboID, iboID;
+	void CalculateBounds();
+	void Upload();
+	void ReleaseBuffers();
+
+	unsigned int id;
+	unsigned int vboID = 0, iboID = 0;
+	bool uploaded = false;
+	Vector3 boundsCenter;
+	float boundsRadius = 0.0f;
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 
 	Material material;
+	std::string source_path;
 };
 
@@ -1,6 +1,8 @@
 #include "ObjLoader.h"
 #include "../Math/vector2.h"
 #include "../Math/vector3.h"
+#include "../Profiling/Profiler.h"
+#include "../Memory/StlAllocators.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -85,20 +87,25 @@ ObjFace ParseObjIndex(const std::string &token)
 	return res;
 }
 
-std::shared_ptr<Mesh> ObjLoader::LoadMesh(const std::string &path)
+MeshHandle ObjLoader::LoadMesh(const std::string &path)
 {
-	std::vector<Vector3> positions;
-	std::vector<Vector3> normals;
-	std::vector<Vector2> texcoords;
+	PROFILE("ObjLoader::LoadMesh");
+	MemoryTagScope memory_tag(MemoryTag::Meshes);
 
-	std::vector<ObjFace> obj_faces;
+	// the file's own lists are only needed until the mesh is built
+	ScratchScope scratch;
+	ScratchVector<Vector3> positions;
+	ScratchVector<Vector3> normals;
+	ScratchVector<Vector2> texcoords;
+
+	ScratchVector<ObjFace> obj_faces;
 
 	std::ifstream file;
 	file.open(path);
 
 	if (!file.is_open()) {
 		std::cout << "Invalid file: " << path << ".\n";
-		return nullptr;
+		return MeshHandle();
 	}
 
 	std::string line;
@@ -153,6 +160,7 @@ std::shared_ptr<Mesh> ObjLoader::LoadMesh(const std::string &path)
 	const bool has_texcoords = !texcoords.empty();
 
 	std::vector<Vertex> final_vertices;
+	final_vertices.reserve(obj_faces.size());
 	for (auto face : obj_faces) {
 		Vertex vertex;
 
@@ -181,9 +189,12 @@ std::shared_ptr<Mesh> ObjLoader::LoadMesh(const std::string &path)
 	}
 
 	std::vector<unsigned int> final_faces;
+	final_faces.reserve(final_vertices.size());
 	for (size_t i = 0; i < final_vertices.size(); i++) {
 		final_faces.push_back(i);
 	}
 
-	return std::make_shared<Mesh>(final_vertices, final_faces);
+	const MeshHandle mesh = Mesh::pool.Create(final_vertices, final_faces);
+	Mesh::pool.Get(mesh)->SetSourcePath(path);
+	return mesh;
 }
\ No newline at end of file
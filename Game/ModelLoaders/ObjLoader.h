@@ -2,9 +2,9 @@
 #include "../Mesh.h"
 
 #include <string>
-#include <memory>
 
 class ObjLoader {
 public:
-	std::shared_ptr<Mesh> LoadMesh(const std::string &path);
+	// the mesh is created in Mesh::pool. a null handle if the file can't be opened.
+	MeshHandle LoadMesh(const std::string &path);
 };
\ No newline at end of file
@@ -0,0 +1,18 @@
+#include "PhysicsMotionState.h"
+#include "PhysicsWorld.h"
+
+PhysicsMotionState::PhysicsMotionState(PhysicsWorld *world, size_t body_id, const btTransform &start_transform)
+	: transform(start_transform), world(world), body_id(body_id)
+{
+}
+
+void PhysicsMotionState::getWorldTransform(btTransform &trans) const
+{
+	trans = transform;
+}
+
+void PhysicsMotionState::setWorldTransform(const btTransform &trans)
+{
+	transform = trans;
+	world->OnBodyMoved(this, trans);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "LinearMath/btMotionState.h"
+
+#include <cstddef>
+
+class PhysicsWorld;
+
+// motion state that writes the transforms bullet calculates straight into the physics world's
+// transform storage. bullet only calls setWorldTransform for active bodies, so sleeping and static
+// bodies are never touched and the per-frame sync only visits bodies that actually moved.
+ATTRIBUTE_ALIGNED16(class) PhysicsMotionState : public btMotionState
+{
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	PhysicsMotionState(PhysicsWorld *world, size_t body_id, const btTransform &start_transform);
+
+	void getWorldTransform(btTransform &trans) const override;
+	void setWorldTransform(const btTransform &trans) override;
+
+	inline size_t GetBodyId() const { return body_id; }
+	inline void SetBodyId(size_t id) { body_id = id; }
+
+	// set when the transform changed since the world last synced this body
+	bool dirty = false;
+
+private:
+	btTransform transform;
+	PhysicsWorld *world;
+	size_t body_id;
+};
+
@@ -0,0 +1,525 @@
+#include "PhysicsShapeCache.h"
+
+#include "BulletCollision/CollisionShapes/btShapeHull.h"
+#include "LinearMath/btConvexHullComputer.h"
+#include "Profiling/Profiler.h"
+
+#include <tuple>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// header of the .bvh sidecar files written next to static models. the bvh itself follows
+// in bullet's in-place serialization format, so it can be used straight from the loaded buffer.
+struct BvhCacheHeader
+{
+	char magic[4];
+	unsigned int version;
+	unsigned int num_vertices;
+	unsigned int num_indices;
+	// checksum of the vertex positions and indices the bvh was built for
+	unsigned int checksum;
+	unsigned int bvh_size;
+	float aabb_min[3];
+	float aabb_max[3];
+};
+
+static const char BVH_CACHE_MAGIC[4] = { 'M', '5', 'B', 'V' };
+static const unsigned int BVH_CACHE_VERSION = 1;
+
+static unsigned int MeshChecksum(const Mesh &mesh)
+{
+	// FNV-1a over everything that affects the bvh
+	unsigned int hash = 2166136261u;
+
+	auto add_bytes = [&hash](const void *data, size_t size) {
+		const unsigned char *bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 16777619u;
+		}
+	};
+
+	for (auto &&vertex : mesh.GetVertices()) {
+		add_bytes(&vertex.x, sizeof(float) * 3);
+	}
+
+	add_bytes(mesh.GetIndices().data(), sizeof(unsigned int) * mesh.GetIndices().size());
+
+	return hash;
+}
+
+// loads a bvh sidecar into a 16 byte aligned buffer and deserializes it in place.
+// returns nullptr if the file is missing, damaged or was built for different mesh data.
+static btOptimizedBvh *LoadCachedBvh(const std::string &path, const Mesh &mesh, unsigned int checksum,
+	btVector3 &aabb_min, btVector3 &aabb_max, void **buffer)
+{
+	std::ifstream file;
+	file.open(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		return nullptr;
+	}
+
+	BvhCacheHeader header;
+	file.read((char*)&header, sizeof(header));
+
+	if (!file || memcmp(header.magic, BVH_CACHE_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != BVH_CACHE_VERSION
+		|| header.num_vertices != mesh.GetVertices().size()
+		|| header.num_indices != mesh.GetIndices().size()
+		|| header.checksum != checksum) {
+		return nullptr;
+	}
+
+	// a truncated or padded file would have the bvh read past its end or come up short
+	const std::streamoff data_start = file.tellg();
+	file.seekg(0, std::ios::end);
+	if (file.tellg() - data_start != std::streamoff(header.bvh_size)) {
+		return nullptr;
+	}
+	file.seekg(data_start);
+
+	void *data = btAlignedAlloc(header.bvh_size, 16);
+	file.read((char*)data, header.bvh_size);
+
+	if (!file) {
+		btAlignedFree(data);
+		return nullptr;
+	}
+
+	aabb_min = btVector3(header.aabb_min[0], header.aabb_min[1], header.aabb_min[2]);
+	aabb_max = btVector3(header.aabb_max[0], header.aabb_max[1], header.aabb_max[2]);
+
+	btOptimizedBvh *bvh = btOptimizedBvh::deSerializeInPlace(data, header.bvh_size, false);
+	if (bvh == nullptr) {
+		btAlignedFree(data);
+		return nullptr;
+	}
+
+	*buffer = data;
+	return bvh;
+}
+
+static void SaveCachedBvh(const std::string &path, const Mesh &mesh, unsigned int checksum, btBvhTriangleMeshShape *shape)
+{
+	const btOptimizedBvh *bvh = shape->getOptimizedBvh();
+
+	BvhCacheHeader header;
+	memcpy(header.magic, BVH_CACHE_MAGIC, sizeof(header.magic));
+	header.version = BVH_CACHE_VERSION;
+	header.num_vertices = mesh.GetVertices().size();
+	header.num_indices = mesh.GetIndices().size();
+	header.checksum = checksum;
+	header.bvh_size = bvh->calculateSerializeBufferSize();
+
+	for (int i = 0; i < 3; i++) {
+		header.aabb_min[i] = shape->getLocalAabbMin()[i];
+		header.aabb_max[i] = shape->getLocalAabbMax()[i];
+	}
+
+	void *data = btAlignedAlloc(header.bvh_size, 16);
+
+	if (bvh->serializeInPlace(data, header.bvh_size, false)) {
+		std::ofstream file;
+		file.open(path, std::ios::out | std::ios::binary);
+		file.write((char*)&header, sizeof(header));
+		file.write((char*)data, header.bvh_size);
+		file.close();
+	}
+
+	btAlignedFree(data);
+}
+
+bool PhysicsShapeCache::ShapeKey::operator<(const ShapeKey &other) const
+{
+	return std::tie(mesh, x, y, z, convex) < std::tie(other.mesh, other.x, other.y, other.z, other.convex);
+}
+
+PhysicsShapeCache::PhysicsShapeCache()
+{
+}
+
+PhysicsShapeCache::~PhysicsShapeCache()
+{
+	// scaled shapes reference the base shapes, delete them first
+	for (btCollisionShape *shape : scaledShapes) {
+		delete shape;
+	}
+
+	for (auto &&it : baseHulls) {
+		delete it.second;
+	}
+
+	for (auto &&it : baseTriangleMeshes) {
+		delete it.second;
+	}
+
+	for (btMipHeightfieldTerrainShape *shape : terrainShapes) {
+		delete shape;
+	}
+
+	for (auto &&it : terrainGrids) {
+		delete it.second;
+	}
+
+	for (void *buffer : bvhBuffers) {
+		btAlignedFree(buffer);
+	}
+
+	for (btStridingMeshInterface *mesh_interface : meshInterfaces) {
+		delete mesh_interface;
+	}
+}
+
+btCollisionShape *PhysicsShapeCache::GetConvexShape(MeshHandle mesh, const Vector3 &scale)
+{
+	const ShapeKey key { mesh, scale.x, scale.y, scale.z, true };
+
+	auto it = shapes.find(key);
+	if (it != shapes.end()) {
+		return it->second;
+	}
+
+	btConvexHullShape *base = GetBaseHull(mesh);
+	btCollisionShape *shape;
+
+	if (scale == Vector3::One()) {
+		shape = base;
+	} else if (scale.x == scale.y && scale.x == scale.z) {
+		shape = new btUniformScalingShape(base, scale.x);
+	} else {
+		// no wrapper for non-uniform scaling of convex shapes, but the simplified hull is cheap to copy
+		btConvexHullShape *hull = new btConvexHullShape(&base->getUnscaledPoints()->x(), base->getNumPoints(), sizeof(btVector3));
+		hull->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
+		shape = hull;
+	}
+
+	if (shape != base) {
+		scaledShapes.push_back(shape);
+	}
+
+	shapes[key] = shape;
+	return shape;
+}
+
+btCollisionShape *PhysicsShapeCache::GetTriangleMeshShape(MeshHandle mesh, const Vector3 &scale)
+{
+	const ShapeKey key { mesh, scale.x, scale.y, scale.z, false };
+
+	auto it = shapes.find(key);
+	if (it != shapes.end()) {
+		return it->second;
+	}
+
+	if (useTerrainShapes) {
+		const TerrainGrid *grid = GetTerrainGrid(mesh);
+		if (grid != nullptr) {
+			btMipHeightfieldTerrainShape *terrain = new btMipHeightfieldTerrainShape(grid->width, grid->length, grid->heights.data(),
+				btVector3(grid->origin.x, grid->origin.y, grid->origin.z), btVector3(grid->spacing.x, grid->spacing.y, grid->spacing.z),
+				grid->flipQuadEdges);
+			terrain->setUseDiamondSubdivision(grid->diamondSubdivision);
+			terrain->setUseZigzagSubdivision(grid->zigzagSubdivision);
+			terrain->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
+			terrainShapes.push_back(terrain);
+
+			shapes[key] = terrain;
+			return terrain;
+		}
+	}
+
+	btBvhTriangleMeshShape *base = GetBaseTriangleMesh(mesh);
+	btCollisionShape *shape;
+
+	if (scale == Vector3::One()) {
+		shape = base;
+	} else {
+		// shares the base shape's bvh
+		shape = new btScaledBvhTriangleMeshShape(base, btVector3(scale.x, scale.y, scale.z));
+		scaledShapes.push_back(shape);
+	}
+
+	shapes[key] = shape;
+	return shape;
+}
+
+btConvexHullShape *PhysicsShapeCache::GetBaseHull(MeshHandle mesh)
+{
+	auto it = baseHulls.find(mesh);
+	if (it != baseHulls.end()) {
+		return it->second;
+	}
+
+	PROFILE("PhysicsShapeCache::GetBaseHull");
+
+	const Mesh &mesh_data = *Mesh::pool.Get(mesh);
+	auto &vertices = mesh_data.GetVertices();
+	if (vertices.empty()) {
+		throw "mesh has no vertices";
+	}
+
+	// reduce the mesh to the vertices on its convex hull, dropping duplicates and interior points
+	btConvexHullComputer computer;
+	computer.compute(&vertices[0].x, sizeof(Vertex), int(vertices.size()), 0.0f, 0.0f);
+
+	btConvexHullShape *hull = new btConvexHullShape(&computer.vertices[0].x(), computer.vertices.size(), sizeof(btVector3));
+
+	if (hull->getNumPoints() > maxHullVertices) {
+		// still too detailed, approximate it with the support points in a fixed set of directions
+		btShapeHull simplified(hull);
+		simplified.buildHull(hull->getMargin());
+
+		btConvexHullShape *simplified_hull = new btConvexHullShape(&simplified.getVertexPointer()->x(),
+			simplified.numVertices(), sizeof(btVector3));
+
+		delete hull;
+		hull = simplified_hull;
+	}
+
+	hull->recalcLocalAabb();
+
+	baseHulls[mesh] = hull;
+
+	return hull;
+}
+
+btBvhTriangleMeshShape *PhysicsShapeCache::GetBaseTriangleMesh(MeshHandle mesh)
+{
+	auto it = baseTriangleMeshes.find(mesh);
+	if (it != baseTriangleMeshes.end()) {
+		return it->second;
+	}
+
+	PROFILE("PhysicsShapeCache::GetBaseTriangleMesh");
+
+	const Mesh &mesh_data = *Mesh::pool.Get(mesh);
+	auto &vertices = mesh_data.GetVertices();
+	auto &indices = mesh_data.GetIndices();
+	if (vertices.empty() || indices.size() < 3) {
+		throw "mesh has no triangles";
+	}
+
+	// bullet reads the triangles straight out of the mesh's own vertex and index data
+	btTriangleIndexVertexArray *mesh_interface = new btTriangleIndexVertexArray(
+		int(indices.size() / 3), (int*)&indices[0], 3 * sizeof(unsigned int),
+		int(vertices.size()), (btScalar*)&vertices[0].x, sizeof(Vertex));
+
+	btBvhTriangleMeshShape *shape = nullptr;
+
+	if (!mesh_data.GetSourcePath().empty()) {
+		const std::string cache_path = mesh_data.GetSourcePath() + ".bvh";
+		const unsigned int checksum = MeshChecksum(mesh_data);
+
+		btVector3 aabb_min, aabb_max;
+		void *buffer = nullptr;
+		btOptimizedBvh *bvh = LoadCachedBvh(cache_path, mesh_data, checksum, aabb_min, aabb_max, &buffer);
+
+		if (bvh != nullptr) {
+			// skip both the aabb pass and the bvh build
+			mesh_interface->setPremadeAabb(aabb_min, aabb_max);
+			shape = new btBvhTriangleMeshShape(mesh_interface, true, false);
+			shape->setOptimizedBvh(bvh);
+			bvhBuffers.push_back(buffer);
+		} else {
+			shape = new btBvhTriangleMeshShape(mesh_interface, true);
+			SaveCachedBvh(cache_path, mesh_data, checksum, shape);
+		}
+	} else {
+		shape = new btBvhTriangleMeshShape(mesh_interface, true);
+	}
+
+	baseTriangleMeshes[mesh] = shape;
+	meshInterfaces.push_back(mesh_interface);
+
+	return shape;
+}
+
+const PhysicsShapeCache::TerrainGrid *PhysicsShapeCache::GetTerrainGrid(MeshHandle mesh)
+{
+	auto it = terrainGrids.find(mesh);
+	if (it != terrainGrids.end()) {
+		return it->second;
+	}
+
+	TerrainGrid *grid = new TerrainGrid();
+	if (!DetectTerrainGrid(*Mesh::pool.Get(mesh), *grid)) {
+		delete grid;
+		grid = nullptr;
+	}
+
+	// remember meshes that aren't grids too, so they are only looked at once
+	terrainGrids[mesh] = grid;
+
+	return grid;
+}
+
+bool PhysicsShapeCache::DetectTerrainGrid(const Mesh &mesh, TerrainGrid &grid)
+{
+	auto &vertices = mesh.GetVertices();
+	auto &indices = mesh.GetIndices();
+
+	if (vertices.size() < 4 || indices.size() < 6 || indices.size() % 3 != 0) {
+		return false;
+	}
+
+	Vector3 min(vertices[0].x, vertices[0].y, vertices[0].z);
+	Vector3 max = min;
+	for (auto &&vertex : vertices) {
+		min = Vector3(std::min(min.x, vertex.x), std::min(min.y, vertex.y), std::min(min.z, vertex.z));
+		max = Vector3(std::max(max.x, vertex.x), std::max(max.y, vertex.y), std::max(max.z, vertex.z));
+	}
+
+	// how far a vertex may be off its grid point, or from another vertex at the same grid point
+	const float epsilon = 1e-4f * std::max(max.x - min.x, max.z - min.z);
+	if (!(epsilon > 0.0f)) {
+		return false;
+	}
+
+	// the distinct x (or z) values of the vertices must be evenly spaced
+	auto find_axis = [&vertices, epsilon](float Vertex::*coord, float min_value, float max_value, int &count, float &spacing) {
+		std::vector<float> values;
+		values.reserve(vertices.size());
+		for (auto &&vertex : vertices) {
+			values.push_back(vertex.*coord);
+		}
+		std::sort(values.begin(), values.end());
+
+		count = 1;
+		for (size_t i = 1; i < values.size(); i++) {
+			if (values[i] - values[i - 1] > epsilon) {
+				count++;
+			}
+		}
+		if (count < 2 || count > 32768) {
+			return false;
+		}
+
+		spacing = (max_value - min_value) / float(count - 1);
+		return spacing > 2.0f * epsilon;
+	};
+
+	float spacing_x, spacing_z;
+	if (!find_axis(&Vertex::x, min.x, max.x, grid.width, spacing_x) || !find_axis(&Vertex::z, min.z, max.z, grid.length, spacing_z)) {
+		return false;
+	}
+
+	if (size_t(grid.width) * size_t(grid.length) > vertices.size()) {
+		return false;
+	}
+
+	// every vertex sits on a grid point, and every grid point has a single height
+	std::vector<int> grid_points(vertices.size());
+	std::vector<float> heights(grid.width * grid.length);
+	std::vector<bool> has_height(grid.width * grid.length, false);
+	const float height_epsilon = 1e-4f * std::max(max.y - min.y, epsilon);
+
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const int x = int(std::lround((vertices[i].x - min.x) / spacing_x));
+		const int z = int(std::lround((vertices[i].z - min.z) / spacing_z));
+		if (std::fabs(min.x + x * spacing_x - vertices[i].x) > epsilon || std::fabs(min.z + z * spacing_z - vertices[i].z) > epsilon) {
+			return false;
+		}
+
+		const int point = z * grid.width + x;
+		if (has_height[point]) {
+			if (std::fabs(heights[point] - vertices[i].y) > height_epsilon) {
+				return false;
+			}
+		} else {
+			heights[point] = vertices[i].y;
+			has_height[point] = true;
+		}
+		grid_points[i] = point;
+	}
+
+	if (std::find(has_height.begin(), has_height.end(), false) != has_height.end()) {
+		return false;
+	}
+
+	// every cell is split into two triangles along one of its diagonals. bit 0 of a cell is set by a triangle
+	// on the (x, z + 1) - (x + 1, z) diagonal missing the (x, z) corner, bit 1 by the one missing the (x + 1, z + 1)
+	// corner, bits 2 and 3 likewise for the other diagonal.
+	const int cells_x = grid.width - 1;
+	const int cells_z = grid.length - 1;
+	if (indices.size() / 3 != size_t(cells_x) * size_t(cells_z) * 2) {
+		return false;
+	}
+
+	std::vector<unsigned char> cells(cells_x * cells_z, 0);
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		int xs[3], zs[3];
+		for (int k = 0; k < 3; k++) {
+			if (indices[i + k] >= vertices.size()) {
+				return false;
+			}
+			const int point = grid_points[indices[i + k]];
+			xs[k] = point % grid.width;
+			zs[k] = point / grid.width;
+		}
+
+		const int x = std::min({ xs[0], xs[1], xs[2] });
+		const int z = std::min({ zs[0], zs[1], zs[2] });
+		if (std::max({ xs[0], xs[1], xs[2] }) != x + 1 || std::max({ zs[0], zs[1], zs[2] }) != z + 1) {
+			return false;
+		}
+
+		// the corners of the cell the triangle covers, as bits of (x offset + 2 * z offset)
+		int corners = 0;
+		for (int k = 0; k < 3; k++) {
+			corners |= 1 << ((xs[k] - x) + 2 * (zs[k] - z));
+		}
+
+		int bit;
+		switch (corners) {
+		case 0xe: bit = 1; break;	// missing (x, z)
+		case 0x7: bit = 2; break;	// missing (x + 1, z + 1)
+		case 0xd: bit = 4; break;	// missing (x + 1, z)
+		case 0xb: bit = 8; break;	// missing (x, z + 1)
+		default: return false;		// two vertices at the same grid point
+		}
+
+		unsigned char &cell = cells[z * cells_x + x];
+		if (cell & bit) {
+			return false;
+		}
+		cell |= bit;
+	}
+
+	// the split of each cell has to follow one of the patterns btHeightfieldTerrainShape knows
+	bool all_default = true, all_flipped = true, diamond = true, zigzag = true;
+	for (int z = 0; z < cells_z; z++) {
+		for (int x = 0; x < cells_x; x++) {
+			const unsigned char cell = cells[z * cells_x + x];
+			if (cell != 0x3 && cell != 0xc) {
+				return false;
+			}
+			const bool flipped = cell == 0xc;
+			all_default = all_default && !flipped;
+			all_flipped = all_flipped && flipped;
+			diamond = diamond && flipped == !((x + z) & 1);
+			zigzag = zigzag && flipped == !(z & 1);
+		}
+	}
+
+	if (all_flipped) {
+		grid.flipQuadEdges = true;
+	} else if (diamond) {
+		grid.diamondSubdivision = true;
+	} else if (zigzag) {
+		grid.zigzagSubdivision = true;
+	} else if (!all_default) {
+		return false;
+	}
+
+	// height = origin.y + q * spacing.y, with q spanning the whole range of a short
+	const float range = max.y - min.y;
+	const float height_scale = range > 0.0f ? range / 65535.0f : 1.0f;
+	grid.origin = Vector3(min.x, min.y + 32768.0f * height_scale, min.z);
+	grid.spacing = Vector3(spacing_x, height_scale, spacing_z);
+	grid.heights.resize(heights.size());
+	for (size_t i = 0; i < heights.size(); i++) {
+		const long q = std::lround((heights[i] - min.y) / height_scale) - 32768;
+		grid.heights[i] = short(std::max(-32768L, std::min(32767L, q)));
+	}
+
+	return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "Mesh.h"
+#include "Math/vector3.h"
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/CollisionShapes/btMipHeightfieldTerrainShape.h"
+
+#include <map>
+#include <vector>
+
+// owns the collision shapes of a physics world and shares them between all bodies using the same
+// mesh. each mesh gets one unscaled base shape; other scales wrap that base shape instead of
+// building a new one. triangle mesh bvhs are cached in a .bvh file next to the mesh's source file.
+// static meshes that turn out to be a regular grid of height samples (e.g. exported terrain) become
+// heightfields instead, which take a fraction of the memory of a bvh and are faster to collide with.
+// bvh shapes read the triangles out of the mesh itself, so a mesh has to outlive the cache.
+class PhysicsShapeCache
+{
+public:
+	PhysicsShapeCache();
+	~PhysicsShapeCache();
+
+	// convex hull of the mesh, for dynamic bodies
+	btCollisionShape *GetConvexShape(MeshHandle mesh, const Vector3 &scale);
+	// exact triangle mesh with a bvh, or a heightfield for grid meshes, for static bodies
+	btCollisionShape *GetTriangleMeshShape(MeshHandle mesh, const Vector3 &scale);
+
+	// hulls with more points than this are simplified before use
+	inline void SetMaxHullVertices(int count) { maxHullVertices = count; }
+	// when disabled, grid meshes get a bvh like any other static mesh
+	inline void SetUseTerrainShapes(bool use) { useTerrainShapes = use; }
+
+private:
+	struct ShapeKey
+	{
+		MeshHandle mesh;
+		float x, y, z;
+		bool convex;
+
+		bool operator<(const ShapeKey &other) const;
+	};
+
+	// heights of a mesh whose vertices lie on a regular grid in x and z, quantized to 16 bits.
+	// grid point (x, z) is at origin + (x, heights[z * width + x], z) * spacing.
+	struct TerrainGrid
+	{
+		int width, length;
+		Vector3 origin, spacing;
+		// which diagonal splits the cells, see btHeightfieldTerrainShape
+		bool flipQuadEdges = false;
+		bool diamondSubdivision = false;
+		bool zigzagSubdivision = false;
+		std::vector<short> heights;
+	};
+
+	btConvexHullShape *GetBaseHull(MeshHandle mesh);
+	btBvhTriangleMeshShape *GetBaseTriangleMesh(MeshHandle mesh);
+	// nullptr if the mesh isn't a grid
+	const TerrainGrid *GetTerrainGrid(MeshHandle mesh);
+	static bool DetectTerrainGrid(const Mesh &mesh, TerrainGrid &grid);
+
+	// scaled shapes keyed by (mesh, scale)
+	std::map<ShapeKey, btCollisionShape*> shapes;
+	std::vector<btCollisionShape*> scaledShapes;
+	std::map<MeshHandle, btConvexHullShape*> baseHulls;
+	std::map<MeshHandle, btBvhTriangleMeshShape*> baseTriangleMeshes;
+	std::map<MeshHandle, TerrainGrid*> terrainGrids;
+	// one per scale, they only share the heights
+	std::vector<btMipHeightfieldTerrainShape*> terrainShapes;
+	std::vector<btStridingMeshInterface*> meshInterfaces;
+	// buffers holding bvhs deserialized in place from .bvh sidecar files
+	std::vector<void*> bvhBuffers;
+
+	int maxHullVertices = 42;
+	bool useTerrainShapes = true;
+};
+
@@ -0,0 +1,49 @@
+#include "PhysicsTaskScheduler.h"
+#include "Profiling/Profiler.h"
+
+#include <algorithm>
+
+PhysicsTaskScheduler::PhysicsTaskScheduler(JobSystem *jobs)
+	: btITaskScheduler("JobSystem"), jobs(jobs), numThreads(jobs->GetThreadCount())
+{
+}
+
+int PhysicsTaskScheduler::getMaxNumThreads() const
+{
+	return jobs->GetThreadCount();
+}
+
+int PhysicsTaskScheduler::getNumThreads() const
+{
+	return numThreads;
+}
+
+void PhysicsTaskScheduler::setNumThreads(int num_threads)
+{
+	numThreads = std::min(std::max(num_threads, 1), jobs->GetThreadCount());
+}
+
+void PhysicsTaskScheduler::parallelFor(int begin, int end, int grain_size, const btIParallelForBody &body)
+{
+	PROFILE("parallelFor_Jobs");
+
+	const int count = end - begin;
+	if (count <= 0) {
+		return;
+	}
+
+	// nested loops, tiny loops and a single thread run right here, like bullet's own schedulers
+	if (numThreads <= 1 || count <= grain_size || btThreadsAreRunning()) {
+		body.forLoop(begin, end);
+		return;
+	}
+
+	// no more ranges than the default scheduler would make for numThreads threads
+	const int grain = std::max(grain_size, (count + numThreads * 4 - 1) / (numThreads * 4));
+
+	btPushThreadsAreRunning();
+	jobs->ParallelFor(size_t(begin), size_t(end), size_t(grain), [&body](size_t range_begin, size_t range_end) {
+		body.forLoop(int(range_begin), int(range_end));
+	});
+	btPopThreadsAreRunning();
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "Threading/JobSystem.h"
+
+#include "LinearMath/btThreads.h"
+
+// runs bullet's parallel loops (narrowphase, island solving, soft bodies) as jobs on the engine's
+// job system, so physics shares the worker threads with everything else instead of starting a
+// pool of its own. set it with btSetTaskScheduler() or hand it to PhysicsWorld.
+class PhysicsTaskScheduler : public btITaskScheduler
+{
+public:
+	// the job system is not owned and must outlive the scheduler
+	PhysicsTaskScheduler(JobSystem *jobs);
+
+	int getMaxNumThreads() const override;
+	int getNumThreads() const override;
+	// limits how many ranges a loop is split into, the job system keeps all its workers
+	void setNumThreads(int num_threads) override;
+	void parallelFor(int begin, int end, int grain_size, const btIParallelForBody &body) override;
+
+private:
+	JobSystem *jobs;
+	int numThreads;
+};
@@ -1,144 +1,668 @@
 #include "PhysicsWorld.h"
+#include "SceneGraph.h"
+#include "Profiling/Profiler.h"
+#include "Memory/MemoryTracker.h"
 
-PhysicsWorld::PhysicsWorld()
-{// Build the broadphase
-	broadphase = new btDbvtBroadphase();
+#include <chrono>
+#include <algorithm>
+
+static PhysicsTransform ToPhysicsTransform(const btTransform &trans)
+{
+	PhysicsTransform result;
+	result.translation = Vector3(trans.getOrigin().x(), trans.getOrigin().y(), trans.getOrigin().z());
+	// bullet rotations are the inverse of ours
+	result.rotation = Quaternion(trans.getRotation().x(), trans.getRotation().y(),
+		trans.getRotation().z(), trans.getRotation().w());
+	result.rotation.Invert();
+	return result;
+}
+
+PhysicsBody::PhysicsBody(PhysicsWorld *world, const btTransform &start_transform, btScalar mass,
+	btCollisionShape *shape, const btVector3 &local_inertia, GameObjectHandle object)
+	: motionState(world, 0, start_transform),
+	  body(btRigidBody::btRigidBodyConstructionInfo(mass, &motionState, shape, local_inertia)),
+	  object(object)
+{
+	body.setUserPointer(this);
+}
+
+PhysicsWorld::PhysicsWorld(bool soft_bodies, btITaskScheduler *task_scheduler)
+{
+	// bullet's own allocations are tagged by the hook, this covers what the engine adds to them
+	MemoryTagScope memory_tag(MemoryTag::Physics);
+
+	// Build the broadphase
+	broadphase = new btIncrementalDbvtBroadphase();
 
 	// Set up the collision configuration and dispatcher
-	collisionConfiguration = new btDefaultCollisionConfiguration();
-	dispatcher = new btCollisionDispatcher(collisionConfiguration);
+	if (soft_bodies) {
+		collisionConfiguration = new btSoftBodyRigidBodyCollisionConfiguration();
+	} else {
+		collisionConfiguration = new btDefaultCollisionConfiguration();
+	}
+
+	// Worker threads for the narrowphase and solver. Falls back to running everything on
+	// the stepping thread when bullet is built without BT_THREADSAFE.
+	if (task_scheduler != nullptr) {
+		taskScheduler = task_scheduler;
+	} else {
+		taskScheduler = btCreateDefaultTaskScheduler();
+		ownsTaskScheduler = true;
+	}
+	btSetTaskScheduler(taskScheduler != nullptr ? taskScheduler : btGetSequentialTaskScheduler());
+
+	dispatcher = new btCollisionDispatcherMt(collisionConfiguration);
+	// the shape cache hands out hulls, uniformly scaled hulls, (scaled) triangle meshes and heightfields
+	const int convex_types[] = { CONVEX_HULL_SHAPE_PROXYTYPE, UNIFORM_SCALING_SHAPE_PROXYTYPE };
+	const int concave_types[] = { TRIANGLE_MESH_SHAPE_PROXYTYPE, SCALED_TRIANGLE_MESH_SHAPE_PROXYTYPE, TERRAIN_SHAPE_PROXYTYPE };
+	for (int convex_type : convex_types) {
+		for (int concave_type : concave_types) {
+			dispatcher->registerCollisionCreateFunc(convex_type, concave_type, &convexConcaveCreateFunc);
+			dispatcher->registerCollisionCreateFunc(concave_type, convex_type, &concaveConvexCreateFunc);
+		}
+	}
 
 	// The actual physics solver
-	solver = new btSequentialImpulseConstraintSolver;
+	solver = new btConstraintSolverPoolMt(btGetTaskScheduler()->getMaxNumThreads());
 
 	// The world.
-	dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
+	if (soft_bodies) {
+		softBodySolver = new btDefaultSoftBodySolverMt();
+		softBodyWorld = new btSoftRigidDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration, softBodySolver);
+		dynamicsWorld = softBodyWorld;
+	} else {
+		largeIslandSolver = new btSequentialImpulseConstraintSolverMt();
+		dynamicsWorld = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, solver, collisionConfiguration, largeIslandSolver);
+	}
 	dynamicsWorld->setGravity(btVector3(0, -1, 0));
+	// static bodies never move, there is no need to hand their bounds to the broadphase every step
+	dynamicsWorld->setForceUpdateAllAabbs(false);
+
+	if (softBodyWorld != nullptr) {
+		// soft bodies have their own copy of the world settings
+		softBodyWorld->getWorldInfo().m_gravity = dynamicsWorld->getGravity();
+	}
+
+	rayTestBatch = new btRayTestBatch(dynamicsWorld, broadphase);
 }
 
 PhysicsWorld::~PhysicsWorld()
 {
+	StopThread();
+	ReleaseRemovedBodies();
+
+	for (btSoftBody *body : softBodies) {
+		softBodyWorld->removeSoftBody(body);
+		delete body;
+	}
+
+	delete rayTestBatch;
 	delete dynamicsWorld;
+	delete softBodySolver;
+	delete largeIslandSolver;
 	delete solver;
 	delete dispatcher;
 	delete collisionConfiguration;
 	delete broadphase;
 
-	// delete all objects
-	for (auto &&it : objects) {
-		btRigidBody *body = it.first.first;
-		btCollisionShape *shape = it.first.second;
-		if (body != nullptr) {
-			delete body->getMotionState();
-			delete body;
-		}
-		if (shape != nullptr) {
-			delete shape;
-		}
+	btSetTaskScheduler(nullptr);
+	if (ownsTaskScheduler) {
+		delete taskScheduler;
 	}
+
+	// delete all objects
+	bodyPool.Clear();
 }
 
-void PhysicsWorld::RegisterObject(std::shared_ptr<GameObject> object, double mass)
+PhysicsBodyHandle PhysicsWorld::RegisterObject(GameObjectHandle object_handle, double mass)
 {
+	PROFILE("PhysicsWorld::RegisterObject");
+	MemoryTagScope memory_tag(MemoryTag::Physics);
+
+	GameObject *object = GameObject::pool.Get(object_handle);
+	if (object == nullptr) {
+		throw "object was destroyed";
+	}
 	if (object->GetMesh() == nullptr) {
 		throw "no mesh attached to object";
 	}
+	if (object->GetScene() != nullptr && object->GetScene()->GetParent(*object) != nullptr) {
+		// bodies move their object in world space
+		throw "object with a body can't be attached to a parent";
+	}
 
 	btVector3 localInertia(0, 0, 0);
 	btCollisionShape *shape;
 
 	if (mass == 0.0) {
 		// static objects use triangle mesh shape
-		btTriangleMesh *trimesh = new btTriangleMesh();
+		shape = shapeCache.GetTriangleMeshShape(object->GetMeshHandle(), object->scale);
+	} else {
+		// use convex hull shape
+		shape = shapeCache.GetConvexShape(object->GetMeshHandle(), object->scale);
+		shape->calculateLocalInertia(mass, localInertia);
+	}
+
+	// bullet rotations are the inverse of ours
+	Quaternion rotation = object->rotation;
+	rotation.Invert();
+
+	const btTransform start_transform(btQuaternion(rotation.x, rotation.y, rotation.z, rotation.w),
+		btVector3(object->translation.x, object->translation.y, object->translation.z));
+
+	const PhysicsBodyHandle handle = bodyPool.Create(this, start_transform, btScalar(mass), shape, localInertia, object_handle);
+	PhysicsBody *body = bodyPool.Get(handle);
+	// the pool slot is the body id, it's only known once the body is created
+	body->motionState.SetBodyId(handle.index);
+
+	// the body only becomes part of the world once the physics thread picks up the command
+	PhysicsCommand command;
+	command.type = PhysicsCommand::ADD_BODY;
+	command.handle = handle;
+	command.body = &body->body;
+	QueueCommand(command);
+
+	return handle;
+}
+
+void PhysicsWorld::RemoveObject(PhysicsBodyHandle handle)
+{
+	PhysicsBody *body = bodyPool.Get(handle);
+	if (body == nullptr || body->removed) {
+		return;
+	}
+
+	// snapshots still in flight no longer reach the object
+	body->removed = true;
+	body->object = GameObjectHandle();
+
+	PhysicsCommand command;
+	command.type = PhysicsCommand::REMOVE_BODY;
+	command.handle = handle;
+	command.body = &body->body;
+	QueueCommand(command);
+
+	if (!threaded) {
+		ReleaseRemovedBodies();
+	}
+}
 
-		auto &mesh = object->GetMesh();
-		auto &vertices = mesh->GetVertices();
-		auto &indices = mesh->GetIndices();
+void PhysicsWorld::ReleaseRemovedBodies()
+{
+	btMutexLock(&removedBodiesMutex);
+	releasingBodies.swap(removedBodies);
+	btMutexUnlock(&removedBodiesMutex);
 
-		for (size_t i = 0; i < indices.size(); i += 3) {
-			Vertex v0 = vertices[indices[i]];
-			Vertex v1 = vertices[indices[i + 1]];
-			Vertex v2 = vertices[indices[i + 2]];
+	for (PhysicsBodyHandle handle : releasingBodies) {
+		bodyPool.Destroy(handle);
+	}
+	releasingBodies.clear();
+}
 
-			v0.x *= object->scale.x;
-			v0.y *= object->scale.y;
-			v0.z *= object->scale.z;
+void PhysicsWorld::ApplyImpulse(PhysicsBodyHandle handle, const Vector3 &impulse)
+{
+	PhysicsBody *body = bodyPool.Get(handle);
+	if (body == nullptr || body->removed) {
+		return;
+	}
 
-			v1.x *= object->scale.x;
-			v1.y *= object->scale.y;
-			v1.z *= object->scale.z;
+	PhysicsCommand command;
+	command.type = PhysicsCommand::APPLY_IMPULSE;
+	command.body = &body->body;
+	command.impulse = impulse;
+	QueueCommand(command);
+}
+
+btSoftBodyWorldInfo &PhysicsWorld::GetSoftBodyWorldInfo()
+{
+	if (softBodyWorld == nullptr) {
+		throw "physics world was created without soft bodies";
+	}
+
+	return softBodyWorld->getWorldInfo();
+}
+
+void PhysicsWorld::AddSoftBody(btSoftBody *body)
+{
+	if (softBodyWorld == nullptr) {
+		throw "physics world was created without soft bodies";
+	}
+
+	softBodies.push_back(body);
+
+	PhysicsCommand command;
+	command.type = PhysicsCommand::ADD_SOFT_BODY;
+	command.softBody = body;
+	QueueCommand(command);
+}
+
+void PhysicsWorld::RayCastBatch(const std::vector<PhysicsRay> &rays, std::vector<PhysicsRayHit> &hits)
+{
+	PROFILE("PhysicsWorld::RayCastBatch");
+
+	// the world can't change under the rays
+	std::unique_lock<std::mutex> step_lock(stepMutex, std::defer_lock);
+	if (threaded) {
+		step_lock.lock();
+	}
+
+	batchedRays.resize(rays.size());
+	for (size_t i = 0; i < rays.size(); i++) {
+		batchedRays[i] = btBatchedRay(btVector3(rays[i].from.x, rays[i].from.y, rays[i].from.z),
+			btVector3(rays[i].to.x, rays[i].to.y, rays[i].to.z));
+	}
+	batchedRayHits.resize(rays.size());
 
-			v2.x *= object->scale.x;
-			v2.y *= object->scale.y;
-			v2.z *= object->scale.z;
+	rayTestBatch->rayTest(batchedRays.data(), int(batchedRays.size()), batchedRayHits.data());
 
-			btVector3 bv0(v0.x, v0.y, v0.z);
-			btVector3 bv1(v1.x, v1.y, v1.z);
-			btVector3 bv2(v2.x, v2.y, v2.z);
+	hits.resize(rays.size());
+	for (size_t i = 0; i < rays.size(); i++) {
+		const btBatchedRayHit &result = batchedRayHits[i];
+		PhysicsRayHit &hit = hits[i];
 
-			trimesh->addTriangle(bv2, bv1, bv0);
+		hit.hit = result.hasHit();
+		hit.fraction = float(result.m_hitFraction);
+		hit.body = PhysicsBodyHandle();
+		if (!hit.hit) {
+			continue;
 		}
 
-		shape = new btBvhTriangleMeshShape(trimesh, true);//new btBoxShape(btVector3(1, 1, 1)); // TODO: calculate bounding box of object
-		// TODO: delete trimesh
-	} else {
-		// use convex hull shape
-		btConvexHullShape *hull = new btConvexHullShape();
+		hit.point = Vector3(result.m_hitPointWorld.x(), result.m_hitPointWorld.y(), result.m_hitPointWorld.z());
+		hit.normal = Vector3(result.m_hitNormalWorld.x(), result.m_hitNormalWorld.y(), result.m_hitNormalWorld.z());
 
-		auto &mesh = object->GetMesh();
-		auto &vertices = mesh->GetVertices();
-		auto &indices = mesh->GetIndices();
+		const btRigidBody *body = btRigidBody::upcast(result.m_collisionObject);
+		if (body != nullptr) {
+			const size_t id = static_cast<const PhysicsBody*>(body->getUserPointer())->motionState.GetBodyId();
+			hit.body = PhysicsBodyHandle { uint32_t(id), generations[id] };
+		}
+	}
+}
 
-		for (size_t i = 0; i < indices.size(); i++) {
-			Vertex v0 = vertices[indices[i]];
+void PhysicsWorld::QueueCommand(const PhysicsCommand &command)
+{
+	if (!threaded) {
+		ExecuteCommand(command);
+		return;
+	}
 
-			v0.x *= object->scale.x;
-			v0.y *= object->scale.y;
-			v0.z *= object->scale.z;
+	// the queue is only full if the physics thread is far behind, wait for it to catch up
+	while (!commands.Push(command)) {
+		std::this_thread::yield();
+	}
+}
 
-			btVector3 bv0(v0.x, v0.y, v0.z);
+void PhysicsWorld::ExecuteCommand(const PhysicsCommand &command)
+{
+	switch (command.type) {
+	case PhysicsCommand::ADD_BODY:
+	{
+		PhysicsMotionState *state = static_cast<PhysicsMotionState*>(command.body->getMotionState());
+		const size_t id = command.handle.index;
 
-			hull->addPoint(bv0);
+		if (id >= bodies.size()) {
+			bodies.resize(id + 1, nullptr);
+			transforms.resize(id + 1);
+			generations.resize(id + 1, 0);
 		}
+		bodies[id] = command.body;
+		generations[id] = command.handle.generation;
 
-		shape = hull;
+		// publish the starting transform like any other move
+		btTransform trans;
+		state->getWorldTransform(trans);
+		OnBodyMoved(state, trans);
 
-		shape->calculateLocalInertia(mass, localInertia);
+		dynamicsWorld->addRigidBody(command.body);
+		break;
 	}
+	case PhysicsCommand::REMOVE_BODY:
+	{
+		dynamicsWorld->removeRigidBody(command.body);
+		bodies[command.handle.index] = nullptr;
+		generations[command.handle.index] = 0;
 
-	btDefaultMotionState* motionState = new btDefaultMotionState(btTransform(
-		btQuaternion(0, 0, 0, 1), btVector3(object->translation.x, object->translation.y, object->translation.z)));
+		// the body may still be in the moved list, the game thread frees it once that is done with
+		btMutexLock(&removedBodiesMutex);
+		removedBodies.push_back(command.handle);
+		btMutexUnlock(&removedBodiesMutex);
+		break;
+	}
+	case PhysicsCommand::ADD_SOFT_BODY:
+		softBodyWorld->addSoftBody(command.softBody);
+		break;
+	case PhysicsCommand::APPLY_IMPULSE:
+		command.body->activate();
+		command.body->applyCentralImpulse(btVector3(command.impulse.x, command.impulse.y, command.impulse.z));
+		break;
+	}
+}
 
-	btRigidBody::btRigidBodyConstructionInfo rigidBodyCI(
-		mass,                  // mass
-		motionState,        // initial position
-		shape,              // collision shape of body
-		localInertia    // local inertia
-	);
+void PhysicsWorld::SetFixedTimeStep(double step_rate, int max_sub_steps)
+{
+	if (step_rate <= 0.0 || max_sub_steps < 1) {
+		throw "invalid fixed timestep settings";
+	}
 
-	btRigidBody *rigidBody = new btRigidBody(rigidBodyCI);
-	dynamicsWorld->addRigidBody(rigidBody);
+	fixedTimeStep = 1.0 / step_rate;
+	maxSubSteps = max_sub_steps;
+}
 
-	PhysicsObjectPair pair { {rigidBody, shape}, object  };
-	objects.push_back(pair);
+void PhysicsWorld::SetVariableTimeStep()
+{
+	maxSubSteps = 0;
 }
 
 void PhysicsWorld::Update(double dt)
 {
-	dynamicsWorld->stepSimulation(dt);
+	PROFILE("PhysicsWorld::Update");
 
-	// loop through all objects connected to the physics world
-	for (auto &&it : objects) {
-		btRigidBody *body = it.first.first;
-		std::shared_ptr<GameObject> &object = it.second;
+	if (threaded) {
+		ApplySnapshot();
+		InterpolateBodies();
+		ReleaseRemovedBodies();
+		return;
+	}
 
-		// update the object's position based on it's physics position.
-		btTransform trans;
-		body->getMotionState()->getWorldTransform(trans);
-		object->translation = Vector3(trans.getOrigin().x(), trans.getOrigin().y(), trans.getOrigin().z());
-		object->rotation = Quaternion(trans.getRotation().x(), trans.getRotation().y(), 
-			trans.getRotation().z(), trans.getRotation().w());
-		object->rotation.Invert();
+	if (maxSubSteps > 0) {
+		// bullet accumulates dt and runs as many fixed steps as fit, dropping any time
+		// beyond max_sub_steps so a slow frame can't spiral into ever longer steps.
+		dynamicsWorld->stepSimulation(dt, maxSubSteps, fixedTimeStep);
+	} else {
+		dynamicsWorld->stepSimulation(dt, 0);
+	}
+	broadphaseStats = broadphase->getStats();
+
+	SyncMovedBodies();
+}
+
+void PhysicsWorld::OnBodyMoved(PhysicsMotionState *state, const btTransform &trans)
+{
+	// each body is only moved by one thread at a time, so its own transform and dirty
+	// flag need no locking, only the shared list does
+	transforms[state->GetBodyId()] = ToPhysicsTransform(trans);
+
+	if (!state->dirty) {
+		state->dirty = true;
+
+		btMutexLock(&movedBodiesMutex);
+		movedBodies.push_back(state->GetBodyId());
+		btMutexUnlock(&movedBodiesMutex);
+	}
+}
+
+void PhysicsWorld::SyncMovedBodies()
+{
+	PROFILE("PhysicsWorld::SyncMovedBodies");
+
+	// in fixed timestep mode the motion states hold transforms interpolated to the
+	// current time between two steps.
+	for (size_t id : movedBodies) {
+		if (bodies[id] == nullptr) {
+			// removed since it moved
+			continue;
+		}
+
+		PhysicsBody *body = static_cast<PhysicsBody*>(bodies[id]->getUserPointer());
+		body->motionState.dirty = false;
+
+		GameObject *object = GameObject::pool.Get(body->object);
+		if (object == nullptr) {
+			continue;
+		}
+		object->translation = transforms[id].translation;
+		object->rotation = transforms[id].rotation;
+		object->UpdateMatrix();
+	}
+
+	movedBodies.clear();
+}
+
+void PhysicsWorld::StartThread()
+{
+	if (threaded) {
+		return;
+	}
+
+	if (maxSubSteps == 0) {
+		throw "threaded physics requires a fixed timestep";
+	}
+
+	// anything that moved in non-threaded mode has already been synced, but the snapshot
+	// buffers have not seen it. skip ahead so every buffer gets a full copy first.
+	stepCount += CHANGE_HISTORY;
+	historyStart = stepCount + 1;
+
+	threaded = true;
+	threadRunning.store(true, std::memory_order_release);
+	thread = std::thread(&PhysicsWorld::ThreadMain, this);
+}
+
+void PhysicsWorld::StopThread()
+{
+	if (!threaded) {
+		return;
+	}
+
+	threadRunning.store(false, std::memory_order_release);
+	thread.join();
+	threaded = false;
+
+	// pick up the last published step; from here on only bodies that move are synced
+	ApplySnapshot();
+	FinishInterpolation();
+
+	// anything queued after the thread's last pass still needs to run
+	PhysicsCommand command;
+	while (commands.Pop(command)) {
+		ExecuteCommand(command);
+	}
+	ReleaseRemovedBodies();
+}
+
+void PhysicsWorld::ThreadMain()
+{
+	typedef std::chrono::steady_clock Clock;
+
+	Profiler::SetThreadName("Physics");
+	MemoryTracker::SetCurrentTag(MemoryTag::Physics);
+
+	const auto step_duration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(fixedTimeStep));
+	auto next_step = Clock::now();
+
+	while (threadRunning.load(std::memory_order_acquire)) {
+		{
+			PROFILE("PhysicsWorld::Step");
+			std::lock_guard<std::mutex> step_lock(stepMutex);
+
+			PhysicsCommand command;
+			while (commands.Pop(command)) {
+				ExecuteCommand(command);
+			}
+
+			// exactly one step per pass; the loop below paces the steps in real time
+			dynamicsWorld->stepSimulation(btScalar(fixedTimeStep), 1, btScalar(fixedTimeStep));
+			stepCount++;
+
+			PublishSnapshot();
+		}
+
+		next_step += step_duration;
+		const auto now = Clock::now();
+
+		if (now - next_step > step_duration * maxSubSteps) {
+			// too far behind to catch up within max_sub_steps, drop the lost time
+			next_step = now;
+		} else {
+			std::this_thread::sleep_until(next_step);
+		}
+	}
+}
+
+void PhysicsWorld::PublishSnapshot()
+{
+	// move this step's moved bodies into the history
+	std::vector<size_t> &history = changeHistory[stepCount % CHANGE_HISTORY];
+	history.swap(movedBodies);
+	movedBodies.clear();
+
+	for (size_t id : history) {
+		if (bodies[id] != nullptr) {
+			static_cast<PhysicsMotionState*>(bodies[id]->getMotionState())->dirty = false;
+		}
+	}
+
+	const unsigned long long oldest_change = std::max(historyStart,
+		stepCount >= CHANGE_HISTORY ? stepCount - CHANGE_HISTORY + 1 : 1);
+
+	PhysicsSnapshot &snapshot = snapshots.GetWriteBuffer();
+
+	if (snapshot.step + 1 >= oldest_change) {
+		// the buffer is only a few steps old, just patch in what moved since
+		snapshot.transforms.resize(transforms.size());
+		snapshot.generations.resize(generations.size(), 0);
+
+		for (unsigned long long step = snapshot.step + 1; step <= stepCount; step++) {
+			for (size_t id : changeHistory[step % CHANGE_HISTORY]) {
+				snapshot.transforms[id] = transforms[id];
+				snapshot.generations[id] = generations[id];
+			}
+		}
+	} else {
+		snapshot.transforms = transforms;
+		snapshot.generations = generations;
+	}
+
+	snapshot.changes.clear();
+	for (unsigned long long step = oldest_change; step <= stepCount; step++) {
+		for (size_t id : changeHistory[step % CHANGE_HISTORY]) {
+			snapshot.changes.push_back(std::make_pair(step, id));
+		}
+	}
+
+	snapshot.step = stepCount;
+	snapshot.time = std::chrono::steady_clock::now();
+	snapshot.oldestChange = oldest_change;
+	snapshot.broadphaseStats = broadphase->getStats();
+	snapshots.Publish();
+}
+
+void PhysicsWorld::ApplySnapshot()
+{
+	if (!snapshots.Acquire()) {
+		// no new step since the last frame
+		return;
+	}
+
+	const PhysicsSnapshot &snapshot = snapshots.GetReadBuffer();
+
+	// whatever is still on its way to the previous snapshot gets there now
+	FinishInterpolation();
+
+	// the body ids in a snapshot may have been reused since, the generation tells them apart
+	auto get_body = [&](size_t id) -> PhysicsBody* {
+		PhysicsBody *body = bodyPool.Get(PhysicsBodyHandle { uint32_t(id), snapshot.generations[id] });
+		if (body == nullptr || GameObject::pool.Get(body->object) == nullptr) {
+			return nullptr;
+		}
+		return body;
+	};
+
+	if (appliedStep + 1 >= snapshot.oldestChange) {
+		// only the bodies that moved since the last snapshot we applied, each of them moves over
+		// the next step from where it is shown now to where the snapshot has it
+		for (auto &&change : snapshot.changes) {
+			if (change.first <= appliedStep) {
+				continue;
+			}
+			PhysicsBody *body = get_body(change.second);
+			if (body == nullptr || body->interpolating) {
+				continue;
+			}
+			const GameObject *object = GameObject::pool.Get(body->object);
+
+			PhysicsInterpolation interpolation;
+			interpolation.body = PhysicsBodyHandle { uint32_t(change.second), snapshot.generations[change.second] };
+			interpolation.from.translation = object->translation;
+			interpolation.from.rotation = object->rotation;
+			interpolation.to = snapshot.transforms[change.second];
+
+			// q and -q are the same rotation, take the one that turns the short way
+			const Quaternion &from = interpolation.from.rotation;
+			Quaternion &to = interpolation.to.rotation;
+			if (from.x * to.x + from.y * to.y + from.z * to.z + from.w * to.w < 0.0f) {
+				to = Quaternion(-to.x, -to.y, -to.z, -to.w);
+			}
+
+			body->interpolating = true;
+			interpolations.push_back(interpolation);
+		}
+	} else {
+		// too far behind to tell what moved, jump straight to the snapshot. bodies registered
+		// after the snapshot was taken keep their initial transform.
+		for (size_t id = 0; id < snapshot.transforms.size(); id++) {
+			PhysicsBody *body = get_body(id);
+			if (body == nullptr) {
+				continue;
+			}
+			GameObject *object = GameObject::pool.Get(body->object);
+			object->translation = snapshot.transforms[id].translation;
+			object->rotation = snapshot.transforms[id].rotation;
+			object->UpdateMatrix();
+		}
+	}
+
+	appliedStep = snapshot.step;
+	appliedTime = snapshot.time;
+	broadphaseStats = snapshot.broadphaseStats;
+}
+
+void PhysicsWorld::InterpolateBodies()
+{
+	if (interpolations.empty()) {
+		return;
+	}
+
+	// a step after the snapshot was taken the objects have caught up with it
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - appliedTime).count();
+	if (elapsed >= fixedTimeStep) {
+		FinishInterpolation();
+		return;
+	}
+	const float amount = float(std::max(elapsed, 0.0) / fixedTimeStep);
+
+	for (auto &&interpolation : interpolations) {
+		// removed bodies have no object any more
+		const PhysicsBody *body = bodyPool.Get(interpolation.body);
+		GameObject *object = body != nullptr ? GameObject::pool.Get(body->object) : nullptr;
+		if (object == nullptr) {
+			continue;
+		}
+
+		object->translation = interpolation.from.translation;
+		object->translation.Lerp(interpolation.to.translation, amount);
+		object->rotation = interpolation.from.rotation;
+		object->rotation.Slerp(interpolation.to.rotation, amount);
+		object->UpdateMatrix();
+	}
+}
+
+void PhysicsWorld::FinishInterpolation()
+{
+	for (auto &&interpolation : interpolations) {
+		PhysicsBody *body = bodyPool.Get(interpolation.body);
+		if (body == nullptr) {
+			continue;
+		}
+		body->interpolating = false;
+
+		GameObject *object = GameObject::pool.Get(body->object);
+		if (object == nullptr) {
+			continue;
+		}
+		object->translation = interpolation.to.translation;
+		object->rotation = interpolation.to.rotation;
 		object->UpdateMatrix();
 	}
-}
\ No newline at end of file
+
+	interpolations.clear();
+}
@@ -1,32 +1,272 @@
 #pragma once
 #include "GameObject.h"
+#include "PhysicsMotionState.h"
+#include "PhysicsShapeCache.h"
 
 #include "btBulletCollisionCommon.h"
 #include "btBulletDynamicsCommon.h"
+#include "BulletCollision/BroadphaseCollision/btIncrementalDbvtBroadphase.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletCollision/CollisionDispatch/btCachedConvexConcaveCollisionAlgorithm.h"
+#include "BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
+#include "BulletCollision/CollisionDispatch/btRayTestBatch.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "BulletSoftBody/btSoftRigidDynamicsWorld.h"
+#include "BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h"
+#include "BulletSoftBody/btDefaultSoftBodySolverMt.h"
+
+#include "Memory/Pool.h"
+#include "Threading/SpscQueue.h"
+#include "Threading/TripleBuffer.h"
 
 #include <vector>
 #include <utility>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+class PhysicsWorld;
+
+// a rigid body and the game object it moves. the motion state and body are stored in place, so
+// once the world's pool has grown, spawning a body doesn't allocate more than bullet itself does.
+ATTRIBUTE_ALIGNED16(struct) PhysicsBody
+{
+	PhysicsBody(PhysicsWorld *world, const btTransform &start_transform, btScalar mass, btCollisionShape *shape,
+		const btVector3 &local_inertia, GameObjectHandle object);
+
+	PhysicsMotionState motionState;
+	btRigidBody body;
+	GameObjectHandle object;
+	// set by RemoveObject(), the body stays in the pool until the physics thread let go of it
+	bool removed = false;
+	// the game thread is moving the object towards the newest snapshot
+	bool interpolating = false;
+};
+
+// the index doubles as the body id used by the motion states and snapshots
+typedef Handle<PhysicsBody> PhysicsBodyHandle;
+
+// world transform of a single body, in engine conventions
+struct PhysicsTransform
+{
+	Vector3 translation;
+	Quaternion rotation;
+};
+
+// body transforms published by the physics thread after each step
+struct PhysicsSnapshot
+{
+	// indexed by body id
+	std::vector<PhysicsTransform> transforms;
+	// generation of the body each transform belongs to, ids are reused once a body is removed
+	std::vector<uint32_t> generations;
+	// (step, body id) for every body that moved during the last few steps, oldest first
+	std::vector<std::pair<unsigned long long, size_t>> changes;
+	// number of steps simulated when this snapshot was taken, and when that was
+	unsigned long long step = 0;
+	std::chrono::steady_clock::time_point time;
+	// first step covered by `changes`. a reader that is further behind has to copy everything.
+	unsigned long long oldestChange = 0;
+	// what the broadphase did during the last step
+	btIncrementalBroadphaseStats broadphaseStats = {};
+};
+
+// an object moving from where it was shown when a snapshot came in to the snapshot's transform
+struct PhysicsInterpolation
+{
+	PhysicsBodyHandle body;
+	PhysicsTransform from;
+	PhysicsTransform to;
+};
+
+// a ray cast from `from` to `to`
+struct PhysicsRay
+{
+	Vector3 from;
+	Vector3 to;
+};
+
+// closest hit of a ray cast
+struct PhysicsRayHit
+{
+	// null if the ray hit nothing or hit a soft body
+	PhysicsBodyHandle body;
+	bool hit;
+	Vector3 point;
+	Vector3 normal;
+	// distance to the hit as a fraction of the ray length, 1 if nothing was hit
+	float fraction;
+};
+
+// work handed from the game thread to the physics thread
+struct PhysicsCommand
+{
+	enum Type {
+		ADD_BODY,
+		REMOVE_BODY,
+		ADD_SOFT_BODY,
+		APPLY_IMPULSE
+	};
 
-typedef std::pair<btRigidBody*, btCollisionShape*> PhysicsBodyInfo;
-typedef std::pair<PhysicsBodyInfo, std::shared_ptr<GameObject>> PhysicsObjectPair;
+	Type type;
+	PhysicsBodyHandle handle;
+	btRigidBody *body;
+	btSoftBody *softBody;
+	Vector3 impulse;
+};
 
 class PhysicsWorld
 {
 public:
-	PhysicsWorld();
+	// with soft_bodies the world is a btSoftRigidDynamicsWorld, which can also simulate cloth and
+	// other soft bodies. rigid body islands are then solved one after another.
+	// bullet's parallel loops run on task_scheduler (not owned), e.g. a PhysicsTaskScheduler on the
+	// engine's job system. without one the world starts bullet's default thread pool.
+	PhysicsWorld(bool soft_bodies=false, btITaskScheduler *task_scheduler=nullptr);
 	~PhysicsWorld();
 
-	void RegisterObject(std::shared_ptr<GameObject> object, double mass=1.0);
+	// adds an object to the simulation. the body keeps moving the object until either is
+	// destroyed; the object's mesh has to outlive the world.
+	PhysicsBodyHandle RegisterObject(GameObjectHandle object, double mass=1.0);
+	// takes the body out of the simulation and stops it moving its object. the handle is stale
+	// from here on, though the pool slot is only reused once the physics thread let go of it.
+	void RemoveObject(PhysicsBodyHandle body);
+
+	// soft bodies are created with btSoftBodyHelpers using this world info. the world takes
+	// ownership of the body.
+	btSoftBodyWorldInfo &GetSoftBodyWorldInfo();
+	void AddSoftBody(btSoftBody *body);
+	inline bool HasSoftBodies() const { return softBodyWorld != nullptr; }
+
+	// does nothing if the body was removed
+	void ApplyImpulse(PhysicsBodyHandle body, const Vector3 &impulse);
 
+	// casts all rays at once on the worker threads and stores the closest hit of rays[i] in
+	// hits[i]. much faster than casting one ray at a time when there are many. while threaded,
+	// the rays are cast between two steps and see the bodies where the physics thread has them,
+	// which may be a step ahead of the objects.
+	void RayCastBatch(const std::vector<PhysicsRay> &rays, std::vector<PhysicsRayHit> &hits);
+
+	// advances the simulation by dt seconds of real time. when threaded, this only moves the
+	// objects between the last two steps published by the physics thread, so they trail it by
+	// up to a step. objects in a scene graph are only marked as moved, the graph's next update
+	// carries the objects attached to them along.
 	void Update(double dt);
 
+	// runs the simulation on its own thread at the fixed timestep rate. the game thread
+	// never waits on the physics thread; bodies and impulses are queued to it instead.
+	void StartThread();
+	void StopThread();
+	inline bool IsThreaded() const { return threaded; }
+
+	// steps the simulation `step_rate` times per second, running at most `max_sub_steps`
+	// steps per Update(). object transforms are interpolated between steps.
+	void SetFixedTimeStep(double step_rate, int max_sub_steps);
+	// steps the simulation once per Update() using the frame's delta time
+	void SetVariableTimeStep();
+
+	// pair search statistics of the last step, for the profiler
+	inline const btIncrementalBroadphaseStats &GetBroadphaseStats() const { return broadphaseStats; }
+
+	inline double GetFixedTimeStep() const { return fixedTimeStep; }
+	inline int GetMaxSubSteps() const { return maxSubSteps; }
+
 private:
-	btBroadphaseInterface *broadphase; 
+	friend class PhysicsMotionState;
+
+	// called by motion states whenever bullet moves their body. bullet syncs motion
+	// states from its worker threads, so this may run for several bodies at once.
+	void OnBodyMoved(PhysicsMotionState *state, const btTransform &trans);
+	// copies the transforms of all bodies that moved into their game objects
+	void SyncMovedBodies();
+
+	void QueueCommand(const PhysicsCommand &command);
+	void ExecuteCommand(const PhysicsCommand &command);
+	// frees the bodies the physics thread is done with
+	void ReleaseRemovedBodies();
+	void ThreadMain();
+	void PublishSnapshot();
+	void ApplySnapshot();
+	// moves the objects along between the previous and the newest snapshot
+	void InterpolateBodies();
+	// moves the objects all the way to the newest snapshot
+	void FinishInterpolation();
+
+	// static bodies live in a tree of their own that is never searched for pairs, only
+	// bodies that moved look for new ones
+	btIncrementalDbvtBroadphase *broadphase;
+	btIncrementalBroadphaseStats broadphaseStats = {};
+	// a btSoftBodyRigidBodyCollisionConfiguration when soft bodies are enabled
 	btDefaultCollisionConfiguration* collisionConfiguration;
-	btCollisionDispatcher* dispatcher;
-	btSequentialImpulseConstraintSolver* solver;
+	// narrowphase runs over the overlapping pairs in parallel
+	btCollisionDispatcherMt* dispatcher;
+	// hulls against triangle meshes keep their contacts and separating axes across steps, and skip
+	// the triangles entirely while they rest
+	btGjkEpaPenetrationDepthSolver penetrationSolver;
+	btCachedConvexConcaveCollisionAlgorithm::CreateFunc convexConcaveCreateFunc { &penetrationSolver };
+	btCachedConvexConcaveCollisionAlgorithm::SwappedCreateFunc concaveConvexCreateFunc { &penetrationSolver };
+	// independent islands are solved in parallel, one solver per worker thread
+	btITaskScheduler *taskScheduler;
+	bool ownsTaskScheduler = false;
+	btConstraintSolverPoolMt* solver;
+	// a single large island (e.g. a pile of debris on the terrain) is solved in parallel batches instead
+	btSequentialImpulseConstraintSolverMt* largeIslandSolver = nullptr;
+	// soft bodies are predicted and solved in parallel, a large cloth is spread over all threads
+	btDefaultSoftBodySolverMt* softBodySolver = nullptr;
+	// either a btDiscreteDynamicsWorldMt or, with soft bodies, softBodyWorld
 	btDiscreteDynamicsWorld* dynamicsWorld;
+	btSoftRigidDynamicsWorld* softBodyWorld = nullptr;
+	// sorts ray batches into packets and walks the broadphase and meshes with them
+	btRayTestBatch* rayTestBatch;
+	std::vector<btBatchedRay> batchedRays;
+	std::vector<btBatchedRayHit> batchedRayHits;
+
+	// collision shapes are shared between bodies and owned by the cache
+	PhysicsShapeCache shapeCache;
+
+	// a max sub step count of zero means variable timestep
+	double fixedTimeStep = 1.0 / 60.0;
+	int maxSubSteps = 4;
+
+	// created and destroyed by the game thread only
+	Pool<PhysicsBody> bodyPool { MemoryTag::Physics };
+	std::vector<btSoftBody*> softBodies;
+
+	// removed from the simulation, to be released by the game thread
+	std::vector<PhysicsBodyHandle> removedBodies;
+	std::vector<PhysicsBodyHandle> releasingBodies;
+	btSpinMutex removedBodiesMutex;
+
+	// the following are indexed by body id and owned by the physics thread while threaded.
+	// removed bodies leave a nullptr behind until their id is reused.
+	std::vector<btRigidBody*> bodies;
+	std::vector<PhysicsTransform> transforms;
+	std::vector<uint32_t> generations;
+	// bodies whose transform changed since the last sync or snapshot
+	std::vector<size_t> movedBodies;
+	btSpinMutex movedBodiesMutex;
+
+	// ids of the bodies that moved during each of the last CHANGE_HISTORY steps,
+	// used to bring stale snapshot buffers up to date without copying every body
+	static const unsigned long long CHANGE_HISTORY = 8;
+	std::vector<size_t> changeHistory[CHANGE_HISTORY];
+	unsigned long long historyStart = 1;
+
+	std::thread thread;
+	std::atomic<bool> threadRunning { false };
+	// held by the physics thread while it steps, ray casts from the game thread wait for it
+	std::mutex stepMutex;
+	bool threaded = false;
 
-	std::vector<PhysicsObjectPair> objects;
+	SpscQueue<PhysicsCommand, 1024> commands;
+	TripleBuffer<PhysicsSnapshot> snapshots;
+	unsigned long long stepCount = 0;
+	// step of the last snapshot copied into the game objects, and when it was taken
+	unsigned long long appliedStep = 0;
+	std::chrono::steady_clock::time_point appliedTime;
+	// objects still on their way to the newest snapshot
+	std::vector<PhysicsInterpolation> interpolations;
 };
 
@@ -0,0 +1,174 @@
+#include "GpuProfiler.h"
+#include "Profiler.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstring>
+
+// the clocks drift apart slowly, pair them up again every so many frames
+static const int CALIBRATION_INTERVAL = 120;
+
+GpuProfiler::GpuProfiler()
+{
+	// timestamp queries need GL 3.3 or ARB_timer_query, and reading the gpu clock GL 3.2 or ARB_sync
+	if ((GLEW_VERSION_3_3 || GLEW_ARB_timer_query) && glGetInteger64v != nullptr) {
+		GLint bits = 0;
+		glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+		available = bits > 0;
+	}
+
+	if (!available) {
+		return;
+	}
+
+	for (Frame &frame : frames) {
+		glGenQueries(MAX_ZONES * 2, frame.queries);
+	}
+
+	track = Profiler::AddTrack("GPU");
+	Calibrate();
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	if (!available) {
+		return;
+	}
+
+	for (Frame &frame : frames) {
+		glDeleteQueries(MAX_ZONES * 2, frame.queries);
+	}
+}
+
+void GpuProfiler::BeginZone(const char *name)
+{
+	Frame &frame = frames[current];
+	if (!available || frame.zoneCount == MAX_ZONES) {
+		overflow++;
+		return;
+	}
+
+	const int zone = frame.zoneCount++;
+	frame.zones[zone].name = name;
+	frame.zones[zone].depth = uint32_t(depth);
+	zoneStack[depth++] = zone;
+
+	glQueryCounter(frame.queries[zone * 2], GL_TIMESTAMP);
+	frame.lastQuery = zone * 2;
+}
+
+void GpuProfiler::EndZone()
+{
+	if (overflow > 0) {
+		overflow--;
+		return;
+	}
+	if (depth == 0) {
+		return;
+	}
+
+	Frame &frame = frames[current];
+	const int zone = zoneStack[--depth];
+
+	glQueryCounter(frame.queries[zone * 2 + 1], GL_TIMESTAMP);
+	frame.lastQuery = zone * 2 + 1;
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!available) {
+		return;
+	}
+
+	// zones left open would never get their end timestamp
+	while (depth > 0) {
+		EndZone();
+	}
+	frames[current].pending = frames[current].zoneCount > 0;
+
+	// oldest first, stop at the first frame the gpu hasn't finished
+	for (int i = 1; i <= FRAME_LATENCY; i++) {
+		Frame &frame = frames[(current + i) % FRAME_LATENCY];
+		if (frame.pending && !Resolve(frame)) {
+			break;
+		}
+	}
+
+	current = (current + 1) % FRAME_LATENCY;
+
+	// the next frame reuses these queries, whatever they hold now is lost
+	Frame &next = frames[current];
+	if (next.pending) {
+		next.pending = false;
+		droppedFrames++;
+	}
+	next.zoneCount = 0;
+	next.lastQuery = -1;
+	depth = 0;
+	overflow = 0;
+
+	if (++framesSinceCalibration >= CALIBRATION_INTERVAL) {
+		Calibrate();
+	}
+}
+
+double GpuProfiler::GetZoneMilliseconds(const char *name) const
+{
+	for (int i = 0; i < lastZoneCount; i++) {
+		if (lastZones[i].name == name || std::strcmp(lastZones[i].name, name) == 0) {
+			return lastMilliseconds[i];
+		}
+	}
+	return -1.0;
+}
+
+bool GpuProfiler::Resolve(Frame &frame)
+{
+	GLint ready = 0;
+	glGetQueryObjectiv(frame.queries[frame.lastQuery], GL_QUERY_RESULT_AVAILABLE, &ready);
+	if (!ready) {
+		return false;
+	}
+
+	const double ticks_per_nanosecond = Profiler::GetTicksPerMillisecond() * 1.0e-6;
+	ProfileEvent events[MAX_ZONES];
+
+	for (int i = 0; i < frame.zoneCount; i++) {
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+		events[i].name = frame.zones[i].name;
+		events[i].depth = frame.zones[i].depth;
+		// zones can be older than the last calibration
+		events[i].start = uint64_t(int64_t(cpuReference) + int64_t(double(int64_t(start) - gpuReference) * ticks_per_nanosecond));
+		events[i].end = uint64_t(int64_t(cpuReference) + int64_t(double(int64_t(end) - gpuReference) * ticks_per_nanosecond));
+
+		lastZones[i] = frame.zones[i];
+		lastMilliseconds[i] = double(end - start) * 1.0e-6;
+	}
+	lastZoneCount = frame.zoneCount;
+
+	// the profiler keeps zones ordered by their end
+	std::sort(events, events + frame.zoneCount, [](const ProfileEvent &a, const ProfileEvent &b) {
+		return a.end < b.end;
+	});
+	for (int i = 0; i < frame.zoneCount; i++) {
+		Profiler::AddTrackEvent(track, events[i]);
+	}
+
+	frame.pending = false;
+	return true;
+}
+
+void GpuProfiler::Calibrate()
+{
+	// the gpu clock as of when all earlier commands reached the gpu, it doesn't wait for them to finish
+	GLint64 gpu_time = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+
+	gpuReference = int64_t(gpu_time);
+	cpuReference = Profiler::Now();
+	framesSinceCalibration = 0;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// times the enclosing scope on the gpu, see GpuProfiler
+#define GPU_PROFILE(profiler, name) GPU_PROFILE_SCOPE_NAME(__LINE__)(profiler, name)
+
+#define GPU_PROFILE_SCOPE_NAME(line) GPU_PROFILE_SCOPE_NAME_2(line)
+#define GPU_PROFILE_SCOPE_NAME_2(line) GpuProfileScope gpu_profile_scope_##line
+
+// times zones of gl commands with timestamp queries and adds them to the Profiler as a "GPU"
+// track, on the same timeline as the cpu zones.
+//
+// queries are only read back once the gpu is done with them, FRAME_LATENCY frames later at the
+// latest, so the cpu never waits on the gpu. the zones of a frame whose results still aren't
+// there by the time its queries are needed again are dropped.
+//
+// without timer queries (gl before 3.3 without ARB_timer_query, or an implementation with a
+// zero bit counter such as some software renderers) zones do nothing.
+//
+// must be created, used and destroyed on the thread that owns the gl context.
+class GpuProfiler
+{
+public:
+	GpuProfiler();
+	~GpuProfiler();
+
+	inline bool IsAvailable() const { return available; }
+
+	// zones nest and must be ended innermost first, within the same frame
+	void BeginZone(const char *name);
+	void EndZone();
+
+	// call once per frame after the last zone, collects the zones of finished frames
+	void EndFrame();
+
+	// duration of the last collected zone with this name, or a negative value if there is none
+	double GetZoneMilliseconds(const char *name) const;
+	// zones of frames that were dropped because their results came too late
+	inline uint64_t GetDroppedFrames() const { return droppedFrames; }
+
+	// frames in flight before their queries are reused
+	static const int FRAME_LATENCY = 4;
+	// zones recorded per frame, more are ignored
+	static const int MAX_ZONES = 64;
+
+private:
+	struct Zone
+	{
+		const char *name;
+		uint32_t depth;
+	};
+
+	struct Frame
+	{
+		// a begin and an end timestamp per zone
+		unsigned int queries[MAX_ZONES * 2];
+		Zone zones[MAX_ZONES];
+		int zoneCount = 0;
+		// query that was issued last, which is also the last to become available
+		int lastQuery = -1;
+		bool pending = false;
+	};
+
+	// reads the frame's timestamps and adds them to the profiler. false if not available yet.
+	bool Resolve(Frame &frame);
+	// pairs a gpu timestamp with a profiler tick, to move gpu times onto the cpu timeline
+	void Calibrate();
+
+	bool available = false;
+	size_t track = 0;
+
+	Frame frames[FRAME_LATENCY];
+	int current = 0;
+
+	int zoneStack[MAX_ZONES];
+	int depth = 0;
+	// zones begun while the frame was full that are still open
+	int overflow = 0;
+
+	int64_t gpuReference = 0;
+	uint64_t cpuReference = 0;
+	int framesSinceCalibration = 0;
+
+	uint64_t droppedFrames = 0;
+
+	// the last collected frame's zones, for GetZoneMilliseconds()
+	Zone lastZones[MAX_ZONES];
+	double lastMilliseconds[MAX_ZONES];
+	int lastZoneCount = 0;
+};
+
+// begins a gpu zone when constructed and ends it when destroyed, see GPU_PROFILE()
+class GpuProfileScope
+{
+public:
+	inline GpuProfileScope(GpuProfiler &profiler, const char *name) : profiler(profiler)
+	{
+		profiler.BeginZone(name);
+	}
+
+	inline ~GpuProfileScope()
+	{
+		profiler.EndZone();
+	}
+
+private:
+	GpuProfiler &profiler;
+};
@@ -0,0 +1,378 @@
+#include "Profiler.h"
+#include "../Threading/SpscQueue.h"
+#include "../Memory/MemoryTracker.h"
+
+#include "LinearMath/btQuickprof.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <new>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PROFILER_USE_RDTSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace {
+
+// finished zones a thread can hold until the game thread drains them
+const size_t RING_CAPACITY = 16384;
+// deeper zones are not recorded
+const uint32_t MAX_DEPTH = 64;
+
+struct ProfileThread
+{
+	// written by the owning thread only
+	SpscQueue<ProfileEvent, RING_CAPACITY> ring;
+	std::atomic<uint64_t> dropped { 0 };
+
+	// guarded by the registry mutex
+	std::string name;
+
+	// owned by the game thread
+	std::vector<ProfileEvent> events;
+};
+
+// the ring's ends sit on cache lines of their own, which operator new doesn't align for before c++17
+ProfileThread *NewProfileThread()
+{
+	void *memory = MemoryTracker::Allocate(sizeof(ProfileThread), alignof(ProfileThread), MemoryTag::General);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return new (memory) ProfileThread();
+}
+
+struct ProfileThreadDeleter
+{
+	void operator()(ProfileThread *thread) const
+	{
+		thread->~ProfileThread();
+		MemoryTracker::Free(thread);
+	}
+};
+
+// zones the calling thread is inside of
+struct OpenZones
+{
+	struct Zone
+	{
+		const char *name;
+		// zero if the profiler was disabled when the zone began
+		uint64_t start;
+	};
+
+	// allocated when the thread finishes its first zone
+	ProfileThread *thread;
+	uint32_t depth;
+	// zones begun past MAX_DEPTH that are still open
+	uint32_t overflow;
+	Zone stack[MAX_DEPTH];
+};
+
+thread_local OpenZones open_zones;
+
+std::atomic<bool> enabled { false };
+
+// threads are never removed, workers and their buffers live as long as the game
+std::mutex threads_mutex;
+std::vector<std::unique_ptr<ProfileThread, ProfileThreadDeleter>> threads;
+
+// the following are owned by the game thread
+size_t history_frames = 300;
+std::vector<ProfileFrame> frames;
+uint64_t frame_start = 0;
+double ticks_per_millisecond = 1.0e6;
+
+ProfileThread *RegisterThread()
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	threads.emplace_back(NewProfileThread());
+	threads.back()->name = "Thread " + std::to_string(threads.size() - 1);
+	return threads.back().get();
+}
+
+ProfileThread *GetThread()
+{
+	if (open_zones.thread == nullptr) {
+		open_zones.thread = RegisterThread();
+	}
+	return open_zones.thread;
+}
+
+void WriteJsonString(std::ostream &out, const char *text)
+{
+	out << '"';
+	for (const char *c = text; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			out << '\\';
+		}
+		out << *c;
+	}
+	out << '"';
+}
+
+}
+
+void Profiler::Init(size_t history)
+{
+	history_frames = history > 0 ? history : 1;
+
+	// measure the tick rate against the steady clock
+	typedef std::chrono::steady_clock Clock;
+	const auto clock_start = Clock::now();
+	const uint64_t tick_start = Now();
+	auto clock_end = clock_start;
+	while (clock_end - clock_start < std::chrono::milliseconds(10)) {
+		clock_end = Clock::now();
+	}
+	const uint64_t tick_end = Now();
+	ticks_per_millisecond = double(tick_end - tick_start) / std::chrono::duration<double, std::milli>(clock_end - clock_start).count();
+
+	frames.clear();
+	frames.reserve(history_frames + 1);
+	frame_start = Now();
+
+	btSetCustomEnterProfileZoneFunc(&Profiler::BeginZone);
+	btSetCustomLeaveProfileZoneFunc(&Profiler::EndZone);
+
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::Shutdown()
+{
+	enabled.store(false, std::memory_order_relaxed);
+
+	btSetCustomEnterProfileZoneFunc(nullptr);
+	btSetCustomLeaveProfileZoneFunc(nullptr);
+}
+
+void Profiler::SetEnabled(bool enable)
+{
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool Profiler::IsEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char *name)
+{
+	ProfileThread *thread = GetThread();
+
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	thread->name = name;
+}
+
+void Profiler::BeginZone(const char *name)
+{
+	OpenZones &zones = open_zones;
+	if (zones.depth == MAX_DEPTH) {
+		zones.overflow++;
+		return;
+	}
+
+	OpenZones::Zone &zone = zones.stack[zones.depth++];
+	zone.name = name;
+	zone.start = enabled.load(std::memory_order_relaxed) ? Now() : 0;
+}
+
+void Profiler::EndZone()
+{
+	OpenZones &zones = open_zones;
+	if (zones.overflow > 0) {
+		zones.overflow--;
+		return;
+	}
+	if (zones.depth == 0) {
+		// more zones ended than begun
+		return;
+	}
+
+	const OpenZones::Zone &zone = zones.stack[--zones.depth];
+	if (zone.start == 0 || !enabled.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	const ProfileEvent event = { zone.name, zone.start, Now(), zones.depth };
+	ProfileThread *thread = GetThread();
+	if (!thread->ring.Push(event)) {
+		thread->dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+size_t Profiler::AddTrack(const char *name)
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	threads.emplace_back(NewProfileThread());
+	threads.back()->name = name;
+	return threads.size() - 1;
+}
+
+void Profiler::AddTrackEvent(size_t track, const ProfileEvent &event)
+{
+	if (!enabled.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	ProfileThread *thread;
+	{
+		std::lock_guard<std::mutex> lock(threads_mutex);
+		thread = threads[track].get();
+	}
+	if (!thread->ring.Push(event)) {
+		thread->dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void Profiler::EndFrame()
+{
+	const uint64_t now = Now();
+	if (!enabled.load(std::memory_order_relaxed)) {
+		// keep the history as it is for inspection
+		frame_start = now;
+		return;
+	}
+
+	frames.push_back({ frame_start, now });
+	frame_start = now;
+
+	// the history is kept in vectors that are trimmed from the front, which moves the rest down
+	// but, unlike a deque, stops allocating once they have grown to the size of the history
+	if (frames.size() > history_frames) {
+		frames.erase(frames.begin(), frames.end() - history_frames);
+	}
+	const uint64_t oldest = frames.front().start;
+
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	for (auto &thread : threads) {
+		ProfileEvent event;
+		while (thread->ring.Pop(event)) {
+			thread->events.push_back(event);
+		}
+
+		// a thread finishes its zones in order, so the stale ones are all at the front
+		auto first_kept = thread->events.begin();
+		while (first_kept != thread->events.end() && first_kept->end < oldest) {
+			++first_kept;
+		}
+		thread->events.erase(thread->events.begin(), first_kept);
+	}
+}
+
+const std::vector<ProfileFrame> &Profiler::GetFrames()
+{
+	return frames;
+}
+
+size_t Profiler::GetThreadCount()
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	return threads.size();
+}
+
+std::string Profiler::GetThreadName(size_t thread)
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	return threads[thread]->name;
+}
+
+const std::vector<ProfileEvent> &Profiler::GetThreadEvents(size_t thread)
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	return threads[thread]->events;
+}
+
+uint64_t Profiler::GetDroppedEvents()
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+
+	uint64_t dropped = 0;
+	for (auto &thread : threads) {
+		dropped += thread->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+bool Profiler::SaveChromeTrace(const std::string &path)
+{
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+
+	// chrome wants microseconds, relative to the oldest kept frame
+	const uint64_t origin = frames.empty() ? frame_start : frames.front().start;
+	const double ticks_per_microsecond = ticks_per_millisecond * 0.001;
+	out.precision(3);
+	out << std::fixed;
+
+	out << "{\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Game\"}}";
+
+	// frame boundaries as global markers
+	for (const ProfileFrame &frame : frames) {
+		out << ",\n{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":"
+			<< double(frame.start - origin) / ticks_per_microsecond << "}";
+	}
+
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	for (size_t i = 0; i < threads.size(); i++) {
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i << ",\"args\":{\"name\":";
+		WriteJsonString(out, threads[i]->name.c_str());
+		out << "}}";
+
+		for (const ProfileEvent &event : threads[i]->events) {
+			// zones that began before the oldest kept frame are cut off
+			if (event.start < origin) {
+				continue;
+			}
+			out << ",\n{\"name\":";
+			WriteJsonString(out, event.name);
+			out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << i
+				<< ",\"ts\":" << double(event.start - origin) / ticks_per_microsecond
+				<< ",\"dur\":" << double(event.end - event.start) / ticks_per_microsecond << "}";
+		}
+	}
+
+	out << "\n]}\n";
+	return bool(out);
+}
+
+uint64_t Profiler::Now()
+{
+#ifdef PROFILER_USE_RDTSC
+	return __rdtsc();
+#else
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+double Profiler::TicksToMilliseconds(uint64_t ticks)
+{
+	return double(ticks) / ticks_per_millisecond;
+}
+
+double Profiler::GetTicksPerMillisecond()
+{
+	return ticks_per_millisecond;
+}
+
+ProfileScope::~ProfileScope()
+{
+	Profiler::EndZone();
+
+	if (start != 0) {
+		std::cout << Profiler::TicksToMilliseconds(Profiler::Now() - start) << "ms " << name << "\n";
+	}
+}
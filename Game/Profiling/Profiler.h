@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// times the enclosing scope as a zone of the calling thread's timeline. `name` must be a string
+// literal (or otherwise outlive the profiler), only the pointer is kept.
+#define PROFILE(name) PROFILE_SCOPE_NAME(__LINE__)(name)
+// same as PROFILE, and also prints the zone's duration to the console when it ends
+#define PROFILE_LOG(name) PROFILE_SCOPE_NAME(__LINE__)(name, true)
+
+#define PROFILE_SCOPE_NAME(line) PROFILE_SCOPE_NAME_2(line)
+#define PROFILE_SCOPE_NAME_2(line) ProfileScope profile_scope_##line
+
+// a finished zone. times are in Profiler::Now() ticks.
+struct ProfileEvent
+{
+	const char *name;
+	uint64_t start;
+	uint64_t end;
+	// number of zones the thread was already inside when this one began
+	uint32_t depth;
+};
+
+// the span between two Profiler::EndFrame() calls
+struct ProfileFrame
+{
+	uint64_t start;
+	uint64_t end;
+};
+
+// low overhead, thread aware profiler for scoped zones.
+//
+// each thread that begins a zone gets its own lock-free ring buffer on first use. finished zones
+// are pushed into it by that thread alone and drained by the game thread once per frame in
+// EndFrame(), so recording never takes a lock or waits on another thread. if a ring fills up
+// before it is drained, zones are dropped and counted instead.
+//
+// the game thread keeps the zones of the last few frames. they can be drawn with ProfilerWindow
+// or written out in the chrome trace format (load in chrome://tracing or ui.perfetto.dev).
+//
+// Init() also routes bullet's BT_PROFILE zones here, from every thread that steps the world.
+class Profiler
+{
+public:
+	// keeps the zones of the last `history_frames` frames
+	static void Init(size_t history_frames=300);
+	static void Shutdown();
+
+	// zones begun while disabled are not recorded and EndFrame() keeps the frames it has, which
+	// freezes the history. enabled by Init().
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled();
+
+	// names the calling thread in the trace and the profiler window
+	static void SetThreadName(const char *name);
+
+	// prefer PROFILE(), these are for zones that can't be tied to a scope. zones have to be
+	// ended by the thread that began them, innermost first.
+	static void BeginZone(const char *name);
+	static void EndZone();
+
+	// adds a timeline that isn't a thread, e.g. for gpu zones, and returns its index. tracks are
+	// listed along with the threads and fed zones that were timed elsewhere with AddTrackEvent(),
+	// by one thread at a time.
+	static size_t AddTrack(const char *name);
+	static void AddTrackEvent(size_t track, const ProfileEvent &event);
+
+	// the following must all be called from the game thread
+
+	// closes the current frame and collects the zones finished by all threads since the last call
+	static void EndFrame();
+
+	// oldest first
+	static const std::vector<ProfileFrame> &GetFrames();
+	static size_t GetThreadCount();
+	static std::string GetThreadName(size_t thread);
+	// zones the thread or track finished within the kept frames, ordered by their end time
+	static const std::vector<ProfileEvent> &GetThreadEvents(size_t thread);
+	// zones lost to full ring buffers since Init()
+	static uint64_t GetDroppedEvents();
+
+	// writes all kept zones as a chrome trace json file. returns false if the file can't be written.
+	static bool SaveChromeTrace(const std::string &path);
+
+	// the time stamp counter where available, a steady clock elsewhere
+	static uint64_t Now();
+	static double TicksToMilliseconds(uint64_t ticks);
+	static double GetTicksPerMillisecond();
+};
+
+// begins a zone when constructed and ends it when destroyed, see PROFILE()
+class ProfileScope
+{
+public:
+	inline explicit ProfileScope(const char *name, bool log=false)
+		: name(name), start(log ? Profiler::Now() : 0)
+	{
+		Profiler::BeginZone(name);
+	}
+
+	~ProfileScope();
+
+private:
+	const char *name;
+	// only set when the duration is logged
+	uint64_t start;
+};
@@ -0,0 +1,124 @@
+#include "ProfilerWindow.h"
+#include "Profiler.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <functional>
+
+static float GetFrameMilliseconds(void *, int index)
+{
+	const ProfileFrame &frame = Profiler::GetFrames()[index];
+	return float(Profiler::TicksToMilliseconds(frame.end - frame.start));
+}
+
+// same color for a zone name every frame
+static ImU32 GetZoneColor(const char *name)
+{
+	const size_t hash = std::hash<const void*>()(name);
+	const float hue = float(hash % 997) / 997.0f;
+	return ImColor::HSV(hue, 0.5f, 0.7f);
+}
+
+void ProfilerWindow::Draw(bool *open)
+{
+	ImGui::SetNextWindowSize(ImVec2(700, 400), ImGuiSetCond_FirstUseEver);
+	if (!ImGui::Begin("Profiler", open)) {
+		ImGui::End();
+		return;
+	}
+
+	const std::vector<ProfileFrame> &frames = Profiler::GetFrames();
+	const int frame_count = int(frames.size());
+
+	bool paused = !Profiler::IsEnabled();
+	if (ImGui::Checkbox("Pause", &paused)) {
+		Profiler::SetEnabled(!paused);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Save trace")) {
+		saveStatus = Profiler::SaveChromeTrace(tracePath) ? "saved " + tracePath : "could not write " + tracePath;
+	}
+	if (!saveStatus.empty()) {
+		ImGui::SameLine();
+		ImGui::Text("%s", saveStatus.c_str());
+	}
+
+	if (frame_count == 0) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::PlotHistogram("##frames", &GetFrameMilliseconds, nullptr, frame_count, 0, "frame ms", 0.0f, 33.3f,
+		ImVec2(ImGui::GetContentRegionAvailWidth(), 60));
+
+	frameOffset = std::min(std::max(frameOffset, 0), frame_count - 1);
+	int selected = -frameOffset;
+	ImGui::SliderInt("frame", &selected, 1 - frame_count, 0);
+	frameOffset = -selected;
+
+	const size_t frame_index = size_t(frame_count - 1 - frameOffset);
+	ImGui::Text("%.3f ms, %llu zones dropped", GetFrameMilliseconds(nullptr, int(frame_index)),
+		(unsigned long long)Profiler::GetDroppedEvents());
+
+	ImGui::Separator();
+	ImGui::BeginChild("##flame");
+	DrawFlameView(frame_index);
+	ImGui::EndChild();
+
+	ImGui::End();
+}
+
+void ProfilerWindow::DrawFlameView(size_t frame_index)
+{
+	const ProfileFrame &frame = Profiler::GetFrames()[frame_index];
+	const double span = double(frame.end - frame.start);
+	const float row_height = ImGui::GetTextLineHeight() + 2.0f;
+	const float width = ImGui::GetContentRegionAvailWidth();
+	ImDrawList *draw_list = ImGui::GetWindowDrawList();
+
+	const size_t thread_count = Profiler::GetThreadCount();
+	for (size_t thread = 0; thread < thread_count; thread++) {
+		const std::vector<ProfileEvent> &events = Profiler::GetThreadEvents(thread);
+
+		// only threads that did something during the frame get a track
+		uint32_t depth = 0;
+		bool active = false;
+		for (const ProfileEvent &event : events) {
+			if (event.end > frame.start && event.start < frame.end) {
+				depth = std::max(depth, event.depth + 1);
+				active = true;
+			}
+		}
+		if (!active) {
+			continue;
+		}
+
+		ImGui::Text("%s", Profiler::GetThreadName(thread).c_str());
+
+		const ImVec2 origin = ImGui::GetCursorScreenPos();
+		const ImVec2 size(width, row_height * depth);
+		ImGui::Dummy(size);
+
+		for (const ProfileEvent &event : events) {
+			if (event.end <= frame.start || event.start >= frame.end) {
+				continue;
+			}
+
+			// zones crossing the frame edges are cut off
+			const double start = double(std::max(event.start, frame.start) - frame.start);
+			const double end = double(std::min(event.end, frame.end) - frame.start);
+			const ImVec2 min(origin.x + float(start / span) * width, origin.y + row_height * event.depth);
+			const ImVec2 max(std::max(origin.x + float(end / span) * width, min.x + 1.0f), min.y + row_height - 1.0f);
+
+			draw_list->AddRectFilled(min, max, GetZoneColor(event.name));
+			if (max.x - min.x > ImGui::CalcTextSize(event.name).x + 4.0f) {
+				draw_list->AddText(ImVec2(min.x + 2.0f, min.y + 1.0f), ImColor(255, 255, 255), event.name);
+			}
+
+			if (ImGui::IsMouseHoveringRect(min, max)) {
+				ImGui::SetTooltip("%s\n%.3f ms", event.name, Profiler::TicksToMilliseconds(event.end - event.start));
+			}
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+// imgui window with the recent frame times and a flame view of one frame's zones on every thread
+class ProfilerWindow
+{
+public:
+	void Draw(bool *open=nullptr);
+
+	// where "Save trace" writes the chrome trace
+	inline void SetTracePath(const std::string &path) { tracePath = path; }
+
+private:
+	void DrawFlameView(size_t frame_index);
+
+	// frame shown in the flame view, counted back from the newest kept frame
+	int frameOffset = 0;
+	std::string tracePath = "profile.json";
+	std::string saveStatus;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include "Mesh.h"
+#include "Texture.h"
+
+#include "Math/matrix4.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// one recorded draw, holding everything the gl thread needs so it never has to look at the
+// object again. the mesh and texture must outlive the frame the draw is submitted in.
+struct DrawCommand
+{
+	// draws are submitted in key order, see MakeKey()
+	uint64_t key;
+	Mesh *mesh;
+	// nullptr for meshes without a diffuse map
+	Texture *diffuseMap;
+	Matrix4 modelMatrix;
+	float roughness;
+	float shininess;
+
+	// the texture in the high bits, the mesh in the low bits, so sorting by key groups draws by
+	// texture first and then by mesh, the two most expensive state changes
+	static inline uint64_t MakeKey(const Mesh *mesh, const Texture *diffuse_map)
+	{
+		const uint64_t texture_id = diffuse_map != nullptr ? diffuse_map->GetId() : 0;
+		return (texture_id << 32) | mesh->GetId();
+	}
+};
+
+// draws recorded by one thread, one after another in a single array. cleared every frame but
+// never shrunk, so after the first few frames recording doesn't allocate. each buffer is on its
+// own cache line, threads recording into neighbouring buffers would fight over it otherwise.
+class alignas(64) RenderCommandBuffer
+{
+public:
+	inline void Clear() { commands.clear(); }
+	inline void Push(const DrawCommand &command) { commands.push_back(command); }
+
+	inline void Sort()
+	{
+		std::sort(commands.begin(), commands.end(), [](const DrawCommand &a, const DrawCommand &b) {
+			return a.key < b.key;
+		});
+	}
+
+	inline size_t GetSize() const { return commands.size(); }
+	inline bool IsEmpty() const { return commands.empty(); }
+	inline const DrawCommand &operator[](size_t index) const { return commands[index]; }
+
+private:
+	std::vector<DrawCommand> commands;
+};
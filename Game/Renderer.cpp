@@ -0,0 +1,228 @@
+#include "Renderer.h"
+#include "Profiling/Profiler.h"
+#include "Threading/JobSystem.h"
+#include "Memory/StlAllocators.h"
+
+#include <GL/glew.h>
+
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+Renderer::Renderer(Shader *shader, JobSystem *jobs)
+	: shader(shader), jobs(jobs)
+{
+	commandBuffers.resize(jobs != nullptr ? JobSystem::MAX_THREADS : 1);
+
+	uniforms.viewMatrix = shader->GetUniformLocation("u_viewMatrix");
+	uniforms.projMatrix = shader->GetUniformLocation("u_projMatrix");
+	uniforms.ambientColor = shader->GetUniformLocation("u_ambientColor");
+	uniforms.numPointLights = shader->GetUniformLocation("u_numPointLights");
+	for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
+		uniforms.pointLightPositions[i] = shader->GetUniformLocation("u_pointLight[" + std::to_string(i) + "].position");
+		uniforms.pointLightColors[i] = shader->GetUniformLocation("u_pointLight[" + std::to_string(i) + "].color");
+	}
+	uniforms.cameraPosition = shader->GetUniformLocation("u_cameraPosition");
+	uniforms.modelMatrix = shader->GetUniformLocation("u_modelMatrix");
+	uniforms.roughness = shader->GetUniformLocation("u_roughness");
+	uniforms.shininess = shader->GetUniformLocation("u_shininess");
+	uniforms.hasTexture = shader->GetUniformLocation("u_hasTexture");
+	uniforms.diffuseTexture = shader->GetUniformLocation("u_diffuseTexture");
+}
+
+void Renderer::SetCamera(const Matrix4 &view_matrix, const Matrix4 &proj_matrix, const Vector3 &position)
+{
+	viewMatrix = view_matrix;
+	projMatrix = proj_matrix;
+	cameraPosition = position;
+
+	// the planes are sums and differences of the rows of the view projection matrix
+	const Matrix4 view_proj = view_matrix * proj_matrix;
+	for (int plane = 0; plane < 6; plane++) {
+		const int row = plane / 2;
+		const float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+
+		Vector3 normal(view_proj(3, 0) + sign * view_proj(row, 0), view_proj(3, 1) + sign * view_proj(row, 1),
+			view_proj(3, 2) + sign * view_proj(row, 2));
+		const float length = normal.Length();
+		frustumNormals[plane] = normal / Vector3(length);
+		frustumDistances[plane] = (view_proj(3, 3) + sign * view_proj(row, 3)) / length;
+	}
+}
+
+bool Renderer::IsVisible(const GameObject &object) const
+{
+	const Mesh *mesh = object.GetMesh();
+	if (mesh == nullptr) {
+		return false;
+	}
+
+	const Matrix4 &model = object.GetMatrix();
+	const Vector3 &local = mesh->GetBoundsCenter();
+	const Vector3 center(model(0, 0) * local.x + model(0, 1) * local.y + model(0, 2) * local.z + model(0, 3),
+		model(1, 0) * local.x + model(1, 1) * local.y + model(1, 2) * local.z + model(1, 3),
+		model(2, 0) * local.x + model(2, 1) * local.y + model(2, 2) * local.z + model(2, 3));
+	// the world scale, which includes the parents' in a scene graph, is the length of the longest axis
+	float scale_squared = 0.0f;
+	for (int axis = 0; axis < 3; axis++) {
+		scale_squared = std::max(scale_squared,
+			model(0, axis) * model(0, axis) + model(1, axis) * model(1, axis) + model(2, axis) * model(2, axis));
+	}
+	const float radius = mesh->GetBoundsRadius() * std::sqrt(scale_squared);
+
+	for (int plane = 0; plane < 6; plane++) {
+		if (frustumNormals[plane].Dot(center) + frustumDistances[plane] < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void Renderer::Render(const std::vector<GameObject*> &objects, const std::vector<PointLight> &point_lights)
+{
+	PROFILE("Renderer::Render");
+
+	for (RenderCommandBuffer &buffer : commandBuffers) {
+		buffer.Clear();
+	}
+
+	{
+		PROFILE("Record");
+
+		if (jobs != nullptr) {
+			jobs->ParallelFor(0, objects.size(), RECORD_GRAIN, [this, &objects](size_t begin, size_t end) {
+				Record(objects, begin, end, commandBuffers[jobs->GetThreadIndex()]);
+			});
+			// sorted where they were recorded, the gl thread only has to merge them
+			jobs->ParallelFor(0, commandBuffers.size(), 1, [this](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					commandBuffers[i].Sort();
+				}
+			});
+		} else {
+			Record(objects, 0, objects.size(), commandBuffers[0]);
+			commandBuffers[0].Sort();
+		}
+	}
+
+	shader->Begin();
+	// set camera parameters
+	shader->SetUniformMatrix(uniforms.viewMatrix, viewMatrix);
+	shader->SetUniformMatrix(uniforms.projMatrix, projMatrix);
+
+	// apply scene ambience color
+	shader->SetUniformVector4(uniforms.ambientColor, ambience);
+
+	// set point lights
+	const int num_point_lights = std::min(int(point_lights.size()), MAX_POINT_LIGHTS);
+	shader->SetUniformInt(uniforms.numPointLights, num_point_lights);
+	for (int i = 0; i < num_point_lights; i++) {
+		shader->SetUniformVector3(uniforms.pointLightPositions[i], point_lights[i].position);
+		shader->SetUniformVector4(uniforms.pointLightColors[i], point_lights[i].color);
+	}
+
+	// set camera position
+	shader->SetUniformVector3(uniforms.cameraPosition, cameraPosition);
+
+	Submit();
+
+	shader->End();
+}
+
+void Renderer::Record(const std::vector<GameObject*> &objects, size_t begin, size_t end, RenderCommandBuffer &buffer) const
+{
+	DrawCommand command;
+	for (size_t i = begin; i < end; i++) {
+		const GameObject *obj = objects[i];
+		Mesh *mesh = obj->GetMesh();
+		if (mesh == nullptr) {
+			continue;
+		}
+
+		const Material &material = mesh->GetMaterial();
+		command.mesh = mesh;
+		command.diffuseMap = material.GetDiffuseMap().get();
+		command.key = DrawCommand::MakeKey(mesh, command.diffuseMap);
+		command.modelMatrix = obj->GetMatrix();
+		command.roughness = material.GetRoughness();
+		command.shininess = material.GetShininess();
+		buffer.Push(command);
+	}
+}
+
+void Renderer::Submit()
+{
+	PROFILE("Submit");
+
+	glActiveTexture(GL_TEXTURE0);
+	shader->SetUniformInt(uniforms.diffuseTexture, 0);
+
+	// read position in each buffer that has draws left
+	FrameVector<std::pair<const RenderCommandBuffer*, size_t>> heads;
+	heads.reserve(commandBuffers.size());
+	for (const RenderCommandBuffer &buffer : commandBuffers) {
+		if (!buffer.IsEmpty()) {
+			heads.emplace_back(&buffer, 0);
+		}
+	}
+
+	// state of the previous draw, only what changed is set again
+	Mesh *bound_mesh = nullptr;
+	Texture *bound_texture = nullptr;
+	bool first = true;
+	float roughness = 0.0f, shininess = 0.0f;
+
+	while (!heads.empty()) {
+		// there are at most as many buffers as threads, few enough to look through them all
+		size_t next = 0;
+		for (size_t i = 1; i < heads.size(); i++) {
+			if ((*heads[i].first)[heads[i].second].key < (*heads[next].first)[heads[next].second].key) {
+				next = i;
+			}
+		}
+
+		const DrawCommand &command = (*heads[next].first)[heads[next].second];
+		if (++heads[next].second == heads[next].first->GetSize()) {
+			heads[next] = heads.back();
+			heads.pop_back();
+		}
+
+		if (first || command.diffuseMap != bound_texture) {
+			if (command.diffuseMap != nullptr) {
+				// this model has a diffuse texture
+				command.diffuseMap->Bind();
+				shader->SetUniformInt(uniforms.hasTexture, true);
+			} else {
+				if (bound_texture != nullptr) {
+					bound_texture->Unbind();
+				}
+				shader->SetUniformInt(uniforms.hasTexture, false);
+			}
+			bound_texture = command.diffuseMap;
+		}
+
+		// set material parameters
+		if (first || command.roughness != roughness) {
+			roughness = command.roughness;
+			shader->SetUniformFloat(uniforms.roughness, roughness);
+		}
+		if (first || command.shininess != shininess) {
+			shininess = command.shininess;
+			shader->SetUniformFloat(uniforms.shininess, shininess);
+		}
+
+		shader->SetUniformMatrix(uniforms.modelMatrix, command.modelMatrix);
+
+		if (command.mesh != bound_mesh) {
+			command.mesh->Bind();
+			bound_mesh = command.mesh;
+		}
+		command.mesh->DrawBound();
+
+		first = false;
+	}
+
+	if (bound_texture != nullptr) {
+		bound_texture->Unbind();
+	}
+}
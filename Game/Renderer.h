@@ -0,0 +1,75 @@
+#pragma once
+#include "Shader.h"
+#include "GameObject.h"
+#include "PointLight.h"
+#include "Color.h"
+#include "RenderCommandBuffer.h"
+
+#include "Math/matrix4.h"
+#include "Math/vector3.h"
+
+#include <vector>
+
+class JobSystem;
+
+// draws game objects with the scene shader.
+//
+// a frame is drawn in two steps: the draws are first recorded into command buffers, one per
+// thread, by jobs each going through a range of the objects, and then submitted on the gl thread
+// alone, merged in key order so draws sharing a texture and mesh follow each other.
+class Renderer
+{
+public:
+	// the shader and job system are not owned. without a job system the draws are recorded on
+	// the calling thread. the shader's uniforms are looked up once here.
+	Renderer(Shader *shader, JobSystem *jobs=nullptr);
+
+	void SetCamera(const Matrix4 &view_matrix, const Matrix4 &proj_matrix, const Vector3 &position);
+	inline void SetAmbience(const Color &color) { ambience = color; }
+
+	// whether the object's bounding sphere is at least partly inside the view of the last
+	// SetCamera(). doesn't touch gl, so objects can be culled on any thread.
+	bool IsVisible(const GameObject &object) const;
+
+	// only the first MAX_POINT_LIGHTS lights are used
+	void Render(const std::vector<GameObject*> &objects, const std::vector<PointLight> &point_lights);
+
+	static const int MAX_POINT_LIGHTS = 4;
+	// objects recorded per job
+	static const size_t RECORD_GRAIN = 256;
+
+private:
+	void Record(const std::vector<GameObject*> &objects, size_t begin, size_t end, RenderCommandBuffer &buffer) const;
+	void Submit();
+
+	Shader *shader;
+	JobSystem *jobs;
+
+	// locations of the shader's uniforms, -1 for those it doesn't have
+	struct Uniforms
+	{
+		int viewMatrix;
+		int projMatrix;
+		int ambientColor;
+		int numPointLights;
+		int pointLightPositions[MAX_POINT_LIGHTS];
+		int pointLightColors[MAX_POINT_LIGHTS];
+		int cameraPosition;
+		int modelMatrix;
+		int roughness;
+		int shininess;
+		int hasTexture;
+		int diffuseTexture;
+	} uniforms;
+
+	// indexed by JobSystem::GetThreadIndex()
+	std::vector<RenderCommandBuffer> commandBuffers;
+
+	Matrix4 viewMatrix;
+	Matrix4 projMatrix;
+	Vector3 cameraPosition;
+	// left, right, bottom, top, near and far plane, normals pointing into the view
+	Vector3 frustumNormals[6];
+	float frustumDistances[6];
+	Color ambience;
+};
@@ -0,0 +1,247 @@
+#include "SceneGraph.h"
+#include "Profiling/Profiler.h"
+#include "Threading/JobSystem.h"
+
+#include <algorithm>
+
+const uint32_t SceneGraph::NO_NODE;
+
+SceneGraph::~SceneGraph()
+{
+	for (GameObject *object : objects) {
+		if (object != nullptr) {
+			object->scene = nullptr;
+		}
+	}
+}
+
+void SceneGraph::Add(GameObject &object)
+{
+	if (object.scene == nullptr) {
+		NewNode(object);
+		return;
+	}
+	if (object.scene != this) {
+		throw "object is in another scene graph";
+	}
+
+	if (parents[object.sceneNode] != NO_NODE) {
+		Unlink(object.sceneNode);
+		MarkDirty(object.sceneNode);
+		sorted = false;
+	}
+}
+
+void SceneGraph::Attach(GameObject &child, GameObject &parent)
+{
+	if (child.scene != nullptr && child.scene != this) {
+		throw "object is in another scene graph";
+	}
+	if (parent.scene == nullptr) {
+		NewNode(parent);
+	} else if (parent.scene != this) {
+		throw "object is in another scene graph";
+	}
+
+	if (child.scene == nullptr) {
+		NewNode(child);
+	} else {
+		for (uint32_t node = parent.sceneNode; node != NO_NODE; node = parents[node]) {
+			if (node == child.sceneNode) {
+				throw "can't attach an object to itself or its children";
+			}
+		}
+		Unlink(child.sceneNode);
+	}
+
+	Link(child.sceneNode, parent.sceneNode);
+	MarkDirty(child.sceneNode);
+	sorted = false;
+}
+
+void SceneGraph::Remove(GameObject &object)
+{
+	if (object.scene != this) {
+		return;
+	}
+
+	Unlink(object.sceneNode);
+
+	// the subtree goes with it
+	order.clear();
+	order.push_back(object.sceneNode);
+	while (!order.empty()) {
+		const uint32_t node = order.back();
+		order.pop_back();
+
+		for (uint32_t child = firstChildren[node]; child != NO_NODE; child = nextSiblings[child]) {
+			order.push_back(child);
+		}
+
+		objects[node]->scene = nullptr;
+		objects[node] = nullptr;
+		removedCount++;
+	}
+	sorted = false;
+}
+
+GameObject *SceneGraph::GetParent(const GameObject &object) const
+{
+	if (object.scene != this || parents[object.sceneNode] == NO_NODE) {
+		return nullptr;
+	}
+	return objects[parents[object.sceneNode]];
+}
+
+void SceneGraph::Update(JobSystem *jobs)
+{
+	PROFILE("SceneGraph::Update");
+
+	if (!sorted) {
+		Sort();
+	}
+	if (!anyDirty) {
+		return;
+	}
+
+	for (size_t level = 0; level + 1 < levels.size(); level++) {
+		const size_t begin = levels[level];
+		const size_t end = levels[level + 1];
+
+		if (jobs != nullptr && end - begin > UPDATE_GRAIN) {
+			jobs->ParallelFor(begin, end, UPDATE_GRAIN, [this](size_t range_begin, size_t range_end) {
+				UpdateRange(range_begin, range_end);
+			});
+		} else {
+			UpdateRange(begin, end);
+		}
+	}
+
+	std::fill(dirty.begin(), dirty.end(), char(0));
+	anyDirty = false;
+}
+
+void SceneGraph::UpdateRange(size_t begin, size_t end)
+{
+	for (size_t node = begin; node < end; node++) {
+		const uint32_t parent = parents[node];
+		// the parent's level is done, its flag says whether it moved
+		if (parent != NO_NODE && dirty[parent]) {
+			dirty[node] = 1;
+		}
+		if (!dirty[node]) {
+			continue;
+		}
+
+		GameObject &object = *objects[node];
+		if (parent == NO_NODE) {
+			object.matrix = object.GetLocalMatrix();
+		} else {
+			object.matrix = object.GetLocalMatrix() * objects[parent]->matrix;
+		}
+	}
+}
+
+uint32_t SceneGraph::NewNode(GameObject &object)
+{
+	const uint32_t node = uint32_t(objects.size());
+	objects.push_back(&object);
+	parents.push_back(NO_NODE);
+	firstChildren.push_back(NO_NODE);
+	nextSiblings.push_back(NO_NODE);
+	// its matrix may be relative to a parent from here on
+	dirty.push_back(1);
+	anyDirty = true;
+	sorted = false;
+
+	object.scene = this;
+	object.sceneNode = node;
+	return node;
+}
+
+void SceneGraph::Link(uint32_t node, uint32_t parent)
+{
+	parents[node] = parent;
+	nextSiblings[node] = firstChildren[parent];
+	firstChildren[parent] = node;
+}
+
+void SceneGraph::Unlink(uint32_t node)
+{
+	const uint32_t parent = parents[node];
+	if (parent == NO_NODE) {
+		return;
+	}
+
+	uint32_t *link = &firstChildren[parent];
+	while (*link != node) {
+		link = &nextSiblings[*link];
+	}
+	*link = nextSiblings[node];
+
+	parents[node] = NO_NODE;
+	nextSiblings[node] = NO_NODE;
+}
+
+void SceneGraph::Sort()
+{
+	PROFILE("SceneGraph::Sort");
+
+	// roots keep their relative order, then every level is the children of the one before
+	order.clear();
+	for (uint32_t node = 0; node < objects.size(); node++) {
+		if (objects[node] != nullptr && parents[node] == NO_NODE) {
+			order.push_back(node);
+		}
+	}
+
+	levels.clear();
+	levels.push_back(0);
+	size_t level_end = order.size();
+	for (size_t i = 0; i < order.size(); i++) {
+		if (i == level_end) {
+			levels.push_back(uint32_t(i));
+			level_end = order.size();
+		}
+		for (uint32_t child = firstChildren[order[i]]; child != NO_NODE; child = nextSiblings[child]) {
+			order.push_back(child);
+		}
+	}
+	if (!order.empty()) {
+		levels.push_back(uint32_t(order.size()));
+	}
+
+	remap.assign(objects.size(), NO_NODE);
+	for (size_t i = 0; i < order.size(); i++) {
+		remap[order[i]] = uint32_t(i);
+	}
+	auto remapped = [this](uint32_t node) {
+		return node != NO_NODE ? remap[node] : NO_NODE;
+	};
+
+	std::vector<GameObject*> sorted_objects(order.size());
+	std::vector<uint32_t> sorted_parents(order.size());
+	std::vector<uint32_t> sorted_first_children(order.size());
+	std::vector<uint32_t> sorted_next_siblings(order.size());
+	std::vector<char> sorted_dirty(order.size());
+
+	for (size_t i = 0; i < order.size(); i++) {
+		const uint32_t node = order[i];
+		sorted_objects[i] = objects[node];
+		sorted_parents[i] = remapped(parents[node]);
+		sorted_first_children[i] = remapped(firstChildren[node]);
+		sorted_next_siblings[i] = remapped(nextSiblings[node]);
+		sorted_dirty[i] = dirty[node];
+
+		sorted_objects[i]->sceneNode = uint32_t(i);
+	}
+
+	objects.swap(sorted_objects);
+	parents.swap(sorted_parents);
+	firstChildren.swap(sorted_first_children);
+	nextSiblings.swap(sorted_next_siblings);
+	dirty.swap(sorted_dirty);
+
+	removedCount = 0;
+	sorted = true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "GameObject.h"
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// parent/child relationships between game objects. an object in the graph keeps its translation,
+// rotation and scale relative to its parent, and its matrix is the world matrix, recomputed by
+// Update() for the objects marked dirty (see GameObject::UpdateMatrix()) and everything attached
+// to them. objects that never move cost nothing but a flag test per frame.
+//
+// the nodes are kept in flat arrays in breadth-first order, so parents always come before their
+// children and each depth level is one contiguous range. a level only reads the level above, so
+// its nodes can be updated in parallel. changing the hierarchy sorts the arrays again on the next
+// Update().
+//
+// the graph doesn't own the objects. it is not thread safe; objects may be marked dirty from one
+// thread at a time, and not during Update().
+class SceneGraph
+{
+public:
+	SceneGraph() = default;
+	// the objects still in the graph are taken out of it
+	~SceneGraph();
+
+	SceneGraph(const SceneGraph &) = delete;
+	SceneGraph &operator=(const SceneGraph &) = delete;
+
+	// adds the object at the root, or moves it there with everything attached to it. the object
+	// must be alive and in no other graph.
+	void Add(GameObject &object);
+	// attaches child to parent, adding either to the graph if needed. the child's transform is
+	// kept as is and is from now on relative to the parent. an object driven by a physics body is
+	// moved in world space and has to stay at the root.
+	void Attach(GameObject &child, GameObject &parent);
+	// takes the object and everything attached to it out of the graph, their matrices are no
+	// longer updated. called by the object's destructor.
+	void Remove(GameObject &object);
+	// nullptr for objects at the root or not in the graph
+	GameObject *GetParent(const GameObject &object) const;
+
+	// recomputes the world matrices of the objects marked dirty and of their children. with a
+	// job system, large levels are spread over its threads.
+	void Update(JobSystem *jobs=nullptr);
+
+	inline size_t GetSize() const { return objects.size() - removedCount; }
+	// number of depth levels after the last Update()
+	inline size_t GetDepth() const { return levels.empty() ? 0 : levels.size() - 1; }
+
+	// nodes of a level updated per job
+	static const size_t UPDATE_GRAIN = 512;
+
+private:
+	friend class GameObject;
+
+	static const uint32_t NO_NODE = uint32_t(-1);
+
+	inline void MarkDirty(uint32_t node)
+	{
+		dirty[node] = 1;
+		anyDirty = true;
+	}
+
+	uint32_t NewNode(GameObject &object);
+	void Link(uint32_t node, uint32_t parent);
+	void Unlink(uint32_t node);
+	// puts the nodes back into breadth-first order and drops the removed ones
+	void Sort();
+	void UpdateRange(size_t begin, size_t end);
+
+	// the following are indexed by node, nullptr objects are removed nodes until the next sort
+	std::vector<GameObject*> objects;
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> firstChildren;
+	std::vector<uint32_t> nextSiblings;
+	// set when the node's transform changed, and by Update() when its parent's did
+	std::vector<char> dirty;
+
+	// first node of each depth level, and one past the last node
+	std::vector<uint32_t> levels;
+	// removed nodes not yet dropped by a sort
+	size_t removedCount = 0;
+	bool sorted = true;
+	bool anyDirty = false;
+
+	// scratch space for sorting
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> remap;
+};
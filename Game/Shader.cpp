@@ -190,4 +190,44 @@ void Shader::SetUniformMatrix(const std::string &name, const Matrix4 &value)
 	if (loc != -1) {
 		glProgramUniformMatrix4fv(programID, loc, 1, true, &value.values[0]);
 	}
-}
\ No newline at end of file
+}
+
+int Shader::GetUniformLocation(const std::string &name) const
+{
+	return glGetUniformLocation(programID, name.c_str());
+}
+
+void Shader::SetUniformInt(int location, int value)
+{
+	if (location != -1) {
+		glProgramUniform1i(programID, location, value);
+	}
+}
+
+void Shader::SetUniformFloat(int location, float value)
+{
+	if (location != -1) {
+		glProgramUniform1f(programID, location, value);
+	}
+}
+
+void Shader::SetUniformVector3(int location, const Vector3 &value)
+{
+	if (location != -1) {
+		glProgramUniform3f(programID, location, value.x, value.y, value.z);
+	}
+}
+
+void Shader::SetUniformVector4(int location, const Vector4 &value)
+{
+	if (location != -1) {
+		glProgramUniform4f(programID, location, value.x, value.y, value.z, value.w);
+	}
+}
+
+void Shader::SetUniformMatrix(int location, const Matrix4 &value)
+{
+	if (location != -1) {
+		glProgramUniformMatrix4fv(programID, location, 1, true, &value.values[0]);
+	}
+}
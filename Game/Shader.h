@@ -19,6 +19,15 @@ public:
 	void SetUniformVector4(const std::string &name, const Vector4 &value);
 	void SetUniformMatrix(const std::string &name, const Matrix4 &value);
 
+	// -1 if the shader has no such uniform, setting it is then a no-op. looking the location up
+	// once saves a lookup per set when the same uniform is set many times a frame.
+	int GetUniformLocation(const std::string &name) const;
+	void SetUniformInt(int location, int value);
+	void SetUniformFloat(int location, float value);
+	void SetUniformVector3(int location, const Vector3 &value);
+	void SetUniformVector4(int location, const Vector4 &value);
+	void SetUniformMatrix(int location, const Matrix4 &value);
+
 private:
 	unsigned int programID, vertexShaderID, fragmentShaderID;
 	bool created = false;
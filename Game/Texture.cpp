@@ -1,48 +1,25 @@
 #include "Texture.h"
+#include "Profiling/Profiler.h"
+#include "Memory/MemoryTracker.h"
 
 #define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC(size) MemoryTracker::Allocate(size, alignof(std::max_align_t), MemoryTag::Textures)
+#define STBI_REALLOC(memory, size) MemoryTracker::Reallocate(memory, size, MemoryTag::Textures)
+#define STBI_FREE(memory) MemoryTracker::Free(memory)
 #include "stb_image.h"
 
-#include <GL/glew.h>
-
-Texture::Texture(const std::string &path)
+TextureImage::TextureImage(const std::string &path)
 {
-	int comp;
-	unsigned char *image = stbi_load(path.c_str(), &width, &height, &comp, STBI_rgb);
-
-	if (image == nullptr) {
-		throw(std::string("Failed to load texture"));
-	}
+	PROFILE("TextureImage::TextureImage");
 
-	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_2D, id);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	pixels = stbi_load(path.c_str(), &width, &height, &components, STBI_rgb);
 
-	if (comp == 3) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	} else if (comp == 4) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+	if (pixels == nullptr) {
+		throw(std::string("Failed to load texture"));
 	}
-
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	stbi_image_free(image);
-}
-
-Texture::~Texture()
-{
-	glDeleteTextures(1, &id);
 }
 
-void Texture::Bind()
+TextureImage::~TextureImage()
 {
-	glBindTexture(GL_TEXTURE_2D, id);
+	stbi_image_free(pixels);
 }
-
-void Texture::Unbind()
-{
-	glBindTexture(GL_TEXTURE_2D, 0);
-}
\ No newline at end of file
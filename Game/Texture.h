@@ -1,15 +1,36 @@
 #pragma once
 #include <string>
 
+// pixels decoded from an image file. decoding needs no gl context, so it can run on any thread
+// and the texture be made from it on the gl thread later.
+class TextureImage
+{
+public:
+	// throws if the file can't be loaded
+	TextureImage(const std::string &path);
+	~TextureImage();
+
+	TextureImage(const TextureImage &) = delete;
+	TextureImage &operator=(const TextureImage &) = delete;
+
+	int width;
+	int height;
+	int components;
+	unsigned char *pixels;
+};
+
 class Texture
 {
 public:
 	Texture(const std::string &path);
+	Texture(const TextureImage &image);
 	~Texture();
 
 	void Bind();
 	void Unbind();
 
+	inline unsigned int GetId() const { return id; }
+
 protected:
 	unsigned int id;
 	int width;
@@ -0,0 +1,45 @@
+#include "Texture.h"
+#include "Profiling/Profiler.h"
+
+#include <GL/glew.h>
+
+Texture::Texture(const std::string &path)
+	: Texture(TextureImage(path))
+{
+}
+
+Texture::Texture(const TextureImage &image)
+	: width(image.width), height(image.height)
+{
+	PROFILE("Texture::Texture");
+
+	glGenTextures(1, &id);
+	glBindTexture(GL_TEXTURE_2D, id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+	if (image.components == 3) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.pixels);
+	} else if (image.components == 4) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+	}
+
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+Texture::~Texture()
+{
+	glDeleteTextures(1, &id);
+}
+
+void Texture::Bind()
+{
+	glBindTexture(GL_TEXTURE_2D, id);
+}
+
+void Texture::Unbind()
+{
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
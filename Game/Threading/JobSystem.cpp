@@ -0,0 +1,355 @@
+#include "JobSystem.h"
+#include "../Profiling/Profiler.h"
+#include "../Memory/MemoryTracker.h"
+
+#include <algorithm>
+#include <new>
+#include <string>
+
+struct Job
+{
+	std::function<void()> func;
+	JobCounter *counter;
+	// next job waiting on the same counter
+	Job *next;
+	// set while the job is queued or waiting, cleared once it starts running
+	std::atomic<bool> used { false };
+};
+
+struct JobThread
+{
+	WorkStealingDeque<Job, JobSystem::MAX_JOBS> deque;
+	// handed out round robin, skipping the ones still in use
+	Job jobs[JobSystem::MAX_JOBS];
+	unsigned int nextJob = 0;
+	int index = 0;
+	// first thread to steal from, the one that had work last time
+	int victim = 0;
+	// the thread the deque belongs to
+	std::thread::id owner;
+};
+
+// times an idle worker looks for jobs before it goes to sleep
+static const int IDLE_SPINS = 64;
+
+// ids of the systems, never reused, so a thread can't mistake a new system for a destroyed one
+// that had the same address
+static std::atomic<uint64_t> next_system_id { 1 };
+
+// the deque the calling thread used last and the system it belongs to. a thread that runs jobs on
+// several systems finds its deque in the system's own list whenever it switches.
+static thread_local uint64_t current_system = 0;
+static thread_local JobThread *current_thread = nullptr;
+
+bool JobCounter::IsDone() const
+{
+	if (pending.load(std::memory_order_acquire) != 0) {
+		return false;
+	}
+
+	// the thread that finished the last job may still hold the lock
+	Lock();
+	Unlock();
+	return true;
+}
+
+JobSystem::JobSystem(int num_workers) : id(next_system_id.fetch_add(1))
+{
+	for (std::atomic<JobThread*> &thread : threads) {
+		thread.store(nullptr, std::memory_order_relaxed);
+	}
+
+	if (num_workers < 0) {
+		num_workers = std::max(int(std::thread::hardware_concurrency()) - 1, 0);
+	}
+	// leave room for a few threads that aren't workers
+	num_workers = std::min(num_workers, MAX_THREADS - 4);
+
+	// the creating thread gets the first deque
+	GetThread();
+
+	for (int i = 0; i < num_workers; i++) {
+		workers.emplace_back(&JobSystem::WorkerMain, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wakeCondition.notify_all();
+
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+
+	// other threads still caching a deque of this system never use it again, the id doesn't match
+	// any system from here on
+	for (std::atomic<JobThread*> &thread : threads) {
+		JobThread *job_thread = thread.load(std::memory_order_relaxed);
+		if (job_thread != nullptr) {
+			job_thread->~JobThread();
+			MemoryTracker::Free(job_thread);
+		}
+	}
+
+	if (current_system == id) {
+		current_system = 0;
+		current_thread = nullptr;
+	}
+}
+
+void JobSystem::Run(const std::function<void()> &func, JobCounter *counter, JobCounter *after)
+{
+	JobThread &thread = GetThread();
+	Job *job = TakeJob(thread);
+	if (job == nullptr) {
+		// every slot is still queued or waiting, no choice but to do it now
+		if (after != nullptr) {
+			Wait(*after);
+		}
+		func();
+		return;
+	}
+
+	job->func = func;
+	job->counter = counter;
+
+	if (counter != nullptr) {
+		counter->Lock();
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+		counter->Unlock();
+	}
+
+	if (after != nullptr) {
+		after->Lock();
+		const bool held = after->pending.load(std::memory_order_relaxed) > 0;
+		if (held) {
+			job->next = after->continuations;
+			after->continuations = job;
+		}
+		after->Unlock();
+
+		if (held) {
+			return;
+		}
+	}
+
+	Push(thread, job);
+}
+
+void JobSystem::Wait(const JobCounter &counter)
+{
+	JobThread &thread = GetThread();
+
+	while (!counter.IsDone()) {
+		Job *job = FindJob(thread);
+		if (job != nullptr) {
+			Execute(job);
+		} else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain_size, const std::function<void(size_t, size_t)> &func)
+{
+	if (end <= begin) {
+		return;
+	}
+
+	// a few ranges per thread so stealing can even out the load, but never smaller than the grain
+	const size_t count = end - begin;
+	const size_t max_ranges = size_t(GetThreadCount()) * 4;
+	const size_t range_size = std::max(std::max(grain_size, size_t(1)), (count + max_ranges - 1) / max_ranges);
+
+	if (count <= range_size) {
+		func(begin, end);
+		return;
+	}
+
+	// the jobs only capture a pointer and an offset, small enough for std::function not to allocate
+	struct Ranges
+	{
+		const std::function<void(size_t, size_t)> *func;
+		size_t end;
+		size_t size;
+	} ranges = { &func, end, range_size };
+
+	JobCounter counter;
+	for (size_t range_begin = begin + range_size; range_begin < end; range_begin += range_size) {
+		const Ranges *shared = &ranges;
+		Run([shared, range_begin]() {
+			(*shared->func)(range_begin, std::min(range_begin + shared->size, shared->end));
+		}, &counter);
+	}
+
+	// the first range is done right here
+	func(begin, begin + range_size);
+	Wait(counter);
+}
+
+int JobSystem::GetThreadIndex()
+{
+	return GetThread().index;
+}
+
+JobThread &JobSystem::GetThread()
+{
+	if (current_system == id) {
+		return *current_thread;
+	}
+
+	// the thread may have run jobs on this system before switching to another
+	const std::thread::id owner = std::this_thread::get_id();
+	const int count = std::min(threadCount.load(std::memory_order_acquire), int(MAX_THREADS));
+	for (int i = 0; i < count; i++) {
+		JobThread *thread = threads[i].load(std::memory_order_acquire);
+		if (thread != nullptr && thread->owner == owner) {
+			current_system = id;
+			current_thread = thread;
+			return *thread;
+		}
+	}
+
+	const int index = threadCount.fetch_add(1);
+	if (index >= MAX_THREADS) {
+		throw "too many threads running jobs";
+	}
+
+	// the deque is aligned to keep its ends on cache lines of their own, plain new only aligns
+	// to 16 bytes before c++17
+	void *memory = MemoryTracker::Allocate(sizeof(JobThread), alignof(JobThread), MemoryTag::General);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	JobThread *thread = new (memory) JobThread();
+	thread->index = index;
+	thread->victim = index + 1;
+	thread->owner = owner;
+	// thieves skip the slot until then
+	threads[index].store(thread, std::memory_order_release);
+
+	current_system = id;
+	current_thread = thread;
+	return *thread;
+}
+
+void JobSystem::Push(JobThread &thread, Job *job)
+{
+	if (!thread.deque.Push(job)) {
+		// too many queued, no choice but to do it now
+		Execute(job);
+		return;
+	}
+
+	// a worker that is about to sleep either sees this job or is seen sleeping here
+	queuedJobs.fetch_add(1);
+	if (sleepingWorkers.load() > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeCondition.notify_one();
+	}
+}
+
+Job *JobSystem::TakeJob(JobThread &thread)
+{
+	// only the owning thread takes slots, any thread may free them
+	for (int i = 0; i < MAX_JOBS; i++) {
+		Job *job = &thread.jobs[thread.nextJob++ & (MAX_JOBS - 1)];
+		if (!job->used.load(std::memory_order_acquire)) {
+			job->used.store(true, std::memory_order_relaxed);
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+Job *JobSystem::FindJob(JobThread &thread)
+{
+	Job *job = thread.deque.Pop();
+
+	if (job == nullptr) {
+		const int count = std::min(threadCount.load(std::memory_order_acquire), int(MAX_THREADS));
+		for (int i = 0; i < count && job == nullptr; i++) {
+			const int index = (thread.victim + i) % count;
+			JobThread *victim = threads[index].load(std::memory_order_acquire);
+			if (victim != nullptr && victim != &thread) {
+				job = victim->deque.Steal();
+				if (job != nullptr) {
+					thread.victim = index;
+				}
+			}
+		}
+	}
+
+	if (job != nullptr) {
+		queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+void JobSystem::Execute(Job *job)
+{
+	// the job slot may be reused by the time func returns, and captures are released right away
+	std::function<void()> func;
+	func.swap(job->func);
+	JobCounter *counter = job->counter;
+	job->used.store(false, std::memory_order_release);
+
+	func();
+
+	if (counter == nullptr) {
+		return;
+	}
+
+	Job *ready = nullptr;
+	counter->Lock();
+	if (counter->pending.fetch_sub(1, std::memory_order_release) == 1) {
+		ready = counter->continuations;
+		counter->continuations = nullptr;
+	}
+	counter->Unlock();
+
+	if (ready != nullptr) {
+		JobThread &thread = GetThread();
+		while (ready != nullptr) {
+			// a pushed job may run right away
+			Job *next = ready->next;
+			Push(thread, ready);
+			ready = next;
+		}
+	}
+}
+
+void JobSystem::WorkerMain(int index)
+{
+	const std::string name = "Worker " + std::to_string(index + 1);
+	Profiler::SetThreadName(name.c_str());
+
+	JobThread &thread = GetThread();
+
+	int idle = 0;
+	while (running.load(std::memory_order_acquire)) {
+		Job *job = FindJob(thread);
+		if (job != nullptr) {
+			Execute(job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers.fetch_add(1);
+		wakeCondition.wait(lock, [this]() {
+			return queuedJobs.load() > 0 || !running.load();
+		});
+		sleepingWorkers.fetch_sub(1);
+		idle = 0;
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include "WorkStealingDeque.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+struct JobThread;
+
+// counts the unfinished jobs run with it. jobs can be made to wait for a counter, and any thread
+// can wait for one with JobSystem::Wait(). a counter must outlive the jobs run with it and those
+// waiting for it; counters can be reused once done.
+class JobCounter
+{
+public:
+	JobCounter() : pending(0) {}
+	JobCounter(const JobCounter &) = delete;
+	JobCounter &operator=(const JobCounter &) = delete;
+
+	bool IsDone() const;
+
+private:
+	friend class JobSystem;
+
+	inline void Lock() const
+	{
+		while (locked.exchange(true, std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+	}
+
+	inline void Unlock() const
+	{
+		locked.store(false, std::memory_order_release);
+	}
+
+	// only changed while locked, so a thread that saw zero and then got the lock knows the
+	// thread that finished the last job is done with the counter
+	std::atomic<int> pending;
+	mutable std::atomic<bool> locked { false };
+	// jobs that run once pending reaches zero, linked through Job::next so that holding a job
+	// back never allocates
+	Job *continuations = nullptr;
+};
+
+// fixed pool of worker threads that run jobs, shared by everything in the engine that wants to
+// run things in parallel (including bullet, see PhysicsTaskScheduler).
+//
+// every thread that runs jobs has its own work-stealing deque: it takes the newest jobs from its
+// own and steals the oldest from the others once it runs dry. threads that aren't workers (the
+// game thread, the physics thread) get a deque the first time they run or wait for jobs, and
+// work on jobs too while they wait, so waiting inside a job never deadlocks. idle workers spin
+// briefly and then sleep until new jobs come in.
+class JobSystem
+{
+public:
+	// num_workers < 0 starts one worker per core besides the calling thread
+	JobSystem(int num_workers=-1);
+	// jobs still queued are not run, wait for their counters first
+	~JobSystem();
+
+	// runs func on some thread. counter, if given, counts the job until it finishes. with after,
+	// the job is held back until that counter is done.
+	void Run(const std::function<void()> &func, JobCounter *counter=nullptr, JobCounter *after=nullptr);
+
+	// runs other jobs until the counter is done
+	void Wait(const JobCounter &counter);
+
+	// calls func(range_begin, range_end) on ranges covering [begin, end), on all threads, and
+	// returns once every range is done. ranges are at least grain_size long.
+	void ParallelFor(size_t begin, size_t end, size_t grain_size, const std::function<void(size_t, size_t)> &func);
+
+	// index of the calling thread among those that ever ran jobs, below MAX_THREADS. threads
+	// get one the first time they run or wait for jobs, so it is stable for the thread's lifetime.
+	int GetThreadIndex();
+
+	inline int GetWorkerCount() const { return int(workers.size()); }
+	// workers plus the calling thread, the number of jobs that can run at once
+	inline int GetThreadCount() const { return int(workers.size()) + 1; }
+
+	// threads that can run jobs, workers and others together
+	static const int MAX_THREADS = 64;
+	// jobs per thread that can be queued or waiting on a counter at once, Run() does the job
+	// right away when they are all taken
+	static const int MAX_JOBS = 4096;
+
+private:
+	// the calling thread's deque, made on first use
+	JobThread &GetThread();
+	// a free job slot of the thread, nullptr if none is left
+	Job *TakeJob(JobThread &thread);
+	void Push(JobThread &thread, Job *job);
+	Job *FindJob(JobThread &thread);
+	void Execute(Job *job);
+	void WorkerMain(int index);
+
+	// tells the system apart from any other, even one created later at the same address
+	const uint64_t id;
+
+	std::vector<std::thread> workers;
+	std::atomic<bool> running { true };
+
+	// deques of all threads that ever ran jobs, up to threadCount
+	std::atomic<JobThread*> threads[MAX_THREADS];
+	std::atomic<int> threadCount { 0 };
+
+	// jobs sitting in the deques, workers sleep while there are none
+	std::atomic<int> queuedJobs { 0 };
+	std::atomic<int> sleepingWorkers { 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+};
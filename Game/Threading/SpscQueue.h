@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// fixed capacity, lock-free queue for exactly one producer thread and one consumer thread.
+// capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+	SpscQueue() : head(0), tail(0)
+	{
+	}
+
+	// called from the producer thread. returns false if the queue is full.
+	bool Push(const T &item)
+	{
+		const size_t current_tail = tail.load(std::memory_order_relaxed);
+		if (current_tail - head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+
+		items[current_tail & (Capacity - 1)] = item;
+		tail.store(current_tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// called from the consumer thread. returns false if the queue is empty.
+	bool Pop(T &item)
+	{
+		const size_t current_head = head.load(std::memory_order_relaxed);
+		if (current_head == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		item = items[current_head & (Capacity - 1)];
+		head.store(current_head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	// head and tail are written by different threads, keep them on separate cache lines
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+	alignas(64) T items[Capacity];
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+
+// lock-free triple buffer for handing the latest version of some data from one writer thread
+// to one reader thread. the writer fills GetWriteBuffer() and calls Publish(); the reader calls
+// Acquire() to swap in the newest published buffer. neither side ever blocks or waits.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : write_index(0), read_index(1), shared(2)
+	{
+	}
+
+	// writer side
+	inline T &GetWriteBuffer() { return buffers[write_index]; }
+
+	void Publish()
+	{
+		// hand our buffer over to the middle slot and take whatever was left there
+		const int previous = shared.exchange(write_index | NEW_DATA_BIT, std::memory_order_acq_rel);
+		write_index = previous & INDEX_MASK;
+	}
+
+	// reader side. returns true if a newer buffer was published since the last call.
+	bool Acquire()
+	{
+		if ((shared.load(std::memory_order_relaxed) & NEW_DATA_BIT) == 0) {
+			return false;
+		}
+
+		const int previous = shared.exchange(read_index, std::memory_order_acq_rel);
+		read_index = previous & INDEX_MASK;
+		return true;
+	}
+
+	inline const T &GetReadBuffer() const { return buffers[read_index]; }
+
+private:
+	enum {
+		INDEX_MASK = 0x3,
+		NEW_DATA_BIT = 0x4
+	};
+
+	T buffers[3];
+
+	int write_index;
+	int read_index;
+	std::atomic<int> shared;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// fixed capacity Chase-Lev deque of pointers. the owning thread pushes and pops at the bottom,
+// any other thread may steal from the top. capacity must be a power of two.
+//
+// see "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013), without
+// the resizing.
+template <typename T, size_t Capacity>
+class WorkStealingDeque
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "WorkStealingDeque capacity must be a power of two");
+
+public:
+	WorkStealingDeque() : top(0), bottom(0)
+	{
+		for (std::atomic<T*> &item : items) {
+			item.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	// called from the owning thread. returns false if the deque is full.
+	bool Push(T *item)
+	{
+		const int64_t current_bottom = bottom.load(std::memory_order_relaxed);
+		const int64_t current_top = top.load(std::memory_order_acquire);
+		if (current_bottom - current_top >= int64_t(Capacity)) {
+			return false;
+		}
+
+		items[current_bottom & (Capacity - 1)].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(current_bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// called from the owning thread, takes the newest item. nullptr if empty.
+	T *Pop()
+	{
+		const int64_t current_bottom = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(current_bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t current_top = top.load(std::memory_order_relaxed);
+
+		if (current_top > current_bottom) {
+			// was already empty
+			bottom.store(current_bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		T *item = items[current_bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+		if (current_top == current_bottom) {
+			// the last item, a thief may be after it too
+			if (!top.compare_exchange_strong(current_top, current_top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				item = nullptr;
+			}
+			bottom.store(current_bottom + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+
+	// called from any thread, takes the oldest item. nullptr if empty or another thread got it first.
+	T *Steal()
+	{
+		int64_t current_top = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t current_bottom = bottom.load(std::memory_order_acquire);
+
+		if (current_top >= current_bottom) {
+			return nullptr;
+		}
+
+		T *item = items[current_top & (Capacity - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(current_top, current_top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		return item;
+	}
+
+private:
+	// top is written by thieves, bottom by the owner only, keep them on separate cache lines
+	alignas(64) std::atomic<int64_t> top;
+	alignas(64) std::atomic<int64_t> bottom;
+	alignas(64) std::atomic<T*> items[Capacity];
+};
@@ -0,0 +1,357 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btIncrementalDbvtBroadphase.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <stdio.h> //printf
+#include <string.h> //memset
+
+
+// adds a pair for every leaf overlapping the leaf of one proxy
+struct btIncrementalDbvtCollider : btDbvt::ICollide
+{
+	btOverlappingPairCache* m_paircache;
+	bool m_trackPartners;
+
+	btIncrementalDbvtCollider( btOverlappingPairCache* paircache, bool trackPartners ) : m_paircache( paircache ), m_trackPartners( trackPartners ) {}
+
+	void Process( const btDbvtNode* na, const btDbvtNode* nb )
+	{
+		if ( na != nb )
+		{
+			btIncrementalDbvtProxy* pa = (btIncrementalDbvtProxy*)na->data;
+			btIncrementalDbvtProxy* pb = (btIncrementalDbvtProxy*)nb->data;
+			const int numPairs = m_paircache->getNumOverlappingPairs();
+			m_paircache->addOverlappingPair( pa, pb );
+			// pairs that were there already are known to both
+			if ( m_trackPartners && m_paircache->getNumOverlappingPairs() != numPairs )
+			{
+				btIncrementalDbvtBroadphase::linkPartners( pa, pb );
+			}
+		}
+	}
+};
+
+
+btIncrementalDbvtBroadphase::btIncrementalDbvtBroadphase( btOverlappingPairCache* paircache )
+	: btDbvtBroadphase( paircache )
+{
+	m_staticToDynamic = 0;
+	m_trackPartners = !m_paircache->hasDeferredRemoval();
+	memset( &m_stats, 0, sizeof( m_stats ) );
+}
+
+
+void btIncrementalDbvtBroadphase::linkPartners( btIncrementalDbvtProxy* a, btIncrementalDbvtProxy* b )
+{
+	if ( a->stage != PROXY_STATIC )
+	{
+		a->m_partners.push_back( b );
+	}
+	if ( b->stage != PROXY_STATIC )
+	{
+		b->m_partners.push_back( a );
+	}
+}
+
+
+void btIncrementalDbvtBroadphase::unlinkPartner( btIncrementalDbvtProxy* proxy, btIncrementalDbvtProxy* partner )
+{
+	if ( proxy->stage != PROXY_STATIC )
+	{
+		btAlignedObjectArray<btIncrementalDbvtProxy*>& partners = proxy->m_partners;
+		const int index = partners.findLinearSearch( partner );
+		if ( index < partners.size() )
+		{
+			partners.swap( index, partners.size() - 1 );
+			partners.pop_back();
+		}
+	}
+}
+
+
+// a static proxy that went into the dynamic tree has no list yet, its pairs are only known to the cache
+void btIncrementalDbvtBroadphase::findPartners( btIncrementalDbvtProxy* proxy )
+{
+	proxy->m_partners.resize( 0 );
+	btBroadphasePairArray& pairs = m_paircache->getOverlappingPairArray();
+	for ( int i = 0; i < pairs.size(); ++i )
+	{
+		if ( pairs[ i ].m_pProxy0 == proxy )
+		{
+			proxy->m_partners.push_back( (btIncrementalDbvtProxy*)pairs[ i ].m_pProxy1 );
+		}
+		else if ( pairs[ i ].m_pProxy1 == proxy )
+		{
+			proxy->m_partners.push_back( (btIncrementalDbvtProxy*)pairs[ i ].m_pProxy0 );
+		}
+	}
+}
+
+
+// takes a proxy about to be destroyed out of the lists of its partners
+void btIncrementalDbvtBroadphase::forgetPartners( btIncrementalDbvtProxy* proxy )
+{
+	if ( proxy->stage != PROXY_STATIC )
+	{
+		for ( int i = 0; i < proxy->m_partners.size(); ++i )
+		{
+			unlinkPartner( proxy->m_partners[ i ], proxy );
+		}
+		return;
+	}
+
+	// a static proxy keeps no list, walk the pairs like removeOverlappingPairsContainingProxy does
+	btBroadphasePairArray& pairs = m_paircache->getOverlappingPairArray();
+	for ( int i = 0; i < pairs.size(); ++i )
+	{
+		if ( pairs[ i ].m_pProxy0 == proxy )
+		{
+			unlinkPartner( (btIncrementalDbvtProxy*)pairs[ i ].m_pProxy1, proxy );
+		}
+		else if ( pairs[ i ].m_pProxy1 == proxy )
+		{
+			unlinkPartner( (btIncrementalDbvtProxy*)pairs[ i ].m_pProxy0, proxy );
+		}
+	}
+}
+
+
+void btIncrementalDbvtBroadphase::queueMovedProxy( btDbvtProxy* proxy )
+{
+	if ( proxy->stage != PROXY_MOVED )
+	{
+		proxy->stage = PROXY_MOVED;
+		m_movedProxies.push_back( proxy );
+	}
+}
+
+
+btBroadphaseProxy* btIncrementalDbvtBroadphase::createProxy( const btVector3& aabbMin, const btVector3& aabbMax, int /*shapeType*/, void* userPtr, short int collisionFilterGroup, short int collisionFilterMask, btDispatcher* /*dispatcher*/, void* /*multiSapProxy*/ )
+{
+	btIncrementalDbvtProxy* proxy = new( btAlignedAlloc( sizeof( btIncrementalDbvtProxy ), 16 ) ) btIncrementalDbvtProxy( aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask );
+	btDbvtVolume aabb = btDbvtVolume::FromMM( aabbMin, aabbMax );
+	proxy->m_uniqueId = ++m_gid;
+	if ( collisionFilterGroup & btBroadphaseProxy::StaticFilter )
+	{
+		proxy->stage = PROXY_STATIC;
+		proxy->leaf = m_sets[ FIXED_SET ].insert( aabb, proxy );
+		m_fixedleft = m_sets[ FIXED_SET ].m_leaves;
+		// nothing in the dynamic tree looks for it unless it moves, so find its pairs now
+		btIncrementalDbvtCollider collider( m_paircache, m_trackPartners );
+		m_sets[ DYNAMIC_SET ].collideTTpersistentStack( m_sets[ DYNAMIC_SET ].m_root, proxy->leaf, collider );
+	}
+	else
+	{
+		proxy->stage = PROXY_DYNAMIC;
+		proxy->leaf = m_sets[ DYNAMIC_SET ].insert( aabb, proxy );
+		queueMovedProxy( proxy );
+	}
+	return proxy;
+}
+
+
+void btIncrementalDbvtBroadphase::destroyProxy( btBroadphaseProxy* absproxy, btDispatcher* dispatcher )
+{
+	btIncrementalDbvtProxy* proxy = (btIncrementalDbvtProxy*)absproxy;
+	if ( m_trackPartners )
+	{
+		forgetPartners( proxy );
+	}
+	if ( proxy->stage == PROXY_STATIC )
+	{
+		m_sets[ FIXED_SET ].remove( proxy->leaf );
+		m_fixedleft = m_sets[ FIXED_SET ].m_leaves;
+	}
+	else
+	{
+		m_sets[ DYNAMIC_SET ].remove( proxy->leaf );
+		if ( proxy->stage == PROXY_MOVED )
+		{
+			m_movedProxies.remove( proxy );
+		}
+	}
+	m_paircache->removeOverlappingPairsContainingProxy( proxy, dispatcher );
+	proxy->~btIncrementalDbvtProxy();
+	btAlignedFree( proxy );
+}
+
+
+void btIncrementalDbvtBroadphase::setAabb( btBroadphaseProxy* absproxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* /*dispatcher*/ )
+{
+	btIncrementalDbvtProxy* proxy = (btIncrementalDbvtProxy*)absproxy;
+	ATTRIBUTE_ALIGNED16( btDbvtVolume ) aabb = btDbvtVolume::FromMM( aabbMin, aabbMax );
+	if ( proxy->stage == PROXY_STATIC )
+	{
+		if ( !NotEqual( aabb, proxy->leaf->volume ) )
+		{
+			return;
+		}
+		// a static object that moves, e.g. a kinematic body
+		m_sets[ FIXED_SET ].remove( proxy->leaf );
+		m_fixedleft = m_sets[ FIXED_SET ].m_leaves;
+		proxy->leaf = m_sets[ DYNAMIC_SET ].insert( aabb, proxy );
+		++m_staticToDynamic;
+		queueMovedProxy( proxy );
+		if ( m_trackPartners )
+		{
+			findPartners( proxy );
+		}
+	}
+	else
+	{
+		// same leaf update as btDbvtBroadphase::setAabb
+		++m_updates_call;
+		bool moved = true;
+		if ( Intersect( proxy->leaf->volume, aabb ) )
+		{
+			const btVector3 delta = aabbMin - proxy->m_aabbMin;
+			btVector3 velocity( ( ( proxy->m_aabbMax - proxy->m_aabbMin ) / 2 ) * m_prediction );
+			if ( delta[ 0 ] < 0 ) velocity[ 0 ] = -velocity[ 0 ];
+			if ( delta[ 1 ] < 0 ) velocity[ 1 ] = -velocity[ 1 ];
+			if ( delta[ 2 ] < 0 ) velocity[ 2 ] = -velocity[ 2 ];
+			moved = m_sets[ DYNAMIC_SET ].update( proxy->leaf, aabb, velocity, DBVT_BP_MARGIN );
+		}
+		else
+		{
+			m_sets[ DYNAMIC_SET ].update( proxy->leaf, aabb );
+		}
+		if ( moved )
+		{
+			++m_updates_done;
+			queueMovedProxy( proxy );
+		}
+	}
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+}
+
+
+void btIncrementalDbvtBroadphase::collideMovedProxies( btDispatcher* dispatcher )
+{
+	const int numPairs = m_paircache->getNumOverlappingPairs();
+
+	{
+		BT_PROFILE( "addPairs" );
+		btIncrementalDbvtCollider collider( m_paircache, m_trackPartners );
+		for ( int i = 0; i < m_movedProxies.size(); ++i )
+		{
+			const btDbvtNode* leaf = m_movedProxies[ i ]->leaf;
+			m_sets[ FIXED_SET ].collideTTpersistentStack( m_sets[ FIXED_SET ].m_root, leaf, collider );
+			m_sets[ DYNAMIC_SET ].collideTTpersistentStack( m_sets[ DYNAMIC_SET ].m_root, leaf, collider );
+		}
+	}
+	m_stats.m_pairsAdded = m_paircache->getNumOverlappingPairs() - numPairs;
+
+	// pairs between two proxies that didn't move still overlap
+	m_stats.m_pairsRemoved = 0;
+	if ( m_trackPartners )
+	{
+		BT_PROFILE( "removePairs" );
+		for ( int i = 0; i < m_movedProxies.size(); ++i )
+		{
+			btIncrementalDbvtProxy* proxy = (btIncrementalDbvtProxy*)m_movedProxies[ i ];
+			btAlignedObjectArray<btIncrementalDbvtProxy*>& partners = proxy->m_partners;
+			int j = 0;
+			while ( j < partners.size() )
+			{
+				btIncrementalDbvtProxy* partner = partners[ j ];
+				// the pair may have been removed through the cache directly
+				const bool stale = m_paircache->findPair( proxy, partner ) == 0;
+				if ( stale || !Intersect( proxy->leaf->volume, partner->leaf->volume ) )
+				{
+					if ( !stale )
+					{
+						m_paircache->removeOverlappingPair( proxy, partner, dispatcher );
+						++m_stats.m_pairsRemoved;
+					}
+					unlinkPartner( partner, proxy );
+					// the last partner takes its place
+					partners.swap( j, partners.size() - 1 );
+					partners.pop_back();
+				}
+				else
+				{
+					++j;
+				}
+			}
+		}
+	}
+
+	for ( int i = 0; i < m_movedProxies.size(); ++i )
+	{
+		m_movedProxies[ i ]->stage = PROXY_DYNAMIC;
+	}
+	m_movedProxies.resize( 0 );
+}
+
+
+void btIncrementalDbvtBroadphase::calculateOverlappingPairs( btDispatcher* dispatcher )
+{
+	BT_PROFILE( "btIncrementalDbvtBroadphase::calculateOverlappingPairs" );
+	m_stats.m_movedProxies = m_movedProxies.size();
+	m_stats.m_staticToDynamic = m_staticToDynamic;
+	m_staticToDynamic = 0;
+
+	m_stats.m_dynamicUpdates = 1 + ( m_sets[ DYNAMIC_SET ].m_leaves * m_dupdates ) / 100;
+	m_sets[ DYNAMIC_SET ].optimizeIncremental( m_stats.m_dynamicUpdates );
+	m_stats.m_fixedUpdates = 0;
+	if ( m_fixedleft )
+	{
+		m_stats.m_fixedUpdates = 1 + ( m_sets[ FIXED_SET ].m_leaves * m_fupdates ) / 100;
+		m_sets[ FIXED_SET ].optimizeIncremental( m_stats.m_fixedUpdates );
+		m_fixedleft = btMax<int>( 0, m_fixedleft - m_stats.m_fixedUpdates );
+	}
+
+	collideMovedProxies( dispatcher );
+	// a cache with deferred removal drops the pairs that stopped overlapping here instead
+	performDeferredRemoval( dispatcher );
+	++m_pid;
+
+	m_stats.m_staticProxies = m_sets[ FIXED_SET ].m_leaves;
+	m_stats.m_dynamicProxies = m_sets[ DYNAMIC_SET ].m_leaves;
+	m_stats.m_numPairs = m_paircache->getNumOverlappingPairs();
+	if ( m_updates_call > 0 )
+	{
+		m_updates_ratio = m_updates_done / (btScalar)m_updates_call;
+	}
+	else
+	{
+		m_updates_ratio = 0;
+	}
+	m_updates_done /= 2;
+	m_updates_call /= 2;
+}
+
+
+void btIncrementalDbvtBroadphase::resetPool( btDispatcher* dispatcher )
+{
+	if ( m_sets[ DYNAMIC_SET ].m_leaves + m_sets[ FIXED_SET ].m_leaves == 0 )
+	{
+		btDbvtBroadphase::resetPool( dispatcher );
+		m_movedProxies.resize( 0 );
+		m_staticToDynamic = 0;
+	}
+}
+
+
+void btIncrementalDbvtBroadphase::printStats()
+{
+	printf( "static(%d) dynamic(%d) moved(%d) static->dynamic(%d) pairs(%d +%d -%d) optimize(%d/%d)\n",
+		m_stats.m_staticProxies, m_stats.m_dynamicProxies, m_stats.m_movedProxies, m_stats.m_staticToDynamic,
+		m_stats.m_numPairs, m_stats.m_pairsAdded, m_stats.m_pairsRemoved, m_stats.m_fixedUpdates, m_stats.m_dynamicUpdates );
+}
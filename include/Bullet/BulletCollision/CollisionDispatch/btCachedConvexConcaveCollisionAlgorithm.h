@@ -0,0 +1,117 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_CACHED_CONVEX_CONCAVE_COLLISION_ALGORITHM_H
+#define BT_CACHED_CONVEX_CONCAVE_COLLISION_ALGORITHM_H
+
+#include "btActivatingCollisionAlgorithm.h"
+#include "btCollisionCreateFunc.h"
+#include "BulletCollision/BroadphaseCollision/btDispatcher.h"
+#include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btTransform.h"
+
+class btConvexPenetrationDepthSolver;
+
+///separating axis of one triangle from the last full pass, in the space of the mesh
+struct btCachedTriangleAxis
+{
+	int			m_partId;
+	int			m_triangleIndex;
+	btVector3	m_axis;
+};
+
+///
+/// btCachedConvexConcaveCollisionAlgorithm -- convex shapes against triangle meshes, with a contact cache that
+/// is kept across steps.
+///
+///  btConvexConcaveCollisionAlgorithm creates a btConvexConvexAlgorithm for every overlapping triangle every step
+///  and starts GJK from scratch each time. This algorithm keeps the separating axis GJK found for each triangle
+///  (keyed by part id and triangle index) and starts the next query for that triangle from it, which is usually
+///  one or two iterations away from the answer. Convex shapes with polyhedral features are clipped against the
+///  triangle with that axis, like btConvexConvexAlgorithm does.
+///
+///  The transform of the convex in mesh space is remembered at every full pass. While the convex has moved less
+///  than s_motionThreshold times the contact breaking threshold (at the edge of its angular motion disc) since
+///  then, the triangles are not visited at all: no triangle that was further away than the breaking threshold can
+///  have come into contact, so the manifold points are only refreshed. The points, and the impulses the solver
+///  warm starts from, are carried over untouched.
+///
+///  Register it in place of btConvexConcaveCollisionAlgorithm for the convex and concave shape types in use with
+///  btCollisionDispatcher::registerCollisionCreateFunc.
+///
+ATTRIBUTE_ALIGNED16( class ) btCachedConvexConcaveCollisionAlgorithm : public btActivatingCollisionAlgorithm
+{
+	btPersistentManifold* m_manifoldPtr;
+	btConvexPenetrationDepthSolver* m_pdSolver;
+	bool m_isSwapped;
+	bool m_hasLastTransform;
+	btTransform m_lastConvexInMesh;		// at the last full pass
+	btAlignedObjectArray<btCachedTriangleAxis> m_axes;
+	btAlignedObjectArray<btCachedTriangleAxis> m_newAxes;
+
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	///motion since the last full pass that skips the triangles, as a fraction of the contact breaking threshold
+	static btScalar s_motionThreshold;
+
+	btCachedConvexConcaveCollisionAlgorithm( const btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, btConvexPenetrationDepthSolver* pdSolver, bool isSwapped );
+
+	virtual ~btCachedConvexConcaveCollisionAlgorithm();
+
+	virtual void processCollision( const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, const btDispatcherInfo& dispatchInfo, btManifoldResult* resultOut );
+
+	virtual btScalar calculateTimeOfImpact( btCollisionObject* body0, btCollisionObject* body1, const btDispatcherInfo& dispatchInfo, btManifoldResult* resultOut );
+
+	virtual void getAllContactManifolds( btManifoldArray& manifoldArray )
+	{
+		if ( m_manifoldPtr )
+		{
+			manifoldArray.push_back( m_manifoldPtr );
+		}
+	}
+
+	///forget the cached axes and do a full pass next time
+	void clearCache();
+
+	struct CreateFunc : public btCollisionAlgorithmCreateFunc
+	{
+		btConvexPenetrationDepthSolver* m_pdSolver;
+
+		CreateFunc( btConvexPenetrationDepthSolver* pdSolver ) : m_pdSolver( pdSolver ) {}
+
+		virtual btCollisionAlgorithm* CreateCollisionAlgorithm( btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap )
+		{
+			void* mem = ci.m_dispatcher1->allocateCollisionAlgorithm( sizeof( btCachedConvexConcaveCollisionAlgorithm ) );
+			return new( mem ) btCachedConvexConcaveCollisionAlgorithm( ci, body0Wrap, body1Wrap, m_pdSolver, false );
+		}
+	};
+
+	struct SwappedCreateFunc : public btCollisionAlgorithmCreateFunc
+	{
+		btConvexPenetrationDepthSolver* m_pdSolver;
+
+		SwappedCreateFunc( btConvexPenetrationDepthSolver* pdSolver ) : m_pdSolver( pdSolver ) {}
+
+		virtual btCollisionAlgorithm* CreateCollisionAlgorithm( btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap )
+		{
+			void* mem = ci.m_dispatcher1->allocateCollisionAlgorithm( sizeof( btCachedConvexConcaveCollisionAlgorithm ) );
+			return new( mem ) btCachedConvexConcaveCollisionAlgorithm( ci, body0Wrap, body1Wrap, m_pdSolver, true );
+		}
+	};
+};
+
+#endif //BT_CACHED_CONVEX_CONCAVE_COLLISION_ALGORITHM_H
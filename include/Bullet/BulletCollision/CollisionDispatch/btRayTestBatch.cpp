@@ -0,0 +1,601 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btRayTestBatch.h"
+#include "BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h"
+#include "BulletCollision/CollisionShapes/btOptimizedBvh.h"
+#include "LinearMath/btQuickprof.h"
+
+#if !defined(BT_USE_DOUBLE_PRECISION) && (defined(BT_USE_SSE) || defined(__SSE2__))
+#include <emmintrin.h>
+#define BT_RAY_PACKET_SSE
+#endif
+
+#define BT_RAY_PACKET_WIDTH 4
+
+
+int btRayTestBatch::s_minBatchSize = 16;
+
+
+// one value per ray of a packet
+#ifdef BT_RAY_PACKET_SSE
+
+struct btRayLanes
+{
+	__m128 v;
+
+	btRayLanes() {}
+	btRayLanes( __m128 x ) : v( x ) {}
+
+	static btRayLanes splat( btScalar x ) { return btRayLanes( _mm_set1_ps( x ) ); }
+	static btRayLanes load( const btScalar* p ) { return btRayLanes( _mm_loadu_ps( p ) ); }
+	void store( btScalar* p ) const { _mm_storeu_ps( p, v ); }
+};
+
+static SIMD_FORCE_INLINE btRayLanes operator+( const btRayLanes& a, const btRayLanes& b ) { return btRayLanes( _mm_add_ps( a.v, b.v ) ); }
+static SIMD_FORCE_INLINE btRayLanes operator-( const btRayLanes& a, const btRayLanes& b ) { return btRayLanes( _mm_sub_ps( a.v, b.v ) ); }
+static SIMD_FORCE_INLINE btRayLanes operator*( const btRayLanes& a, const btRayLanes& b ) { return btRayLanes( _mm_mul_ps( a.v, b.v ) ); }
+static SIMD_FORCE_INLINE btRayLanes operator/( const btRayLanes& a, const btRayLanes& b ) { return btRayLanes( _mm_div_ps( a.v, b.v ) ); }
+static SIMD_FORCE_INLINE btRayLanes btRayMin( const btRayLanes& a, const btRayLanes& b ) { return btRayLanes( _mm_min_ps( a.v, b.v ) ); }
+static SIMD_FORCE_INLINE btRayLanes btRayMax( const btRayLanes& a, const btRayLanes& b ) { return btRayLanes( _mm_max_ps( a.v, b.v ) ); }
+// comparisons return one bit per lane
+static SIMD_FORCE_INLINE int btRayLess( const btRayLanes& a, const btRayLanes& b ) { return _mm_movemask_ps( _mm_cmplt_ps( a.v, b.v ) ); }
+static SIMD_FORCE_INLINE int btRayLessEqual( const btRayLanes& a, const btRayLanes& b ) { return _mm_movemask_ps( _mm_cmple_ps( a.v, b.v ) ); }
+
+#else //BT_RAY_PACKET_SSE
+
+struct btRayLanes
+{
+	btScalar v[ BT_RAY_PACKET_WIDTH ];
+
+	static btRayLanes splat( btScalar x )
+	{
+		btRayLanes r;
+		for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i ) r.v[ i ] = x;
+		return r;
+	}
+	static btRayLanes load( const btScalar* p )
+	{
+		btRayLanes r;
+		for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i ) r.v[ i ] = p[ i ];
+		return r;
+	}
+	void store( btScalar* p ) const
+	{
+		for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i ) p[ i ] = v[ i ];
+	}
+};
+
+#define BT_RAY_LANES_OP( name, expr ) \
+	static SIMD_FORCE_INLINE btRayLanes name( const btRayLanes& a, const btRayLanes& b ) \
+	{ \
+		btRayLanes r; \
+		for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i ) r.v[ i ] = expr; \
+		return r; \
+	}
+BT_RAY_LANES_OP( operator+, a.v[ i ] + b.v[ i ] )
+BT_RAY_LANES_OP( operator-, a.v[ i ] - b.v[ i ] )
+BT_RAY_LANES_OP( operator*, a.v[ i ] * b.v[ i ] )
+BT_RAY_LANES_OP( operator/, a.v[ i ] / b.v[ i ] )
+BT_RAY_LANES_OP( btRayMin, a.v[ i ] < b.v[ i ] ? a.v[ i ] : b.v[ i ] )
+BT_RAY_LANES_OP( btRayMax, a.v[ i ] > b.v[ i ] ? a.v[ i ] : b.v[ i ] )
+#undef BT_RAY_LANES_OP
+
+static SIMD_FORCE_INLINE int btRayLess( const btRayLanes& a, const btRayLanes& b )
+{
+	int mask = 0;
+	for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i ) mask |= ( a.v[ i ] < b.v[ i ] ) ? ( 1 << i ) : 0;
+	return mask;
+}
+static SIMD_FORCE_INLINE int btRayLessEqual( const btRayLanes& a, const btRayLanes& b )
+{
+	int mask = 0;
+	for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i ) mask |= ( a.v[ i ] <= b.v[ i ] ) ? ( 1 << i ) : 0;
+	return mask;
+}
+
+#endif //BT_RAY_PACKET_SSE
+
+
+// start, end and inverse direction of the rays of a packet, in world or in shape space
+struct btRayPacketSegments
+{
+	btScalar m_from[ 3 ][ BT_RAY_PACKET_WIDTH ];
+	btScalar m_to[ 3 ][ BT_RAY_PACKET_WIDTH ];
+	btScalar m_invDir[ 3 ][ BT_RAY_PACKET_WIDTH ];
+
+	void setLane( int lane, const btVector3& from, const btVector3& to )
+	{
+		btVector3 dir = to - from;
+		for ( int k = 0; k < 3; ++k )
+		{
+			m_from[ k ][ lane ] = from[ k ];
+			m_to[ k ][ lane ] = to[ k ];
+			// same as btBroadphaseRayCallback, avoids 0 * inf in the slab test
+			m_invDir[ k ][ lane ] = dir[ k ] == btScalar( 0 ) ? btScalar( BT_LARGE_FLOAT ) : btScalar( 1 ) / dir[ k ];
+		}
+	}
+
+	void copyLane( int lane, int source )
+	{
+		for ( int k = 0; k < 3; ++k )
+		{
+			m_from[ k ][ lane ] = m_from[ k ][ source ];
+			m_to[ k ][ lane ] = m_to[ k ][ source ];
+			m_invDir[ k ][ lane ] = m_invDir[ k ][ source ];
+		}
+	}
+
+	///lanes whose segment 0 .. maxFraction touches the box
+	int testAabb( const btScalar* maxFraction, const btVector3& aabbMin, const btVector3& aabbMax ) const
+	{
+		btRayLanes tmin = btRayLanes::splat( btScalar( 0 ) );
+		btRayLanes tmax = btRayLanes::load( maxFraction );
+		for ( int k = 0; k < 3; ++k )
+		{
+			btRayLanes from = btRayLanes::load( m_from[ k ] );
+			btRayLanes invDir = btRayLanes::load( m_invDir[ k ] );
+			btRayLanes t0 = ( btRayLanes::splat( aabbMin[ k ] ) - from ) * invDir;
+			btRayLanes t1 = ( btRayLanes::splat( aabbMax[ k ] ) - from ) * invDir;
+			tmin = btRayMax( tmin, btRayMin( t0, t1 ) );
+			tmax = btRayMin( tmax, btRayMax( t0, t1 ) );
+		}
+		return btRayLessEqual( tmin, tmax );
+	}
+};
+
+
+struct btRayTestBatch::RayPacket
+{
+	btRayPacketSegments m_world;
+	btRayPacketSegments m_local;						// scratch for the triangle mesh currently walked
+	btScalar m_maxFraction[ BT_RAY_PACKET_WIDTH ];		// closest hit so far, nothing further away can win
+	const btBatchedRay* m_rays[ BT_RAY_PACKET_WIDTH ];
+	btBatchedRayHit* m_hits[ BT_RAY_PACKET_WIDTH ];
+	int m_activeMask;
+};
+
+
+struct btRayTestBatch::RayLoop : public btIParallelForBody
+{
+	const btRayTestBatch* m_batch;
+	const btBatchedRay* m_rays;
+	btBatchedRayHit* m_hits;
+	int m_numRays;
+
+	RayLoop( const btRayTestBatch* batch, const btBatchedRay* rays, int numRays, btBatchedRayHit* hits )
+	{
+		m_batch = batch;
+		m_rays = rays;
+		m_numRays = numRays;
+		m_hits = hits;
+	}
+
+	void setHit( RayPacket& packet, int lane, const btCollisionObject* collisionObject, const btVector3& hitNormalWorld, btScalar hitFraction, int partId, int triangleIndex ) const
+	{
+		btBatchedRayHit* hit = packet.m_hits[ lane ];
+		hit->m_collisionObject = collisionObject;
+		hit->m_hitNormalWorld = hitNormalWorld;
+		hit->m_hitFraction = hitFraction;
+		hit->m_partId = partId;
+		hit->m_triangleIndex = triangleIndex;
+		packet.m_maxFraction[ lane ] = hitFraction;
+	}
+
+	// same test as btTriangleRaycastCallback::processTriangle, for all lanes in mask
+	void testTriangle( RayPacket& packet, int mask, const btVector3* triangle, const btCollisionObject* collisionObject, int partId, int triangleIndex ) const
+	{
+		const btVector3& vert0 = triangle[ 0 ];
+		const btVector3& vert1 = triangle[ 1 ];
+		const btVector3& vert2 = triangle[ 2 ];
+		btVector3 triangleNormal = ( vert1 - vert0 ).cross( vert2 - vert0 );
+		const btRayPacketSegments& seg = packet.m_local;
+
+		btRayLanes nx = btRayLanes::splat( triangleNormal.x() );
+		btRayLanes ny = btRayLanes::splat( triangleNormal.y() );
+		btRayLanes nz = btRayLanes::splat( triangleNormal.z() );
+		btRayLanes dist = btRayLanes::splat( vert0.dot( triangleNormal ) );
+		btRayLanes fx = btRayLanes::load( seg.m_from[ 0 ] ), fy = btRayLanes::load( seg.m_from[ 1 ] ), fz = btRayLanes::load( seg.m_from[ 2 ] );
+		btRayLanes tx = btRayLanes::load( seg.m_to[ 0 ] ), ty = btRayLanes::load( seg.m_to[ 1 ] ), tz = btRayLanes::load( seg.m_to[ 2 ] );
+		btRayLanes distA = ( nx * fx + ny * fy + nz * fz ) - dist;
+		btRayLanes distB = ( nx * tx + ny * ty + nz * tz ) - dist;
+		btRayLanes zero = btRayLanes::splat( btScalar( 0 ) );
+
+		// the segment has to cross the plane
+		mask &= btRayLess( distA * distB, zero );
+		if ( !mask )
+		{
+			return;
+		}
+		btRayLanes distance = distA / ( distA - distB );
+		mask &= btRayLess( distance, btRayLanes::load( packet.m_maxFraction ) );
+		if ( !mask )
+		{
+			return;
+		}
+
+		btRayLanes edgeTolerance = btRayLanes::splat( triangleNormal.length2() * btScalar( -0.0001 ) );
+		btRayLanes s = btRayLanes::splat( btScalar( 1 ) ) - distance;
+		btRayLanes px = s * fx + distance * tx;
+		btRayLanes py = s * fy + distance * ty;
+		btRayLanes pz = s * fz + distance * tz;
+		btRayLanes v0x = btRayLanes::splat( vert0.x() ) - px, v0y = btRayLanes::splat( vert0.y() ) - py, v0z = btRayLanes::splat( vert0.z() ) - pz;
+		btRayLanes v1x = btRayLanes::splat( vert1.x() ) - px, v1y = btRayLanes::splat( vert1.y() ) - py, v1z = btRayLanes::splat( vert1.z() ) - pz;
+		btRayLanes v2x = btRayLanes::splat( vert2.x() ) - px, v2y = btRayLanes::splat( vert2.y() ) - py, v2z = btRayLanes::splat( vert2.z() ) - pz;
+		// the point has to be on the inner side of all three edges
+		btRayLanes cp0 = ( v0y * v1z - v0z * v1y ) * nx + ( v0z * v1x - v0x * v1z ) * ny + ( v0x * v1y - v0y * v1x ) * nz;
+		btRayLanes cp1 = ( v1y * v2z - v1z * v2y ) * nx + ( v1z * v2x - v1x * v2z ) * ny + ( v1x * v2y - v1y * v2x ) * nz;
+		btRayLanes cp2 = ( v2y * v0z - v2z * v0y ) * nx + ( v2z * v0x - v2x * v0z ) * ny + ( v2x * v0y - v2y * v0x ) * nz;
+		mask &= btRayLessEqual( edgeTolerance, cp0 ) & btRayLessEqual( edgeTolerance, cp1 ) & btRayLessEqual( edgeTolerance, cp2 );
+		if ( !mask )
+		{
+			return;
+		}
+
+		btScalar laneDistA[ BT_RAY_PACKET_WIDTH ];
+		btScalar laneDistance[ BT_RAY_PACKET_WIDTH ];
+		distA.store( laneDistA );
+		distance.store( laneDistance );
+		btVector3 normalWorld = collisionObject->getWorldTransform().getBasis() * triangleNormal.normalized();
+		for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i )
+		{
+			if ( mask & ( 1 << i ) )
+			{
+				// the normal faces the start of the ray
+				setHit( packet, i, collisionObject, laneDistA[ i ] <= btScalar( 0 ) ? -normalWorld : normalWorld, laneDistance[ i ], partId, triangleIndex );
+			}
+		}
+	}
+
+	void walkTriangleMesh( RayPacket& packet, int mask, const btCollisionObject* collisionObject, btBvhTriangleMeshShape* meshShape ) const
+	{
+		btOptimizedBvh* bvh = meshShape->getOptimizedBvh();
+		const btStridingMeshInterface* meshInterface = meshShape->getMeshInterface();
+		const btVector3& meshScaling = meshInterface->getScaling();
+
+		// the bvh and the triangles are in the space of the shape
+		btTransform worldToShape = collisionObject->getWorldTransform().inverse();
+		int firstLane = -1;
+		for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i )
+		{
+			if ( mask & ( 1 << i ) )
+			{
+				packet.m_local.setLane( i, worldToShape * packet.m_rays[ i ]->m_rayFromWorld, worldToShape * packet.m_rays[ i ]->m_rayToWorld );
+				if ( firstLane < 0 )
+				{
+					firstLane = i;
+				}
+			}
+		}
+		for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i )
+		{
+			if ( !( mask & ( 1 << i ) ) )
+			{
+				packet.m_local.copyLane( i, firstLane );
+			}
+		}
+
+		// stackless walk like btQuantizedBvh::walkStacklessQuantizedTreeAgainstRay, the escape index of the root is the node count
+		const btQuantizedBvhNode* node = &bvh->getQuantizedNodeArray()[ 0 ];
+		int endNodeIndex = node->isLeafNode() ? 1 : node->getEscapeIndex();
+		int nodeIndex = 0;
+		while ( nodeIndex < endNodeIndex )
+		{
+			btVector3 aabbMin = bvh->unQuantize( node->m_quantizedAabbMin );
+			btVector3 aabbMax = bvh->unQuantize( node->m_quantizedAabbMax );
+			int overlap = mask & packet.m_local.testAabb( packet.m_maxFraction, aabbMin, aabbMax );
+			bool isLeafNode = node->isLeafNode();
+			if ( overlap && isLeafNode )
+			{
+				const int partId = node->getPartId();
+				const int triangleIndex = node->getTriangleIndex();
+				const unsigned char* vertexbase;
+				int numverts;
+				PHY_ScalarType type;
+				int stride;
+				const unsigned char* indexbase;
+				int indexstride;
+				int numfaces;
+				PHY_ScalarType indicestype;
+				meshInterface->getLockedReadOnlyVertexIndexBase( &vertexbase, numverts, type, stride, &indexbase, indexstride, numfaces, indicestype, partId );
+
+				const unsigned int* gfxbase = (const unsigned int*)( indexbase + triangleIndex * indexstride );
+				btVector3 triangle[ 3 ];
+				for ( int j = 2; j >= 0; j-- )
+				{
+					int graphicsindex = indicestype == PHY_SHORT ? ( (const unsigned short*)gfxbase )[ j ] : indicestype == PHY_INTEGER ? gfxbase[ j ] : ( (const unsigned char*)gfxbase )[ j ];
+					if ( type == PHY_FLOAT )
+					{
+						const float* graphicsbase = (const float*)( vertexbase + graphicsindex * stride );
+						triangle[ j ] = btVector3( graphicsbase[ 0 ] * meshScaling.getX(), graphicsbase[ 1 ] * meshScaling.getY(), graphicsbase[ 2 ] * meshScaling.getZ() );
+					}
+					else
+					{
+						const double* graphicsbase = (const double*)( vertexbase + graphicsindex * stride );
+						triangle[ j ] = btVector3( btScalar( graphicsbase[ 0 ] ) * meshScaling.getX(), btScalar( graphicsbase[ 1 ] ) * meshScaling.getY(), btScalar( graphicsbase[ 2 ] ) * meshScaling.getZ() );
+					}
+				}
+				testTriangle( packet, overlap, triangle, collisionObject, partId, triangleIndex );
+				meshInterface->unLockReadOnlyVertexBase( partId );
+			}
+			if ( overlap || isLeafNode )
+			{
+				node++;
+				nodeIndex++;
+			}
+			else
+			{
+				int escapeIndex = node->getEscapeIndex();
+				node += escapeIndex;
+				nodeIndex += escapeIndex;
+			}
+		}
+	}
+
+	void processProxy( RayPacket& packet, int mask, const btBroadphaseProxy* proxy ) const
+	{
+		// same filter as ClosestRayResultCallback::needsCollision
+		for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i )
+		{
+			const btBatchedRay* ray = packet.m_rays[ i ];
+			if ( ( mask & ( 1 << i ) ) && !( ( proxy->m_collisionFilterGroup & ray->m_collisionFilterMask ) && ( ray->m_collisionFilterGroup & proxy->m_collisionFilterMask ) ) )
+			{
+				mask &= ~( 1 << i );
+			}
+		}
+		if ( !mask )
+		{
+			return;
+		}
+
+		const btCollisionObject* collisionObject = (const btCollisionObject*)proxy->m_clientObject;
+		const btCollisionShape* collisionShape = collisionObject->getCollisionShape();
+		if ( collisionShape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE )
+		{
+			btBvhTriangleMeshShape* meshShape = (btBvhTriangleMeshShape*)collisionShape;
+			if ( meshShape->getOptimizedBvh() && meshShape->getOptimizedBvh()->isQuantized() )
+			{
+				walkTriangleMesh( packet, mask, collisionObject, meshShape );
+				return;
+			}
+		}
+
+		// any other shape, one ray at a time
+		for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i )
+		{
+			if ( mask & ( 1 << i ) )
+			{
+				const btBatchedRay* ray = packet.m_rays[ i ];
+				btTransform rayFromTrans;
+				rayFromTrans.setIdentity();
+				rayFromTrans.setOrigin( ray->m_rayFromWorld );
+				btTransform rayToTrans;
+				rayToTrans.setIdentity();
+				rayToTrans.setOrigin( ray->m_rayToWorld );
+
+				btCollisionWorld::ClosestRayResultCallback resultCallback( ray->m_rayFromWorld, ray->m_rayToWorld );
+				resultCallback.m_collisionFilterGroup = ray->m_collisionFilterGroup;
+				resultCallback.m_collisionFilterMask = ray->m_collisionFilterMask;
+				resultCallback.m_closestHitFraction = packet.m_maxFraction[ i ];
+				btCollisionWorld::rayTestSingle( rayFromTrans, rayToTrans, (btCollisionObject*)collisionObject, collisionShape, collisionObject->getWorldTransform(), resultCallback );
+				if ( resultCallback.hasHit() )
+				{
+					setHit( packet, i, collisionObject, resultCallback.m_hitNormalWorld, resultCallback.m_closestHitFraction, -1, -1 );
+				}
+			}
+		}
+	}
+
+	void walkTree( RayPacket& packet, const btDbvtNode* root, btAlignedObjectArray<const btDbvtNode*>& stack ) const
+	{
+		if ( !root )
+		{
+			return;
+		}
+		stack.resize( 0 );
+		stack.push_back( root );
+		while ( stack.size() )
+		{
+			const btDbvtNode* node = stack[ stack.size() - 1 ];
+			stack.pop_back();
+			int mask = packet.m_activeMask & packet.m_world.testAabb( packet.m_maxFraction, node->volume.Mins(), node->volume.Maxs() );
+			if ( !mask )
+			{
+				continue;
+			}
+			if ( node->isinternal() )
+			{
+				stack.push_back( node->childs[ 0 ] );
+				stack.push_back( node->childs[ 1 ] );
+			}
+			else
+			{
+				processProxy( packet, mask, (const btBroadphaseProxy*)node->data );
+			}
+		}
+	}
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		btAlignedObjectArray<const btDbvtNode*> stack;
+		for ( int iPacket = iBegin; iPacket < iEnd; ++iPacket )
+		{
+			RayPacket packet;
+			packet.m_activeMask = 0;
+			const int firstKey = iPacket * BT_RAY_PACKET_WIDTH;
+			for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i )
+			{
+				// a short last packet repeats its first ray in the unused lanes, they are never active
+				const int key = firstKey + i < m_numRays ? firstKey + i : firstKey;
+				const int iRay = m_batch->m_sortKeys[ key ].m_ray;
+				if ( key == firstKey + i )
+				{
+					packet.m_activeMask |= 1 << i;
+				}
+				packet.m_rays[ i ] = &m_rays[ iRay ];
+				packet.m_hits[ i ] = &m_hits[ iRay ];
+				packet.m_world.setLane( i, m_rays[ iRay ].m_rayFromWorld, m_rays[ iRay ].m_rayToWorld );
+				packet.m_maxFraction[ i ] = btScalar( 1 );
+			}
+			for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i )
+			{
+				if ( packet.m_activeMask & ( 1 << i ) )
+				{
+					btBatchedRayHit* hit = packet.m_hits[ i ];
+					hit->m_collisionObject = 0;
+					hit->m_hitFraction = btScalar( 1 );
+					hit->m_partId = -1;
+					hit->m_triangleIndex = -1;
+				}
+			}
+
+			walkTree( packet, m_batch->m_broadphase->m_sets[ 0 ].m_root, stack );
+			walkTree( packet, m_batch->m_broadphase->m_sets[ 1 ].m_root, stack );
+
+			for ( int i = 0; i < BT_RAY_PACKET_WIDTH; ++i )
+			{
+				btBatchedRayHit* hit = packet.m_hits[ i ];
+				if ( ( packet.m_activeMask & ( 1 << i ) ) && hit->m_collisionObject )
+				{
+					hit->m_hitPointWorld.setInterpolate3( packet.m_rays[ i ]->m_rayFromWorld, packet.m_rays[ i ]->m_rayToWorld, hit->m_hitFraction );
+				}
+			}
+		}
+	}
+};
+
+
+struct btRayTestBatch::ConvexCastLoop : public btIParallelForBody
+{
+	const btCollisionWorld* m_collisionWorld;
+	const btBatchedConvexCast* m_casts;
+	btBatchedRayHit* m_hits;
+
+	ConvexCastLoop( const btCollisionWorld* collisionWorld, const btBatchedConvexCast* casts, btBatchedRayHit* hits )
+	{
+		m_collisionWorld = collisionWorld;
+		m_casts = casts;
+		m_hits = hits;
+	}
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			const btBatchedConvexCast& cast = m_casts[ i ];
+			btCollisionWorld::ClosestConvexResultCallback resultCallback( cast.m_convexFromWorld.getOrigin(), cast.m_convexToWorld.getOrigin() );
+			resultCallback.m_collisionFilterGroup = cast.m_collisionFilterGroup;
+			resultCallback.m_collisionFilterMask = cast.m_collisionFilterMask;
+			m_collisionWorld->convexSweepTest( cast.m_castShape, cast.m_convexFromWorld, cast.m_convexToWorld, resultCallback, cast.m_allowedCcdPenetration );
+
+			btBatchedRayHit& hit = m_hits[ i ];
+			hit.m_collisionObject = resultCallback.m_hitCollisionObject;
+			hit.m_hitPointWorld = resultCallback.m_hitPointWorld;
+			hit.m_hitNormalWorld = resultCallback.m_hitNormalWorld;
+			hit.m_hitFraction = resultCallback.m_closestHitFraction;
+			hit.m_partId = -1;
+			hit.m_triangleIndex = -1;
+		}
+	}
+};
+
+
+btRayTestBatch::btRayTestBatch( const btCollisionWorld* collisionWorld, const btDbvtBroadphase* broadphase )
+{
+	btAssert( collisionWorld->getBroadphase() == broadphase );
+	m_collisionWorld = collisionWorld;
+	m_broadphase = broadphase;
+}
+
+
+// spreads the low 9 bits of x so there are two zero bits between each of them
+static unsigned int btSpreadBits9( unsigned int x )
+{
+	x &= 0x1ff;
+	x = ( x | ( x << 16 ) ) & 0x030000ff;
+	x = ( x | ( x << 8 ) ) & 0x0300f00f;
+	x = ( x | ( x << 4 ) ) & 0x030c30c3;
+	x = ( x | ( x << 2 ) ) & 0x09249249;
+	return x;
+}
+
+
+struct btRaySortKeyLess
+{
+	template<typename T>
+	bool operator()( const T& a, const T& b ) const
+	{
+		return a.m_key < b.m_key || ( a.m_key == b.m_key && a.m_ray < b.m_ray );
+	}
+};
+
+
+void btRayTestBatch::sortRays( const btBatchedRay* rays, int numRays )
+{
+	btVector3 boundsMin = rays[ 0 ].m_rayFromWorld;
+	btVector3 boundsMax = rays[ 0 ].m_rayFromWorld;
+	for ( int i = 1; i < numRays; ++i )
+	{
+		boundsMin.setMin( rays[ i ].m_rayFromWorld );
+		boundsMax.setMax( rays[ i ].m_rayFromWorld );
+	}
+	btVector3 extent = boundsMax - boundsMin;
+	btVector3 cellScale;
+	for ( int k = 0; k < 3; ++k )
+	{
+		cellScale[ k ] = extent[ k ] > SIMD_EPSILON ? btScalar( 511 ) / extent[ k ] : btScalar( 0 );
+	}
+
+	// rays going the same way from nearby starts tend to visit the same nodes, so they share a packet
+	m_sortKeys.resizeNoInitialize( numRays );
+	for ( int i = 0; i < numRays; ++i )
+	{
+		const btVector3& from = rays[ i ].m_rayFromWorld;
+		btVector3 dir = rays[ i ].m_rayToWorld - from;
+		btVector3 cell = ( from - boundsMin ) * cellScale;
+		unsigned int octant = ( dir.x() < 0 ? 1 : 0 ) | ( dir.y() < 0 ? 2 : 0 ) | ( dir.z() < 0 ? 4 : 0 );
+		unsigned int morton = btSpreadBits9( (unsigned int)cell.x() ) | ( btSpreadBits9( (unsigned int)cell.y() ) << 1 ) | ( btSpreadBits9( (unsigned int)cell.z() ) << 2 );
+		m_sortKeys[ i ].m_key = ( octant << 27 ) | morton;
+		m_sortKeys[ i ].m_ray = i;
+	}
+	m_sortKeys.quickSort( btRaySortKeyLess() );
+}
+
+
+void btRayTestBatch::rayTest( const btBatchedRay* rays, int numRays, btBatchedRayHit* hits )
+{
+	BT_PROFILE( "btRayTestBatch::rayTest" );
+	if ( numRays <= 0 )
+	{
+		return;
+	}
+	sortRays( rays, numRays );
+	const int numPackets = ( numRays + BT_RAY_PACKET_WIDTH - 1 ) / BT_RAY_PACKET_WIDTH;
+	RayLoop loop( this, rays, numRays, hits );
+	btParallelFor( 0, numPackets, s_minBatchSize, loop );
+}
+
+
+void btRayTestBatch::convexSweepTest( const btBatchedConvexCast* casts, int numCasts, btBatchedRayHit* hits ) const
+{
+	BT_PROFILE( "btRayTestBatch::convexSweepTest" );
+	if ( numCasts <= 0 )
+	{
+		return;
+	}
+	ConvexCastLoop loop( m_collisionWorld, casts, hits );
+	btParallelFor( 0, numCasts, s_minBatchSize, loop );
+}
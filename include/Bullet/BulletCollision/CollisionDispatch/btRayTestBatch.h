@@ -0,0 +1,123 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_RAY_TEST_BATCH_H
+#define BT_RAY_TEST_BATCH_H
+
+#include "btCollisionWorld.h"
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "LinearMath/btThreads.h"
+
+///one ray of a batch, the filter works like the one of btCollisionWorld::ClosestRayResultCallback
+struct btBatchedRay
+{
+	btVector3	m_rayFromWorld;
+	btVector3	m_rayToWorld;
+	int			m_collisionFilterGroup;
+	int			m_collisionFilterMask;
+
+	btBatchedRay()
+		: m_collisionFilterGroup( btBroadphaseProxy::DefaultFilter ),
+		m_collisionFilterMask( btBroadphaseProxy::AllFilter )
+	{
+	}
+
+	btBatchedRay( const btVector3& rayFromWorld, const btVector3& rayToWorld )
+		: m_rayFromWorld( rayFromWorld ),
+		m_rayToWorld( rayToWorld ),
+		m_collisionFilterGroup( btBroadphaseProxy::DefaultFilter ),
+		m_collisionFilterMask( btBroadphaseProxy::AllFilter )
+	{
+	}
+};
+
+///closest hit of one ray or convex cast, m_collisionObject is 0 and m_hitFraction 1 if nothing was hit
+struct btBatchedRayHit
+{
+	const btCollisionObject*	m_collisionObject;
+	btVector3	m_hitPointWorld;
+	btVector3	m_hitNormalWorld;
+	btScalar	m_hitFraction;
+	int			m_partId;			// triangle meshes only, -1 otherwise
+	int			m_triangleIndex;
+
+	bool hasHit() const
+	{
+		return m_collisionObject != 0;
+	}
+};
+
+///one convex cast of a batch, see btCollisionWorld::convexSweepTest
+struct btBatchedConvexCast
+{
+	const btConvexShape*	m_castShape;
+	btTransform	m_convexFromWorld;
+	btTransform	m_convexToWorld;
+	int			m_collisionFilterGroup;
+	int			m_collisionFilterMask;
+	btScalar	m_allowedCcdPenetration;
+
+	btBatchedConvexCast()
+		: m_castShape( 0 ),
+		m_collisionFilterGroup( btBroadphaseProxy::DefaultFilter ),
+		m_collisionFilterMask( btBroadphaseProxy::AllFilter ),
+		m_allowedCcdPenetration( 0 )
+	{
+	}
+};
+
+///
+/// btRayTestBatch -- closest hit ray tests for many rays at once, on all threads of the task scheduler.
+///
+///  The rays are sorted by direction octant and by the Morton code of their start point, then walked
+///  through the btDbvtBroadphase trees in packets of 4 neighbouring rays, so one node test serves 4 rays.
+///  Static and dynamic btBvhTriangleMeshShapes with a quantized bvh are walked by the same packet, and
+///  their triangles are tested 4 rays at a time with the same test as btTriangleRaycastCallback. Other
+///  shapes go through btCollisionWorld::rayTestSingle for each ray of the packet that reaches them.
+///
+///  Hits are written to hits[i] for rays[i], in the order the rays were given. The collision world must
+///  not change while rayTest runs, and the broadphase must be the one of the world.
+///  convexSweepTest runs btCollisionWorld::convexSweepTest for each cast, spread over the threads.
+///
+class btRayTestBatch
+{
+public:
+	///minimum number of ray packets or convex casts per parallel-for job
+	static int s_minBatchSize;
+
+	btRayTestBatch( const btCollisionWorld* collisionWorld, const btDbvtBroadphase* broadphase );
+
+	void rayTest( const btBatchedRay* rays, int numRays, btBatchedRayHit* hits );
+	void convexSweepTest( const btBatchedConvexCast* casts, int numCasts, btBatchedRayHit* hits ) const;
+
+protected:
+	struct RayPacket;
+	struct RayLoop;
+	struct ConvexCastLoop;
+
+	struct SortKey
+	{
+		unsigned int	m_key;
+		int				m_ray;
+	};
+
+	const btCollisionWorld*	m_collisionWorld;
+	const btDbvtBroadphase*	m_broadphase;
+	btAlignedObjectArray<SortKey>	m_sortKeys;
+
+	void sortRays( const btBatchedRay* rays, int numRays );
+};
+
+#endif //BT_RAY_TEST_BATCH_H
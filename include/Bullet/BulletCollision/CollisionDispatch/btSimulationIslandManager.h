@@ -32,6 +32,7 @@ class btSimulationIslandManager
 {
 	btUnionFind m_unionFind;
 
+protected:
 	btAlignedObjectArray<btPersistentManifold*>  m_islandmanifold;
 	btAlignedObjectArray<btCollisionObject* >  m_islandBodies;
 	
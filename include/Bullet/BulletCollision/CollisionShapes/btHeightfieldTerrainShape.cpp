@@ -16,6 +16,7 @@ subject to the following restrictions:
 #include "btHeightfieldTerrainShape.h"
 
 #include "LinearMath/btTransformUtil.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
 
 
 
@@ -392,6 +393,15 @@ void	btHeightfieldTerrainShape::processAllTriangles(btTriangleCallback* callback
 
 }
 
+void	btHeightfieldTerrainShape::performRaycast(btTriangleRaycastCallback* callback, const btVector3& raySource, const btVector3& rayTarget) const
+{
+	btVector3 rayAabbMin = raySource;
+	rayAabbMin.setMin(rayTarget);
+	btVector3 rayAabbMax = raySource;
+	rayAabbMax.setMax(rayTarget);
+	processAllTriangles(callback,rayAabbMin,rayAabbMax);
+}
+
 void	btHeightfieldTerrainShape::calculateLocalInertia(btScalar ,btVector3& inertia) const
 {
 	//moving concave objects not supported
@@ -18,6 +18,8 @@ subject to the following restrictions:
 
 #include "btConcaveShape.h"
 
+class btTriangleRaycastCallback;
+
 ///btHeightfieldTerrainShape simulates a 2D heightfield terrain
 /**
   The caller is responsible for maintaining the heightfield array; this
@@ -153,6 +155,9 @@ public:
 
 	virtual void	processAllTriangles(btTriangleCallback* callback,const btVector3& aabbMin,const btVector3& aabbMax) const;
 
+	///ray in local space, used by btCollisionWorld::rayTestSingle. this one visits the triangles in the aabb of the ray.
+	virtual void	performRaycast(btTriangleRaycastCallback* callback, const btVector3& raySource, const btVector3& rayTarget) const;
+
 	virtual void	calculateLocalInertia(btScalar mass,btVector3& inertia) const;
 
 	virtual void	setLocalScaling(const btVector3& scaling);
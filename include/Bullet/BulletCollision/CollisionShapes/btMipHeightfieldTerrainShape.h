@@ -0,0 +1,95 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_MIP_HEIGHTFIELD_TERRAIN_SHAPE_H
+#define BT_MIP_HEIGHTFIELD_TERRAIN_SHAPE_H
+
+#include "btHeightfieldTerrainShape.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+///
+/// btMipHeightfieldTerrainShape -- a y-up heightfield of 16 bit heights with a min/max mip hierarchy.
+///
+///  Grid point (x,j) is at ( gridOrigin + btVector3( x, heights[ j * width + x ], j ) * gridSpacing ) * localScaling,
+///  so a heightfield taken from a mesh keeps the mesh's coordinates instead of being centered like
+///  btHeightfieldTerrainShape. The heights are not copied and must outlive the shape.
+///
+///  Level 0 of the hierarchy holds the lowest and highest height of each cell, every further level the range of
+///  2x2 entries of the level below, up to a single entry for the whole grid. processAllTriangles and performRaycast
+///  walk it from the top and skip any block whose box misses the aabb or the ray, so a query touches a handful of
+///  entries per level instead of every cell under its aabb.
+///
+///  Triangles are reported with part id 0 and triangle index 2 * ( j * ( width - 1 ) + x ) + 0 or 1, which tells
+///  both triangles of a cell apart. The quad edge options of btHeightfieldTerrainShape are honored. Call
+///  updateMips after changing the heights.
+///
+ATTRIBUTE_ALIGNED16( class ) btMipHeightfieldTerrainShape : public btHeightfieldTerrainShape
+{
+protected:
+	struct MipLevel
+	{
+		int m_width;		// entries along x
+		int m_length;		// entries along z
+		int m_offset;		// of the first entry in m_mips
+	};
+
+	btVector3 m_gridOrigin;
+	btVector3 m_gridSpacing;
+	///two shorts per entry, the lowest and the highest height of its cells
+	btAlignedObjectArray<short> m_mips;
+	btAlignedObjectArray<MipLevel> m_levels;
+
+	SIMD_FORCE_INLINE void getGridVertex( int x, int j, btVector3& vertex ) const
+	{
+		vertex.setValue( btScalar( x ), btScalar( m_heightfieldDataShort[ j * m_heightStickWidth + x ] ), btScalar( j ) );
+		vertex = ( m_gridOrigin + vertex * m_gridSpacing ) * m_localScaling;
+	}
+
+	void processCell( btTriangleCallback* callback, int x, int j ) const;
+
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btMipHeightfieldTerrainShape( int heightStickWidth, int heightStickLength, const short* heightfieldData, const btVector3& gridOrigin, const btVector3& gridSpacing, bool flipQuadEdges );
+
+	virtual ~btMipHeightfieldTerrainShape();
+
+	///rebuilds the hierarchy and the bounds from the heights
+	void updateMips();
+
+	virtual void getAabb( const btTransform& t, btVector3& aabbMin, btVector3& aabbMax ) const;
+
+	virtual void processAllTriangles( btTriangleCallback* callback, const btVector3& aabbMin, const btVector3& aabbMax ) const;
+
+	///visits the cells along the ray front to back, and stops once the callback has a hit closer than the rest
+	virtual void performRaycast( btTriangleRaycastCallback* callback, const btVector3& raySource, const btVector3& rayTarget ) const;
+
+	const btVector3& getGridOrigin() const
+	{
+		return m_gridOrigin;
+	}
+
+	const btVector3& getGridSpacing() const
+	{
+		return m_gridSpacing;
+	}
+
+	virtual const char* getName() const
+	{
+		return "MIPHEIGHTFIELD";
+	}
+};
+
+#endif //BT_MIP_HEIGHTFIELD_TERRAIN_SHAPE_H
@@ -719,6 +719,26 @@ int	btSequentialImpulseConstraintSolver::getOrInitSolverBody(btCollisionObject&
 
 	int solverBodyIdA = -1;
 
+#if BT_THREADSAFE
+	if (body.isKinematicObject())
+	{
+		btRigidBody* rb = btRigidBody::upcast(&body);
+		if (rb)
+		{
+			const int* found = m_kinematicBodyToSolverBodyTable.find(btHashPtr(&body));
+			if (found)
+			{
+				return *found;
+			}
+			solverBodyIdA = m_tmpSolverBodyPool.size();
+			btSolverBody& solverBody = m_tmpSolverBodyPool.expand();
+			initSolverBody(&solverBody,&body,timeStep);
+			m_kinematicBodyToSolverBodyTable.insert(btHashPtr(&body), solverBodyIdA);
+			return solverBodyIdA;
+		}
+	}
+#endif //BT_THREADSAFE
+
 	if (body.getCompanionId() >= 0)
 	{
 		//body has already been converted
@@ -1903,6 +1923,13 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyFinish(btCo
 	for ( i=0;i<m_tmpSolverBodyPool.size();i++)
 	{
 		btRigidBody* body = m_tmpSolverBodyPool[i].m_originalBody;
+#if BT_THREADSAFE
+		// the solver never changes a kinematic body, and other threads may be reading it
+		if (body && body->isKinematicObject())
+		{
+			continue;
+		}
+#endif //BT_THREADSAFE
 		if (body)
 		{
 			if (infoGlobal.m_splitImpulse)
@@ -1931,6 +1958,12 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyFinish(btCo
 	m_tmpSolverContactRollingFrictionConstraintPool.resizeNoInitialize(0);
 
 	m_tmpSolverBodyPool.resizeNoInitialize(0);
+#if BT_THREADSAFE
+	if (m_kinematicBodyToSolverBodyTable.size())
+	{
+		m_kinematicBodyToSolverBodyTable.clear();
+	}
+#endif //BT_THREADSAFE
 	return 0.f;
 }
 
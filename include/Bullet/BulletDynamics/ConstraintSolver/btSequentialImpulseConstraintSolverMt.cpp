@@ -0,0 +1,624 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btSequentialImpulseConstraintSolverMt.h"
+
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btCpuFeatureUtility.h"
+
+
+int btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = 250;
+int btSequentialImpulseConstraintSolverMt::s_minBatchSize = 50;
+
+// a body can be in at most this many batches, rows beyond that go to the serial batch
+static const int kMaxBatches = 64;
+
+
+btSequentialImpulseConstraintSolverMt::btSequentialImpulseConstraintSolverMt()
+{
+	m_useBatching = false;
+	m_useSoaGroups = false;
+	m_deterministic = false;
+	m_soaNumFriction = 1;
+#ifdef BT_USE_DOUBLE_PRECISION
+	m_useSoaRows = false;	// the groups are single precision
+#else
+	m_useSoaRows = true;
+#endif
+	m_solveSoaContactRows = btSolveSoaContactRows_scalar;
+	m_solveSoaFrictionRows = btSolveSoaFrictionRows_scalar;
+#ifdef BT_ALLOW_AVX2
+	if ( btCpuFeatureUtility::getCpuFeatures() & btCpuFeatureUtility::CPU_FEATURE_AVX2 )
+	{
+		m_solveSoaContactRows = btSolveSoaContactRows_avx2;
+		m_solveSoaFrictionRows = btSolveSoaFrictionRows_avx2;
+	}
+#endif //BT_ALLOW_AVX2
+}
+
+
+btSequentialImpulseConstraintSolverMt::~btSequentialImpulseConstraintSolverMt()
+{
+}
+
+
+void btSequentialImpulseConstraintSolverMt::buildBatches( btBatchedRows* batches, const btConstraintArray& rows )
+{
+	const int numRows = rows.size();
+	const int numBodies = m_tmpSolverBodyPool.size();
+
+	m_bodyBatchMasks.resizeNoInitialize( numBodies );
+	for ( int i = 0; i < numBodies; ++i )
+	{
+		m_bodyBatchMasks[ i ] = 0;
+	}
+	m_rowBatches.resizeNoInitialize( numRows );
+
+	// greedy coloring in pool order: each row goes into the first batch neither of its bodies is in yet.
+	// the fixed body (static objects) is never written by the solver, so it doesn't count.
+	int batchSizes[ kMaxBatches + 1 ];
+	for ( int i = 0; i <= kMaxBatches; ++i )
+	{
+		batchSizes[ i ] = 0;
+	}
+	int numBatches = 0;
+	for ( int i = 0; i < numRows; ++i )
+	{
+		const btSolverConstraint& row = rows[ i ];
+		const bool dynamicA = m_tmpSolverBodyPool[ row.m_solverBodyIdA ].m_originalBody != NULL;
+		const bool dynamicB = m_tmpSolverBodyPool[ row.m_solverBodyIdB ].m_originalBody != NULL;
+		unsigned long long used = 0;
+		if ( dynamicA )
+		{
+			used |= m_bodyBatchMasks[ row.m_solverBodyIdA ];
+		}
+		if ( dynamicB )
+		{
+			used |= m_bodyBatchMasks[ row.m_solverBodyIdB ];
+		}
+
+		int batch = 0;
+		while ( batch < kMaxBatches && ( used & ( 1ULL << batch ) ) )
+		{
+			++batch;
+		}
+		if ( batch < kMaxBatches )
+		{
+			const unsigned long long bit = 1ULL << batch;
+			if ( dynamicA )
+			{
+				m_bodyBatchMasks[ row.m_solverBodyIdA ] |= bit;
+			}
+			if ( dynamicB )
+			{
+				m_bodyBatchMasks[ row.m_solverBodyIdB ] |= bit;
+			}
+			numBatches = btMax( numBatches, batch + 1 );
+		}
+		m_rowBatches[ i ] = batch;
+		batchSizes[ batch ]++;
+	}
+
+	// counting sort by batch, keeps pool order within a batch. the serial batch goes last.
+	batches->m_serialBatch = -1;
+	if ( batchSizes[ kMaxBatches ] > 0 )
+	{
+		batches->m_serialBatch = numBatches;
+		batchSizes[ numBatches ] = batchSizes[ kMaxBatches ];
+		for ( int i = 0; i < numRows; ++i )
+		{
+			if ( m_rowBatches[ i ] == kMaxBatches )
+			{
+				m_rowBatches[ i ] = numBatches;
+			}
+		}
+		numBatches++;
+	}
+
+	batches->m_batchStarts.resizeNoInitialize( numBatches + 1 );
+	batches->m_batchOrder.resizeNoInitialize( numBatches );
+	int start = 0;
+	for ( int i = 0; i < numBatches; ++i )
+	{
+		batches->m_batchStarts[ i ] = start;
+		batches->m_batchOrder[ i ] = i;
+		start += batchSizes[ i ];
+		batchSizes[ i ] = batches->m_batchStarts[ i ];
+	}
+	batches->m_batchStarts[ numBatches ] = start;
+
+	batches->m_rows.resizeNoInitialize( numRows );
+	for ( int i = 0; i < numRows; ++i )
+	{
+		batches->m_rows[ batchSizes[ m_rowBatches[ i ] ]++ ] = i;
+	}
+}
+
+
+void btSequentialImpulseConstraintSolverMt::buildRollingFrictionLookup()
+{
+	const int numContacts = m_tmpSolverContactConstraintPool.size();
+	const int numRollingFriction = m_tmpSolverContactRollingFrictionConstraintPool.size();
+
+	m_rollingFrictionStarts.resizeNoInitialize( numContacts + 1 );
+	for ( int i = 0; i <= numContacts; ++i )
+	{
+		m_rollingFrictionStarts[ i ] = 0;
+	}
+	for ( int i = 0; i < numRollingFriction; ++i )
+	{
+		m_rollingFrictionStarts[ m_tmpSolverContactRollingFrictionConstraintPool[ i ].m_frictionIndex + 1 ]++;
+	}
+	for ( int i = 0; i < numContacts; ++i )
+	{
+		m_rollingFrictionStarts[ i + 1 ] += m_rollingFrictionStarts[ i ];
+	}
+	m_rollingFrictionRows.resizeNoInitialize( numRollingFriction );
+	btAlignedObjectArray<int>& cursors = m_rowBatches;
+	cursors.resizeNoInitialize( numContacts );
+	for ( int i = 0; i < numContacts; ++i )
+	{
+		cursors[ i ] = m_rollingFrictionStarts[ i ];
+	}
+	for ( int i = 0; i < numRollingFriction; ++i )
+	{
+		m_rollingFrictionRows[ cursors[ m_tmpSolverContactRollingFrictionConstraintPool[ i ].m_frictionIndex ]++ ] = i;
+	}
+}
+
+
+bool btSequentialImpulseConstraintSolverMt::buildSoaGroups( const btContactSolverInfo& infoGlobal )
+{
+	const int numFriction = ( infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS ) ? 2 : 1;
+	if ( m_tmpSolverContactFrictionConstraintPool.size() != m_tmpSolverContactConstraintPool.size() * numFriction )
+	{
+		return false;
+	}
+	m_soaNumFriction = numFriction;
+
+	// each batch gets its own groups, so the lanes of a group never share a dynamic body.
+	// the serial batch stays with the row solver.
+	const btBatchedRows& batches = m_contactBatches;
+	const int numBatches = batches.getNumBatches();
+	m_soaGroupStarts.resizeNoInitialize( numBatches + 1 );
+	int numGroups = 0;
+	for ( int i = 0; i < numBatches; ++i )
+	{
+		m_soaGroupStarts[ i ] = numGroups;
+		if ( i != batches.m_serialBatch )
+		{
+			const int batchSize = batches.m_batchStarts[ i + 1 ] - batches.m_batchStarts[ i ];
+			numGroups += ( batchSize + BT_SOA_ROW_WIDTH - 1 ) / BT_SOA_ROW_WIDTH;
+		}
+	}
+	m_soaGroupStarts[ numBatches ] = numGroups;
+
+	m_soaContactGroups.resizeNoInitialize( numGroups );
+	m_soaFrictionGroups.resizeNoInitialize( numGroups * numFriction );
+	for ( int i = 0; i < m_soaContactGroups.size(); ++i )
+	{
+		m_soaContactGroups[ i ].clear();
+	}
+	for ( int i = 0; i < m_soaFrictionGroups.size(); ++i )
+	{
+		m_soaFrictionGroups[ i ].clear();
+	}
+
+	const btSolverBody* bodies = m_tmpSolverBodyPool.size() ? &m_tmpSolverBodyPool[ 0 ] : NULL;
+	for ( int i = 0; i < numBatches; ++i )
+	{
+		if ( i == batches.m_serialBatch )
+		{
+			continue;
+		}
+		const int batchStart = batches.m_batchStarts[ i ];
+		for ( int k = batchStart; k < batches.m_batchStarts[ i + 1 ]; ++k )
+		{
+			const int group = m_soaGroupStarts[ i ] + ( k - batchStart ) / BT_SOA_ROW_WIDTH;
+			const int lane = ( k - batchStart ) % BT_SOA_ROW_WIDTH;
+			const int c = batches.m_rows[ k ];
+			const btSolverConstraint& contact = m_tmpSolverContactConstraintPool[ c ];
+			m_soaContactGroups[ group ].setRow( lane, c, contact, bodies );
+			for ( int j = 0; j < numFriction; ++j )
+			{
+				const int f = contact.m_frictionIndex + j;
+				m_soaFrictionGroups[ group * numFriction + j ].setRow( lane, f, m_tmpSolverContactFrictionConstraintPool[ f ], bodies );
+			}
+		}
+	}
+	for ( int i = 0; i < m_soaContactGroups.size(); ++i )
+	{
+		m_soaContactGroups[ i ].padUnusedLanes();
+	}
+	for ( int i = 0; i < m_soaFrictionGroups.size(); ++i )
+	{
+		m_soaFrictionGroups[ i ].padUnusedLanes();
+	}
+	return true;
+}
+
+
+btScalar btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlySetup( btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer )
+{
+	btScalar result = btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup( bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer );
+
+	m_useBatching = false;
+	m_useSoaGroups = false;
+	if ( numManifolds >= s_minimumContactManifoldsForBatching )
+	{
+		btITaskScheduler* scheduler = btGetTaskScheduler();
+		bool haveThreads = scheduler && scheduler->getNumThreads() > 1 && !btThreadsAreRunning();
+		m_useBatching = m_deterministic || haveThreads;
+	}
+
+	if ( m_useBatching )
+	{
+		BT_PROFILE( "buildBatches" );
+		buildBatches( &m_jointBatches, m_tmpSolverNonContactConstraintPool );
+		buildBatches( &m_contactBatches, m_tmpSolverContactConstraintPool );
+		buildRollingFrictionLookup();
+		if ( m_useSoaRows )
+		{
+			m_useSoaGroups = buildSoaGroups( infoGlobal );
+		}
+	}
+	return result;
+}
+
+
+struct btSequentialImpulseConstraintSolverMt::BatchSolveLoop : public btIParallelForBody
+{
+	btSequentialImpulseConstraintSolverMt* m_solver;
+	const int* m_rows;
+	const btContactSolverInfo* m_infoGlobal;
+	RowKind m_kind;
+	int m_iteration;
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		m_solver->solveRows( m_kind, m_rows, iBegin, iEnd, m_iteration, *m_infoGlobal );
+	}
+};
+
+
+void btSequentialImpulseConstraintSolverMt::solveRows( RowKind kind, const int* rows, int iBegin, int iEnd, int iteration, const btContactSolverInfo& infoGlobal )
+{
+	const bool simd = ( infoGlobal.m_solverMode & SOLVER_SIMD ) != 0;
+	const int numFriction = ( infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS ) ? 2 : 1;
+
+	switch ( kind )
+	{
+	case ROW_JOINT:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			const btSolverConstraint& constraint = m_tmpSolverNonContactConstraintPool[ rows[ i ] ];
+			if ( iteration < constraint.m_overrideNumSolverIterations )
+			{
+				btSolverBody& bodyA = m_tmpSolverBodyPool[ constraint.m_solverBodyIdA ];
+				btSolverBody& bodyB = m_tmpSolverBodyPool[ constraint.m_solverBodyIdB ];
+				if ( simd )
+					resolveSingleConstraintRowGenericSIMD( bodyA, bodyB, constraint );
+				else
+					resolveSingleConstraintRowGeneric( bodyA, bodyB, constraint );
+			}
+		}
+		break;
+
+	case ROW_CONTACT:
+	case ROW_FRICTION:
+	case ROW_CONTACT_AND_FRICTION:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			const btSolverConstraint& contact = m_tmpSolverContactConstraintPool[ rows[ i ] ];
+			btSolverBody& bodyA = m_tmpSolverBodyPool[ contact.m_solverBodyIdA ];
+			btSolverBody& bodyB = m_tmpSolverBodyPool[ contact.m_solverBodyIdB ];
+			if ( kind != ROW_FRICTION )
+			{
+				if ( simd )
+					resolveSingleConstraintRowLowerLimitSIMD( bodyA, bodyB, contact );
+				else
+					resolveSingleConstraintRowLowerLimit( bodyA, bodyB, contact );
+			}
+			if ( kind != ROW_CONTACT )
+			{
+				btScalar totalImpulse = contact.m_appliedImpulse;
+				if ( totalImpulse > btScalar( 0 ) )
+				{
+					for ( int j = 0; j < numFriction; ++j )
+					{
+						btSolverConstraint& friction = m_tmpSolverContactFrictionConstraintPool[ contact.m_frictionIndex + j ];
+						friction.m_lowerLimit = -( friction.m_friction * totalImpulse );
+						friction.m_upperLimit = friction.m_friction * totalImpulse;
+						if ( simd )
+							resolveSingleConstraintRowGenericSIMD( bodyA, bodyB, friction );
+						else
+							resolveSingleConstraintRowGeneric( bodyA, bodyB, friction );
+					}
+				}
+			}
+		}
+		break;
+
+	case ROW_ROLLING_FRICTION:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			const int c = rows[ i ];
+			btScalar totalImpulse = m_tmpSolverContactConstraintPool[ c ].m_appliedImpulse;
+			if ( totalImpulse <= btScalar( 0 ) )
+			{
+				continue;
+			}
+			for ( int j = m_rollingFrictionStarts[ c ]; j < m_rollingFrictionStarts[ c + 1 ]; ++j )
+			{
+				btSolverConstraint& rollingFrictionConstraint = m_tmpSolverContactRollingFrictionConstraintPool[ m_rollingFrictionRows[ j ] ];
+				btScalar rollingFrictionMagnitude = rollingFrictionConstraint.m_friction * totalImpulse;
+				if ( rollingFrictionMagnitude > rollingFrictionConstraint.m_friction )
+					rollingFrictionMagnitude = rollingFrictionConstraint.m_friction;
+
+				rollingFrictionConstraint.m_lowerLimit = -rollingFrictionMagnitude;
+				rollingFrictionConstraint.m_upperLimit = rollingFrictionMagnitude;
+
+				btSolverBody& bodyA = m_tmpSolverBodyPool[ rollingFrictionConstraint.m_solverBodyIdA ];
+				btSolverBody& bodyB = m_tmpSolverBodyPool[ rollingFrictionConstraint.m_solverBodyIdB ];
+				if ( simd )
+					resolveSingleConstraintRowGenericSIMD( bodyA, bodyB, rollingFrictionConstraint );
+				else
+					resolveSingleConstraintRowGeneric( bodyA, bodyB, rollingFrictionConstraint );
+			}
+		}
+		break;
+
+	case ROW_SPLIT_PENETRATION:
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			const btSolverConstraint& contact = m_tmpSolverContactConstraintPool[ rows[ i ] ];
+			btSolverBody& bodyA = m_tmpSolverBodyPool[ contact.m_solverBodyIdA ];
+			btSolverBody& bodyB = m_tmpSolverBodyPool[ contact.m_solverBodyIdB ];
+			if ( simd )
+				resolveSplitPenetrationSIMD( bodyA, bodyB, contact );
+			else
+				resolveSplitPenetrationImpulseCacheFriendly( bodyA, bodyB, contact );
+		}
+		break;
+	}
+}
+
+
+void btSequentialImpulseConstraintSolverMt::solveBatches( btBatchedRows& batches, RowKind kind, int iteration, const btContactSolverInfo& infoGlobal )
+{
+	if ( batches.m_rows.size() == 0 )
+	{
+		return;
+	}
+
+	BatchSolveLoop loop;
+	loop.m_solver = this;
+	loop.m_rows = &batches.m_rows[ 0 ];
+	loop.m_infoGlobal = &infoGlobal;
+	loop.m_kind = kind;
+	loop.m_iteration = iteration;
+	// deterministic mode batches even without a task scheduler
+	const bool parallel = btGetTaskScheduler() != NULL;
+
+	// each batch has to be finished before the next one starts, the rows in a batch are independent
+	for ( int i = 0; i < batches.getNumBatches(); ++i )
+	{
+		const int batch = batches.m_batchOrder[ i ];
+		const int iBegin = batches.m_batchStarts[ batch ];
+		const int iEnd = batches.m_batchStarts[ batch + 1 ];
+		if ( batch == batches.m_serialBatch || !parallel )
+		{
+			solveRows( kind, loop.m_rows, iBegin, iEnd, iteration, infoGlobal );
+		}
+		else
+		{
+			btParallelFor( iBegin, iEnd, s_minBatchSize, loop );
+		}
+	}
+}
+
+
+struct btSequentialImpulseConstraintSolverMt::SoaBatchSolveLoop : public btIParallelForBody
+{
+	btSequentialImpulseConstraintSolverMt* m_solver;
+	RowKind m_kind;
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		m_solver->solveSoaGroups( m_kind, iBegin, iEnd );
+	}
+};
+
+
+void btSequentialImpulseConstraintSolverMt::solveSoaGroups( RowKind kind, int iBegin, int iEnd )
+{
+	if ( iBegin >= iEnd )
+	{
+		return;
+	}
+	btSolverBody* bodies = &m_tmpSolverBodyPool[ 0 ];
+	if ( kind != ROW_FRICTION )
+	{
+		m_solveSoaContactRows( bodies, &m_soaContactGroups[ 0 ], iBegin, iEnd );
+	}
+	if ( kind != ROW_CONTACT )
+	{
+		m_solveSoaFrictionRows( bodies, &m_soaFrictionGroups[ 0 ], &m_soaContactGroups[ 0 ], m_soaNumFriction, iBegin, iEnd );
+	}
+}
+
+
+void btSequentialImpulseConstraintSolverMt::writeSoaAppliedImpulses( bool contactsOnly )
+{
+	for ( int i = 0; i < m_soaContactGroups.size(); ++i )
+	{
+		m_soaContactGroups[ i ].writeAppliedImpulses( &m_tmpSolverContactConstraintPool[ 0 ] );
+	}
+	if ( !contactsOnly )
+	{
+		for ( int i = 0; i < m_soaFrictionGroups.size(); ++i )
+		{
+			m_soaFrictionGroups[ i ].writeAppliedImpulses( &m_tmpSolverContactFrictionConstraintPool[ 0 ] );
+		}
+	}
+}
+
+
+void btSequentialImpulseConstraintSolverMt::solveSoaBatches( RowKind kind, int iteration, const btContactSolverInfo& infoGlobal )
+{
+	btBatchedRows& batches = m_contactBatches;
+	if ( batches.m_rows.size() == 0 )
+	{
+		return;
+	}
+
+	SoaBatchSolveLoop loop;
+	loop.m_solver = this;
+	loop.m_kind = kind;
+	const bool parallel = btGetTaskScheduler() != NULL;
+	const int grainSize = btMax( 1, s_minBatchSize / BT_SOA_ROW_WIDTH );
+
+	for ( int i = 0; i < batches.getNumBatches(); ++i )
+	{
+		const int batch = batches.m_batchOrder[ i ];
+		if ( batch == batches.m_serialBatch )
+		{
+			solveRows( kind, &batches.m_rows[ 0 ], batches.m_batchStarts[ batch ], batches.m_batchStarts[ batch + 1 ], iteration, infoGlobal );
+		}
+		else if ( parallel )
+		{
+			btParallelFor( m_soaGroupStarts[ batch ], m_soaGroupStarts[ batch + 1 ], grainSize, loop );
+		}
+		else
+		{
+			solveSoaGroups( kind, m_soaGroupStarts[ batch ], m_soaGroupStarts[ batch + 1 ] );
+		}
+	}
+}
+
+
+void btSequentialImpulseConstraintSolverMt::shuffleBatches( btBatchedRows* batches )
+{
+	// rows within a batch don't affect each other, so only the batch order is worth randomizing
+	btAlignedObjectArray<int>& order = batches->m_batchOrder;
+	for ( int j = 0; j < order.size(); ++j )
+	{
+		int tmp = order[ j ];
+		int swapi = btRandInt2( j + 1 );
+		order[ j ] = order[ swapi ];
+		order[ swapi ] = tmp;
+	}
+}
+
+
+void btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlySplitImpulseIterations( btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer )
+{
+	if ( !m_useBatching )
+	{
+		btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySplitImpulseIterations( bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer );
+		return;
+	}
+
+	if ( infoGlobal.m_splitImpulse )
+	{
+		for ( int iteration = 0; iteration < infoGlobal.m_numIterations; iteration++ )
+		{
+			solveBatches( m_contactBatches, ROW_SPLIT_PENETRATION, iteration, infoGlobal );
+		}
+	}
+}
+
+
+btScalar btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlyFinish( btCollisionObject** bodies, int numBodies, const btContactSolverInfo& infoGlobal )
+{
+	if ( m_useSoaGroups )
+	{
+		writeSoaAppliedImpulses( false );
+		m_useSoaGroups = false;
+	}
+	return btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyFinish( bodies, numBodies, infoGlobal );
+}
+
+
+btScalar btSequentialImpulseConstraintSolverMt::solveSingleIteration( int iteration, btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer )
+{
+	if ( !m_useBatching )
+	{
+		return btSequentialImpulseConstraintSolver::solveSingleIteration( iteration, bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer );
+	}
+
+	if ( infoGlobal.m_solverMode & SOLVER_RANDMIZE_ORDER )
+	{
+		shuffleBatches( &m_jointBatches );
+		//contact/friction constraints are not solved more than
+		if ( iteration < infoGlobal.m_numIterations )
+		{
+			shuffleBatches( &m_contactBatches );
+		}
+	}
+
+	///solve all joint constraints
+	solveBatches( m_jointBatches, ROW_JOINT, iteration, infoGlobal );
+
+	if ( iteration < infoGlobal.m_numIterations )
+	{
+		for ( int j = 0; j < numConstraints; j++ )
+		{
+			if ( constraints[ j ]->isEnabled() )
+			{
+				int bodyAid = getOrInitSolverBody( constraints[ j ]->getRigidBodyA(), infoGlobal.m_timeStep );
+				int bodyBid = getOrInitSolverBody( constraints[ j ]->getRigidBodyB(), infoGlobal.m_timeStep );
+				btSolverBody& bodyA = m_tmpSolverBodyPool[ bodyAid ];
+				btSolverBody& bodyB = m_tmpSolverBodyPool[ bodyBid ];
+				constraints[ j ]->solveConstraintObsolete( bodyA, bodyB, infoGlobal.m_timeStep );
+			}
+		}
+
+		// same passes as the sequential solver, which only interleaves in SIMD mode
+		if ( ( infoGlobal.m_solverMode & SOLVER_SIMD ) && ( infoGlobal.m_solverMode & SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS ) )
+		{
+			if ( m_useSoaGroups )
+				solveSoaBatches( ROW_CONTACT_AND_FRICTION, iteration, infoGlobal );
+			else
+				solveBatches( m_contactBatches, ROW_CONTACT_AND_FRICTION, iteration, infoGlobal );
+		}
+		else
+		{
+			///solve all contact constraints, then the friction constraints with the new contact impulses
+			if ( m_useSoaGroups )
+			{
+				solveSoaBatches( ROW_CONTACT, iteration, infoGlobal );
+				solveSoaBatches( ROW_FRICTION, iteration, infoGlobal );
+			}
+			else
+			{
+				solveBatches( m_contactBatches, ROW_CONTACT, iteration, infoGlobal );
+				solveBatches( m_contactBatches, ROW_FRICTION, iteration, infoGlobal );
+			}
+
+			if ( m_tmpSolverContactRollingFrictionConstraintPool.size() )
+			{
+				if ( m_useSoaGroups )
+				{
+					// rolling friction reads the contact impulses from the rows
+					writeSoaAppliedImpulses( true );
+				}
+				solveBatches( m_contactBatches, ROW_ROLLING_FRICTION, iteration, infoGlobal );
+			}
+		}
+	}
+	return 0.f;
+}
@@ -0,0 +1,206 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btSolverConstraintSoa.h"
+
+#include <string.h> //memset
+
+
+void btSolverConstraintSoa::clear()
+{
+	memset( this, 0, sizeof( *this ) );
+	for ( int i = 0; i < BT_SOA_ROW_WIDTH; ++i )
+	{
+		m_row[ i ] = -1;
+	}
+}
+
+
+void btSolverConstraintSoa::setRow( int lane, int row, const btSolverConstraint& constraint, const btSolverBody* bodies )
+{
+	const btSolverBody& bodyA = bodies[ constraint.m_solverBodyIdA ];
+	const btSolverBody& bodyB = bodies[ constraint.m_solverBodyIdB ];
+	// same terms as btSolverBody::internalApplyImpulse, computed once instead of every iteration
+	btVector3 linearA = constraint.m_contactNormal1 * bodyA.internalGetInvMass() * bodyA.m_linearFactor;
+	btVector3 angularA = constraint.m_angularComponentA * bodyA.m_angularFactor;
+	btVector3 linearB = constraint.m_contactNormal2 * bodyB.internalGetInvMass() * bodyB.m_linearFactor;
+	btVector3 angularB = constraint.m_angularComponentB * bodyB.m_angularFactor;
+	for ( int k = 0; k < 3; ++k )
+	{
+		m_contactNormal1[ k ][ lane ] = constraint.m_contactNormal1[ k ];
+		m_relpos1CrossNormal[ k ][ lane ] = constraint.m_relpos1CrossNormal[ k ];
+		m_contactNormal2[ k ][ lane ] = constraint.m_contactNormal2[ k ];
+		m_relpos2CrossNormal[ k ][ lane ] = constraint.m_relpos2CrossNormal[ k ];
+		m_linearComponentA[ k ][ lane ] = linearA[ k ];
+		m_angularComponentA[ k ][ lane ] = angularA[ k ];
+		m_linearComponentB[ k ][ lane ] = linearB[ k ];
+		m_angularComponentB[ k ][ lane ] = angularB[ k ];
+	}
+	m_rhs[ lane ] = constraint.m_rhs;
+	m_cfm[ lane ] = constraint.m_cfm;
+	m_jacDiagABInv[ lane ] = constraint.m_jacDiagABInv;
+	m_lowerLimit[ lane ] = constraint.m_lowerLimit;
+	m_friction[ lane ] = constraint.m_friction;
+	m_appliedImpulse[ lane ] = constraint.m_appliedImpulse;
+	m_solverBodyIdA[ lane ] = constraint.m_solverBodyIdA;
+	m_solverBodyIdB[ lane ] = constraint.m_solverBodyIdB;
+	m_row[ lane ] = row;
+	if ( bodyA.m_originalBody )
+	{
+		m_writeMaskA |= 1 << lane;
+	}
+	if ( bodyB.m_originalBody )
+	{
+		m_writeMaskB |= 1 << lane;
+	}
+}
+
+
+void btSolverConstraintSoa::padUnusedLanes()
+{
+	// lane 0 is always used, its bodies are only touched by the thread solving this group
+	for ( int i = 1; i < BT_SOA_ROW_WIDTH; ++i )
+	{
+		if ( m_row[ i ] < 0 )
+		{
+			m_solverBodyIdA[ i ] = m_solverBodyIdA[ 0 ];
+			m_solverBodyIdB[ i ] = m_solverBodyIdB[ 0 ];
+		}
+	}
+}
+
+
+void btSolverConstraintSoa::writeAppliedImpulses( btSolverConstraint* rows ) const
+{
+	for ( int i = 0; i < BT_SOA_ROW_WIDTH; ++i )
+	{
+		if ( m_row[ i ] >= 0 )
+		{
+			rows[ m_row[ i ] ].m_appliedImpulse = m_appliedImpulse[ i ];
+		}
+	}
+}
+
+
+// the vector versions do exactly these operations in this order, so the results match bit for bit
+static SIMD_FORCE_INLINE float btSoaRelativeVelocity( const btSolverConstraintSoa& group, int lane, const btSolverBody& bodyA, const btSolverBody& bodyB )
+{
+	const int l = lane;
+	const btVector3& linA = bodyA.m_deltaLinearVelocity;
+	const btVector3& angA = bodyA.m_deltaAngularVelocity;
+	const btVector3& linB = bodyB.m_deltaLinearVelocity;
+	const btVector3& angB = bodyB.m_deltaAngularVelocity;
+	float vel1 = ( group.m_contactNormal1[ 0 ][ l ] * float( linA[ 0 ] ) + group.m_contactNormal1[ 1 ][ l ] * float( linA[ 1 ] ) + group.m_contactNormal1[ 2 ][ l ] * float( linA[ 2 ] ) ) +
+		( group.m_relpos1CrossNormal[ 0 ][ l ] * float( angA[ 0 ] ) + group.m_relpos1CrossNormal[ 1 ][ l ] * float( angA[ 1 ] ) + group.m_relpos1CrossNormal[ 2 ][ l ] * float( angA[ 2 ] ) );
+	float vel2 = ( group.m_contactNormal2[ 0 ][ l ] * float( linB[ 0 ] ) + group.m_contactNormal2[ 1 ][ l ] * float( linB[ 1 ] ) + group.m_contactNormal2[ 2 ][ l ] * float( linB[ 2 ] ) ) +
+		( group.m_relpos2CrossNormal[ 0 ][ l ] * float( angB[ 0 ] ) + group.m_relpos2CrossNormal[ 1 ][ l ] * float( angB[ 1 ] ) + group.m_relpos2CrossNormal[ 2 ][ l ] * float( angB[ 2 ] ) );
+	float deltaImpulse = group.m_rhs[ l ] - group.m_appliedImpulse[ l ] * group.m_cfm[ l ];
+	deltaImpulse = deltaImpulse - vel1 * group.m_jacDiagABInv[ l ];
+	deltaImpulse = deltaImpulse - vel2 * group.m_jacDiagABInv[ l ];
+	return deltaImpulse;
+}
+
+
+static SIMD_FORCE_INLINE void btSoaApplyImpulse( const btSolverConstraintSoa& group, int lane, btSolverBody& bodyA, btSolverBody& bodyB, float deltaImpulse )
+{
+	const int l = lane;
+	if ( group.m_writeMaskA & ( 1 << l ) )
+	{
+		btVector3& linA = bodyA.m_deltaLinearVelocity;
+		btVector3& angA = bodyA.m_deltaAngularVelocity;
+		linA.setValue( float( linA[ 0 ] ) + group.m_linearComponentA[ 0 ][ l ] * deltaImpulse, float( linA[ 1 ] ) + group.m_linearComponentA[ 1 ][ l ] * deltaImpulse, float( linA[ 2 ] ) + group.m_linearComponentA[ 2 ][ l ] * deltaImpulse );
+		angA.setValue( float( angA[ 0 ] ) + group.m_angularComponentA[ 0 ][ l ] * deltaImpulse, float( angA[ 1 ] ) + group.m_angularComponentA[ 1 ][ l ] * deltaImpulse, float( angA[ 2 ] ) + group.m_angularComponentA[ 2 ][ l ] * deltaImpulse );
+	}
+	if ( group.m_writeMaskB & ( 1 << l ) )
+	{
+		btVector3& linB = bodyB.m_deltaLinearVelocity;
+		btVector3& angB = bodyB.m_deltaAngularVelocity;
+		linB.setValue( float( linB[ 0 ] ) + group.m_linearComponentB[ 0 ][ l ] * deltaImpulse, float( linB[ 1 ] ) + group.m_linearComponentB[ 1 ][ l ] * deltaImpulse, float( linB[ 2 ] ) + group.m_linearComponentB[ 2 ][ l ] * deltaImpulse );
+		angB.setValue( float( angB[ 0 ] ) + group.m_angularComponentB[ 0 ][ l ] * deltaImpulse, float( angB[ 1 ] ) + group.m_angularComponentB[ 1 ][ l ] * deltaImpulse, float( angB[ 2 ] ) + group.m_angularComponentB[ 2 ][ l ] * deltaImpulse );
+	}
+}
+
+
+void btSolveSoaContactRows_scalar( btSolverBody* bodies, btSolverConstraintSoa* groups, int iBegin, int iEnd )
+{
+	for ( int i = iBegin; i < iEnd; ++i )
+	{
+		btSolverConstraintSoa& group = groups[ i ];
+		for ( int l = 0; l < BT_SOA_ROW_WIDTH; ++l )
+		{
+			if ( group.m_row[ l ] < 0 )
+			{
+				continue;
+			}
+			btSolverBody& bodyA = bodies[ group.m_solverBodyIdA[ l ] ];
+			btSolverBody& bodyB = bodies[ group.m_solverBodyIdB[ l ] ];
+			float deltaImpulse = btSoaRelativeVelocity( group, l, bodyA, bodyB );
+			const float sum = group.m_appliedImpulse[ l ] + deltaImpulse;
+			if ( sum < group.m_lowerLimit[ l ] )
+			{
+				deltaImpulse = group.m_lowerLimit[ l ] - group.m_appliedImpulse[ l ];
+				group.m_appliedImpulse[ l ] = group.m_lowerLimit[ l ];
+			}
+			else
+			{
+				group.m_appliedImpulse[ l ] = sum;
+			}
+			btSoaApplyImpulse( group, l, bodyA, bodyB, deltaImpulse );
+		}
+	}
+}
+
+
+void btSolveSoaFrictionRows_scalar( btSolverBody* bodies, btSolverConstraintSoa* frictionGroups, const btSolverConstraintSoa* contactGroups, int numFriction, int iBegin, int iEnd )
+{
+	for ( int i = iBegin; i < iEnd; ++i )
+	{
+		const btSolverConstraintSoa& contactGroup = contactGroups[ i ];
+		for ( int j = 0; j < numFriction; ++j )
+		{
+			btSolverConstraintSoa& group = frictionGroups[ i * numFriction + j ];
+			for ( int l = 0; l < BT_SOA_ROW_WIDTH; ++l )
+			{
+				const float totalImpulse = contactGroup.m_appliedImpulse[ l ];
+				if ( group.m_row[ l ] < 0 || !( totalImpulse > 0.0f ) )
+				{
+					continue;
+				}
+				const float upperLimit = group.m_friction[ l ] * totalImpulse;
+				const float lowerLimit = -upperLimit;
+				btSolverBody& bodyA = bodies[ group.m_solverBodyIdA[ l ] ];
+				btSolverBody& bodyB = bodies[ group.m_solverBodyIdB[ l ] ];
+				float deltaImpulse = btSoaRelativeVelocity( group, l, bodyA, bodyB );
+				const float sum = group.m_appliedImpulse[ l ] + deltaImpulse;
+				if ( sum < lowerLimit )
+				{
+					deltaImpulse = lowerLimit - group.m_appliedImpulse[ l ];
+					group.m_appliedImpulse[ l ] = lowerLimit;
+				}
+				else if ( sum > upperLimit )
+				{
+					deltaImpulse = upperLimit - group.m_appliedImpulse[ l ];
+					group.m_appliedImpulse[ l ] = upperLimit;
+				}
+				else
+				{
+					group.m_appliedImpulse[ l ] = sum;
+				}
+				btSoaApplyImpulse( group, l, bodyA, bodyB, deltaImpulse );
+			}
+		}
+	}
+}
@@ -0,0 +1,85 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SOLVER_CONSTRAINT_SOA_H
+#define BT_SOLVER_CONSTRAINT_SOA_H
+
+#include "btSolverConstraint.h"
+#include "btSolverBody.h"
+
+///the AVX2 row solvers are only compiled where the compiler can target AVX2 independent of the build flags
+#if !defined(BT_USE_DOUBLE_PRECISION) && (defined(BT_ALLOW_SSE4) || ((defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))))
+#define BT_ALLOW_AVX2
+#endif
+
+#define BT_SOA_ROW_WIDTH 8
+
+///btSolverConstraintSoa -- up to 8 contact or friction rows in structure-of-arrays layout.
+///
+///  The rows of one btSolverConstraintSoa must not share a dynamic solver body, so all of them can be
+///  solved at the same time, one vector lane per row. Only the fixed body (m_originalBody == NULL) may
+///  appear in several lanes, it is read but never written back.
+///  Unused lanes have m_row == -1 and zero coefficients, so they don't change anything. After packing,
+///  padUnusedLanes points them at the bodies of lane 0, so the vector versions never load a body that
+///  another thread is solving.
+///
+ATTRIBUTE_ALIGNED16 (struct) btSolverConstraintSoa
+{
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	float	m_contactNormal1[ 3 ][ BT_SOA_ROW_WIDTH ];
+	float	m_relpos1CrossNormal[ 3 ][ BT_SOA_ROW_WIDTH ];
+	float	m_contactNormal2[ 3 ][ BT_SOA_ROW_WIDTH ];
+	float	m_relpos2CrossNormal[ 3 ][ BT_SOA_ROW_WIDTH ];
+	// velocity change of body A/B per unit impulse, inverse mass and linear/angular factors folded in
+	float	m_linearComponentA[ 3 ][ BT_SOA_ROW_WIDTH ];
+	float	m_angularComponentA[ 3 ][ BT_SOA_ROW_WIDTH ];
+	float	m_linearComponentB[ 3 ][ BT_SOA_ROW_WIDTH ];
+	float	m_angularComponentB[ 3 ][ BT_SOA_ROW_WIDTH ];
+	float	m_rhs[ BT_SOA_ROW_WIDTH ];
+	float	m_cfm[ BT_SOA_ROW_WIDTH ];
+	float	m_jacDiagABInv[ BT_SOA_ROW_WIDTH ];
+	float	m_lowerLimit[ BT_SOA_ROW_WIDTH ];	// contact rows
+	float	m_friction[ BT_SOA_ROW_WIDTH ];		// friction rows, the limits follow the impulse of the contact
+	float	m_appliedImpulse[ BT_SOA_ROW_WIDTH ];
+	int		m_solverBodyIdA[ BT_SOA_ROW_WIDTH ];
+	int		m_solverBodyIdB[ BT_SOA_ROW_WIDTH ];
+	int		m_row[ BT_SOA_ROW_WIDTH ];			// index of the row in its constraint pool
+	int		m_writeMaskA;						// lanes whose body A is dynamic, bit per lane
+	int		m_writeMaskB;
+
+	void	clear();
+	void	setRow( int lane, int row, const btSolverConstraint& constraint, const btSolverBody* bodies );
+	void	padUnusedLanes();
+	///copies m_appliedImpulse back to the rows it was set up from
+	void	writeAppliedImpulses( btSolverConstraint* rows ) const;
+};
+
+///solves contact rows: groups[iBegin] .. groups[iEnd-1]. the impulses stay in the groups until writeAppliedImpulses
+typedef void ( *btSoaContactRowSolver )( btSolverBody* bodies, btSolverConstraintSoa* groups, int iBegin, int iEnd );
+///solves the friction rows of contact groups iBegin .. iEnd-1, friction direction j of contact group i is frictionGroups[i * numFriction + j]
+typedef void ( *btSoaFrictionRowSolver )( btSolverBody* bodies, btSolverConstraintSoa* frictionGroups, const btSolverConstraintSoa* contactGroups, int numFriction, int iBegin, int iEnd );
+
+///lane by lane reference, gives the same results as the vector versions
+void btSolveSoaContactRows_scalar( btSolverBody* bodies, btSolverConstraintSoa* groups, int iBegin, int iEnd );
+void btSolveSoaFrictionRows_scalar( btSolverBody* bodies, btSolverConstraintSoa* frictionGroups, const btSolverConstraintSoa* contactGroups, int numFriction, int iBegin, int iEnd );
+
+#ifdef BT_ALLOW_AVX2
+///only call these if btCpuFeatureUtility reports CPU_FEATURE_AVX2
+void btSolveSoaContactRows_avx2( btSolverBody* bodies, btSolverConstraintSoa* groups, int iBegin, int iEnd );
+void btSolveSoaFrictionRows_avx2( btSolverBody* bodies, btSolverConstraintSoa* frictionGroups, const btSolverConstraintSoa* contactGroups, int numFriction, int iBegin, int iEnd );
+#endif //BT_ALLOW_AVX2
+
+#endif //BT_SOLVER_CONSTRAINT_SOA_H
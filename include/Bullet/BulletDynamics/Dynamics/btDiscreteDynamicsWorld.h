@@ -72,6 +72,12 @@ protected:
 	virtual void	predictUnconstraintMotion(btScalar timeStep);
 	
 	virtual void	integrateTransforms(btScalar timeStep);
+
+	///computes where an active body ends up after timeStep, clamped by its CCD sweep. returns false if the body doesn't move.
+	///only reads other bodies, so it can run for several bodies in parallel as long as none of them is moved meanwhile
+	bool	integrateSingleTransform(btRigidBody* body, btScalar timeStep, btTransform& predictedTrans);
+
+	void	applySpeculativeContactRestitution();
 		
 	virtual void	calculateSimulationIslands();
 
@@ -0,0 +1,502 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btDiscreteDynamicsWorldMt.h"
+
+//collision detection
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include "BulletCollision/BroadphaseCollision/btSimpleBroadphase.h"
+#include "BulletCollision/CollisionDispatch/btCollisionWorld.h"
+#include "btSimulationIslandManagerMt.h"
+
+//rigidbody & constraints
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "BulletDynamics/ConstraintSolver/btContactSolverInfo.h"
+#include "BulletDynamics/ConstraintSolver/btTypedConstraint.h"
+
+#include "LinearMath/btIDebugDraw.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <new>
+
+
+// bodies per parallel-for job for the per-body passes, which are cheap per body
+static const int kBodyGrainSize = 64;
+
+
+///
+/// btConstraintSolverPoolMt
+///
+
+btConstraintSolverPoolMt::ThreadSolver* btConstraintSolverPoolMt::getAndLockThreadSolver()
+{
+	int i = 0;
+#if BT_THREADSAFE
+	i = btGetCurrentThreadIndex() % m_solvers.size();
+#endif // #if BT_THREADSAFE
+	while ( true )
+	{
+		ThreadSolver& solver = m_solvers[ i ];
+		if ( btMutexTryLock( &solver.mutex ) )
+		{
+			return &solver;
+		}
+		// failed, try the next one
+		i = ( i + 1 ) % m_solvers.size();
+	}
+	return NULL;
+}
+
+void btConstraintSolverPoolMt::init( btConstraintSolver** solvers, int numSolvers )
+{
+	m_solverType = BT_SEQUENTIAL_IMPULSE_SOLVER;
+	m_solvers.resize( numSolvers );
+	for ( int i = 0; i < numSolvers; ++i )
+	{
+		m_solvers[ i ].solver = solvers[ i ];
+	}
+	if ( numSolvers > 0 )
+	{
+		m_solverType = solvers[ 0 ]->getSolverType();
+	}
+}
+
+// create the solvers for me
+btConstraintSolverPoolMt::btConstraintSolverPoolMt( int numSolvers )
+{
+	btAlignedObjectArray<btConstraintSolver*> solvers;
+	solvers.reserve( numSolvers );
+	for ( int i = 0; i < numSolvers; ++i )
+	{
+		void* mem = btAlignedAlloc( sizeof( btSequentialImpulseConstraintSolver ), 16 );
+		btConstraintSolver* solver = new ( mem ) btSequentialImpulseConstraintSolver();
+		solvers.push_back( solver );
+	}
+	init( &solvers[ 0 ], numSolvers );
+}
+
+// pass in fully constructed solvers (destructor will delete them)
+btConstraintSolverPoolMt::btConstraintSolverPoolMt( btConstraintSolver** solvers, int numSolvers )
+{
+	init( solvers, numSolvers );
+}
+
+btConstraintSolverPoolMt::~btConstraintSolverPoolMt()
+{
+	// delete all solvers
+	for ( int i = 0; i < m_solvers.size(); ++i )
+	{
+		ThreadSolver& solver = m_solvers[ i ];
+		solver.solver->~btConstraintSolver();
+		btAlignedFree( solver.solver );
+		solver.solver = NULL;
+	}
+}
+
+///solve a group of constraints
+btScalar btConstraintSolverPoolMt::solveGroup( btCollisionObject** bodies,
+	int numBodies,
+	btPersistentManifold** manifolds,
+	int numManifolds,
+	btTypedConstraint** constraints,
+	int numConstraints,
+	const btContactSolverInfo& info,
+	btIDebugDraw* debugDrawer,
+	btDispatcher* dispatcher
+)
+{
+	ThreadSolver* ts = getAndLockThreadSolver();
+	ts->solver->solveGroup( bodies, numBodies, manifolds, numManifolds, constraints, numConstraints, info, debugDrawer, dispatcher );
+	btMutexUnlock( &ts->mutex );
+	return 0.0f;
+}
+
+void btConstraintSolverPoolMt::reset()
+{
+	for ( int i = 0; i < m_solvers.size(); ++i )
+	{
+		ThreadSolver& solver = m_solvers[ i ];
+		btMutexLock( &solver.mutex );
+		solver.solver->reset();
+		btMutexUnlock( &solver.mutex );
+	}
+}
+
+
+///
+/// btSolverIslandCallbackMt -- hands each island to the solver pool, which may be called from any thread,
+///                             or large islands to the large island solver, which is only called from the stepping thread
+///
+struct btSolverIslandCallbackMt : public btSimulationIslandManagerMt::IslandCallback
+{
+	btContactSolverInfo*	m_solverInfo;
+	btConstraintSolver*		m_solver;
+	btConstraintSolver*		m_largeIslandSolver;
+	btIDebugDraw*			m_debugDrawer;
+	btDispatcher*			m_dispatcher;
+
+	btSolverIslandCallbackMt(
+		btConstraintSolver*	solver,
+		btConstraintSolver*	largeIslandSolver,
+		btDispatcher* dispatcher)
+		:m_solverInfo(NULL),
+		m_solver(solver),
+		m_largeIslandSolver(largeIslandSolver),
+		m_debugDrawer(NULL),
+		m_dispatcher(dispatcher)
+	{
+
+	}
+
+	btSolverIslandCallbackMt& operator=(btSolverIslandCallbackMt& other)
+	{
+		btAssert(0);
+		(void)other;
+		return *this;
+	}
+
+	SIMD_FORCE_INLINE void setup ( btContactSolverInfo* solverInfo, btIDebugDraw* debugDrawer)
+	{
+		btAssert(solverInfo);
+		m_solverInfo = solverInfo;
+		m_debugDrawer = debugDrawer;
+	}
+
+
+	virtual	void	processIsland( btCollisionObject** bodies,
+								   int numBodies,
+								   btPersistentManifold** manifolds,
+								   int numManifolds,
+								   btTypedConstraint** constraints,
+								   int numConstraints,
+								   int islandId
+								   ) BT_OVERRIDE
+	{
+		(void)islandId;
+		btConstraintSolver* solver = m_solver;
+		if ( m_largeIslandSolver && numManifolds >= btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching && !btThreadsAreRunning() )
+		{
+			solver = m_largeIslandSolver;
+		}
+		solver->solveGroup( bodies,
+							  numBodies,
+							  manifolds,
+							  numManifolds,
+							  constraints,
+							  numConstraints,
+							  *m_solverInfo,
+							  m_debugDrawer,
+							  m_dispatcher
+							  );
+	}
+
+	virtual int getMinimumLargeIslandManifolds() const BT_OVERRIDE
+	{
+		return m_largeIslandSolver ? btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching : 0;
+	}
+
+};
+
+
+btDiscreteDynamicsWorldMt::btDiscreteDynamicsWorldMt(btDispatcher* dispatcher,
+	btBroadphaseInterface* pairCache,
+	btConstraintSolverPoolMt* constraintSolver,
+	btCollisionConfiguration* collisionConfiguration,
+	btConstraintSolver* largeIslandSolver
+)
+: btDiscreteDynamicsWorld(dispatcher,pairCache,constraintSolver,collisionConfiguration)
+{
+	m_largeIslandSolver = largeIslandSolver;
+	if (m_ownsIslandManager)
+	{
+		m_islandManager->~btSimulationIslandManager();
+		btAlignedFree( m_islandManager);
+	}
+	{
+		void* mem = btAlignedAlloc(sizeof(btSolverIslandCallbackMt),16);
+		m_solverIslandCallbackMt = new (mem) btSolverIslandCallbackMt (constraintSolver, largeIslandSolver, dispatcher);
+	}
+	{
+		void* mem = btAlignedAlloc(sizeof(btSimulationIslandManagerMt),16);
+		m_islandManager = new (mem) btSimulationIslandManagerMt();
+	}
+	m_ownsIslandManager = true;
+}
+
+
+btDiscreteDynamicsWorldMt::~btDiscreteDynamicsWorldMt()
+{
+	if (m_solverIslandCallbackMt)
+	{
+		m_solverIslandCallbackMt->~btSolverIslandCallbackMt();
+		btAlignedFree(m_solverIslandCallbackMt);
+	}
+}
+
+
+void	btDiscreteDynamicsWorldMt::solveConstraints(btContactSolverInfo& solverInfo)
+{
+	BT_PROFILE("solveConstraints");
+
+	m_solverIslandCallbackMt->setup(&solverInfo, getDebugDrawer());
+	m_constraintSolver->prepareSolve(getCollisionWorld()->getNumCollisionObjects(), getCollisionWorld()->getDispatcher()->getNumManifolds());
+	if (m_largeIslandSolver)
+	{
+		m_largeIslandSolver->prepareSolve(getCollisionWorld()->getNumCollisionObjects(), getCollisionWorld()->getDispatcher()->getNumManifolds());
+	}
+
+	/// solve all the constraints for this island
+	btSimulationIslandManagerMt* im = static_cast<btSimulationIslandManagerMt*>(m_islandManager);
+	im->buildAndProcessIslands( getCollisionWorld()->getDispatcher(), getCollisionWorld(), m_constraints, m_solverIslandCallbackMt );
+
+	m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
+	if (m_largeIslandSolver)
+	{
+		m_largeIslandSolver->allSolved(solverInfo, m_debugDrawer);
+	}
+}
+
+
+void	btDiscreteDynamicsWorldMt::setNumTasks(int numTasks)
+{
+	if (btITaskScheduler* scheduler = btGetTaskScheduler())
+	{
+		scheduler->setNumThreads(numTasks);
+	}
+}
+
+
+struct btDiscreteDynamicsWorldMt::UpdaterUnconstraintMotion : public btIParallelForBody
+{
+	btRigidBody** m_bodies;
+	btScalar m_timeStep;
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btRigidBody* body = m_bodies[ i ];
+			if ( !body->isStaticOrKinematicObject() )
+			{
+				//don't integrate/update velocities here, it happens in the constraint solver
+				body->applyDamping( m_timeStep );
+				body->predictIntegratedTransform( m_timeStep, body->getInterpolationWorldTransform() );
+			}
+		}
+	}
+};
+
+
+void	btDiscreteDynamicsWorldMt::predictUnconstraintMotion(btScalar timeStep)
+{
+	BT_PROFILE("predictUnconstraintMotion");
+	if ( m_nonStaticRigidBodies.size() > 0 )
+	{
+		UpdaterUnconstraintMotion update;
+		update.m_bodies = &m_nonStaticRigidBodies[ 0 ];
+		update.m_timeStep = timeStep;
+		btParallelFor( 0, m_nonStaticRigidBodies.size(), kBodyGrainSize, update );
+	}
+}
+
+
+struct btDiscreteDynamicsWorldMt::UpdaterIntegrateTransforms : public btIParallelForBody
+{
+	btDiscreteDynamicsWorldMt* m_world;
+	btRigidBody** m_bodies;
+	// when set, the transforms are only computed and stored here, see integrateTransforms
+	btTransform* m_transforms;
+	btScalar m_timeStep;
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		btTransform predictedTrans;
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btRigidBody* body = m_bodies[ i ];
+			btTransform& trans = m_transforms ? m_transforms[ i ] : predictedTrans;
+			if ( m_world->integrateSingleTransform( body, m_timeStep, trans ) && !m_transforms )
+			{
+				body->proceedToTransform( trans );
+			}
+		}
+	}
+};
+
+
+struct btDiscreteDynamicsWorldMt::UpdaterProceedToTransforms : public btIParallelForBody
+{
+	btRigidBody** m_bodies;
+	const btTransform* m_transforms;
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btRigidBody* body = m_bodies[ i ];
+			// same test integrateSingleTransform uses to decide whether the body moves
+			if ( body->isActive() && !body->isStaticOrKinematicObject() )
+			{
+				body->proceedToTransform( m_transforms[ i ] );
+			}
+		}
+	}
+};
+
+
+void	btDiscreteDynamicsWorldMt::integrateTransforms(btScalar timeStep)
+{
+	BT_PROFILE("integrateTransforms");
+	const int numBodies = m_nonStaticRigidBodies.size();
+	if ( numBodies > 0 )
+	{
+		UpdaterIntegrateTransforms update;
+		update.m_world = this;
+		update.m_bodies = &m_nonStaticRigidBodies[ 0 ];
+		update.m_transforms = NULL;
+		update.m_timeStep = timeStep;
+
+		if ( getDispatchInfo().m_useContinuous )
+		{
+			// CCD sweeps test against the transforms of the other bodies, so every body is swept
+			// before any of them moves. the broadphase is only read here.
+			m_integratedTransforms.resizeNoInitialize( numBodies );
+			update.m_transforms = &m_integratedTransforms[ 0 ];
+			btParallelFor( 0, numBodies, kBodyGrainSize, update );
+
+			UpdaterProceedToTransforms proceed;
+			proceed.m_bodies = &m_nonStaticRigidBodies[ 0 ];
+			proceed.m_transforms = &m_integratedTransforms[ 0 ];
+			btParallelFor( 0, numBodies, kBodyGrainSize, proceed );
+		}
+		else
+		{
+			btParallelFor( 0, numBodies, kBodyGrainSize, update );
+		}
+	}
+
+	applySpeculativeContactRestitution();
+}
+
+
+struct btDiscreteDynamicsWorldMt::UpdaterComputeAabbs : public btIParallelForBody
+{
+	const btDiscreteDynamicsWorldMt* m_world;
+	btCollisionObject** m_objects;
+	AabbUpdate* m_updates;
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btCollisionObject* colObj = m_objects[ i ];
+			AabbUpdate& update = m_updates[ i ];
+
+			//only update aabb of active objects
+			update.m_needsUpdate = m_world->m_forceUpdateAllAabbs || colObj->isActive();
+			if ( update.m_needsUpdate )
+			{
+				m_world->computeBroadphaseAabb( colObj, update.m_aabbMin, update.m_aabbMax );
+			}
+		}
+	}
+};
+
+
+void	btDiscreteDynamicsWorldMt::updateAabbs()
+{
+	BT_PROFILE("updateAabbs");
+	const int numObjects = m_collisionObjects.size();
+	if ( numObjects == 0 )
+	{
+		return;
+	}
+
+	// the shape queries run in parallel, the broadphase is updated afterwards on this thread
+	m_aabbUpdates.resizeNoInitialize( numObjects );
+
+	UpdaterComputeAabbs update;
+	update.m_world = this;
+	update.m_objects = &m_collisionObjects[ 0 ];
+	update.m_updates = &m_aabbUpdates[ 0 ];
+	btParallelFor( 0, numObjects, kBodyGrainSize, update );
+
+	// in object order, like the serial version, so the broadphase ends up the same
+	// however many threads computed the boxes
+	for ( int i = 0; i < numObjects; ++i )
+	{
+		const AabbUpdate& aabb = m_aabbUpdates[ i ];
+		if ( aabb.m_needsUpdate )
+		{
+			setBroadphaseAabb( m_collisionObjects[ i ], aabb.m_aabbMin, aabb.m_aabbMax );
+		}
+	}
+}
+
+
+struct btDiscreteDynamicsWorldMt::UpdaterSynchronizeMotionStates : public btIParallelForBody
+{
+	btDiscreteDynamicsWorldMt* m_world;
+	btCollisionObject** m_objects;
+	btRigidBody** m_bodies;
+
+	void forLoop( int iBegin, int iEnd ) const BT_OVERRIDE
+	{
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			if ( m_objects )
+			{
+				//iterate  over all collision objects
+				btRigidBody* body = btRigidBody::upcast( m_objects[ i ] );
+				if ( body )
+					m_world->synchronizeSingleMotionState( body );
+			}
+			else
+			{
+				//iterate over all active rigid bodies
+				btRigidBody* body = m_bodies[ i ];
+				if ( body->isActive() )
+					m_world->synchronizeSingleMotionState( body );
+			}
+		}
+	}
+};
+
+
+void	btDiscreteDynamicsWorldMt::synchronizeMotionStates()
+{
+	BT_PROFILE("synchronizeMotionStates");
+	UpdaterSynchronizeMotionStates update;
+	update.m_world = this;
+	update.m_objects = NULL;
+	update.m_bodies = NULL;
+
+	if ( m_synchronizeAllMotionStates )
+	{
+		if ( m_collisionObjects.size() > 0 )
+		{
+			update.m_objects = &m_collisionObjects[ 0 ];
+			btParallelFor( 0, m_collisionObjects.size(), kBodyGrainSize, update );
+		}
+	}
+	else if ( m_nonStaticRigidBodies.size() > 0 )
+	{
+		update.m_bodies = &m_nonStaticRigidBodies[ 0 ];
+		btParallelFor( 0, m_nonStaticRigidBodies.size(), kBodyGrainSize, update );
+	}
+}
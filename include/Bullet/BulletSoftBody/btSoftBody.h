@@ -868,7 +868,9 @@ public:
 	/* Solver presets														*/ 
 	void				setSolver(eSolverPresets::_ preset);
 	/* predictMotion														*/ 
-	void				predictMotion(btScalar dt);
+	///with updateBroadphase false the broadphase aabb is left alone, call updateBroadphaseAabb afterwards.
+	///btDefaultSoftBodySolverMt uses this to predict several bodies at once.
+	void				predictMotion(btScalar dt,bool updateBroadphase=true);
 	/* solveConstraints														*/ 
 	void				solveConstraints();
 	/* staticSolve															*/ 
@@ -964,7 +966,8 @@ public:
 	btVector3			evaluateCom() const;
 	bool				checkContact(const btCollisionObjectWrapper* colObjWrap,const btVector3& x,btScalar margin,btSoftBody::sCti& cti) const;
 	void				updateNormals();
-	void				updateBounds();
+	void				updateBounds(bool updateBroadphase=true);
+	void				updateBroadphaseAabb();
 	void				updatePose();
 	void				updateConstants();
 	void				updateLinkConstants();
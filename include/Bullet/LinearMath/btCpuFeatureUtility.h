@@ -12,6 +12,11 @@
 #endif //BT_ALLOW_SSE4
 #endif //USE_SIMD
 
+#if !defined(BT_ALLOW_SSE4) && (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+#define BT_CPUID_GCC
+#include <cpuid.h>
+#endif //BT_CPUID_GCC
+
 #if defined BT_USE_NEON
 #define ARM_NEON_GCC_COMPATIBILITY  1
 #include <arm_neon.h>
@@ -19,7 +24,7 @@
 #include <sys/sysctl.h> //for sysctlbyname
 #endif //BT_USE_NEON
 
-///Rudimentary btCpuFeatureUtility for CPU features: only report the features that Bullet actually uses (SSE4/FMA3, NEON_HPFP)
+///Rudimentary btCpuFeatureUtility for CPU features: only report the features that Bullet actually uses (SSE4/FMA3, AVX2, NEON_HPFP)
 ///We assume SSE2 in case BT_USE_SSE2 is defined in LinearMath/btScalar.h
 class btCpuFeatureUtility
 {
@@ -28,7 +33,8 @@ public:
 	{
 		CPU_FEATURE_FMA3=1,
 		CPU_FEATURE_SSE4_1=2,
-		CPU_FEATURE_NEON_HPFP=4
+		CPU_FEATURE_NEON_HPFP=4,
+		CPU_FEATURE_AVX2=8
 	};
 
 	static int getCpuFeatures()
@@ -78,9 +84,60 @@ public:
 			{
 				capabilities |= btCpuFeatureUtility::CPU_FEATURE_SSE4_1;
 			}
+
+			// AVX2 needs the OS to save the ymm registers as well
+			bool osSupportsAVX = (cpuInfo[2] & AVXFlag) == AVXFlag && (sseExt & 6) == 6;
+			__cpuid(cpuInfo, 0);
+			if (osSupportsAVX && cpuInfo[0] >= 7)
+			{
+				__cpuidex(cpuInfo, 7, 0);
+				const int AVX2Flag = (1 << 5);
+				if (cpuInfo[1] & AVX2Flag)
+				{
+					capabilities |= btCpuFeatureUtility::CPU_FEATURE_AVX2;
+				}
+			}
 		}
 #endif//BT_ALLOW_SSE4
 
+#ifdef BT_CPUID_GCC
+		{
+			unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+			unsigned long long sseExt = 0;
+			__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+
+			const unsigned int OSXSAVEFlag = (1UL << 27);
+			const unsigned int AVXFlag = ((1UL << 28) | OSXSAVEFlag);
+			if ((ecx & AVXFlag) == AVXFlag)
+			{
+				unsigned int xcr0Low = 0, xcr0High = 0;
+				__asm__ __volatile__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+				sseExt = ((unsigned long long)xcr0High << 32) | xcr0Low;
+			}
+			const unsigned int FMAFlag = ((1UL << 12) | AVXFlag);
+			if ((ecx & FMAFlag) == FMAFlag && (sseExt & 6) == 6)
+			{
+				capabilities |= btCpuFeatureUtility::CPU_FEATURE_FMA3;
+			}
+
+			const unsigned int SSE41Flag = (1 << 19);
+			if (ecx & SSE41Flag)
+			{
+				capabilities |= btCpuFeatureUtility::CPU_FEATURE_SSE4_1;
+			}
+
+			if ((ecx & AVXFlag) == AVXFlag && (sseExt & 6) == 6 && __get_cpuid_max(0, NULL) >= 7)
+			{
+				__cpuid_count(7, 0, eax, ebx, ecx, edx);
+				const unsigned int AVX2Flag = (1 << 5);
+				if (ebx & AVX2Flag)
+				{
+					capabilities |= btCpuFeatureUtility::CPU_FEATURE_AVX2;
+				}
+			}
+		}
+#endif//BT_CPUID_GCC
+
 		testedCapabilities = true;
 		return capabilities;
 	}
@@ -576,3 +576,62 @@ void	CProfileManager::dumpAll()
 
 
 #endif //BT_NO_PROFILE
+
+
+#ifndef BT_NO_PROFILE
+
+static void btEnterProfileZoneDefault(const char* name)
+{
+	CProfileManager::Start_Profile( name );
+}
+
+static void btLeaveProfileZoneDefault()
+{
+	CProfileManager::Stop_Profile();
+}
+
+#else
+
+static void btEnterProfileZoneDefault(const char*)
+{
+}
+
+static void btLeaveProfileZoneDefault()
+{
+}
+
+#endif //BT_NO_PROFILE
+
+
+static btEnterProfileZoneFunc* bts_enterFunc = btEnterProfileZoneDefault;
+static btLeaveProfileZoneFunc* bts_leaveFunc = btLeaveProfileZoneDefault;
+
+void btEnterProfileZone(const char* name)
+{
+	(bts_enterFunc)(name);
+}
+
+void btLeaveProfileZone()
+{
+	(bts_leaveFunc)();
+}
+
+btEnterProfileZoneFunc* btGetCurrentEnterProfileZoneFunc()
+{
+	return bts_enterFunc;
+}
+
+btLeaveProfileZoneFunc* btGetCurrentLeaveProfileZoneFunc()
+{
+	return bts_leaveFunc;
+}
+
+void btSetCustomEnterProfileZoneFunc(btEnterProfileZoneFunc* enterFunc)
+{
+	bts_enterFunc = enterFunc ? enterFunc : btEnterProfileZoneDefault;
+}
+
+void btSetCustomLeaveProfileZoneFunc(btLeaveProfileZoneFunc* leaveFunc)
+{
+	bts_leaveFunc = leaveFunc ? leaveFunc : btLeaveProfileZoneDefault;
+}
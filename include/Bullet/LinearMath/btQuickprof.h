@@ -52,6 +52,20 @@ private:
 
 #endif //USE_BT_CLOCK
 
+typedef void (btEnterProfileZoneFunc)(const char* msg);
+typedef void (btLeaveProfileZoneFunc)();
+
+btEnterProfileZoneFunc* btGetCurrentEnterProfileZoneFunc();
+btLeaveProfileZoneFunc* btGetCurrentLeaveProfileZoneFunc();
+
+///Routes BT_PROFILE to an external profiler instead of CProfileManager. The functions are called from every thread
+///that runs Bullet code (see btThreads.h), so they must be thread safe. Pass 0 to restore the default.
+void btSetCustomEnterProfileZoneFunc(btEnterProfileZoneFunc* enterFunc);
+void btSetCustomLeaveProfileZoneFunc(btLeaveProfileZoneFunc* leaveFunc);
+
+void btEnterProfileZone(const char* name);
+void btLeaveProfileZone();
+
 
 //To disable built-in profiling, please comment out next line
 #define BT_NO_PROFILE 1
@@ -180,30 +194,26 @@ private:
 };
 
 
+#endif //#ifndef BT_NO_PROFILE
+
 ///ProfileSampleClass is a simple way to profile a function's scope
 ///Use the BT_PROFILE macro at the start of scope to time
 class	CProfileSample {
 public:
 	CProfileSample( const char * name )
 	{ 
-		CProfileManager::Start_Profile( name ); 
+		btEnterProfileZone( name ); 
 	}
 
 	~CProfileSample( void )					
 	{ 
-		CProfileManager::Stop_Profile(); 
+		btLeaveProfileZone(); 
 	}
 };
 
 
 #define	BT_PROFILE( name )			CProfileSample __profile( name )
 
-#else
-
-#define	BT_PROFILE( name )
-
-#endif //#ifndef BT_NO_PROFILE
-
 
 
 #endif //BT_QUICK_PROF_H
@@ -0,0 +1,276 @@
+/*
+Copyright (c) 2003-2014 Erwin Coumans  http://bullet.googlecode.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btThreads.h"
+
+#if BT_THREADSAFE
+
+#include "btQuickprof.h"
+#include "btAlignedObjectArray.h"
+#include "btMinMax.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+///
+/// btTaskSchedulerDefault -- built-in work-stealing thread pool.
+///
+/// Each thread (the calling thread included) owns a queue of jobs. parallelFor() splits the range into
+/// jobs, deals them out round-robin, wakes the workers and then works on its own queue like any other
+/// worker. A thread takes jobs from the back of its own queue and steals from the front of the others
+/// once it runs dry. Workers sleep on a condition variable between calls so an idle pool costs nothing.
+/// Nested parallelFor() calls run sequentially on the calling thread.
+///
+class btTaskSchedulerDefault : public btITaskScheduler
+{
+	struct Job
+	{
+		const btIParallelForBody* m_body;
+		int m_begin;
+		int m_end;
+	};
+
+	struct JobQueue
+	{
+		btSpinMutex m_mutex;
+		btAlignedObjectArray<Job> m_jobs;
+		int m_head;
+		char m_padding[ 64 ];  // keep neighbouring queues off each other's cache line
+
+		JobQueue() : m_head( 0 ) {}
+
+		bool popBack( Job* job )
+		{
+			bool found = false;
+			m_mutex.lock();
+			if ( m_head < m_jobs.size() )
+			{
+				*job = m_jobs[ m_jobs.size() - 1 ];
+				m_jobs.pop_back();
+				found = true;
+			}
+			m_mutex.unlock();
+			return found;
+		}
+
+		bool popFront( Job* job )
+		{
+			bool found = false;
+			m_mutex.lock();
+			if ( m_head < m_jobs.size() )
+			{
+				*job = m_jobs[ m_head++ ];
+				found = true;
+			}
+			m_mutex.unlock();
+			return found;
+		}
+	};
+
+	btAlignedObjectArray<std::thread*> m_threads;
+	JobQueue m_queues[ BT_MAX_THREAD_COUNT ];
+	int m_numThreads;
+	int m_maxNumThreads;
+
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCondition;
+	unsigned int m_generation;
+	bool m_quit;
+
+	std::atomic<int> m_jobsRemaining;
+
+	void runJob( const Job& job )
+	{
+		job.m_body->forLoop( job.m_begin, job.m_end );
+		m_jobsRemaining.fetch_sub( 1, std::memory_order_acq_rel );
+	}
+
+	// work on our own queue first, then steal from the others until everything is taken
+	void runJobs( int slot )
+	{
+		Job job;
+		for ( ;; )
+		{
+			if ( m_queues[ slot ].popBack( &job ) )
+			{
+				runJob( job );
+				continue;
+			}
+			bool stole = false;
+			for ( int i = 1; i < m_numThreads; ++i )
+			{
+				int victim = ( slot + i ) % m_numThreads;
+				if ( m_queues[ victim ].popFront( &job ) )
+				{
+					runJob( job );
+					stole = true;
+					break;
+				}
+			}
+			if ( !stole )
+			{
+				return;
+			}
+		}
+	}
+
+	void workerMain( int slot )
+	{
+		btGetCurrentThreadIndex();  // claim a thread index up front
+		unsigned int seenGeneration = 0;
+		for ( ;; )
+		{
+			{
+				std::unique_lock<std::mutex> lock( m_wakeMutex );
+				m_wakeCondition.wait( lock, [ this, seenGeneration ] { return m_quit || m_generation != seenGeneration; } );
+				if ( m_quit )
+				{
+					return;
+				}
+				seenGeneration = m_generation;
+			}
+			runJobs( slot );
+		}
+	}
+
+	void startThreads()
+	{
+		// the creating thread has to claim its thread index before the workers do, or a
+		// worker could end up as "main thread" index 0
+		btGetCurrentThreadIndex();
+		m_quit = false;
+		for ( int i = 1; i < m_numThreads; ++i )
+		{
+			m_threads.push_back( new std::thread( &btTaskSchedulerDefault::workerMain, this, i ) );
+		}
+	}
+
+	void stopThreads()
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_wakeMutex );
+			m_quit = true;
+		}
+		m_wakeCondition.notify_all();
+		for ( int i = 0; i < m_threads.size(); ++i )
+		{
+			m_threads[ i ]->join();
+			delete m_threads[ i ];
+		}
+		m_threads.clear();
+	}
+
+public:
+	btTaskSchedulerDefault() : btITaskScheduler( "Default" )
+	{
+		m_generation = 0;
+		m_quit = false;
+		m_jobsRemaining.store( 0 );
+		int numCores = int( std::thread::hardware_concurrency() );
+		m_maxNumThreads = btClamped( numCores, 1, int( BT_MAX_THREAD_COUNT ) );
+		m_numThreads = m_maxNumThreads;
+		startThreads();
+	}
+
+	virtual ~btTaskSchedulerDefault()
+	{
+		stopThreads();
+	}
+
+	virtual int getMaxNumThreads() const BT_OVERRIDE { return m_maxNumThreads; }
+	virtual int getNumThreads() const BT_OVERRIDE { return m_numThreads; }
+
+	virtual void setNumThreads( int numThreads ) BT_OVERRIDE
+	{
+		numThreads = btClamped( numThreads, 1, m_maxNumThreads );
+		if ( numThreads != m_numThreads )
+		{
+			stopThreads();
+			m_numThreads = numThreads;
+			startThreads();
+		}
+	}
+
+	virtual void parallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body ) BT_OVERRIDE
+	{
+		BT_PROFILE( "parallelFor_Default" );
+		int count = iEnd - iBegin;
+		if ( count <= 0 )
+		{
+			return;
+		}
+		// nested loops, tiny loops and a single thread don't go through the queues
+		if ( m_numThreads <= 1 || count <= grainSize || btThreadsAreRunning() )
+		{
+			body.forLoop( iBegin, iEnd );
+			return;
+		}
+
+		// a few jobs per thread so stealing can even out the load, but never smaller than the grain
+		int maxJobs = m_numThreads * 4;
+		int jobSize = btMax( btMax( grainSize, 1 ), ( count + maxJobs - 1 ) / maxJobs );
+		int numJobs = ( count + jobSize - 1 ) / jobSize;
+
+		btPushThreadsAreRunning();
+		m_jobsRemaining.store( numJobs, std::memory_order_release );
+		for ( int i = 0; i < numJobs; ++i )
+		{
+			Job job;
+			job.m_body = &body;
+			job.m_begin = iBegin + i * jobSize;
+			job.m_end = btMin( job.m_begin + jobSize, iEnd );
+			JobQueue& queue = m_queues[ i % m_numThreads ];
+			queue.m_mutex.lock();
+			if ( queue.m_head == queue.m_jobs.size() )
+			{
+				queue.m_jobs.resizeNoInitialize( 0 );
+				queue.m_head = 0;
+			}
+			queue.m_jobs.push_back( job );
+			queue.m_mutex.unlock();
+		}
+		{
+			std::lock_guard<std::mutex> lock( m_wakeMutex );
+			++m_generation;
+		}
+		m_wakeCondition.notify_all();
+
+		// the calling thread works too, then waits for jobs still running on other threads
+		runJobs( 0 );
+		while ( m_jobsRemaining.load( std::memory_order_acquire ) > 0 )
+		{
+			std::this_thread::yield();
+		}
+		btPopThreadsAreRunning();
+	}
+};
+
+
+btITaskScheduler* btCreateDefaultTaskScheduler()
+{
+	return new btTaskSchedulerDefault();
+}
+
+#else // #if BT_THREADSAFE
+
+btITaskScheduler* btCreateDefaultTaskScheduler()
+{
+	return NULL;
+}
+
+#endif // #else // #if BT_THREADSAFE